@@ -0,0 +1,65 @@
+// Batch benchmark: K guest instances of the same ALU loop (alu_loop from
+// workloads.h) run one after the other through Simulator, against all K at
+// once through BatchExecutor.
+#include "batch_executor.h"
+#include "simulator.h"
+#include "workloads.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+constexpr uint64_t ITERATIONS = 20'000;
+constexpr uint64_t MEMORY_BYTES = 64 * 1024;
+constexpr size_t LANE_COUNTS[] = {64, 1024};
+
+auto scalar_mips(size_t lanes) -> double {
+  Memory mem(MEMORY_BYTES);
+  workloads::load(mem, workloads::ALU_LOOP.words);
+  uint64_t retired = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t lane = 0; lane < lanes; lane++) {
+    arm64::CPUState cpu{};
+    cpu.setReg(1, ITERATIONS + lane % 7); // Slightly divergent trip counts
+    Simulator sim(cpu, mem);
+    sim.run();
+    retired += sim.stats().instructions;
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return static_cast<double>(retired) / elapsed.count() / 1e6;
+}
+
+struct BatchResult {
+  double mips;
+  double utilisation;
+  const char *path;
+};
+
+auto batch_run(size_t lanes, bool simd) -> BatchResult {
+  Memory mem(MEMORY_BYTES);
+  workloads::load(mem, workloads::ALU_LOOP.words);
+  BatchState state(lanes);
+  for (size_t lane = 0; lane < lanes; lane++) {
+    state.setReg(lane, 1, ITERATIONS + lane % 7);
+  }
+  BatchExecutor batch(state, mem, std::vector<Memory *>(lanes, &mem), simd);
+  batch.run();
+  return {batch.stats().mips(), batch.stats().utilisation(lanes),
+          batch.simdPath()};
+}
+} // namespace
+
+auto main() -> int {
+  for (size_t lanes : LANE_COUNTS) {
+    double scalar = scalar_mips(lanes);
+    BatchResult portable = batch_run(lanes, false);
+    BatchResult simd = batch_run(lanes, true);
+    std::fprintf(stderr,
+                 "lanes %5zu  scalar %7.1f MIPS  batch/portable %7.1f MIPS  "
+                 "batch/%s %7.1f MIPS  (%.1fx, utilisation %.2f)\n",
+                 lanes, scalar, portable.mips, simd.path, simd.mips,
+                 simd.mips / scalar, simd.utilisation);
+  }
+  return 0;
+}
@@ -0,0 +1,95 @@
+// Dispatch benchmark: the switch engine (Executor::runBlock) against the
+// direct-threaded engine (ThreadedExecutor::runBlock) on the same guest loops,
+// both fed from the same BlockCache so only dispatch differs, plus the Jit
+// driven the way the Simulator drives it. The interpreters also run with
+// macro-op fusion turned off, to show what fused pairs save in dispatches
+// per guest instruction and in MIPS.
+#include "block_cache.h"
+#include "executor.h"
+#include "jit.h"
+#include "threaded_executor.h"
+#include "workloads.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+constexpr uint64_t ITERATIONS = 2'000'000;
+// stride_loop walks 8 * ITERATIONS bytes in from each end of guest memory
+constexpr uint64_t MEMORY_BYTES = 64 * 1024 * 1024;
+
+struct Result {
+  double mips;
+  double dispatchesPerInstruction;
+};
+
+template <typename Engine>
+auto measure(const workloads::Kernel &kernel, Engine runBlock,
+             bool fuse = true) -> Result {
+  Memory mem(MEMORY_BYTES);
+  workloads::load(mem, kernel.words);
+  BlockCache cache(mem, fuse);
+  arm64::CPUState cpu{};
+  workloads::prepare(cpu, ITERATIONS, MEMORY_BYTES);
+
+  uint64_t retired = 0;
+  uint64_t dispatches = 0;
+  auto start = std::chrono::steady_clock::now();
+  while (cpu.getReg(1) != 0 || cpu.PC != kernel.words.size() * 4) {
+    const BasicBlock *block = cache.lookup(cpu.PC);
+    uint64_t executed =
+        runBlock(*block, block->instructions.size(), cpu, mem);
+    retired += executed;
+    dispatches += block->dispatches[executed];
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return {static_cast<double>(retired) / elapsed.count() / 1e6,
+          static_cast<double>(dispatches) / static_cast<double>(retired)};
+}
+auto measure_jit(const workloads::Kernel &kernel) -> double {
+  Memory mem(MEMORY_BYTES);
+  workloads::load(mem, kernel.words);
+  BlockCache cache(mem);
+  Jit jit(cache, mem);
+  arm64::CPUState cpu{};
+  workloads::prepare(cpu, ITERATIONS, MEMORY_BYTES);
+
+  uint64_t retired = 0;
+  auto start = std::chrono::steady_clock::now();
+  while (cpu.getReg(1) != 0 || cpu.PC != kernel.words.size() * 4) {
+    const BasicBlock *block = cache.lookup(cpu.PC);
+    retired += jit.runBlock(*block, UINT64_MAX, cpu);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return static_cast<double>(retired) / elapsed.count() / 1e6;
+}
+} // namespace
+
+auto main() -> int {
+  for (const workloads::Kernel &kernel : workloads::KERNELS) {
+    double viaSwitch = measure(kernel, Executor::runBlock).mips;
+    double viaThreaded = measure(kernel, ThreadedExecutor::runBlock).mips;
+    double viaJit = measure_jit(kernel);
+    std::fprintf(stderr,
+                 "%-11s switch %7.1f MIPS  threaded %7.1f MIPS  (%.2fx)  "
+                 "jit %7.1f MIPS  (%.2fx)\n",
+                 kernel.name, viaSwitch, viaThreaded, viaThreaded / viaSwitch,
+                 viaJit, viaJit / viaSwitch);
+  }
+  for (const workloads::Kernel &kernel : workloads::KERNELS) {
+    Result fused = measure(kernel, ThreadedExecutor::runBlock);
+    Result unfused = measure(kernel, ThreadedExecutor::runBlock, false);
+    std::fprintf(stderr,
+                 "%-11s fusion: dispatches/instr %.2f -> %.2f  "
+                 "threaded %7.1f -> %7.1f MIPS  (%.2fx)\n",
+                 kernel.name, unfused.dispatchesPerInstruction,
+                 fused.dispatchesPerInstruction, unfused.mips, fused.mips,
+                 fused.mips / unfused.mips);
+  }
+  std::fprintf(stderr, "computed goto: %s  jit: %s\n",
+               ThreadedExecutor::usesComputedGoto() ? "yes" : "no",
+               Jit::supported() ? "yes" : "no");
+  return 0;
+}
@@ -0,0 +1,225 @@
+// sim_bench: Google Benchmark suite over the simulator's hot paths.
+//
+//   Decoder/*   Decoder::decode and Decoder::decodeBlock on a randomized
+//               corpus and on the words of the guest kernels
+//               (both from workloads.h)
+//   Execute/*   Executor::execute on one instruction of each class
+//   Memory/*    read64/write64 sequential and random, by working-set size,
+//               and snapshot restore by number of dirty pages
+//   Kernel/*    whole guest loops through Simulator::run
+//
+// Results are tracked as JSON between releases:
+//   sim_bench --benchmark_out=sim_bench.json --benchmark_out_format=json
+// (the bench_json target does exactly this).
+#include "decoder.h"
+#include "executor.h"
+#include "simulator.h"
+#include "workloads.h"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+constexpr uint64_t MEMORY_BYTES = 64 * 1024 * 1024;
+constexpr uint64_t KERNEL_BYTES = 4 * 1024 * 1024;
+constexpr uint64_t KERNEL_ITERATIONS = 100'000;
+
+void decode_corpus(benchmark::State &state,
+                   const std::vector<uint32_t> &corpus) {
+  for (auto _ : state) {
+    for (uint32_t word : corpus) {
+      benchmark::DoNotOptimize(Decoder::decode(word));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * corpus.size());
+}
+
+void BM_DecodeRandom(benchmark::State &state) {
+  static const std::vector<uint32_t> corpus = workloads::random_corpus();
+  decode_corpus(state, corpus);
+}
+BENCHMARK(BM_DecodeRandom)->Name("Decoder/random");
+
+void BM_DecodeKernels(benchmark::State &state) {
+  static const std::vector<uint32_t> corpus = workloads::kernel_corpus();
+  decode_corpus(state, corpus);
+}
+BENCHMARK(BM_DecodeKernels)->Name("Decoder/kernels");
+
+void decode_corpus_block(benchmark::State &state,
+                         const std::vector<uint32_t> &corpus) {
+  std::vector<DecodedInstruction> decoded(corpus.size());
+  for (auto _ : state) {
+    Decoder::decodeBlock(corpus.data(), corpus.size(), decoded.data());
+    benchmark::DoNotOptimize(decoded.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * corpus.size());
+}
+
+void BM_DecodeBlockRandom(benchmark::State &state) {
+  static const std::vector<uint32_t> corpus = workloads::random_corpus();
+  decode_corpus_block(state, corpus);
+}
+BENCHMARK(BM_DecodeBlockRandom)->Name("Decoder/block_random");
+
+void BM_DecodeBlockKernels(benchmark::State &state) {
+  static const std::vector<uint32_t> corpus = workloads::kernel_corpus();
+  decode_corpus_block(state, corpus);
+}
+BENCHMARK(BM_DecodeBlockKernels)->Name("Decoder/block_kernels");
+
+// One instruction executed over and over against the same state. Loads and
+// stores use plain offset addressing so the address never moves.
+void BM_Execute(benchmark::State &state, uint32_t word) {
+  Memory mem(KERNEL_BYTES);
+  arm64::CPUState cpu{};
+  cpu.setReg(1, 7);
+  cpu.setReg(10, workloads::DATA_BASE);
+  DecodedInstruction instr = Decoder::decode(word);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Executor::execute(instr, cpu, mem));
+    cpu.PC = 0; // Taken branches would otherwise walk the PC away
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_Execute, add_imm, 0x91000800)->Name("Execute/add_imm");
+BENCHMARK_CAPTURE(BM_Execute, add_reg, 0x8B000042)->Name("Execute/add_reg");
+BENCHMARK_CAPTURE(BM_Execute, subs_imm, 0xF100003F)->Name("Execute/subs_imm");
+BENCHMARK_CAPTURE(BM_Execute, ldr, 0xF9400140)->Name("Execute/ldr");
+BENCHMARK_CAPTURE(BM_Execute, str, 0xF9000140)->Name("Execute/str");
+BENCHMARK_CAPTURE(BM_Execute, b, 0x14000010)->Name("Execute/b");
+BENCHMARK_CAPTURE(BM_Execute, b_cond, 0x54FFFF41)->Name("Execute/b_cond");
+
+// Working sets from L1-sized to well past the LLC
+void working_sets(benchmark::internal::Benchmark *bench) {
+  for (int64_t bytes = 16 << 10; bytes <= 64 << 20; bytes <<= 4) {
+    bench->Arg(bytes);
+  }
+}
+
+auto shuffled_offsets(uint64_t bytes) -> std::vector<uint64_t> {
+  std::vector<uint64_t> offsets(bytes / 8);
+  std::iota(offsets.begin(), offsets.end(), 0);
+  std::shuffle(offsets.begin(), offsets.end(), std::mt19937_64(7));
+  for (uint64_t &offset : offsets) {
+    offset *= 8;
+  }
+  return offsets;
+}
+
+void BM_ReadSequential(benchmark::State &state) {
+  uint64_t bytes = state.range(0);
+  Memory mem(MEMORY_BYTES);
+  for (uint64_t a = 0; a < bytes; a += 8) {
+    mem.write64(a, a);
+  }
+  for (auto _ : state) {
+    uint64_t sum = 0;
+    for (uint64_t a = 0; a < bytes; a += 8) {
+      sum += mem.read64(a);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BM_ReadSequential)->Name("Memory/read64_seq")->Apply(working_sets);
+
+void BM_WriteSequential(benchmark::State &state) {
+  uint64_t bytes = state.range(0);
+  Memory mem(MEMORY_BYTES);
+  for (auto _ : state) {
+    for (uint64_t a = 0; a < bytes; a += 8) {
+      mem.write64(a, a);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BM_WriteSequential)->Name("Memory/write64_seq")->Apply(working_sets);
+
+void BM_ReadRandom(benchmark::State &state) {
+  uint64_t bytes = state.range(0);
+  Memory mem(MEMORY_BYTES);
+  std::vector<uint64_t> offsets = shuffled_offsets(bytes);
+  for (uint64_t a : offsets) {
+    mem.write64(a, a);
+  }
+  for (auto _ : state) {
+    uint64_t sum = 0;
+    for (uint64_t a : offsets) {
+      sum += mem.read64(a);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BM_ReadRandom)->Name("Memory/read64_rand")->Apply(working_sets);
+
+void BM_WriteRandom(benchmark::State &state) {
+  uint64_t bytes = state.range(0);
+  Memory mem(MEMORY_BYTES);
+  std::vector<uint64_t> offsets = shuffled_offsets(bytes);
+  for (auto _ : state) {
+    for (uint64_t a : offsets) {
+      mem.write64(a, a);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BM_WriteRandom)->Name("Memory/write64_rand")->Apply(working_sets);
+
+// Reset of a 1 GiB guest with a populated image after a short run that
+// dirtied range(0) pages
+void BM_Restore(benchmark::State &state) {
+  uint64_t pages = state.range(0);
+  Memory mem(uint64_t{1} << 30);
+  for (uint64_t a = 0; a < (uint64_t{16} << 20); a += Memory::PAGE_SIZE) {
+    mem.write64(a, a);
+  }
+  mem.snapshot();
+  for (auto _ : state) {
+    for (uint64_t p = 0; p < pages; p++) {
+      mem.write64(p * 64 * Memory::PAGE_SIZE, p);
+    }
+    mem.restore();
+  }
+  state.SetItemsProcessed(state.iterations() * pages);
+}
+BENCHMARK(BM_Restore)->Name("Memory/restore")->Arg(1)->Arg(16)->Arg(256);
+
+// A whole guest loop per iteration, through the block cache; items are
+// guest instructions, so items_per_second is the end-to-end MIPS figure
+void BM_Kernel(benchmark::State &state, const workloads::Kernel &kernel) {
+  Memory mem(KERNEL_BYTES);
+  workloads::load(mem, kernel.words);
+  uint64_t retired = 0;
+  for (auto _ : state) {
+    arm64::CPUState cpu{};
+    cpu.setReg(1, KERNEL_ITERATIONS);
+    cpu.setReg(10, workloads::DATA_BASE);
+    cpu.setReg(11, KERNEL_BYTES);
+    Simulator sim(cpu, mem);
+    sim.run();
+    retired += sim.stats().instructions;
+  }
+  state.SetItemsProcessed(retired);
+}
+BENCHMARK_CAPTURE(BM_Kernel, alu_loop, workloads::ALU_LOOP)
+    ->Name("Kernel/alu_loop")
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Kernel, mem_loop, workloads::MEM_LOOP)
+    ->Name("Kernel/mem_loop")
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Kernel, stride_loop, workloads::STRIDE_LOOP)
+    ->Name("Kernel/stride_loop")
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Kernel, field_loop, workloads::FIELD_LOOP)
+    ->Name("Kernel/field_loop")
+    ->Unit(benchmark::kMillisecond);
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,130 @@
+#pragma once
+// Guest workloads shared by the benchmarks, so every bench measures the same
+// instruction mix and the same loops.
+#include "memory.h"
+#include "registers.h"
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace workloads {
+constexpr size_t CORPUS_WORDS = 1 << 16;
+// Loads and stores of the kernels start at X10 = DATA_BASE; stride_loop also
+// pushes down from X11 = the top of guest memory
+constexpr uint64_t DATA_BASE = 0x8000;
+
+struct Kernel {
+  const char *name;
+  std::vector<uint32_t> words;
+};
+
+// Each kernel counts X1 down to zero and branches back to address 0
+inline const Kernel ALU_LOOP = {"alu_loop",
+                                {
+                                    0x91000800, // ADD  X0, X0, #2
+                                    0x8B000042, // ADD  X2, X2, X0
+                                    0xCB000063, // SUB  X3, X3, X0
+                                    0x91000484, // ADD  X4, X4, #1
+                                    0xD1000421, // SUB  X1, X1, #1
+                                    0xF100003F, // CMP  X1, #0
+                                    0x54FFFF41, // B.NE #-24
+                                }};
+inline const Kernel MEM_LOOP = {"mem_loop",
+                                {
+                                    0xF9400140, // LDR  X0, [X10]
+                                    0x91000400, // ADD  X0, X0, #1
+                                    0xF9000140, // STR  X0, [X10]
+                                    0xF9400542, // LDR  X2, [X10, #8]
+                                    0xD1000421, // SUB  X1, X1, #1
+                                    0xF100003F, // CMP  X1, #0
+                                    0x54FFFF41, // B.NE #-24
+                                }};
+inline const Kernel STRIDE_LOOP = {"stride_loop",
+                                   {
+                                       0xF8408540, // LDR  X0, [X10], #8
+                                       0x8B000042, // ADD  X2, X2, X0
+                                       0xF81F8D62, // STR  X2, [X11, #-8]!
+                                       0xD1000421, // SUB  X1, X1, #1
+                                       0xF100003F, // CMP  X1, #0
+                                       0x54FFFF61, // B.NE #-20
+                                   }};
+inline const Kernel FIELD_LOOP = {"field_loop",
+                                  {
+                                      0x9100214B, // ADD  X11, X10, #8
+                                      0xF9400160, // LDR  X0, [X11]
+                                      0x8B000042, // ADD  X2, X2, X0
+                                      0xF1000421, // SUBS X1, X1, #1
+                                      0x54FFFF81, // B.NE #-16
+                                  }};
+inline const Kernel KERNELS[] = {ALU_LOOP, MEM_LOOP, STRIDE_LOOP, FIELD_LOOP};
+
+// Copy words into mem from address 0
+inline void load(Memory &mem, const std::vector<uint32_t> &words) {
+  for (size_t i = 0; i < words.size(); i++) {
+    mem.write<uint32_t>(i * 4, words[i]);
+  }
+}
+
+// Registers for iterations of any kernel in a guest memory of memoryBytes.
+// stride_loop touches 8 * iterations bytes from each end.
+inline void prepare(arm64::CPUState &cpu, uint64_t iterations,
+                    uint64_t memoryBytes) {
+  cpu.setReg(1, iterations);
+  cpu.setReg(10, DATA_BASE);
+  cpu.setReg(11, memoryBytes);
+}
+
+// Mixed corpus: every supported class with random fields, plus a share of
+// words that do not decode, so no decoder gets a single-class fast path
+inline auto random_corpus() -> std::vector<uint32_t> {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<uint32_t> any;
+  std::vector<uint32_t> words;
+  words.reserve(CORPUS_WORDS);
+  for (size_t i = 0; i < CORPUS_WORDS; i++) {
+    uint32_t r = any(rng);
+    uint32_t regs = r & 0x3FF;             // Rn, Rd
+    uint32_t imm12 = ((r >> 10) & 0xFFF) << 10;
+    switch (r % 8) {
+    case 0:
+      words.push_back(0x91000000 | imm12 | regs); // ADD (imm)
+      break;
+    case 1:
+      words.push_back(0xF1000000 | imm12 | regs); // SUBS (imm)
+      break;
+    case 2:
+      words.push_back(0x8B000000 | ((r >> 22) & 0x1F) << 16 | regs); // ADD
+      break;
+    case 3:
+      words.push_back(0xF9400000 | imm12 | regs); // LDR (unsigned offset)
+      break;
+    case 4:
+      words.push_back(0xF8000C00 | ((r >> 12) & 0x1FF) << 12 | regs); // STR!
+      break;
+    case 5:
+      words.push_back(0x14000000 | (r & 0x3FFFFFF)); // B
+      break;
+    case 6:
+      words.push_back(0x54000000 | ((r >> 4) & 0x7FFFF) << 5 | (r & 0xF));
+      break;
+    default:
+      words.push_back(r); // Random word, mostly UNKNOWN
+      break;
+    }
+  }
+  return words;
+}
+
+// The kernels' own words, repeated to the corpus size
+inline auto kernel_corpus() -> std::vector<uint32_t> {
+  std::vector<uint32_t> words;
+  words.reserve(CORPUS_WORDS);
+  while (words.size() < CORPUS_WORDS) {
+    for (const Kernel &kernel : KERNELS) {
+      words.insert(words.end(), kernel.words.begin(), kernel.words.end());
+    }
+  }
+  words.resize(CORPUS_WORDS);
+  return words;
+}
+} // namespace workloads
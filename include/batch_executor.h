@@ -0,0 +1,125 @@
+#pragma once
+#include "block_cache.h"
+#include "memory.h"
+#include "registers.h"
+#include "simulator.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Architectural state of K independent guest instances ("lanes") in
+ * structure-of-arrays layout, so one instruction can be applied to every lane
+ * with SIMD loads and stores.
+ * - X: register rows of stride() lanes each; register r of lane l lives at
+ * X[r * stride() + l]. Row 31 is all zeros (XZR reads) and row 32 absorbs
+ * writes to XZR, so ALU kernels never special-case register 31.
+ * - SP, PC: one entry per lane
+ * - N, Z, C, V: condition flags, 0 or 1 per lane
+ * - running: non-zero while the lane is still executing
+ * - retired: instructions the lane has retired
+ *
+ * stride() is lanes() rounded up to the SIMD width; padding lanes never run.
+ */
+struct BatchState {
+  static constexpr uint8_t ZERO_ROW = 31;
+  static constexpr uint8_t DISCARD_ROW = 32;
+  static constexpr size_t REG_ROWS = 33;
+  static constexpr size_t LANE_ALIGN = 4; // 256-bit vectors of 64-bit lanes
+
+  explicit BatchState(size_t lanes);
+
+  auto lanes() const -> size_t { return laneCount; }
+  auto stride() const -> size_t { return laneStride; }
+  auto row(uint8_t reg) -> uint64_t * { return X.data() + reg * laneStride; }
+
+  // Register access with XZR semantics, as CPUState::getReg/setReg
+  auto getReg(size_t lane, uint8_t reg) const -> uint64_t;
+  void setReg(size_t lane, uint8_t reg, uint64_t value);
+  // Copy one lane out to, or in from, an ordinary CPUState
+  auto lane(size_t index) const -> arm64::CPUState;
+  void setLane(size_t index, const arm64::CPUState &cpu);
+  // The lane's flags packed as arm64::PState::nzcv() packs them
+  auto nzcv(size_t lane) const -> uint8_t;
+  void setNZCV(size_t lane, uint8_t value);
+
+  std::vector<uint64_t> X;
+  std::vector<uint64_t> SP;
+  std::vector<uint64_t> PC;
+  std::vector<uint64_t> N;
+  std::vector<uint64_t> Z;
+  std::vector<uint64_t> C;
+  std::vector<uint64_t> V;
+  std::vector<uint8_t> running;
+  std::vector<uint64_t> retired;
+
+private:
+  size_t laneCount;
+  size_t laneStride;
+};
+
+/**
+ * @brief Counters for a BatchExecutor.
+ * - laneInstructions: instructions retired, summed over all lanes
+ * - issued: instructions dispatched to the lane kernels (once per group of
+ * lanes, whatever the mask)
+ * - hostSeconds: wall-clock time spent inside run()
+ */
+struct BatchStats {
+  uint64_t laneInstructions = 0;
+  uint64_t issued = 0;
+  double hostSeconds = 0.0;
+
+  // Aggregate millions of guest instructions per host second
+  auto mips() const -> double;
+  // Fraction of lane slots doing useful work (1.0 without divergence)
+  auto utilisation(size_t lanes) const -> double;
+};
+
+/**
+ * @brief BatchExecutor runs the same guest code over every lane of a
+ * BatchState. Code is fetched from one Memory through a BlockCache; data
+ * accesses of lane l go to laneMemory[l] (entries may repeat to share data).
+ *
+ * Each step picks the smallest PC among running lanes and executes the block
+ * there for exactly the lanes at that PC (the mask). 64-bit ADD/SUB are
+ * applied to all lanes at once with AVX2 on x86-64 hosts that support it,
+ * NEON on AArch64 hosts, or a portable loop otherwise, and the results are
+ * blended into the masked lanes only. Loads, stores and W-register ADD/SUB
+ * run per masked lane. A conditional branch that splits the mask leaves the
+ * lanes at different PCs; running the lowest PC first makes lanes that left
+ * a loop early wait at its exit until the rest catch up, so they reconverge
+ * there.
+ *
+ * The semantics match Executor instruction for instruction, so any lane can
+ * be checked against a scalar Simulator run from the same start state.
+ */
+class BatchExecutor {
+public:
+  // allowSimd = false forces the portable kernels (for testing)
+  BatchExecutor(BatchState &state, Memory &code,
+                std::vector<Memory *> laneMemory, bool allowSimd = true);
+
+  // Run until every lane has stopped or retired max_instructions
+  auto run(uint64_t max_instructions = Simulator::NO_LIMIT) -> void;
+  // Why the lane stopped (InstructionLimit while it is still running)
+  auto stopReason(size_t lane) const -> StopReason { return reasons[lane]; }
+  auto stats() const -> const BatchStats & { return batchStats; }
+  // Kernel set in use: "avx2", "neon" or "scalar"
+  auto simdPath() const -> const char *;
+
+private:
+  auto step(uint64_t max_instructions) -> void;
+  auto executeAlu(const DecodedInstruction &instr) -> void;
+  auto executeAlu32(const DecodedInstruction &instr) -> void;
+  auto executeMemory(const DecodedInstruction &instr) -> void;
+  auto finishBranch(const DecodedInstruction &instr, uint64_t pc) -> void;
+
+  BatchState &state;
+  std::vector<Memory *> laneMemory;
+  BlockCache blocks;
+  bool simd;
+  std::vector<uint64_t> mask; // ~0 for lanes in the current step, else 0
+  std::vector<StopReason> reasons;
+  BatchStats batchStats;
+};
@@ -0,0 +1,120 @@
+#pragma once
+#include "decoder.h"
+#include "memory.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Adjacent instruction pairs that the block engines run as a single
+ * dispatch (macro-op fusion). BlockCache finds them when it builds a block.
+ * - CompareBranch: SUBS/CMP (immediate or register) followed by B.cond; the
+ * branch condition is evaluated from the subtraction's operands instead of
+ * from the flags it records
+ * - AddLoad: ADD Xd, Xn, #imm (not ADDS) followed by an LDR whose base
+ * register is Xd
+ */
+enum class MacroOp : uint8_t { None, CompareBranch, AddLoad };
+constexpr size_t MACRO_OP_COUNT = static_cast<size_t>(MacroOp::AddLoad) + 1;
+
+/**
+ * @brief A run of guest instructions that is entered only at its first
+ * instruction and left only after its last one. Blocks end at the first
+ * BRANCH/BRANCH_COND (which is included), just before the first word that does
+ * not decode, or after BlockCache::MAX_BLOCK_INSTRUCTIONS words.
+ * - startPC: guest address of the first instruction
+ * - endPC: guest address one past the last instruction
+ * - instructions: decoded instructions, packed as MicroOps; instructions[i]
+ * lives at startPC + 4*i
+ * - fusion: fusion[i] is the MacroOp that instructions[i] starts, or None;
+ * the second instruction of a pair is always None. Same length as
+ * instructions.
+ * - dispatches: dispatches[k] is the number of dispatches a block engine makes
+ * to retire the first k instructions, counting a pair once when both halves
+ * are among them (k = 0 .. instructions.size())
+ * - valid: cleared when a write lands on the block's code; a run loop that is
+ * part-way through the block must stop before the next instruction
+ */
+struct BasicBlock {
+  uint64_t startPC = 0;
+  uint64_t endPC = 0;
+  std::vector<MicroOp> instructions;
+  std::vector<MacroOp> fusion;
+  std::vector<uint8_t> dispatches;
+  bool valid = true;
+};
+
+/**
+ * @brief Counters describing how well the cache is doing.
+ * - hits: lookups served from an already decoded block
+ * - misses: lookups that had to decode a new block
+ * - invalidations: blocks dropped because their code was written
+ */
+struct BlockCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t invalidations = 0;
+};
+
+/**
+ * @brief BlockCache decodes guest code once per basic block and keeps the
+ * result keyed by the block's start PC, so loops stop paying for
+ * Decoder::decode on every iteration. It registers itself as the Memory's
+ * CodeWriteObserver and marks every page it decodes from with
+ * Memory::watchCode(); a later write to one of those pages drops every block
+ * overlapping the written bytes. Dropped blocks are kept alive until the next
+ * lookup() so a caller still executing one can notice BasicBlock::valid going
+ * false without touching freed memory.
+ *
+ * Building a block also marks its fusible pairs (see MacroOp), scanning left
+ * to right so pairs never overlap. Fusion can be turned off at construction,
+ * which leaves every BasicBlock::fusion entry None, so benchmarks and tests
+ * can compare the two.
+ */
+class BlockCache : public CodeWriteObserver {
+public:
+  static constexpr size_t MAX_BLOCK_INSTRUCTIONS = 64;
+
+  explicit BlockCache(Memory &mem, bool fuse = true);
+  ~BlockCache() override;
+  BlockCache(const BlockCache &) = delete;
+  auto operator=(const BlockCache &) -> BlockCache & = delete;
+
+  // Returns the block starting at pc, decoding it on a miss. Never null; the
+  // block has no instructions if the word at pc does not decode.
+  auto lookup(uint64_t pc) -> const BasicBlock *;
+  // Drop every block overlapping [address, address + length)
+  void invalidate(uint64_t address, uint64_t length);
+  // Drop every block
+  void flush();
+
+  void onCodeWrite(uint64_t address, uint64_t length) override;
+
+  // The MacroOp formed by first followed by second, or None
+  static auto macroOp(const DecodedInstruction &first,
+                      const DecodedInstruction &second) -> MacroOp;
+
+  auto size() const -> size_t { return blocks.size(); }
+  auto fusing() const -> bool { return fuse; }
+  auto stats() const -> const BlockCacheStats & { return cacheStats; }
+
+private:
+  static constexpr size_t FAST_ENTRIES = 1024;
+
+  auto build(uint64_t pc) -> BasicBlock *;
+  void drop(std::unique_ptr<BasicBlock> block);
+
+  Memory &mem;
+  bool fuse;
+  std::unordered_map<uint64_t, std::unique_ptr<BasicBlock>> blocks;
+  // Start PCs of the blocks that have code on each page
+  std::unordered_map<uint64_t, std::vector<uint64_t>> pageBlocks;
+  // Direct-mapped front end for lookup(), indexed by (pc >> 2)
+  std::array<BasicBlock *, FAST_ENTRIES> fast{};
+  // Invalidated blocks, freed at the next lookup()
+  std::vector<std::unique_ptr<BasicBlock>> retired;
+  BlockCacheStats cacheStats;
+};
@@ -0,0 +1,247 @@
+#pragma once
+#include "config_file.h"
+#include "retire_observer.h"
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Interface of a conditional branch direction predictor. predict()
+ * is asked first and update() is then told the outcome of the same branch,
+ * before the next branch is predicted.
+ */
+class DirectionPredictor {
+public:
+  virtual ~DirectionPredictor() = default;
+  virtual auto name() const -> const char * = 0;
+  // Predicted direction of the B.cond at pc (true: taken)
+  virtual auto predict(uint64_t pc) -> bool = 0;
+  // Train on the real direction of the B.cond at pc
+  virtual void update(uint64_t pc, bool taken) = 0;
+  // Forget all training
+  virtual void reset() = 0;
+};
+
+/**
+ * @brief 2^tableBits two-bit saturating counters indexed by the PC.
+ */
+class BimodalPredictor : public DirectionPredictor {
+public:
+  explicit BimodalPredictor(uint32_t tableBits = 12);
+  auto name() const -> const char * override { return "bimodal"; }
+  auto predict(uint64_t pc) -> bool override;
+  void update(uint64_t pc, bool taken) override;
+  void reset() override;
+
+private:
+  std::vector<uint8_t> counters;
+};
+
+/**
+ * @brief 2^tableBits two-bit counters indexed by the PC XORed with the last
+ * historyBits branch directions (McFarling's gshare).
+ */
+class GsharePredictor : public DirectionPredictor {
+public:
+  explicit GsharePredictor(uint32_t tableBits = 12, uint32_t historyBits = 12);
+  auto name() const -> const char * override { return "gshare"; }
+  auto predict(uint64_t pc) -> bool override;
+  void update(uint64_t pc, bool taken) override;
+  void reset() override;
+
+private:
+  auto index(uint64_t pc) const -> size_t;
+
+  std::vector<uint8_t> counters;
+  uint64_t history = 0;
+  uint64_t historyMask;
+};
+
+/**
+ * @brief A small TAGE: a bimodal base table plus TAGGED_TABLES tables of
+ * 2^(tableBits - 2) entries, tagged with TAG_BITS bits and indexed with
+ * geometrically longer global histories (HISTORY_LENGTHS, up to 64 branches).
+ * The longest matching table provides the prediction, the next match (or
+ * the base) is the alternate. Each entry has a 3-bit signed counter and a
+ * 2-bit useful counter; after a mispredict one entry is allocated in a
+ * longer table whose victim is not useful, and the useful counters of all
+ * tables are halved every USEFUL_RESET_PERIOD branches so stale entries can
+ * be replaced.
+ */
+class TagePredictor : public DirectionPredictor {
+public:
+  static constexpr size_t TAGGED_TABLES = 4;
+  static constexpr std::array<uint32_t, TAGGED_TABLES> HISTORY_LENGTHS = {
+      4, 10, 24, 64};
+  static constexpr uint32_t TAG_BITS = 10;
+  static constexpr uint64_t USEFUL_RESET_PERIOD = 256 * 1024;
+
+  explicit TagePredictor(uint32_t tableBits = 12);
+  auto name() const -> const char * override { return "tage"; }
+  auto predict(uint64_t pc) -> bool override;
+  void update(uint64_t pc, bool taken) override;
+  void reset() override;
+
+private:
+  struct Entry {
+    uint16_t tag = 0;
+    int8_t counter = 0; // -4..3, taken when >= 0
+    uint8_t useful = 0; // 0..3
+    bool valid = false;
+  };
+  // Where the prediction for one branch comes from
+  struct Lookup {
+    std::array<size_t, TAGGED_TABLES> index{};
+    std::array<uint16_t, TAGGED_TABLES> tag{};
+    int provider = -1;  // Tagged table, or -1 for the base
+    int alternate = -1; // Next shorter match, or -1 for the base
+    bool prediction = false;
+    bool alternatePrediction = false;
+  };
+
+  auto lookup(uint64_t pc) const -> Lookup;
+  auto fold(uint32_t length, uint32_t bits) const -> uint64_t;
+
+  std::vector<uint8_t> base; // Two-bit counters
+  std::array<std::vector<Entry>, TAGGED_TABLES> tables;
+  uint32_t taggedBits;
+  uint64_t history = 0;
+  uint64_t branches = 0;
+};
+
+/**
+ * @brief Set-associative branch target buffer: maps the PC of a taken
+ * branch to its target, with LRU replacement within a set.
+ */
+class BranchTargetBuffer {
+public:
+  // entries / ways must be a power of two
+  explicit BranchTargetBuffer(uint32_t entries = 1024, uint32_t ways = 4);
+
+  // The target remembered for pc; false when pc is not in the buffer
+  auto lookup(uint64_t pc, uint64_t &target) -> bool;
+  // Remember that the branch at pc went to target
+  void update(uint64_t pc, uint64_t target);
+  void reset();
+
+private:
+  struct Entry {
+    uint64_t pc = 0;
+    uint64_t target = 0;
+    uint64_t stamp = 0;
+    bool valid = false;
+  };
+
+  auto set(uint64_t pc) -> Entry *;
+
+  std::vector<Entry> entries;
+  uint32_t ways;
+  size_t sets;
+  uint64_t clock = 0;
+};
+
+enum class PredictorKind { Bimodal, Gshare, Tage };
+
+/**
+ * @brief Parameters of a BranchModel.
+ * - kind: direction predictor to build
+ * - tableBits: log2 of the counter table size (bimodal, gshare, TAGE base)
+ * - historyBits: global history length of gshare
+ * - btbEntries, btbWays: branch target buffer geometry
+ *
+ * load() reads a config_file over the defaults. Keys are predictor (bimodal,
+ * gshare or tage), table_bits, history_bits, btb_entries and btb_ways;
+ * btb_entries / btb_ways must be a power of two.
+ */
+struct BranchConfig {
+  PredictorKind kind = PredictorKind::Tage;
+  uint32_t tableBits = 12;
+  uint32_t historyBits = 12;
+  uint32_t btbEntries = 1024;
+  uint32_t btbWays = 4;
+
+  auto load(const std::string &path, std::string &error) -> bool;
+  auto parse(std::istream &in, std::string &error) -> bool;
+};
+
+// Build the direction predictor config.kind names
+auto make_predictor(const BranchConfig &config)
+    -> std::unique_ptr<DirectionPredictor>;
+
+/**
+ * @brief Prediction outcomes of the branch at one PC.
+ * - executed, taken: times it retired, and was taken
+ * - mispredicts: wrong direction, or taken without the right BTB target
+ */
+struct PcBranchStats {
+  uint64_t executed = 0;
+  uint64_t taken = 0;
+  uint64_t mispredicts = 0;
+
+  // Mispredicts per execution
+  auto rate() const -> double;
+};
+
+/**
+ * @brief Totals of a BranchModel.
+ * - instructions: instructions retired (for MPKI)
+ * - conditional, directionMispredicts: B.cond retired, and predicted in the
+ * wrong direction
+ * - unconditional: B retired
+ * - targetMisses: taken branches predicted taken (B always) whose target the
+ * BTB did not hold or held wrong
+ */
+struct BranchStats {
+  uint64_t instructions = 0;
+  uint64_t conditional = 0;
+  uint64_t directionMispredicts = 0;
+  uint64_t unconditional = 0;
+  uint64_t targetMisses = 0;
+
+  auto mispredicts() const -> uint64_t {
+    return directionMispredicts + targetMisses;
+  }
+  // Mispredicts per thousand instructions
+  auto mpki() const -> double;
+};
+
+/**
+ * @brief Runs a DirectionPredictor and a BranchTargetBuffer on the retired
+ * branch stream as a RetireObserver. Every B.cond is predicted and then
+ * trained with its outcome; every B, and every B.cond predicted and actually
+ * taken, looks up and then trains the BTB. The predictor sees branches in
+ * retirement order and is updated at once, i.e. there are no in-flight
+ * branches with stale history.
+ */
+class BranchModel : public RetireObserver {
+public:
+  explicit BranchModel(const BranchConfig &config = {});
+  BranchModel(std::unique_ptr<DirectionPredictor> predictor,
+              const BranchConfig &config);
+
+  void onRetire(const RetiredInstruction &retired) override;
+
+  auto stats() const -> const BranchStats & { return branchStats; }
+  auto pcStats() const
+      -> const std::unordered_map<uint64_t, PcBranchStats> & {
+    return perPc;
+  }
+  // The count branches with the most mispredicts, worst first
+  auto hottest(size_t count) const
+      -> std::vector<std::pair<uint64_t, PcBranchStats>>;
+  auto predictor() const -> const DirectionPredictor & { return *direction; }
+  void reset();
+  // Totals, MPKI and the branches mispredicting the most
+  auto report(std::ostream &out) const -> void;
+
+private:
+  std::unique_ptr<DirectionPredictor> direction;
+  BranchTargetBuffer btb;
+  std::unordered_map<uint64_t, PcBranchStats> perPc;
+  BranchStats branchStats;
+};
@@ -0,0 +1,215 @@
+#pragma once
+#include "config_file.h"
+#include "retire_observer.h"
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum class ReplacementPolicy {
+  LRU,  // True least recently used (per-line timestamps)
+  PLRU, // Tree pseudo-LRU (ways must be a power of two)
+  RRIP, // Static RRIP: 2-bit re-reference predictions, insert at "long"
+};
+
+/**
+ * @brief Geometry and policies of one cache.
+ * - sizeBytes: capacity; 0 leaves the level out of the hierarchy
+ * - ways: associativity (1 to 64)
+ * - lineBytes: line size (a power of two, at least 8)
+ * - policy: replacement policy
+ * - writeBack: stores dirty the line and reach the next level on eviction;
+ * otherwise every store is written through
+ * - writeAllocate: a store miss fills the line; otherwise it only goes on
+ * to the next level
+ */
+struct CacheConfig {
+  uint32_t sizeBytes = 32 * 1024;
+  uint32_t ways = 8;
+  uint32_t lineBytes = 64;
+  ReplacementPolicy policy = ReplacementPolicy::LRU;
+  bool writeBack = true;
+  bool writeAllocate = true;
+
+  // Empty when the geometry is usable, else why it is not
+  auto validate() const -> std::string;
+};
+
+/**
+ * @brief Counters of one cache.
+ * - reads, writes: accesses from the level above (writes include its
+ * writebacks and write-throughs)
+ * - readMisses, writeMisses: accesses that did not find their line
+ * - evictions: valid lines replaced by a fill
+ * - writebacks: dirty lines written to the next level on eviction
+ * - prefetches: lines filled by fill() rather than by a demand access
+ */
+struct CacheStats {
+  uint64_t reads = 0;
+  uint64_t writes = 0;
+  uint64_t readMisses = 0;
+  uint64_t writeMisses = 0;
+  uint64_t evictions = 0;
+  uint64_t writebacks = 0;
+  uint64_t prefetches = 0;
+
+  auto accesses() const -> uint64_t { return reads + writes; }
+  auto misses() const -> uint64_t { return readMisses + writeMisses; }
+  // Misses per access (0 before the first access)
+  auto missRate() const -> double;
+};
+
+/**
+ * @brief A set-associative cache that tracks tags only (no data). The level
+ * above decides what to do with a miss; access() reports it and the dirty
+ * victim, if any, that has to be written back.
+ */
+class Cache {
+public:
+  /**
+   * @brief What one access did.
+   * - hit: the line was present
+   * - writeback: a dirty line was evicted to make room
+   * - victim: address of the evicted dirty line
+   */
+  struct Outcome {
+    bool hit = false;
+    bool writeback = false;
+    uint64_t victim = 0;
+  };
+
+  // config must validate()
+  explicit Cache(const CacheConfig &config);
+
+  // Look up the line holding address, filling it on a miss unless this is a
+  // store and the cache does not write-allocate
+  auto access(uint64_t address, bool write) -> Outcome;
+  // Bring the line holding address in without counting an access, as a
+  // prefetch does; a present line is left alone (Outcome::hit)
+  auto fill(uint64_t address) -> Outcome;
+  // True when the line holding address is present (no side effects)
+  auto contains(uint64_t address) const -> bool;
+  // Drop every line and counter
+  void reset();
+
+  auto stats() const -> const CacheStats & { return cacheStats; }
+  auto config() const -> const CacheConfig & { return cacheConfig; }
+
+private:
+  struct Line {
+    uint64_t tag = 0;   // address / lineBytes
+    uint64_t stamp = 0; // LRU: last use
+    bool valid = false;
+    bool dirty = false;
+    uint8_t rrpv = 0; // RRIP: re-reference prediction
+  };
+
+  auto find(uint64_t tag) const -> const Line *;
+  // Replace a line of set with tag, reporting a dirty victim in outcome
+  void insert(size_t set, uint64_t tag, bool dirty, Outcome &outcome);
+  auto victim(size_t set) -> size_t;
+  void touch(size_t set, size_t way, bool fill);
+
+  CacheConfig cacheConfig;
+  size_t sets = 0;
+  uint32_t lineShift = 0;
+  uint32_t treeDepth = 0; // PLRU: log2(ways)
+  std::vector<Line> lines;    // sets * ways, set-major
+  std::vector<uint64_t> plru; // PLRU: one tree of ways - 1 bits per set
+  uint64_t clock = 0;
+  CacheStats cacheStats;
+};
+
+enum class CacheLevel { L1I, L1D, L2, LLC };
+constexpr size_t CACHE_LEVEL_COUNT = 4;
+
+/**
+ * @brief Configuration of every level, indexed by CacheLevel. Defaults:
+ * - L1I: 32 KiB, 8-way, PLRU
+ * - L1D: 32 KiB, 8-way, PLRU
+ * - L2: 512 KiB, 8-way, LRU
+ * - LLC: 8 MiB, 16-way, RRIP
+ * All with 64-byte lines, write-back and write-allocate.
+ *
+ * load() reads a config_file over the defaults. The keys are <level>.<field>,
+ * with level one of l1i, l1d, l2 or llc and field one of size, ways, line,
+ * policy (LRU, PLRU or RRIP), write_back and write_allocate (0 or 1), e.g.
+ * "l2.size = 1048576". Every level is validated after the whole file is read.
+ */
+struct CacheHierarchyConfig {
+  std::array<CacheConfig, CACHE_LEVEL_COUNT> levels = {{
+      {32 * 1024, 8, 64, ReplacementPolicy::PLRU, true, true},
+      {32 * 1024, 8, 64, ReplacementPolicy::PLRU, true, true},
+      {512 * 1024, 8, 64, ReplacementPolicy::LRU, true, true},
+      {8 * 1024 * 1024, 16, 64, ReplacementPolicy::RRIP, true, true},
+  }};
+
+  auto load(const std::string &path, std::string &error) -> bool;
+  auto parse(std::istream &in, std::string &error) -> bool;
+  auto operator[](CacheLevel level) -> CacheConfig & {
+    return levels[static_cast<size_t>(level)];
+  }
+};
+
+/**
+ * @brief Cache behaviour of the accesses made by the instruction at one PC.
+ * - loads, stores: data accesses issued (a line-crossing access counts once)
+ * - misses: by CacheLevel, misses caused by fetching the instruction and by
+ * its data accesses
+ */
+struct PcCacheStats {
+  uint64_t loads = 0;
+  uint64_t stores = 0;
+  std::array<uint64_t, CACHE_LEVEL_COUNT> misses{};
+
+  auto totalMisses() const -> uint64_t;
+};
+
+/**
+ * @brief L1I/L1D/L2/LLC hierarchy driven by the retired instruction stream as
+ * a RetireObserver. Every instruction is fetched through L1I and every
+ * LDR/STR accesses L1D with its effective address (both lines when it
+ * crosses a line boundary); misses, writebacks and write-throughs continue
+ * into the shared L2 and LLC, and LLC misses go to memory. The hierarchy is
+ * non-inclusive: each level fills on its own misses and evicts on its own.
+ * Levels configured with size 0 are skipped.
+ */
+class CacheHierarchy : public RetireObserver {
+public:
+  explicit CacheHierarchy(const CacheHierarchyConfig &config = {});
+
+  void onRetire(const RetiredInstruction &retired) override;
+
+  // Nullptr when the level is left out
+  auto level(CacheLevel level) const -> const Cache *;
+  auto pcStats() const -> const std::unordered_map<uint64_t, PcCacheStats> & {
+    return perPc;
+  }
+  // The count PCs with the most misses over all levels, worst first
+  auto hottest(size_t count) const
+      -> std::vector<std::pair<uint64_t, PcCacheStats>>;
+  void reset();
+  // Fill the line holding address into every data-side level that lacks it
+  // (L1D, L2, LLC), writing back dirty victims; for prefetchers
+  void prefetch(uint64_t address);
+  // Per-level counters and the PCs missing the most
+  auto report(std::ostream &out) const -> void;
+
+private:
+  // Access address at path[index] and, on a miss, the levels below it.
+  // Returns how many levels in a row missed, starting at path[index].
+  auto access(const std::vector<CacheLevel> &path, size_t index,
+              uint64_t address, bool write) -> size_t;
+  // Count the levels of path that missed against stats
+  static void charge(const std::vector<CacheLevel> &path, size_t missed,
+                     PcCacheStats &stats);
+
+  std::array<std::unique_ptr<Cache>, CACHE_LEVEL_COUNT> caches;
+  std::vector<CacheLevel> fetchPath; // L1I, L2, LLC as configured
+  std::vector<CacheLevel> dataPath;  // L1D, L2, LLC as configured
+  std::unordered_map<uint64_t, PcCacheStats> perPc;
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include "decoder.h"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+
+/**
+ * @brief Readers for the "key = value" text files that configure the timing
+ * models (the .cfg files in configs/). '#' starts a comment, blank lines are
+ * skipped and spaces around keys and values are ignored. Each model supplies
+ * a Setter that applies one key; it returns an empty string on success or
+ * the reason the line is rejected. Errors read "N: reason" (parse) or
+ * "path:N: reason" (load).
+ */
+namespace config_file {
+using Setter = std::function<std::string(const std::string &key,
+                                         const std::string &value)>;
+// Result latency in cycles for every InstructionType
+using LatencyTable = std::array<uint32_t, INSTRUCTION_TYPE_COUNT>;
+
+auto parse(std::istream &in, std::string &error, const Setter &set) -> bool;
+auto load(const std::string &path, std::string &error, const Setter &set)
+    -> bool;
+
+// Parse a non-negative decimal count (at most 9 digits)
+auto parse_count(const std::string &text, uint32_t &out) -> bool;
+// Parse value as a count into out; the empty string or a reason naming key
+auto set_count(const std::string &key, const std::string &value,
+               uint32_t &out, uint32_t minimum = 0) -> std::string;
+// True for keys of the form "latency.<TYPE>"
+auto is_latency_key(const std::string &key) -> bool;
+// Apply "latency.<TYPE> = cycles", TYPE spelled as Decoder::typeName() does
+auto set_latency(const std::string &key, const std::string &value,
+                 LatencyTable &latency) -> std::string;
+} // namespace config_file
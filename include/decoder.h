@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 
@@ -9,7 +10,7 @@
  * - Load/Store (Immediate): LDR, STR with various addressing modes
  * - Branches: B, BL, B.cond
  */
-enum class InstructionType {
+enum class InstructionType : uint8_t {
   UNKNOWN,
   ADD_IMM,
   SUB_IMM,
@@ -20,6 +21,8 @@ enum class InstructionType {
   BRANCH,
   BRANCH_COND,
 };
+constexpr size_t INSTRUCTION_TYPE_COUNT =
+    static_cast<size_t>(InstructionType::BRANCH_COND) + 1;
 
 /**
  * @brief Addressing modes for load/store instructions. For ADD/SUB, this will
@@ -28,7 +31,7 @@ enum class InstructionType {
  * - PreIndex: [Xn, #imm]!
  * - PostIndex: [Xn], #imm
  */
-enum class AddrMode {
+enum class AddrMode : uint8_t {
   None,     // For Math (ADD/SUB)
   Offset,   // [Xn, #imm]
   PreIndex, // [Xn, #imm]!
@@ -43,27 +46,118 @@ enum class AddrMode {
  * - rn: First source register (0-31)
  * - rm: Second source register (0-31), used for register-based instructions
  * like SUB_REG
- * - imm: Immediate value, sign-extended if necessary
+ * - imm: Immediate value, sign-extended if necessary; byte offsets for
+ * branches (imm26 * 4 reaches +-128 MiB) and scaled offsets for LDR/STR
  * - mode: Addressing mode for load/store instructions
  * - is64Bit: Indicates if the instruction operates on 64-bit registers (true)
  * or 32-bit registers (false)
- * - setFlags: For CMP instructions, indicates if flags should be set (true if
- * rd is XZR)
+ * - setFlags: S bit [29] of ADD/SUB; true for ADDS/SUBS and their CMN/CMP
+ * aliases, which update the condition flags
  * - cond: Condition code for conditional branches (0-15), valid only if type is
  * BRANCH_COND
+ * - size: log2 of the access size in bytes for LDR/STR (0 = byte, 1 = half,
+ * 2 = word, 3 = doubleword), taken from bits [31:30]; defaults to 64-bit
  */
 struct DecodedInstruction {
   InstructionType type = InstructionType::UNKNOWN;
   uint8_t rd = 0;
   uint8_t rn = 0;
   uint8_t rm = 0; // For SUB_REG
-  int16_t imm = 0;
+  int32_t imm = 0;
   AddrMode mode = AddrMode::None;
   bool is64Bit = false;
-  bool setFlags = 0; // For CMP instructions
+  bool setFlags = 0; // ADDS/SUBS (and CMN/CMP)
   uint8_t cond = 0;  // For conditional branches
+  uint8_t size = 3;  // For LDR/STR: access is (1 << size) bytes
 };
 
+/**
+ * @brief A DecodedInstruction packed into one 64-bit word, the form in which
+ * basic blocks keep decoded code resident: eight fit in a 64-byte cache line
+ * against four DecodedInstructions. Fields are read back with a shift and a
+ * mask each, and unpack() rebuilds the whole DecodedInstruction, which the
+ * engines do at dispatch so the compiler can keep it in registers.
+ * - bits [3:0]: type
+ * - bits [8:4], [13:9], [18:14]: rd, rn, rm
+ * - bits [20:19]: mode
+ * - bit 21: is64Bit; bit 22: setFlags
+ * - bits [26:23]: cond; bits [28:27]: size
+ * - bits [63:32]: imm, signed, so an arithmetic shift extracts it
+ */
+class MicroOp {
+public:
+  constexpr MicroOp() : MicroOp(DecodedInstruction{}) {}
+  constexpr explicit MicroOp(const DecodedInstruction &instr)
+      : bits(static_cast<uint64_t>(instr.type) |
+             field(instr.rd, RD_SHIFT) | field(instr.rn, RN_SHIFT) |
+             field(instr.rm, RM_SHIFT) |
+             field(static_cast<uint8_t>(instr.mode), MODE_SHIFT) |
+             field(instr.is64Bit ? 1 : 0, IS64_SHIFT) |
+             field(instr.setFlags ? 1 : 0, FLAGS_SHIFT) |
+             field(instr.cond, COND_SHIFT) | field(instr.size, SIZE_SHIFT) |
+             static_cast<uint64_t>(static_cast<uint32_t>(instr.imm))
+                 << IMM_SHIFT) {}
+
+  constexpr auto type() const -> InstructionType {
+    return static_cast<InstructionType>(bits & TYPE_MASK);
+  }
+  constexpr auto rd() const -> uint8_t { return get(RD_SHIFT, REG_MASK); }
+  constexpr auto rn() const -> uint8_t { return get(RN_SHIFT, REG_MASK); }
+  constexpr auto rm() const -> uint8_t { return get(RM_SHIFT, REG_MASK); }
+  constexpr auto mode() const -> AddrMode {
+    return static_cast<AddrMode>(get(MODE_SHIFT, MODE_MASK));
+  }
+  constexpr auto is64Bit() const -> bool { return get(IS64_SHIFT, 1) != 0; }
+  constexpr auto setFlags() const -> bool { return get(FLAGS_SHIFT, 1) != 0; }
+  constexpr auto cond() const -> uint8_t { return get(COND_SHIFT, COND_MASK); }
+  constexpr auto size() const -> uint8_t { return get(SIZE_SHIFT, SIZE_MASK); }
+  constexpr auto imm() const -> int32_t {
+    return static_cast<int32_t>(static_cast<int64_t>(bits) >> IMM_SHIFT);
+  }
+  constexpr auto raw() const -> uint64_t { return bits; }
+
+  constexpr auto unpack() const -> DecodedInstruction {
+    DecodedInstruction instr;
+    instr.type = type();
+    instr.rd = rd();
+    instr.rn = rn();
+    instr.rm = rm();
+    instr.imm = imm();
+    instr.mode = mode();
+    instr.is64Bit = is64Bit();
+    instr.setFlags = setFlags();
+    instr.cond = cond();
+    instr.size = size();
+    return instr;
+  }
+
+private:
+  static constexpr uint64_t TYPE_MASK = 0xF;
+  static constexpr uint64_t REG_MASK = 0x1F;
+  static constexpr uint64_t MODE_MASK = 0x3;
+  static constexpr uint64_t COND_MASK = 0xF;
+  static constexpr uint64_t SIZE_MASK = 0x3;
+  static constexpr unsigned RD_SHIFT = 4;
+  static constexpr unsigned RN_SHIFT = 9;
+  static constexpr unsigned RM_SHIFT = 14;
+  static constexpr unsigned MODE_SHIFT = 19;
+  static constexpr unsigned IS64_SHIFT = 21;
+  static constexpr unsigned FLAGS_SHIFT = 22;
+  static constexpr unsigned COND_SHIFT = 23;
+  static constexpr unsigned SIZE_SHIFT = 27;
+  static constexpr unsigned IMM_SHIFT = 32;
+
+  static constexpr auto field(uint64_t value, unsigned shift) -> uint64_t {
+    return value << shift;
+  }
+  constexpr auto get(unsigned shift, uint64_t mask) const -> uint8_t {
+    return static_cast<uint8_t>((bits >> shift) & mask);
+  }
+
+  uint64_t bits;
+};
+static_assert(sizeof(MicroOp) == 8, "MicroOp must stay one 64-bit word");
+
 /**
  * @brief Decoder class with a static method to decode a 32-bit instruction into
  * a DecodedInstruction struct. The decode method identifies the instruction
@@ -79,8 +173,28 @@ struct DecodedInstruction {
  * decoder is not exhaustive and only supports a limited set of instructions. It
  * can be extended to cover more instructions and addressing modes as needed.
  *
+ * decode() is table driven: bits [28:25], bit 30 and bit 22 of the word form a
+ * 6-bit key into a constexpr table of per-class field-extraction routines, so
+ * every word costs one indexed call no matter how many classes are supported.
+ * decodeReference() is the original chain of if/else group tests, kept as the
+ * oracle for equivalence tests and as the baseline for benchmarks.
+ *
+ * decodeBlock() decodes a run of words, such as a text segment, 64 at a
+ * time: the keys are computed with AVX2 (8 words per vector, selected at run
+ * time), SSE2 (4 words) or scalar code, turned into a bit mask of the words of
+ * each class, and each class is decoded in its own loop over its mask. The
+ * per-word indirect call of decode(), which mispredicts on mixed code, becomes
+ * at most one loop per class per 64 words. The result equals decode() word
+ * for word.
  */
 class Decoder {
 public:
   static auto decode(uint32_t instr) -> DecodedInstruction;
+  static auto decodeReference(uint32_t instr) -> DecodedInstruction;
+  // out[i] = decode(words[i]) for every i < n
+  static void decodeBlock(const uint32_t *words, size_t n,
+                          DecodedInstruction *out);
+  // Enumerator spelling of type ("ADD_IMM", "LDR", ...), as used in reports
+  // and configuration files
+  static auto typeName(InstructionType type) -> const char *;
 };
@@ -0,0 +1,63 @@
+#pragma once
+#include "memory.h"
+#include "registers.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One entry of the image's static symbol table (.symtab).
+ * - name: symbol name from the linked string table
+ * - value: guest address of the symbol
+ * - size: extent in bytes (0 when the object file does not say)
+ * - type: STT_* symbol type (STT_FUNC, STT_OBJECT, ...)
+ */
+struct ElfSymbol {
+  std::string name;
+  uint64_t value = 0;
+  uint64_t size = 0;
+  uint8_t type = 0;
+};
+
+/**
+ * @brief Loads a little-endian AArch64 ELF64 executable into Memory.
+ *
+ * The file is mmap()ed once with MAP_PRIVATE and each page of a PT_LOAD
+ * segment's file image is handed to Memory::mapHostPage(), so loading costs no
+ * copies: untouched pages stay shared with the page cache and the first guest
+ * store to a page makes the kernel give it a private copy. Only the last file
+ * page of a segment with BSS is copied (the rest of that file page must read
+ * as zero); BSS pages past it are never backed and read as zero. A segment
+ * whose file offset and address are not congruent modulo PAGE_SIZE, and a
+ * page whose file page or guest page is already in use, are copied too.
+ *
+ * load() points CPUState::PC at e_entry and keeps a copy of .symtab for
+ * symbolisation. It returns false and leaves a message in error() when the
+ * file cannot be read or is not an ELF64 AArch64 little-endian image.
+ */
+class ElfImage {
+public:
+  auto load(const std::string &path, Memory &mem, arm64::CPUState &cpu)
+      -> bool;
+
+  // Why the last load() failed
+  auto error() const -> const std::string & { return lastError; }
+  auto entry() const -> uint64_t { return entryPoint; }
+  auto symbols() const -> const std::vector<ElfSymbol> & { return symtab; }
+  // Symbol with the given name, or nullptr
+  auto findSymbol(const std::string &name) const -> const ElfSymbol *;
+  // Function or object symbol whose [value, value + size) holds address
+  auto symbolFor(uint64_t address) const -> const ElfSymbol *;
+  // Bytes of segment file images aliased from the mapping vs copied
+  auto bytesMapped() const -> uint64_t { return mapped; }
+  auto bytesCopied() const -> uint64_t { return copied; }
+
+private:
+  auto fail(const std::string &message) -> bool;
+
+  std::string lastError;
+  uint64_t entryPoint = 0;
+  std::vector<ElfSymbol> symtab;
+  uint64_t mapped = 0;
+  uint64_t copied = 0;
+};
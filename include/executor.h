@@ -1,4 +1,5 @@
 #pragma once
+#include "block_cache.h"
 #include "decoder.h"
 #include "memory.h"
 #include "registers.h"
@@ -17,9 +18,18 @@
  */
 class Executor {
 public:
-  // Takes the decoded instruction and updates the CPU state accordingly
+  // Takes the decoded instruction and updates the CPU state accordingly.
+  // Returns true when the instruction wrote the PC (a taken branch); the
+  // caller is responsible for advancing the PC by 4 otherwise.
   static auto execute(const DecodedInstruction &instr, arm64::CPUState &cpu,
-                      Memory &mem) -> void;
+                      Memory &mem) -> bool;
+  // Switch-dispatched block engine: executes up to count instructions of
+  // block starting at its first one, advancing the PC as the Simulator does.
+  // Stops after a taken branch or once the block is invalidated by its own
+  // store. Fused pairs (BasicBlock::fusion) that fit in count run as one
+  // dispatch. Returns the number of instructions retired.
+  static auto runBlock(const BasicBlock &block, uint64_t count,
+                       arm64::CPUState &cpu, Memory &mem) -> uint64_t;
   static auto read_reg(const arm64::CPUState &cpu, uint8_t reg_idx, bool is_sp)
       -> uint64_t;
   static auto write_reg(arm64::CPUState &cpu, uint8_t reg_idx, uint64_t value,
@@ -0,0 +1,139 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Where the simulator spends host time.
+ * - Fetch: finding the basic block at PC (BlockCache lookups and builds)
+ * - Decode: Decoder::decode
+ * - Execute: running decoded instructions (Executor, ThreadedExecutor)
+ * - Memory: guest loads and stores made by LDR/STR
+ */
+enum class HostPhase { Fetch, Decode, Execute, Memory };
+constexpr size_t HOST_PHASE_COUNT = static_cast<size_t>(HostPhase::Memory) + 1;
+
+// Hardware events HostProfiler can count with perf_event_open
+enum class HostEvent { Cycles, BranchMisses, CacheMisses };
+constexpr size_t HOST_EVENT_COUNT =
+    static_cast<size_t>(HostEvent::CacheMisses) + 1;
+
+/**
+ * @brief Time and hardware events of one HostPhase. Self counts exclude the
+ * phases nested inside it (Decode inside Fetch, Memory inside Execute), so
+ * the self counts of all phases add up to the profiled total.
+ * - calls: times the phase was entered
+ * - ticks: self time in timer ticks (see HostProfiler::tickSeconds())
+ * - events: self counts by HostEvent; zero without perf events
+ */
+struct PhaseStats {
+  uint64_t calls = 0;
+  uint64_t ticks = 0;
+  std::array<uint64_t, HOST_EVENT_COUNT> events{};
+};
+
+/**
+ * @brief Scoped timers around the simulator's phases. The timer is the TSC
+ * (rdtsc) on x86-64 hosts and clock_gettime(CLOCK_MONOTONIC) elsewhere; TSC
+ * ticks are converted to seconds against the steady clock over the
+ * profiler's lifetime. With perfEvents, cycles, branch misses and cache
+ * misses are also read from a Linux perf_event_open group counting the
+ * constructing thread in user mode; when the kernel refuses (no PMU access,
+ * perf_event_paranoid) the profiler falls back to timing only and
+ * perfError() says why. Reading the group is a system call per phase
+ * boundary, so event counts include the profiler's own overhead.
+ *
+ * The simulator enters phases in the calling thread's profiler (see
+ * HostProfiler::attach()) through the SIM_PROFILE_PHASE macro, which expands
+ * to nothing unless the build is configured with -DAARCH64_SIM_PROFILE=ON.
+ */
+class HostProfiler {
+public:
+  explicit HostProfiler(bool perfEvents = false);
+  ~HostProfiler();
+  HostProfiler(const HostProfiler &) = delete;
+  auto operator=(const HostProfiler &) -> HostProfiler & = delete;
+
+  // Start phase, nested in the phase currently running (if any)
+  void enter(HostPhase phase);
+  // End the phase entered last
+  void leave();
+
+  auto stats(HostPhase phase) const -> const PhaseStats & {
+    return phases[static_cast<size_t>(phase)];
+  }
+  // Self ticks of every phase
+  auto totalTicks() const -> uint64_t;
+  // Seconds per timer tick
+  auto tickSeconds() const -> double;
+  auto perfEnabled() const -> bool { return perfFd >= 0; }
+  auto perfError() const -> const std::string & { return perfMessage; }
+  // Drop all counts (not allowed while a phase is running)
+  void reset();
+  // Calls, self time, share and events per phase
+  auto report(std::ostream &out) const -> void;
+
+  // Make profiler the calling thread's (nullptr detaches)
+  static void attach(HostProfiler *profiler);
+  static auto sink() -> HostProfiler * { return threadSink; }
+
+private:
+  struct Frame {
+    HostPhase phase;
+    uint64_t start;
+    uint64_t child = 0; // Ticks spent in nested phases
+    std::array<uint64_t, HOST_EVENT_COUNT> startEvents;
+    std::array<uint64_t, HOST_EVENT_COUNT> childEvents{};
+  };
+
+  static auto now() -> uint64_t;
+  auto readEvents() const -> std::array<uint64_t, HOST_EVENT_COUNT>;
+  void openPerf();
+
+  static thread_local HostProfiler *threadSink;
+
+  std::array<PhaseStats, HOST_PHASE_COUNT> phases{};
+  std::vector<Frame> stack;
+  int perfFd = -1; // Group leader (cycles); the others follow it
+  std::array<int, HOST_EVENT_COUNT> eventFds{-1, -1, -1};
+  std::string perfMessage;
+  uint64_t createdTicks;
+  double createdSeconds;
+};
+
+/**
+ * @brief Enters a phase of the calling thread's HostProfiler for the
+ * lifetime of the object; does nothing when no profiler is attached.
+ */
+class ScopedPhase {
+public:
+  explicit ScopedPhase(HostPhase phase) : profiler(HostProfiler::sink()) {
+    if (profiler != nullptr) {
+      profiler->enter(phase);
+    }
+  }
+  ~ScopedPhase() {
+    if (profiler != nullptr) {
+      profiler->leave();
+    }
+  }
+  ScopedPhase(const ScopedPhase &) = delete;
+  auto operator=(const ScopedPhase &) -> ScopedPhase & = delete;
+
+private:
+  HostProfiler *profiler;
+};
+
+// SIM_PROFILE_PHASE(phase): time the rest of the enclosing scope as
+// HostPhase::phase. At most one per scope; nothing when compiled out.
+#if defined(AARCH64_SIM_PROFILE)
+#define SIM_PROFILE_PHASE(PHASE_)                                              \
+  ScopedPhase sim_profile_phase(HostPhase::PHASE_)
+#else
+#define SIM_PROFILE_PHASE(PHASE_)                                              \
+  do {                                                                         \
+  } while (0)
+#endif
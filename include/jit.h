@@ -0,0 +1,123 @@
+#pragma once
+#include "block_cache.h"
+#include "memory.h"
+#include "registers.h"
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Tuning knobs of the Jit.
+ * - hotThreshold: executions of a block before it is translated
+ * - codeBytes: size of the executable code cache; when it fills up every
+ * translation is dropped and the cache starts over
+ */
+struct JitConfig {
+  uint32_t hotThreshold = 16;
+  size_t codeBytes = size_t{4} << 20;
+};
+
+/**
+ * @brief Counters describing what the Jit did.
+ * - blocksCompiled: blocks translated to host code
+ * - blocksRejected: hot blocks holding something the Jit cannot translate
+ * - nativeRuns: dispatches that entered translated code
+ * - interpretedRuns: dispatches handed to Executor::runBlock
+ * - chainLinks: block exits patched to jump straight into another block
+ * - flushes: times every translation was dropped (code writes, full cache)
+ */
+struct JitStats {
+  uint64_t blocksCompiled = 0;
+  uint64_t blocksRejected = 0;
+  uint64_t nativeRuns = 0;
+  uint64_t interpretedRuns = 0;
+  uint64_t chainLinks = 0;
+  uint64_t flushes = 0;
+};
+
+/**
+ * @brief Dynamic binary translator from decoded basic blocks to x86-64 host
+ * code. runBlock() has the contract of Executor::runBlock, except that it is
+ * given the whole remaining instruction budget: it counts how often each
+ * block starts executing, translates a block once it reaches
+ * JitConfig::hotThreshold and from then on enters the translation instead of
+ * interpreting. A translated block ends by writing the guest PC and jumping
+ * either back to runBlock() or, once the successor has been translated too,
+ * straight into the successor's code (chaining), so hot loops run without
+ * returning to the dispatcher until the budget runs out.
+ *
+ * Translated code keeps guest registers and the lazy flag record
+ * (arm64::PState) in the CPUState and calls back into Memory for loads and
+ * stores, so it shares all state with the interpreter and the two can be
+ * mixed freely. ADD/SUB (immediate and register, X and W, with flags),
+ * LDR/STR (every addressing mode and width), B and B.cond are translated; a
+ * block holding anything else stays interpreted. A store that
+ * invalidates cached code leaves translated code right after it, and the
+ * next runBlock() drops every translation, so self-modifying code behaves as
+ * in the interpreter.
+ *
+ * The code cache is W^X: it is read-write only while compile() emits a
+ * block and patches chain links into earlier blocks, and read-execute
+ * whenever translated code runs (two mprotect calls per compiled block,
+ * which a hot threshold keeps rare).
+ *
+ * Translation needs an x86-64 host and an executable mapping; elsewhere (and
+ * in -DAARCH64_SIM_TRACE=ON, -DAARCH64_SIM_PMU=ON or -DAARCH64_SIM_PROFILE=ON
+ * builds, whose instrumentation lives in the interpreter) every block is
+ * interpreted.
+ * The Simulator uses the Jit when the build is configured with
+ * -DAARCH64_SIM_DISPATCH=jit.
+ */
+class Jit {
+public:
+  Jit(BlockCache &blocks, Memory &mem, JitConfig config = {});
+  ~Jit();
+  Jit(const Jit &) = delete;
+  auto operator=(const Jit &) -> Jit & = delete;
+
+  // Execute block (and, through chaining, the blocks that follow it) for at
+  // most budget instructions. Returns the number of instructions retired.
+  auto runBlock(const BasicBlock &block, uint64_t budget, arm64::CPUState &cpu)
+      -> uint64_t;
+  // Drop every translation and execution count
+  void flush();
+
+  auto stats() const -> const JitStats & { return jitStats; }
+  // Bytes of the code cache currently holding translations
+  auto codeBytesUsed() const -> size_t;
+  // True when this build and host can run translated code
+  static auto supported() -> bool;
+  // True when every instruction of block can be translated
+  static auto translatable(const BasicBlock &block) -> bool;
+
+private:
+  struct Translation {
+    const uint8_t *code = nullptr;
+    uint32_t heat = 0;
+    bool rejected = false;
+  };
+
+  auto compile(const BasicBlock &block) -> const uint8_t *;
+  void emitStubs();
+  void link(uint8_t *rel32, const uint8_t *target);
+  // Make the code cache read-execute (run) or read-write; false on failure
+  auto executable(bool run) -> bool;
+  // Unmap the code cache and drop every translation
+  void release();
+
+  BlockCache &blocks;
+  Memory &mem;
+  JitConfig config;
+  uint8_t *codeBase = nullptr; // nullptr when translation is unavailable
+  uint8_t *codeCursor = nullptr;
+  uint8_t *codeEnd = nullptr;
+  const uint8_t *enterStub = nullptr; // void(JitContext *, const uint8_t *)
+  const uint8_t *exitStub = nullptr;  // Back to enterStub's caller
+  uint8_t *firstBlock = nullptr;      // Where translations start
+  std::unordered_map<uint64_t, Translation> translations;
+  // Block exits still jumping to exitStub, by the guest PC they lead to
+  std::unordered_map<uint64_t, std::vector<uint8_t *>> pendingLinks;
+  uint64_t seenInvalidations = 0;
+  JitStats jitStats;
+};
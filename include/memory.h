@@ -1,38 +1,285 @@
 #pragma once
+#include <array>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SIM_HOST_LITTLE_ENDIAN 1
+#else
+#define SIM_HOST_LITTLE_ENDIAN 0
+#endif
+
+/**
+ * @brief Interface for components that cache information derived from guest
+ * code (such as decoded basic blocks) and therefore need to hear about writes
+ * that land on it. Memory only calls the observer for pages that were marked
+ * with watchCode(), so ordinary data writes stay on the fast path.
+ */
+class CodeWriteObserver {
+public:
+  virtual ~CodeWriteObserver() = default;
+  // Called after a write touched [address, address + length) on a watched page
+  virtual void onCodeWrite(uint64_t address, uint64_t length) = 0;
+};
+
 /**
  * @brief Memory class to represent the memory of the simulated system. It
  * provides methods to read and write bytes and 64-bit values at specific
- * addresses. The memory is implemented as a vector of bytes, and the class
- * ensures that all accesses are within the allocated size. This class abstracts
- * away the details of memory management and provides a simple interface for the
- * executor to interact with memory during instruction execution. The readByte
- * and writeByte methods allow for byte-level access, while read64 and write64
- * provide convenient methods for accessing 64-bit values, which are common in
- * AArch64 instructions. The class can be extended to include additional
- * functionality such as memory-mapped I/O or support for different endianness
- * if needed. Note: This implementation does not include any bounds checking for
- * simplicity, but it can be added to ensure that all memory accesses are valid
- * and to prevent out-of-bounds errors.
+ * addresses. This class abstracts away the details of memory management and
+ * provides a simple interface for the executor to interact with memory during
+ * instruction execution. The readByte and writeByte methods allow for
+ * byte-level access, while read64 and write64 provide convenient methods for
+ * accessing 64-bit values, which are common in AArch64 instructions.
+ *
+ * Storage is sparse: the 48-bit guest address space is split into 4 KiB pages
+ * reached through a three-level page directory (bits [47:36], [35:24] and
+ * [23:12] of the address). Directory tables and pages are allocated on the
+ * first write that needs them, and reads of pages that were never written
+ * return zero without allocating anything. The size given to the constructor
+ * only sets the highest valid address, so a stack near the top of a 48-bit
+ * space costs nothing until it is used and construction time does not depend
+ * on the configured size. Accesses that do not fit below that size are
+ * ignored (writes) or read as zero, as before.
  *
+ * read<T>() and write<T>() access 1, 2, 4 or 8 bytes. In front of the page
+ * directory sit two small direct-mapped software TLBs (one for reads, one
+ * for writes) that remember the host pointer of recently used guest pages.
+ * An access that hits and stays inside its page costs a tag compare plus a
+ * single (possibly unaligned) host load or store on little-endian hosts;
+ * everything else takes the out-of-line slow path, which walks the
+ * directory, handles page-straddling and out-of-range accesses and refills
+ * the TLB. Pages watched for code writes are never entered in the write TLB,
+ * so stores to them always reach the CodeWriteObserver. The TLBs make
+ * even const reads mutate the object, so a Memory must not be accessed from
+ * several threads at once.
+ *
+ * For multi-core guests, makeView() returns another Memory over the same
+ * page directory with its own TLBs and observer, so each host thread can own
+ * one view. The directory is safe to grow from several views at once. A store
+ * to a watched code page is reported to the writing view's observer straight
+ * away and queued for every other view, which hands it to its own observer in
+ * syncCodeWrites() (BlockCache::lookup calls it); cross-core code changes
+ * therefore take effect at the other cores' next block boundary. watchCode()
+ * marks every other view's write TLB stale before it returns, and the write
+ * fast path checks that flag, so a page another core already cached as data
+ * cannot take stores that bypass the observer once it holds code.
+ *
+ * snapshot() makes the current contents the baseline that restore() returns
+ * to. It flushes every view's write TLB, so the first store to each page
+ * after it takes the slow path, which saves a copy of the page before
+ * changing it (pages first allocated after the snapshot are only noted, as
+ * their baseline is zero). restore() copies back just those pages, so its
+ * cost depends on how much the guest wrote, not on the size of the address
+ * space; the baseline stays in place for the next restore(). Neither may run
+ * while another thread is accessing any view.
  */
 class Memory {
 public:
+  // Guest page size; also the granularity at which code pages are watched
+  static constexpr uint64_t PAGE_SHIFT = 12;
+  static constexpr uint64_t PAGE_SIZE = uint64_t{1} << PAGE_SHIFT;
+  // Largest supported guest address space (48-bit virtual addresses)
+  static constexpr uint64_t ADDRESS_BITS = 48;
+  static constexpr uint64_t MAX_SIZE = uint64_t{1} << ADDRESS_BITS;
+
   // constructor : create memory with size given by application in bytes
-  Memory(size_t size);
+  // (clamped to MAX_SIZE); nothing is allocated up front
+  Memory(uint64_t size);
+  ~Memory();
+  Memory(const Memory &) = delete;
+  auto operator=(const Memory &) -> Memory & = delete;
+
+  // Little-endian access of sizeof(T) bytes; T is uint8_t, uint16_t,
+  // uint32_t or uint64_t
+  template <typename T> auto read(uint64_t address) const -> T;
+  template <typename T> void write(uint64_t address, T value);
 
   // reading a byte of specific address from memory
-  uint8_t readByte(uint64_t address) const;
+  uint8_t readByte(uint64_t address) const { return read<uint8_t>(address); }
   // writing a byte on memory on specific address
-  void writeByte(uint64_t address, uint8_t val);
+  void writeByte(uint64_t address, uint8_t val) {
+    write<uint8_t>(address, val);
+  }
+  // reading a 4 bytes of specific address from memory (instruction fetch)
+  uint32_t read32(uint64_t address) const { return read<uint32_t>(address); }
   // reading a 8 bytes of specific address from memory
-  uint64_t read64(uint64_t address) const;
+  uint64_t read64(uint64_t address) const { return read<uint64_t>(address); }
   // writing a 8 bytes on memory on specific address
-  void write64(uint64_t address, uint64_t val);
+  void write64(uint64_t address, uint64_t val) {
+    write<uint64_t>(address, val);
+  }
+
+  // Another Memory over the same guest pages, for use by another thread
+  auto makeView() -> std::unique_ptr<Memory>;
+
+  // Register the observer told about writes to watched code pages (nullptr
+  // detaches). Only one observer is supported per view.
+  void setCodeWriteObserver(CodeWriteObserver *observer);
+  auto codeWriteObserver() const -> CodeWriteObserver * { return observer; }
+  // Mark the page containing address as holding cached code
+  void watchCode(uint64_t address);
+  // Deliver code writes made through other views to this view's observer.
+  // Cheap when there are none.
+  void syncCodeWrites() {
+    if (remoteWritesPending.load(std::memory_order_acquire)) {
+      drainRemoteWrites();
+    }
+  }
+
+  // Back the page containing address with caller-provided host memory of
+  // PAGE_SIZE bytes instead of a private allocation (used to map file images
+  // without copying). keepAlive is held for the Memory's lifetime to keep
+  // the host memory valid. Returns false, changing nothing, when the page is
+  // already backed or lies outside the address space.
+  auto mapHostPage(uint64_t address, uint8_t *host,
+                   std::shared_ptr<void> keepAlive) -> bool;
+
+  // Record the current contents as the baseline for restore()
+  void snapshot();
+  // Roll every page written since snapshot() (or the previous restore())
+  // back to the baseline and tell code observers about restored code pages.
+  // Returns false, changing nothing, when there is no snapshot.
+  auto restore() -> bool;
+  // Pages written since the last snapshot() or restore()
+  auto dirtyPages() const -> uint64_t;
+
+  // Configured address-space size in bytes
+  auto size() const -> uint64_t { return limit; }
+  // Number of 4 KiB pages allocated by Memory itself (the guest's working set)
+  auto residentPages() const -> uint64_t;
+  // Number of pages backed by host memory given to mapHostPage()
+  auto mappedPages() const -> uint64_t;
 
 private:
-  std::vector<uint8_t> storage;
+  static constexpr uint64_t TLB_ENTRIES = 64;
+  static constexpr uint64_t TLB_INVALID = ~uint64_t{0};
+  static constexpr uint64_t LEVEL_BITS = 12;
+  static constexpr uint64_t LEVEL_ENTRIES = uint64_t{1} << LEVEL_BITS;
+
+  // Pointers are published with release stores once fully built, so lookups
+  // need no lock; creation happens under Directory::lock
+  struct PageEntry {
+    std::atomic<uint8_t *> data{nullptr}; // nullptr: never written, reads 0
+    std::unique_ptr<uint8_t[]> owned;     // set when Memory allocated data
+    std::atomic<bool> code{false};        // set by watchCode()
+    std::atomic<bool> saved{false};       // baseline copy taken since snapshot
+  };
+  struct LeafTable {
+    std::array<PageEntry, LEVEL_ENTRIES> pages;
+  };
+  struct MidTable {
+    std::array<std::atomic<LeafTable *>, LEVEL_ENTRIES> leaves{};
+  };
+  // Page tables, counters and the list of views; shared by all views
+  struct Directory;
+
+  explicit Memory(std::shared_ptr<Directory> shared);
+  struct TlbEntry {
+    uint64_t page = TLB_INVALID; // guest page number
+    uint8_t *host = nullptr;     // host address of the page's first byte
+  };
+
+  // Directory walk for a page number; nullptr when no table covers it yet
+  auto findEntry(uint64_t page) const -> const PageEntry *;
+  // Directory walk that creates missing tables (but not the page itself)
+  auto touchEntry(uint64_t page) -> PageEntry &;
+  // Host bytes of a page, allocated and zero-filled on first use; while a
+  // snapshot is active, also saves the page's baseline before the first write
+  auto pageForWrite(uint64_t page) -> uint8_t *;
+  // Under Directory::lock: remember entry's current bytes for restore()
+  void savePage(uint64_t page, PageEntry &entry);
+  // Under Directory::lock: drop every view's write-TLB entries
+  void flushAllWriteTlbs();
+  auto fits(uint64_t address, uint64_t length) const -> bool {
+    return address <= limit && length <= limit - address;
+  }
+  // TLB-miss paths: range check, directory walk and TLB refill
+  auto readSlow(uint64_t address, uint32_t length) const -> uint64_t;
+  void writeSlow(uint64_t address, uint32_t length, uint64_t value);
+  auto readLE(uint64_t address, uint32_t length) const -> uint64_t;
+  void writeLE(uint64_t address, uint32_t length, uint64_t value);
+  void notifyCodeWrite(uint64_t address, uint64_t length);
+  // Queue [address, address + length) for every other view's observer
+  void postToOtherViews(uint64_t address, uint64_t length);
+  void drainRemoteWrites();
+  // True when every byte of the page lies below limit (TLB-cacheable)
+  auto pageInRange(uint64_t page) const -> bool {
+    return page < (limit >> PAGE_SHIFT);
+  }
+  static auto tlbSlot(uint64_t page) -> size_t {
+    return static_cast<size_t>(page & (TLB_ENTRIES - 1));
+  }
+  void flushWriteTlb(uint64_t page);
+  // Make every other view flush its write TLB before its next fast store
+  void staleOtherWriteTlbs();
+
+  template <typename T> static auto loadLE(const uint8_t *src) -> T;
+  template <typename T> static void storeLE(uint8_t *dst, T value);
+
+  std::shared_ptr<Directory> dir;
+  uint64_t limit;
+  CodeWriteObserver *observer = nullptr;
+  std::mutex remoteLock; // guards remoteWrites
+  std::vector<std::pair<uint64_t, uint64_t>> remoteWrites;
+  std::atomic<bool> remoteWritesPending{false};
+  // Set under dir->lock when another view starts watching a page; the write
+  // TLB may then hold that page and is flushed before its next use
+  std::atomic<bool> writeTlbStale{false};
+  mutable std::array<TlbEntry, TLB_ENTRIES> readTlb{};
+  std::array<TlbEntry, TLB_ENTRIES> writeTlb{};
 };
+
+template <typename T> auto Memory::loadLE(const uint8_t *src) -> T {
+  T value = 0;
+#if SIM_HOST_LITTLE_ENDIAN
+  std::memcpy(&value, src, sizeof(T)); // One unaligned host load
+#else
+  for (size_t i = 0; i < sizeof(T); i++) {
+    value |= static_cast<T>(static_cast<T>(src[i]) << (i * 8));
+  }
+#endif
+  return value;
+}
+
+template <typename T> void Memory::storeLE(uint8_t *dst, T value) {
+#if SIM_HOST_LITTLE_ENDIAN
+  std::memcpy(dst, &value, sizeof(T)); // One unaligned host store
+#else
+  for (size_t i = 0; i < sizeof(T); i++) {
+    dst[i] = static_cast<uint8_t>(value >> (i * 8));
+  }
+#endif
+}
+
+template <typename T> auto Memory::read(uint64_t address) const -> T {
+  static_assert(std::is_unsigned<T>::value && sizeof(T) <= sizeof(uint64_t),
+                "Memory::read<T> needs uint8_t/16/32/64");
+  uint64_t page = address >> PAGE_SHIFT;
+  uint64_t offset = address & (PAGE_SIZE - 1);
+  const TlbEntry &entry = readTlb[tlbSlot(page)];
+  if (entry.page == page && offset <= PAGE_SIZE - sizeof(T)) {
+    return loadLE<T>(entry.host + offset);
+  }
+  return static_cast<T>(readSlow(address, sizeof(T)));
+}
+
+template <typename T> void Memory::write(uint64_t address, T value) {
+  static_assert(std::is_unsigned<T>::value && sizeof(T) <= sizeof(uint64_t),
+                "Memory::write<T> needs uint8_t/16/32/64");
+  uint64_t page = address >> PAGE_SHIFT;
+  uint64_t offset = address & (PAGE_SIZE - 1);
+  const TlbEntry &entry = writeTlb[tlbSlot(page)];
+  if (entry.page == page && offset <= PAGE_SIZE - sizeof(T) &&
+      !writeTlbStale.load(std::memory_order_acquire)) {
+    storeLE<T>(entry.host + offset, value);
+    return;
+  }
+  writeSlow(address, sizeof(T), value);
+}
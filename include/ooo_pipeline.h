@@ -0,0 +1,164 @@
+#pragma once
+#include "branch_predictor.h"
+#include "config_file.h"
+#include "retire_observer.h"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Parameters of the out-of-order core model.
+ * - fetchWidth: instructions fetched, renamed and dispatched per cycle
+ * - issueWidth: instructions leaving the reservation stations per cycle
+ * - retireWidth: instructions leaving the reorder buffer per cycle
+ * - robSize: reorder buffer entries (instructions in flight)
+ * - rsSize: reservation station entries (dispatched, not yet issued)
+ * - frontendStages: cycles from fetch to dispatch (decode, rename)
+ * - latency: per InstructionType, cycles from issue until dependents can
+ * issue
+ * - mispredictPenalty: cycles from a mispredicted branch executing until
+ * fetch restarts on the right path
+ *
+ * load() reads a config_file over the defaults. Keys are the field names in
+ * snake_case (fetch_width, rob_size, ...) and latency.<TYPE>.
+ */
+struct OutOfOrderConfig {
+  uint32_t fetchWidth = 4;
+  uint32_t issueWidth = 4;
+  uint32_t retireWidth = 4;
+  uint32_t robSize = 128;
+  uint32_t rsSize = 48;
+  uint32_t frontendStages = 4;
+  config_file::LatencyTable latency = {1, 1, 1, 1, 1, 4, 1, 1, 1};
+  uint32_t mispredictPenalty = 3;
+
+  auto load(const std::string &path, std::string &error) -> bool;
+  auto parse(std::istream &in, std::string &error) -> bool;
+};
+
+/**
+ * @brief Cycle accounting of an OutOfOrderPipeline. The wait counters are
+ * summed over instructions; waits overlap in an out-of-order core, so they
+ * show where instructions spend time rather than adding up to cycles.
+ * - instructions, cycles: instructions retired and cycles until the last one
+ * retired
+ * - branches, mispredicts: B.cond seen, and those predicted in the wrong
+ * direction
+ * - fetchRedirectCycles: cycles fetch waited for mispredicted branches
+ * - robFullCycles: dispatch delay because the reorder buffer was full
+ * - rsFullCycles: dispatch delay because the reservation stations were full
+ * - dataWaitCycles: issue delay waiting for an ALU result
+ * - loadWaitCycles: issue delay waiting for an LDR result
+ * - flagWaitCycles: issue delay of B.cond waiting for the flags
+ * - issueConflictCycles: issue delay of ready instructions (width exhausted)
+ */
+struct OutOfOrderStats {
+  uint64_t instructions = 0;
+  uint64_t cycles = 0;
+  uint64_t branches = 0;
+  uint64_t mispredicts = 0;
+  uint64_t fetchRedirectCycles = 0;
+  uint64_t robFullCycles = 0;
+  uint64_t rsFullCycles = 0;
+  uint64_t dataWaitCycles = 0;
+  uint64_t loadWaitCycles = 0;
+  uint64_t flagWaitCycles = 0;
+  uint64_t issueConflictCycles = 0;
+
+  // Instructions per cycle (0 before the first instruction)
+  auto ipc() const -> double;
+};
+
+/**
+ * @brief A producer on the critical path: the instruction at pc delayed the
+ * issue of count dependent instructions by cycles in total.
+ */
+struct CriticalPathHint {
+  uint64_t pc = 0;
+  InstructionType type = InstructionType::UNKNOWN;
+  uint64_t cycles = 0;
+  uint64_t count = 0;
+};
+
+/**
+ * @brief Timing model of a superscalar out-of-order core, driven by the
+ * retired instruction stream as a RetireObserver.
+ *
+ * Each instruction is fetched in groups of fetchWidth (a taken branch ends
+ * the group), dispatched frontendStages later into the reorder buffer and the
+ * reservation stations once both have room, issued when its sources are
+ * ready and an issue slot is free, and retired in order. The X registers, SP
+ * and the flags are renamed: a source only waits for its latest producer, so
+ * there are no write-after-write or write-after-read stalls. B.cond is
+ * predicted by the DirectionPredictor given to the constructor, or else
+ * statically backward taken, forward not taken; a wrong guess stops fetch
+ * until the branch has executed plus mispredictPenalty. Branch targets are
+ * assumed to come from a perfect BTB. Loads never wait on
+ * earlier stores (perfect disambiguation) and always take latency.LDR.
+ *
+ * For critical-path hints every issue delay caused by a source operand is
+ * charged to the PC of the instruction that produced it; hints() returns the
+ * producers charged the most.
+ */
+class OutOfOrderPipeline : public RetireObserver {
+public:
+  explicit OutOfOrderPipeline(
+      OutOfOrderConfig config = {},
+      std::unique_ptr<DirectionPredictor> predictor = nullptr);
+
+  void onRetire(const RetiredInstruction &retired) override;
+
+  auto stats() const -> const OutOfOrderStats & { return coreStats; }
+  auto config() const -> const OutOfOrderConfig & { return coreConfig; }
+  // The count producers that delayed dependents the most, worst first
+  auto hints(size_t count) const -> std::vector<CriticalPathHint>;
+  // Forget all timing state and counters
+  void reset();
+  // Human-readable summary (IPC, stall breakdown, critical-path hints)
+  auto report(std::ostream &out) const -> void;
+
+private:
+  // Latest in-flight writer of an architectural register
+  struct Producer {
+    uint64_t ready = 0; // Cycle dependents may issue
+    uint64_t pc = 0;
+    InstructionType type = InstructionType::UNKNOWN;
+    bool load = false; // Result comes from memory
+  };
+  // Issue slots used in one cycle of the scheduling window
+  struct IssueSlot {
+    uint64_t cycle = 0;
+    uint32_t used = 0;
+  };
+  static constexpr size_t FLAGS = 32; // Rename slot after X0-X30 and SP
+
+  auto fetch() -> uint64_t;
+  auto dispatch(uint64_t earliest) -> uint64_t;
+  auto issue(uint64_t ready) -> uint64_t;
+  auto retire(uint64_t complete) -> uint64_t;
+  // Delay ready until the producer in slot has its result
+  void waitFor(size_t slot, uint64_t &ready, const Producer *&late) const;
+
+  OutOfOrderConfig coreConfig;
+  std::unique_ptr<DirectionPredictor> predictor; // Static when null
+  std::array<Producer, 33> rename{};
+  uint64_t fetchCycle = 0;
+  uint32_t fetched = 0; // In fetchCycle
+  uint64_t dispatchCycle = 0;
+  uint32_t dispatched = 0; // In dispatchCycle
+  uint64_t retireCycle = 0;
+  uint32_t retiredInCycle = 0;
+  std::vector<uint64_t> robRetire; // Retire cycle, by sequence % robSize
+  uint64_t sequence = 0;
+  // Issue cycles of the instructions in the reservation stations
+  std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<>> rs;
+  std::vector<IssueSlot> issueSlots; // Power of two, indexed by cycle
+  std::unordered_map<uint64_t, CriticalPathHint> blame;
+  OutOfOrderStats coreStats;
+};
@@ -0,0 +1,64 @@
+#pragma once
+#include "elf_loader.h"
+#include "simulator.h"
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Sampling profiler of the guest PC. run() drives a Simulator in
+ * slices of period instructions and records CPUState::PC (the next
+ * instruction to execute) after each slice into a histogram, so the guest
+ * runs at full engine speed in between and the cost is one Simulator::run()
+ * call per sample. The sampling phase carries over between run() calls.
+ *
+ * report() lists the hottest functions and PCs; writeFolded() writes the
+ * histogram as folded stacks ("function;function+0xoffset count" lines) for
+ * flamegraph tools. Both symbolise against an ElfImage's symbol table when
+ * one is given and show raw addresses otherwise (no image, a stripped image,
+ * or a PC outside every symbol). The guest ISA has no calls yet, so the
+ * stacks are one function deep.
+ */
+class PcProfiler {
+public:
+  // A period of 0 samples every instruction, like 1
+  explicit PcProfiler(uint64_t period = 1000);
+
+  // Run sim (executing on cpu) like Simulator::run(), sampling cpu.PC every
+  // period retired instructions
+  auto run(Simulator &sim, const arm64::CPUState &cpu,
+           uint64_t max_instructions = Simulator::NO_LIMIT) -> StopReason;
+  // Record one sample at pc
+  void sample(uint64_t pc) {
+    histogram[pc]++;
+    sampleCount++;
+  }
+
+  auto period() const -> uint64_t { return samplePeriod; }
+  auto samples() const -> uint64_t { return sampleCount; }
+  auto pcSamples() const -> const std::unordered_map<uint64_t, uint64_t> & {
+    return histogram;
+  }
+  // The count PCs sampled most often, hottest first
+  auto hottest(size_t count) const
+      -> std::vector<std::pair<uint64_t, uint64_t>>;
+  void reset();
+
+  // "name+0xoffset" for pc in a symbol of symbols, else "0x<pc>"
+  static auto symbolize(uint64_t pc, const ElfImage *symbols) -> std::string;
+  // Sample count, then the top functions (with symbols) and PCs
+  auto report(std::ostream &out, const ElfImage *symbols = nullptr,
+              size_t top = 10) const -> void;
+  // One folded stack per sampled PC, in address order
+  auto writeFolded(std::ostream &out, const ElfImage *symbols = nullptr) const
+      -> void;
+
+private:
+  uint64_t samplePeriod;
+  uint64_t untilSample; // Instructions left in the current period
+  uint64_t sampleCount = 0;
+  std::unordered_map<uint64_t, uint64_t> histogram;
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include "config_file.h"
+#include "decoder.h"
+#include "retire_observer.h"
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+/**
+ * @brief Parameters of the in-order pipeline model.
+ * - stages: pipeline depth; an instruction retires stages cycles after it
+ * enters fetch, so N independent instructions take N + stages - 1 cycles
+ * - latency: per InstructionType, cycles from an instruction entering EX
+ * until its result can be forwarded to a dependent one. 1 means back to back;
+ * the LDR default of 2 gives the classic one-cycle load-use bubble.
+ * - flagLatency: cycles from a flag-setting ADD/SUB entering EX until a
+ * B.cond can evaluate its condition
+ * - branchPenalty: fetch bubbles after an unconditional B (redirected in ID)
+ * - takenBranchPenalty: fetch bubbles after a taken B.cond (resolved in EX;
+ * fetch continues down the fall-through path, so not-taken branches are free)
+ *
+ * load() reads a config_file of "key = value" lines over the defaults. Keys
+ * are the field names in snake_case (stages, flag_latency, branch_penalty,
+ * taken_branch_penalty) and latency.<TYPE>, e.g. "latency.LDR = 3".
+ * Unknown keys and malformed values fail with a message naming the line.
+ */
+struct PipelineConfig {
+  uint32_t stages = 5;
+  config_file::LatencyTable latency = {1, 1, 1, 1, 1, 2, 1, 1, 1};
+  uint32_t flagLatency = 1;
+  uint32_t branchPenalty = 1;
+  uint32_t takenBranchPenalty = 2;
+
+  auto load(const std::string &path, std::string &error) -> bool;
+  auto parse(std::istream &in, std::string &error) -> bool;
+};
+
+/**
+ * @brief Cycle accounting of an InOrderPipeline.
+ * - instructions: instructions seen
+ * - cycles: cycles until the last of them left the pipeline
+ * - loadUseStalls: bubbles waiting for an LDR result
+ * - dataStalls: bubbles waiting for any other register result
+ * - flagStalls: bubbles of a B.cond waiting for the flags
+ * - branchPenaltyCycles: fetch bubbles after taken branches
+ */
+struct PipelineStats {
+  uint64_t instructions = 0;
+  uint64_t cycles = 0;
+  uint64_t loadUseStalls = 0;
+  uint64_t dataStalls = 0;
+  uint64_t flagStalls = 0;
+  uint64_t branchPenaltyCycles = 0;
+
+  // Cycles per instruction (0 before the first instruction)
+  auto cpi() const -> double;
+};
+
+/**
+ * @brief Timing model of a scalar in-order pipeline (IF ID EX MEM WB by
+ * default) with full forwarding, driven by the retired instruction stream.
+ * It runs alongside functional execution as a RetireObserver: attach it to a
+ * Simulator and every retired instruction is issued into EX one cycle after
+ * its predecessor, later if a source register or (for B.cond) the flags are
+ * not ready yet, plus the fetch bubbles of taken branches. Register 31 reads
+ * as XZR in ADD/SUB and as SP in the base (and store data) of LDR/STR, as in
+ * the executor; pre- and post-index writeback makes the base ready with ALU
+ * latency.
+ *
+ * The model only keeps per-register ready times, so it costs a few compares
+ * per instruction and nothing at all when it is not attached.
+ */
+class InOrderPipeline : public RetireObserver {
+public:
+  explicit InOrderPipeline(PipelineConfig config = {});
+
+  void onRetire(const RetiredInstruction &retired) override;
+
+  auto stats() const -> const PipelineStats & { return pipelineStats; }
+  auto config() const -> const PipelineConfig & { return pipelineConfig; }
+  // Forget all timing state and counters
+  void reset();
+  // Human-readable summary (cycles, CPI, stall breakdown)
+  auto report(std::ostream &out) const -> void;
+
+private:
+  // Delay issue until the register in slot is ready
+  void waitFor(size_t slot, uint64_t &issue, bool &fromLoad) const;
+
+  PipelineConfig pipelineConfig;
+  std::array<uint64_t, 32> ready{}; // X0-X30, then SP
+  std::array<bool, 32> loaded{};    // Last written by an LDR
+  uint64_t flagsReady = 0;
+  uint64_t nextIssue = 0; // Earliest cycle the next instruction enters EX
+  PipelineStats pipelineStats;
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include "decoder.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+constexpr size_t ADDR_MODE_COUNT =
+    static_cast<size_t>(AddrMode::PostIndex) + 1;
+
+/**
+ * @brief Guest performance counters of one thread of execution.
+ * - retired: instructions retired, by InstructionType
+ * - loads, stores: LDR/STR retired, by AddrMode (None stays zero)
+ * - branchesTaken, branchesNotTaken: B and B.cond by outcome (B is always
+ * taken)
+ * - flagSetting: ADDS/SUBS and their CMN/CMP aliases
+ *
+ * The execution engines count into the calling thread's block (see
+ * PmuCounters::attach()) through the SIM_PMU_COUNT macro, which expands to
+ * nothing unless the build is configured with -DAARCH64_SIM_PMU=ON. Counting
+ * is a handful of increments with no allocation or I/O. Each block fills
+ * whole cache lines, so blocks of different cores kept side by side do not
+ * share a line.
+ */
+struct alignas(64) PmuCounters {
+  std::array<uint64_t, INSTRUCTION_TYPE_COUNT> retired{};
+  std::array<uint64_t, ADDR_MODE_COUNT> loads{};
+  std::array<uint64_t, ADDR_MODE_COUNT> stores{};
+  uint64_t branchesTaken = 0;
+  uint64_t branchesNotTaken = 0;
+  uint64_t flagSetting = 0;
+
+  // Count one retired instruction; taken is its branch outcome
+  void count(const DecodedInstruction &instr, bool taken) {
+    retired[static_cast<size_t>(instr.type)]++;
+    switch (instr.type) {
+    case InstructionType::LDR:
+      loads[static_cast<size_t>(instr.mode)]++;
+      break;
+    case InstructionType::STR:
+      stores[static_cast<size_t>(instr.mode)]++;
+      break;
+    case InstructionType::BRANCH:
+    case InstructionType::BRANCH_COND:
+      (taken ? branchesTaken : branchesNotTaken)++;
+      break;
+    default:
+      flagSetting += instr.setFlags ? 1 : 0;
+      break;
+    }
+  }
+
+  // Instructions retired of every type
+  auto instructions() const -> uint64_t;
+  // Counts since earlier, a copy of these counters taken before
+  auto since(const PmuCounters &earlier) const -> PmuCounters;
+  auto operator+=(const PmuCounters &other) -> PmuCounters &;
+  void clear() { *this = {}; }
+
+  // One-line JSON object, e.g. {"instructions":3,"retired":{"ADD_IMM":2,...},
+  // "loads":{"offset":1,...},"stores":{...},"branches":{"taken":0,
+  // "not_taken":0},"flag_setting":1}
+  auto json() const -> std::string;
+  auto writeJson(std::ostream &out) const -> void;
+
+  // Make counters the calling thread's block (nullptr detaches)
+  static void attach(PmuCounters *counters);
+  static auto sink() -> PmuCounters * { return threadSink; }
+
+private:
+  static thread_local PmuCounters *threadSink;
+};
+
+// SIM_PMU_COUNT(instr, taken): count one retired instruction into the calling
+// thread's block. Arguments are not evaluated when the PMU is compiled out.
+#if defined(AARCH64_SIM_PMU)
+#define SIM_PMU_COUNT(INSTR_, TAKEN_)                                          \
+  do {                                                                         \
+    if (PmuCounters *sim_pmu_sink = PmuCounters::sink()) {                     \
+      sim_pmu_sink->count((INSTR_), (TAKEN_));                                 \
+    }                                                                          \
+  } while (0)
+#else
+#define SIM_PMU_COUNT(INSTR_, TAKEN_)                                          \
+  do {                                                                         \
+  } while (0)
+#endif
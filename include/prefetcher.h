@@ -0,0 +1,220 @@
+#pragma once
+#include "cache_model.h"
+#include "config_file.h"
+#include "retire_observer.h"
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief One demand access as a Prefetcher sees it.
+ * - pc: the LDR/STR making it
+ * - address: effective address
+ * - line: address / line size
+ * - miss: the line was not in the cache
+ * - prefetchHit: first use of a line brought in by a prefetch
+ */
+struct PrefetchAccess {
+  uint64_t pc = 0;
+  uint64_t address = 0;
+  uint64_t line = 0;
+  bool miss = false;
+  bool prefetchHit = false;
+};
+
+/**
+ * @brief Interface of a data prefetcher: it watches demand accesses and
+ * names the lines (as line numbers, address / line size) it wants fetched.
+ * PrefetchModel filters out lines already present, so a prefetcher does not
+ * need to remember what it asked for.
+ */
+class Prefetcher {
+public:
+  virtual ~Prefetcher() = default;
+  virtual auto name() const -> const char * = 0;
+  // Look at access and append the lines to prefetch to lines
+  virtual void observe(const PrefetchAccess &access,
+                       std::vector<uint64_t> &lines) = 0;
+  // Forget all training
+  virtual void reset() = 0;
+};
+
+/**
+ * @brief Fetches the next degree lines after every miss and after the first
+ * use of a prefetched line (tagged next-line prefetching), so a sequential
+ * walk keeps degree lines ahead after its first miss.
+ */
+class NextLinePrefetcher : public Prefetcher {
+public:
+  explicit NextLinePrefetcher(uint32_t degree = 1) : degree(degree) {}
+  auto name() const -> const char * override { return "next-line"; }
+  void observe(const PrefetchAccess &access,
+               std::vector<uint64_t> &lines) override;
+  void reset() override {}
+
+private:
+  uint32_t degree;
+};
+
+/**
+ * @brief Reference prediction table indexed by PC. Each entry remembers the
+ * last address and stride of one LDR/STR and a 2-bit confidence that rises
+ * when the stride repeats and falls when it does not; with confidence of at
+ * least 2 the lines of the next degree strides are fetched. The table is
+ * direct-mapped on the PC and tagged with it.
+ */
+class StridePrefetcher : public Prefetcher {
+public:
+  explicit StridePrefetcher(uint32_t entries = 64, uint32_t degree = 2,
+                            uint32_t lineBytes = 64);
+  auto name() const -> const char * override { return "stride"; }
+  void observe(const PrefetchAccess &access,
+               std::vector<uint64_t> &lines) override;
+  void reset() override;
+
+private:
+  struct Entry {
+    uint64_t pc = 0;
+    uint64_t last = 0;
+    int64_t stride = 0;
+    uint8_t confidence = 0;
+    bool valid = false;
+  };
+
+  std::vector<Entry> table;
+  uint32_t degree;
+  uint32_t lineShift;
+};
+
+/**
+ * @brief Stream buffers in the style of Jouppi: a miss that no stream
+ * expects starts a stream (replacing the least recently used one) in the
+ * direction of the previous miss and fetches depth lines ahead; an access
+ * inside a stream's window advances it and tops the window up again.
+ */
+class StreamPrefetcher : public Prefetcher {
+public:
+  explicit StreamPrefetcher(uint32_t streams = 4, uint32_t depth = 4);
+  auto name() const -> const char * override { return "stream"; }
+  void observe(const PrefetchAccess &access,
+               std::vector<uint64_t> &lines) override;
+  void reset() override;
+
+private:
+  struct Stream {
+    uint64_t head = 0; // Next line the stream expects to be used
+    uint64_t next = 0; // Next line to fetch
+    int64_t direction = 1;
+    uint64_t lastUse = 0;
+    bool valid = false;
+  };
+
+  void fill(Stream &stream, std::vector<uint64_t> &lines) const;
+
+  std::vector<Stream> buffers;
+  uint32_t depth;
+  uint64_t lastMiss = 0;
+  uint64_t clock = 0;
+};
+
+enum class PrefetcherKind { NextLine, Stride, Stream };
+
+/**
+ * @brief Parameters of a PrefetchModel.
+ * - kind: which prefetcher to build
+ * - degree: lines fetched per trigger (next-line, stride)
+ * - tableEntries: stride table entries
+ * - streams, depth: stream buffers and lines each keeps ahead
+ * - latency: retired instructions a prefetch takes to arrive; a demand
+ * access sooner than that still waits, and counts as late
+ * - cache: the L1D the model measures against (when it warms a
+ * CacheHierarchy, that hierarchy's L1D is used instead)
+ *
+ * load() reads a config_file over the defaults. Keys are prefetcher
+ * (next_line, stride or stream), degree, table_entries, streams, depth and
+ * latency.
+ */
+struct PrefetchConfig {
+  PrefetcherKind kind = PrefetcherKind::Stride;
+  uint32_t degree = 2;
+  uint32_t tableEntries = 64;
+  uint32_t streams = 4;
+  uint32_t depth = 4;
+  uint32_t latency = 32;
+  CacheConfig cache = {32 * 1024, 8, 64, ReplacementPolicy::PLRU, true, true};
+
+  auto load(const std::string &path, std::string &error) -> bool;
+  auto parse(std::istream &in, std::string &error) -> bool;
+};
+
+// Build the prefetcher config.kind names
+auto make_prefetcher(const PrefetchConfig &config)
+    -> std::unique_ptr<Prefetcher>;
+
+/**
+ * @brief How well a prefetcher did.
+ * - accesses: demand LDR/STR accesses
+ * - misses: demand accesses that still missed
+ * - issued: prefetches sent for lines not already present
+ * - useful: prefetched lines used by a demand access before eviction
+ * - late: useful prefetches used before they had arrived
+ */
+struct PrefetchStats {
+  uint64_t accesses = 0;
+  uint64_t misses = 0;
+  uint64_t issued = 0;
+  uint64_t useful = 0;
+  uint64_t late = 0;
+
+  // Useful prefetches per prefetch issued
+  auto accuracy() const -> double;
+  // Share of would-be misses that prefetching removed: useful / (useful +
+  // misses)
+  auto coverage() const -> double;
+  // Share of useful prefetches that arrived in time
+  auto timeliness() const -> double;
+};
+
+/**
+ * @brief Runs a Prefetcher on the LDR/STR address stream as a
+ * RetireObserver. Demand accesses and prefetches go through a private copy
+ * of the L1D, which decides what missed and remembers which lines were
+ * prefetched and when; that keeps the measurements independent of the
+ * order observers run in. Given a CacheHierarchy, every prefetch is also
+ * filled into its L1D, L2 and LLC (CacheHierarchy::prefetch()), so its
+ * counters show the effect of prefetching.
+ */
+class PrefetchModel : public RetireObserver {
+public:
+  explicit PrefetchModel(const PrefetchConfig &config = {},
+                         CacheHierarchy *warm = nullptr);
+  PrefetchModel(std::unique_ptr<Prefetcher> prefetcher,
+                const PrefetchConfig &config, CacheHierarchy *warm = nullptr);
+
+  void onRetire(const RetiredInstruction &retired) override;
+
+  auto stats() const -> const PrefetchStats & { return prefetchStats; }
+  auto prefetcher() const -> const Prefetcher & { return *model; }
+  void reset();
+  // Accuracy, coverage and timeliness
+  auto report(std::ostream &out) const -> void;
+
+private:
+  void access(uint64_t pc, uint64_t address, bool write);
+  // Drop records of prefetched lines the cache no longer holds
+  void forgetEvicted();
+
+  std::unique_ptr<Prefetcher> model;
+  uint32_t latency;
+  CacheHierarchy *warm;
+  Cache cache;
+  uint32_t lineShift = 0;
+  // Prefetched lines not used yet, with the instruction count at issue
+  std::unordered_map<uint64_t, uint64_t> pending;
+  std::vector<uint64_t> candidates;
+  uint64_t retiredCount = 0;
+  PrefetchStats prefetchStats;
+};
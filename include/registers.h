@@ -1,5 +1,6 @@
 #pragma once
 #include <array>
+#include <cstddef>
 #include <cstdint>
 
 namespace arm64 {
@@ -19,6 +20,212 @@ namespace arm64 {
  *
  */
 constexpr uint8_t REG_XZR = 31;
+
+// Bits of PState::nzcv(), in PSTATE.NZCV order
+constexpr uint8_t FLAG_N = 0x8;
+constexpr uint8_t FLAG_Z = 0x4;
+constexpr uint8_t FLAG_C = 0x2;
+constexpr uint8_t FLAG_V = 0x1;
+
+// CONDITION_TABLE[cond] has bit n set when condition code cond holds for
+// NZCV == n. Even codes test EQ Z, CS C, MI N, VS V, HI C && !Z, GE N == V,
+// GT !Z && N == V and AL; odd codes negate them, except NV (0xF), which is
+// also "always".
+constexpr auto make_condition_table() -> std::array<uint16_t, 16> {
+  std::array<uint16_t, 16> table{};
+  for (uint8_t cond = 0; cond < 16; cond++) {
+    for (uint8_t nzcv = 0; nzcv < 16; nzcv++) {
+      bool n = (nzcv & FLAG_N) != 0;
+      bool z = (nzcv & FLAG_Z) != 0;
+      bool c = (nzcv & FLAG_C) != 0;
+      bool v = (nzcv & FLAG_V) != 0;
+      bool holds = true;
+      switch (cond >> 1) {
+      case 0:
+        holds = z;
+        break;
+      case 1:
+        holds = c;
+        break;
+      case 2:
+        holds = n;
+        break;
+      case 3:
+        holds = v;
+        break;
+      case 4:
+        holds = c && !z;
+        break;
+      case 5:
+        holds = n == v;
+        break;
+      case 6:
+        holds = !z && n == v;
+        break;
+      default:
+        break;
+      }
+      if ((cond & 1) != 0 && cond != 0xF) {
+        holds = !holds;
+      }
+      table[cond] |= static_cast<uint16_t>(holds ? 1U << nzcv : 0U);
+    }
+  }
+  return table;
+}
+inline constexpr std::array<uint16_t, 16> CONDITION_TABLE =
+    make_condition_table();
+
+/**
+ * @brief Lazily evaluated condition flags. A flag-setting ADD or SUB only
+ * records its operands and result (record()); N, Z, C and V are derived from
+ * them when something reads them, so flags that are overwritten before any
+ * B.cond looks at them cost three stores. Writing a flag directly
+ * materializes all four and drops the record.
+ *
+ * Operands and result are stored already truncated to the operation's
+ * width, so Z is (result == 0) for either width and C/V follow the AArch64
+ * AddWithCarry rules: ADD sets C on unsigned carry out, SUB on no borrow,
+ * and both set V on signed overflow.
+ */
+class PState {
+public:
+  enum class Op : uint8_t { None, Add64, Sub64, Add32, Sub32 };
+
+  // Byte offsets of the record inside a PState, for translated code
+  struct Layout {
+    size_t lhs;
+    size_t rhs;
+    size_t result;
+    size_t op;
+  };
+  static constexpr auto layout() -> Layout;
+
+  void record(Op kind, uint64_t a, uint64_t b, uint64_t r) {
+    lhs = a;
+    rhs = b;
+    result = r;
+    op = kind;
+  }
+
+  // Does condition code cond (0-15) hold? EQ/NE test the recorded result
+  // directly; everything else goes through CONDITION_TABLE.
+  auto condition(uint8_t cond) const -> bool {
+    if ((cond >> 1) == 0 && op != Op::None) {
+      return (result == 0) != ((cond & 1) != 0);
+    }
+    return ((CONDITION_TABLE[cond & 0xF] >> nzcv()) & 1) != 0;
+  }
+
+  // Does condition code cond hold after a SUBS of a and b, both already
+  // truncated to the width? Same answer as record() then condition(), but
+  // computed from the operands with a compare, as a fused CMP + B.cond does.
+  static auto afterSub(uint8_t cond, uint64_t a, uint64_t b, bool is64)
+      -> bool {
+    unsigned shift = is64 ? 0 : 32; // Move a W sign bit to bit 63
+    auto sa = static_cast<int64_t>(a << shift);
+    auto sb = static_cast<int64_t>(b << shift);
+    auto sr = static_cast<int64_t>((a - b) << shift);
+    bool holds = true;
+    switch ((cond >> 1) & 0x7) {
+    case 0: // EQ
+      holds = a == b;
+      break;
+    case 1: // CS
+      holds = a >= b;
+      break;
+    case 2: // MI
+      holds = sr < 0;
+      break;
+    case 3: // VS
+      holds = ((sa ^ sb) & (sa ^ sr)) < 0;
+      break;
+    case 4: // HI
+      holds = a > b;
+      break;
+    case 5: // GE
+      holds = sa >= sb;
+      break;
+    case 6: // GT
+      holds = sa > sb;
+      break;
+    default: // AL, NV
+      return true;
+    }
+    return holds != ((cond & 1) != 0);
+  }
+
+  auto nzcv() const -> uint8_t {
+    if (op == Op::None) {
+      return flags;
+    }
+    return static_cast<uint8_t>(N() << 3 | Z() << 2 | C() << 1 | V());
+  }
+  void setNZCV(uint8_t value) {
+    flags = value & 0xF;
+    op = Op::None;
+  }
+
+  auto N() const -> bool {
+    if (op == Op::None) {
+      return (flags & FLAG_N) != 0;
+    }
+    return ((result >> signBit()) & 1) != 0;
+  }
+  auto Z() const -> bool {
+    if (op == Op::None) {
+      return (flags & FLAG_Z) != 0;
+    }
+    return result == 0;
+  }
+  auto C() const -> bool {
+    switch (op) {
+    case Op::None:
+      return (flags & FLAG_C) != 0;
+    case Op::Add64:
+    case Op::Add32:
+      return result < lhs; // Carry out
+    default:
+      return lhs >= rhs; // No borrow
+    }
+  }
+  auto V() const -> bool {
+    switch (op) {
+    case Op::None:
+      return (flags & FLAG_V) != 0;
+    case Op::Add64:
+    case Op::Add32: // Operands agree in sign, result does not
+      return (((lhs ^ result) & (rhs ^ result)) >> signBit() & 1) != 0;
+    default: // Operands differ in sign, result took rhs's
+      return (((lhs ^ rhs) & (lhs ^ result)) >> signBit() & 1) != 0;
+    }
+  }
+
+  void setN(bool value) { setFlag(FLAG_N, value); }
+  void setZ(bool value) { setFlag(FLAG_Z, value); }
+  void setC(bool value) { setFlag(FLAG_C, value); }
+  void setV(bool value) { setFlag(FLAG_V, value); }
+
+private:
+  auto signBit() const -> unsigned {
+    return (op == Op::Add32 || op == Op::Sub32) ? 31 : 63;
+  }
+  void setFlag(uint8_t bit, bool value) {
+    uint8_t current = nzcv();
+    setNZCV(value ? (current | bit) : (current & ~bit));
+  }
+
+  uint64_t lhs = 0;
+  uint64_t rhs = 0;
+  uint64_t result = 0;
+  Op op = Op::None;
+  uint8_t flags = 0; // NZCV while op is None
+};
+
+constexpr auto PState::layout() -> Layout {
+  return {offsetof(PState, lhs), offsetof(PState, rhs),
+          offsetof(PState, result), offsetof(PState, op)};
+}
 /**
  * @brief CPUState struct to represent the state of the CPU, including
  * general-purpose registers (X0-X30), the program counter (PC), the stack
@@ -29,20 +236,15 @@ constexpr uint8_t REG_XZR = 31;
  * simulator. Note: The getReg and setReg methods will handle the logic for
  * accessing registers, including the special case for XZR. The PC and SP are
  * treated as separate fields for clarity, but they can also be accessed through
- * the getReg and setReg methods if desired. The condition flags are stored in a
- * nested struct for better organization.
+ * the getReg and setReg methods if desired. The condition flags live in a
+ * PState, which evaluates them lazily.
  *
  */
 struct CPUState {
   std::array<uint64_t, REG_XZR> X; // X0-X30
   uint64_t PC;                     // Program Counter
   uint64_t SP;                     // Stack Pointer
-  struct {
-    bool N; // Negative Flag
-    bool Z; // Zero Flag
-    bool C; // Carry Flag
-    bool V; // Overflow Flag
-  } pstate;
+  PState pstate;                   // Condition flags (N, Z, C, V)
   // Core Register Logic
   auto getReg(uint8_t regId) const -> uint64_t;
   auto setReg(uint8_t regId, uint64_t value) -> void;
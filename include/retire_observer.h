@@ -0,0 +1,32 @@
+#pragma once
+#include "decoder.h"
+#include <cstdint>
+
+/**
+ * @brief One instruction as it retires, handed to every RetireObserver.
+ * - pc: address of the instruction
+ * - instr: the decoded instruction; only valid during the callback
+ * - address: effective address of an LDR/STR, target of a B/B.cond, else 0
+ * - taken: the instruction wrote the PC (B, or a B.cond whose condition held)
+ */
+struct RetiredInstruction {
+  uint64_t pc = 0;
+  const DecodedInstruction *instr = nullptr;
+  uint64_t address = 0;
+  bool taken = false;
+};
+
+/**
+ * @brief Interface for models that follow the instruction stream without
+ * affecting it (timing, caches, branch predictors). A Simulator with at least
+ * one observer attached executes instruction by instruction through
+ * Executor::execute and calls every observer after each instruction, in
+ * program order; with none attached it keeps its block engine, so the
+ * functional fast path pays one branch per block.
+ */
+class RetireObserver {
+public:
+  virtual ~RetireObserver() = default;
+  // Called after instruction retired.instr has executed
+  virtual void onRetire(const RetiredInstruction &retired) = 0;
+};
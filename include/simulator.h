@@ -0,0 +1,130 @@
+#pragma once
+#include "block_cache.h"
+#include "decoder.h"
+#include "jit.h"
+#include "memory.h"
+#include "registers.h"
+#include "retire_observer.h"
+#include <cstdint>
+#include <iosfwd>
+#include <limits>
+#include <vector>
+
+/**
+ * @brief Reasons for which the Simulator hands control back to its caller.
+ * - Retired: a single step() completed normally
+ * - InstructionLimit: the instruction budget given to run() was used up
+ * - Breakpoint: the PC reached the address given to run_until()
+ * - UndefinedInstruction: the word at PC did not decode; PC is left on it so
+ * the caller can inspect the faulting address
+ */
+enum class StopReason {
+  Retired,
+  InstructionLimit,
+  Breakpoint,
+  UndefinedInstruction,
+};
+
+/**
+ * @brief Throughput counters accumulated by the Simulator run loops.
+ * - instructions: guest instructions retired
+ * - dispatches: handler dispatches of the interpreter: one per instruction,
+ * except that a fused pair (see MacroOp) is one. Code run by the Jit counts
+ * one per instruction.
+ * - hostSeconds: wall-clock time spent inside run()/run_until()
+ */
+struct RunStats {
+  uint64_t instructions = 0;
+  uint64_t dispatches = 0;
+  double hostSeconds = 0.0;
+
+  // Millions of guest instructions retired per host second
+  auto mips() const -> double;
+  // Dispatches per retired instruction (1.0 without fusion)
+  auto dispatchesPerInstruction() const -> double;
+};
+
+/**
+ * @brief Simulator ties the Decoder, Executor, CPUState and Memory together
+ * into a fetch-decode-execute loop. Each step reads the 32-bit word at
+ * CPUState::PC, decodes it, executes it and then advances the PC by 4 unless
+ * the instruction was a taken branch (in which case the Executor has already
+ * written the branch target). The CPU state and memory are borrowed, so the
+ * caller keeps full control over their setup and can inspect them between
+ * runs. Retired instructions and host time are accumulated in RunStats so
+ * end-to-end interpreter throughput can be measured in one place.
+ *
+ * step() always decodes the word at PC afresh. run() and run_until() go
+ * through a BlockCache instead and execute a whole decoded basic block per
+ * lookup, falling back to a partial block only when the instruction budget or
+ * the run_until() target ends inside it; adjacent pairs the BlockCache fused
+ * run as one dispatch (RunStats::dispatches). Blocks are executed by
+ * Executor::runBlock, or by ThreadedExecutor::runBlock when the build is
+ * configured with -DAARCH64_SIM_DISPATCH=threaded. With
+ * -DAARCH64_SIM_DISPATCH=jit, run() hands blocks to a Jit, which translates
+ * hot ones to host code; run_until() keeps interpreting so the breakpoint is
+ * checked at every block.
+ *
+ * Timing, cache and branch models attach as RetireObservers. While any is
+ * attached, step(), run() and run_until() execute one instruction at a time
+ * through Executor::execute (still fetching from the BlockCache) and report
+ * each retired instruction to the observers in program order.
+ *
+ * snapshot() captures the CPU state (registers, PC, SP and PSTATE) and makes
+ * the memory contents the baseline of Memory::snapshot(); restore() returns
+ * both to it, copying back only the pages written since, so a harness can
+ * reset the machine between runs without rebuilding it. Decoded blocks of
+ * restored code pages are invalidated through the usual code-write path.
+ */
+class Simulator {
+public:
+  static constexpr uint64_t NO_LIMIT = std::numeric_limits<uint64_t>::max();
+
+  Simulator(arm64::CPUState &cpu, Memory &mem);
+
+  // Fetch, decode and execute exactly one instruction
+  auto step() -> StopReason;
+  // Execute until max_instructions have retired or the guest stops
+  auto run(uint64_t max_instructions = NO_LIMIT) -> StopReason;
+  // Execute until the PC equals pc (checked before each instruction)
+  auto run_until(uint64_t pc, uint64_t max_instructions = NO_LIMIT)
+      -> StopReason;
+
+  // Capture CPU state and memory contents for restore()
+  auto snapshot() -> void;
+  // Return CPU state and memory to the last snapshot(); false when there is
+  // none
+  auto restore() -> bool;
+
+  // Report every retired instruction to observer until it is removed
+  auto addObserver(RetireObserver *observer) -> void;
+  auto removeObserver(RetireObserver *observer) -> void;
+
+  auto stats() const -> const RunStats & { return runStats; }
+  auto resetStats() -> void { runStats = {}; }
+  auto blockCache() -> BlockCache & { return blocks; }
+#if defined(AARCH64_SIM_JIT_DISPATCH)
+  auto jitEngine() -> Jit & { return jit; }
+#endif
+  // Human-readable throughput summary (instructions, dispatches, seconds,
+  // MIPS)
+  auto report(std::ostream &out) const -> void;
+
+private:
+  auto loop(uint64_t max_instructions, uint64_t stop_pc, bool use_stop_pc)
+      -> StopReason;
+  // Executor::runBlock with the observers told about every instruction
+  auto runObserved(const BasicBlock &block, uint64_t count) -> uint64_t;
+  auto retire(const DecodedInstruction &instr) -> bool;
+
+  arm64::CPUState &cpu;
+  Memory &mem;
+  BlockCache blocks;
+#if defined(AARCH64_SIM_JIT_DISPATCH)
+  Jit jit{blocks, mem};
+#endif
+  RunStats runStats;
+  std::vector<RetireObserver *> observers;
+  arm64::CPUState savedCpu{};
+  bool hasSnapshot = false;
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include "memory.h"
+#include "pmu.h"
+#include "registers.h"
+#include "simulator.h"
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Scheduling knobs for SmpSimulator.
+ * - quantum: guest instructions a core retires between synchronisation
+ * points. Smaller quanta keep the cores closer together in guest time at the
+ * cost of more synchronisation.
+ * - deterministic: run all cores round-robin, one quantum each, on the
+ * calling thread. Runs are then exactly reproducible; otherwise every core
+ * gets its own host thread.
+ */
+struct SmpConfig {
+  uint64_t quantum = 10000;
+  bool deterministic = false;
+};
+
+/**
+ * @brief SmpSimulator runs several cores against one shared guest Memory.
+ * Each CPUState gets its own Simulator (and so its own BlockCache) over its
+ * own Memory::makeView(), so cores share guest pages but no host-side caches.
+ *
+ * In the default threaded mode core i runs on host thread i. After every
+ * quantum the running cores meet at a barrier, so no core gets more than one
+ * quantum ahead of the others; a core that stops leaves the barrier. Guest
+ * memory accesses are not ordered between cores beyond that, and a store to
+ * code another core has cached is seen by that core at its next block.
+ * In deterministic mode the cores take turns on the calling thread in index
+ * order.
+ *
+ * Each core has its own PmuCounters, attached to whichever thread runs it
+ * for the length of a quantum; they stay zero unless the build is configured
+ * with -DAARCH64_SIM_PMU=ON.
+ *
+ * The CPUStates are borrowed and must outlive the SmpSimulator.
+ */
+class SmpSimulator {
+public:
+  SmpSimulator(std::vector<arm64::CPUState> &cpus, Memory &mem,
+               SmpConfig config = {});
+  ~SmpSimulator();
+  SmpSimulator(const SmpSimulator &) = delete;
+  auto operator=(const SmpSimulator &) -> SmpSimulator & = delete;
+
+  // Run until every core has stopped or retired max_instructions of its own
+  auto run(uint64_t max_instructions = Simulator::NO_LIMIT) -> void;
+
+  auto cores() const -> size_t { return coreStates.size(); }
+  auto core(size_t index) -> Simulator & { return *coreStates[index].sim; }
+  // Why core index stopped in the last run()
+  auto stopReason(size_t index) const -> StopReason {
+    return coreStates[index].reason;
+  }
+  // Guest performance counters of core index, over all runs
+  auto pmu(size_t index) const -> const PmuCounters & {
+    return coreStates[index].pmu;
+  }
+  // Instructions retired by all cores and wall-clock seconds spent in run()
+  auto totalInstructions() const -> uint64_t;
+  auto hostSeconds() const -> double { return wallSeconds; }
+  // Per-core and aggregate throughput summary
+  auto report(std::ostream &out) const -> void;
+
+private:
+  struct Core {
+    std::unique_ptr<Memory> view;
+    std::unique_ptr<Simulator> sim;
+    StopReason reason = StopReason::InstructionLimit;
+    PmuCounters pmu;
+  };
+
+  auto runQuantum(Core &core, uint64_t &left) -> bool;
+  auto runThreaded(uint64_t max_instructions) -> void;
+  auto runDeterministic(uint64_t max_instructions) -> void;
+
+  SmpConfig config;
+  std::vector<Core> coreStates;
+  double wallSeconds = 0.0;
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include "block_cache.h"
+#include "memory.h"
+#include "registers.h"
+#include <cstdint>
+
+/**
+ * @brief ThreadedExecutor is a direct-threaded alternative to the
+ * switch-based Executor::runBlock. With GCC/Clang it uses computed goto: the
+ * block's instructions are walked by a chain of labels, one per
+ * InstructionType, and every label ends with its own indirect jump to the
+ * next instruction's label. Dispatch therefore happens from as many branch
+ * sites as there are instruction kinds, which lets the host predictor learn
+ * per-kind successor patterns instead of funnelling everything through one
+ * switch. Other compilers fall back to a table of handler pointers indexed by
+ * InstructionType. Both variants share the instruction semantics with
+ * Executor (src/executor_ops.h), so the engines only differ in dispatch.
+ * Fused pairs (BasicBlock::fusion) get labels of their own: the label table
+ * is indexed by the pair kind as well as the instruction type, so a pair
+ * costs one indirect jump.
+ *
+ * The Simulator uses this engine when the build is configured with
+ * -DAARCH64_SIM_DISPATCH=threaded; both engines are always compiled so they
+ * can be benchmarked against each other.
+ */
+class ThreadedExecutor {
+public:
+  // Same contract as Executor::runBlock
+  static auto runBlock(const BasicBlock &block, uint64_t count,
+                       arm64::CPUState &cpu, Memory &mem) -> uint64_t;
+  // True when the computed-goto variant was compiled in
+  static auto usesComputedGoto() -> bool;
+};
@@ -0,0 +1,108 @@
+#pragma once
+#include "decoder.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One fixed-size binary trace record.
+ * - pc: address of the instruction
+ * - address: effective address (LDR/STR) or branch target (B, B.cond)
+ * - value: value loaded or stored; for B.cond, 1 when the branch was taken
+ * - type: InstructionType of the instruction
+ * - reg: transfer register (Rt) of a load or store
+ */
+struct TraceEvent {
+  uint64_t pc = 0;
+  uint64_t address = 0;
+  uint64_t value = 0;
+  uint8_t type = 0;
+  uint8_t reg = 0;
+  uint8_t reserved[6] = {};
+};
+static_assert(sizeof(TraceEvent) == 32, "trace files store 32-byte events");
+
+/**
+ * @brief Preallocated ring of TraceEvents. record() is a masked store and an
+ * increment, with no allocation or I/O; once the ring is full the oldest
+ * events are overwritten and counted as dropped.
+ *
+ * The execution engines record into the calling thread's sink (see
+ * TraceBuffer::attach()) through the SIM_TRACE macro, which expands to nothing
+ * unless the build is configured with -DAARCH64_SIM_TRACE=ON. dump() writes
+ * the surviving events, oldest first, to a file that tools/trace_dump turns
+ * back into text. The file is a FileHeader followed by `count` raw events
+ * in host byte order.
+ */
+class TraceBuffer {
+public:
+  static constexpr char FILE_MAGIC[8] = {'A', '6', '4', 'T',
+                                         'R', 'A', 'C', 'E'};
+  static constexpr uint32_t FILE_VERSION = 1;
+
+  struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t eventSize;
+    uint64_t count;   // Events that follow the header
+    uint64_t dropped; // Older events overwritten before the dump
+  };
+
+  // capacity is rounded up to a power of two
+  explicit TraceBuffer(size_t capacity = size_t{1} << 16);
+
+  void record(const TraceEvent &event) {
+    events[recorded & mask] = event;
+    recorded++;
+  }
+
+  // Events currently held, oldest first
+  auto snapshot() const -> std::vector<TraceEvent>;
+  auto capacity() const -> size_t { return events.size(); }
+  // Events recorded since the last clear(), including overwritten ones
+  auto total() const -> uint64_t { return recorded; }
+  auto dropped() const -> uint64_t;
+  void clear() { recorded = 0; }
+
+  // Write the held events to path; false on I/O failure
+  auto dump(const std::string &path) const -> bool;
+  // Read a dump back; false when the file is missing, not a trace, or holds
+  // a different number of events than its header says (truncated, corrupt)
+  static auto readFile(const std::string &path, std::vector<TraceEvent> &out,
+                       FileHeader *header = nullptr) -> bool;
+  // One line of text describing event, as printed by tools/trace_dump
+  static auto format(const TraceEvent &event) -> std::string;
+
+  // Make buffer the calling thread's sink (nullptr detaches)
+  static void attach(TraceBuffer *buffer);
+  static auto sink() -> TraceBuffer * { return threadSink; }
+
+private:
+  static thread_local TraceBuffer *threadSink;
+
+  std::vector<TraceEvent> events;
+  uint64_t mask;
+  uint64_t recorded = 0;
+};
+
+// SIM_TRACE(pc, type, address, value, reg): record one event into the calling
+// thread's sink. Arguments are not evaluated when tracing is compiled out.
+#if defined(AARCH64_SIM_TRACE)
+#define SIM_TRACE(PC_, TYPE_, ADDRESS_, VALUE_, REG_)                          \
+  do {                                                                         \
+    if (TraceBuffer *sim_trace_sink = TraceBuffer::sink()) {                   \
+      TraceEvent sim_trace_event;                                              \
+      sim_trace_event.pc = (PC_);                                              \
+      sim_trace_event.address = (ADDRESS_);                                    \
+      sim_trace_event.value = (VALUE_);                                        \
+      sim_trace_event.type = static_cast<uint8_t>(TYPE_);                      \
+      sim_trace_event.reg = (REG_);                                            \
+      sim_trace_sink->record(sim_trace_event);                                 \
+    }                                                                          \
+  } while (0)
+#else
+#define SIM_TRACE(PC_, TYPE_, ADDRESS_, VALUE_, REG_)                          \
+  do {                                                                         \
+  } while (0)
+#endif
@@ -0,0 +1,466 @@
+#include "batch_executor.h"
+#include "executor_ops.h"
+#include <algorithm>
+#include <chrono>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SIM_BATCH_AVX2 1
+#include <immintrin.h>
+#else
+#define SIM_BATCH_AVX2 0
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define SIM_BATCH_NEON 1
+#include <arm_neon.h>
+#else
+#define SIM_BATCH_NEON 0
+#endif
+
+namespace {
+constexpr uint64_t INSTRUCTION_BYTES = 4;
+constexpr double INSTRUCTIONS_PER_MILLION = 1e6;
+constexpr uint64_t ALL_LANES = ~uint64_t{0};
+
+// Operands of one 64-bit ADD/SUB across count lanes (a multiple of
+// LANE_ALIGN)
+struct AluArgs {
+  uint64_t *rd;
+  const uint64_t *rn;
+  const uint64_t *rm; // nullptr for the immediate forms
+  uint64_t imm;
+  const uint64_t *mask;
+  uint64_t *n;
+  uint64_t *z;
+  uint64_t *c;
+  uint64_t *v;
+  size_t count;
+};
+
+using AluKernel = void (*)(const AluArgs &);
+
+// Portable kernel. Written as blends so compilers can vectorise it too.
+template <bool Sub, bool Flags, bool Reg>
+void alu_scalar(const AluArgs &args) {
+  for (size_t i = 0; i < args.count; i++) {
+    uint64_t m = args.mask[i];
+    uint64_t x = args.rn[i];
+    uint64_t y = Reg ? args.rm[i] : args.imm;
+    uint64_t r = Sub ? x - y : x + y;
+    args.rd[i] = (r & m) | (args.rd[i] & ~m);
+    if (Flags) {
+      uint64_t carry = Sub ? (x >= y) : (r < x);
+      uint64_t overflow = (Sub ? (x ^ y) & (x ^ r) : (x ^ r) & (y ^ r)) >> 63;
+      args.n[i] = ((r >> 63) & m) | (args.n[i] & ~m);
+      args.z[i] = (uint64_t{r == 0} & m) | (args.z[i] & ~m);
+      args.c[i] = (carry & m) | (args.c[i] & ~m);
+      args.v[i] = (overflow & m) | (args.v[i] & ~m);
+    }
+  }
+}
+
+#if SIM_BATCH_AVX2
+#define SIM_AVX2 __attribute__((target("avx2")))
+
+SIM_AVX2 inline auto load4(const uint64_t *p) -> __m256i {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+
+// Store value into the lanes of p selected by m
+SIM_AVX2 inline void blend4(uint64_t *p, __m256i value, __m256i m) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(p),
+                      _mm256_blendv_epi8(load4(p), value, m));
+}
+
+// AVX2 has no unsigned 64-bit compare; flipping the sign bits of both
+// operands turns the signed one into it
+template <bool Sub, bool Flags, bool Reg>
+SIM_AVX2 void alu_avx2(const AluArgs &args) {
+  const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+  const __m256i one = _mm256_set1_epi64x(1);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i imm = _mm256_set1_epi64x(static_cast<int64_t>(args.imm));
+  for (size_t i = 0; i < args.count; i += BatchState::LANE_ALIGN) {
+    __m256i m = load4(args.mask + i);
+    __m256i x = load4(args.rn + i);
+    __m256i y = Reg ? load4(args.rm + i) : imm;
+    __m256i r = Sub ? _mm256_sub_epi64(x, y) : _mm256_add_epi64(x, y);
+    blend4(args.rd + i, r, m);
+    if (Flags) {
+      __m256i carry;
+      if (Sub) { // x >= y  <=>  !(y > x)
+        carry = _mm256_andnot_si256(
+            _mm256_cmpgt_epi64(_mm256_xor_si256(y, sign),
+                               _mm256_xor_si256(x, sign)),
+            one);
+      } else { // r < x
+        carry = _mm256_and_si256(
+            _mm256_cmpgt_epi64(_mm256_xor_si256(x, sign),
+                               _mm256_xor_si256(r, sign)),
+            one);
+      }
+      __m256i xr = _mm256_xor_si256(x, r);
+      __m256i overflow =
+          Sub ? _mm256_and_si256(_mm256_xor_si256(x, y), xr)
+              : _mm256_and_si256(xr, _mm256_xor_si256(y, r));
+      blend4(args.n + i, _mm256_srli_epi64(r, 63), m);
+      blend4(args.z + i, _mm256_and_si256(_mm256_cmpeq_epi64(r, zero), one),
+             m);
+      blend4(args.c + i, carry, m);
+      blend4(args.v + i, _mm256_srli_epi64(overflow, 63), m);
+    }
+  }
+}
+#undef SIM_AVX2
+#endif
+
+#if SIM_BATCH_NEON
+template <bool Sub, bool Flags, bool Reg>
+void alu_neon(const AluArgs &args) {
+  const uint64x2_t one = vdupq_n_u64(1);
+  const uint64x2_t zero = vdupq_n_u64(0);
+  const uint64x2_t imm = vdupq_n_u64(args.imm);
+  auto blend = [](uint64_t *p, uint64x2_t value, uint64x2_t m) {
+    vst1q_u64(p, vbslq_u64(m, value, vld1q_u64(p)));
+  };
+  for (size_t i = 0; i < args.count; i += 2) {
+    uint64x2_t m = vld1q_u64(args.mask + i);
+    uint64x2_t x = vld1q_u64(args.rn + i);
+    uint64x2_t y = Reg ? vld1q_u64(args.rm + i) : imm;
+    uint64x2_t r = Sub ? vsubq_u64(x, y) : vaddq_u64(x, y);
+    blend(args.rd + i, r, m);
+    if (Flags) {
+      uint64x2_t carry = Sub ? vcgeq_u64(x, y) : vcgtq_u64(x, r);
+      uint64x2_t xr = veorq_u64(x, r);
+      uint64x2_t overflow = Sub ? vandq_u64(veorq_u64(x, y), xr)
+                                : vandq_u64(xr, veorq_u64(y, r));
+      blend(args.n + i, vshrq_n_u64(r, 63), m);
+      blend(args.z + i, vandq_u64(vceqq_u64(r, zero), one), m);
+      blend(args.c + i, vandq_u64(carry, one), m);
+      blend(args.v + i, vshrq_n_u64(overflow, 63), m);
+    }
+  }
+}
+#endif
+
+// Kernel table indexed by [sub][setFlags][register form]
+using AluTable = AluKernel[2][2][2];
+
+#define SIM_ALU_TABLE(fn)                                                      \
+  {{{fn<false, false, false>, fn<false, false, true>},                         \
+    {fn<false, true, false>, fn<false, true, true>}},                          \
+   {{fn<true, false, false>, fn<true, false, true>},                           \
+    {fn<true, true, false>, fn<true, true, true>}}}
+
+const AluTable SCALAR_KERNELS = SIM_ALU_TABLE(alu_scalar);
+#if SIM_BATCH_AVX2
+const AluTable AVX2_KERNELS = SIM_ALU_TABLE(alu_avx2);
+#endif
+#if SIM_BATCH_NEON
+const AluTable NEON_KERNELS = SIM_ALU_TABLE(alu_neon);
+#endif
+#undef SIM_ALU_TABLE
+
+auto host_has_avx2() -> bool {
+#if SIM_BATCH_AVX2
+  static const bool supported = __builtin_cpu_supports("avx2") != 0;
+  return supported;
+#else
+  return false;
+#endif
+}
+
+auto kernels(bool simd) -> const AluTable & {
+#if SIM_BATCH_AVX2
+  if (simd && host_has_avx2()) {
+    return AVX2_KERNELS;
+  }
+#elif SIM_BATCH_NEON
+  if (simd) {
+    return NEON_KERNELS;
+  }
+#endif
+  (void)simd;
+  return SCALAR_KERNELS;
+}
+
+auto is_alu(InstructionType type) -> bool {
+  return type == InstructionType::ADD_IMM ||
+         type == InstructionType::SUB_IMM ||
+         type == InstructionType::ADD_REG || type == InstructionType::SUB_REG;
+}
+} // namespace
+
+BatchState::BatchState(size_t lanes)
+    : laneCount(lanes),
+      laneStride((lanes + LANE_ALIGN - 1) / LANE_ALIGN * LANE_ALIGN) {
+  X.assign(REG_ROWS * laneStride, 0);
+  SP.assign(laneStride, 0);
+  PC.assign(laneStride, 0);
+  N.assign(laneStride, 0);
+  Z.assign(laneStride, 0);
+  C.assign(laneStride, 0);
+  V.assign(laneStride, 0);
+  running.assign(laneStride, 0);
+  std::fill(running.begin(), running.begin() + lanes, 1);
+  retired.assign(laneStride, 0);
+}
+
+auto BatchState::getReg(size_t lane, uint8_t reg) const -> uint64_t {
+  if (reg == arm64::REG_XZR) {
+    return 0;
+  }
+  return X[reg * laneStride + lane];
+}
+
+void BatchState::setReg(size_t lane, uint8_t reg, uint64_t value) {
+  if (reg != arm64::REG_XZR) {
+    X[reg * laneStride + lane] = value;
+  }
+}
+
+auto BatchState::lane(size_t index) const -> arm64::CPUState {
+  arm64::CPUState cpu{};
+  for (uint8_t r = 0; r < arm64::REG_XZR; r++) {
+    cpu.X[r] = getReg(index, r);
+  }
+  cpu.SP = SP[index];
+  cpu.PC = PC[index];
+  cpu.pstate.setNZCV(nzcv(index));
+  return cpu;
+}
+
+void BatchState::setLane(size_t index, const arm64::CPUState &cpu) {
+  for (uint8_t r = 0; r < arm64::REG_XZR; r++) {
+    setReg(index, r, cpu.X[r]);
+  }
+  SP[index] = cpu.SP;
+  PC[index] = cpu.PC;
+  setNZCV(index, cpu.pstate.nzcv());
+}
+
+auto BatchState::nzcv(size_t lane) const -> uint8_t {
+  return static_cast<uint8_t>(N[lane] << 3 | Z[lane] << 2 | C[lane] << 1 |
+                              V[lane]);
+}
+
+void BatchState::setNZCV(size_t lane, uint8_t value) {
+  N[lane] = (value & arm64::FLAG_N) != 0;
+  Z[lane] = (value & arm64::FLAG_Z) != 0;
+  C[lane] = (value & arm64::FLAG_C) != 0;
+  V[lane] = (value & arm64::FLAG_V) != 0;
+}
+
+auto BatchStats::mips() const -> double {
+  if (hostSeconds <= 0.0) {
+    return 0.0;
+  }
+  return static_cast<double>(laneInstructions) / hostSeconds /
+         INSTRUCTIONS_PER_MILLION;
+}
+
+auto BatchStats::utilisation(size_t lanes) const -> double {
+  if (issued == 0 || lanes == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(laneInstructions) /
+         static_cast<double>(issued * lanes);
+}
+
+BatchExecutor::BatchExecutor(BatchState &state, Memory &code,
+                             std::vector<Memory *> laneMemory, bool allowSimd)
+    : state(state), laneMemory(std::move(laneMemory)), blocks(code),
+      simd(allowSimd), mask(state.stride(), 0),
+      reasons(state.lanes(), StopReason::InstructionLimit) {}
+
+auto BatchExecutor::simdPath() const -> const char * {
+  if (&kernels(simd) == &SCALAR_KERNELS) {
+    return "scalar";
+  }
+  return SIM_BATCH_NEON ? "neon" : "avx2";
+}
+
+auto BatchExecutor::run(uint64_t max_instructions) -> void {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t lane = 0; lane < state.lanes(); lane++) {
+    if (state.running[lane] != 0 && state.retired[lane] >= max_instructions) {
+      state.running[lane] = 0;
+    }
+  }
+  while (std::any_of(state.running.begin(), state.running.end(),
+                     [](uint8_t r) { return r != 0; })) {
+    step(max_instructions);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  batchStats.hostSeconds += elapsed.count();
+}
+
+// Runs the block at the lowest running PC for every lane sitting on it
+auto BatchExecutor::step(uint64_t max_instructions) -> void {
+  uint64_t pc = UINT64_MAX;
+  for (size_t lane = 0; lane < state.lanes(); lane++) {
+    if (state.running[lane] != 0) {
+      pc = std::min(pc, state.PC[lane]);
+    }
+  }
+  uint64_t budget = max_instructions;
+  size_t active = 0;
+  for (size_t lane = 0; lane < state.lanes(); lane++) {
+    bool on = state.running[lane] != 0 && state.PC[lane] == pc;
+    mask[lane] = on ? ALL_LANES : 0;
+    if (on) {
+      budget = std::min(budget, max_instructions - state.retired[lane]);
+      active++;
+    }
+  }
+
+  const BasicBlock *block = blocks.lookup(pc);
+  const auto &instructions = block->instructions;
+  if (instructions.empty()) {
+    for (size_t lane = 0; lane < state.lanes(); lane++) {
+      if (mask[lane] != 0) {
+        state.running[lane] = 0;
+        reasons[lane] = StopReason::UndefinedInstruction;
+      }
+    }
+    return;
+  }
+
+  uint64_t count = std::min<uint64_t>(instructions.size(), budget);
+  uint64_t executed = 0;
+  bool branched = false;
+  while (executed < count) {
+    DecodedInstruction instr = instructions[executed++].unpack();
+    batchStats.issued++;
+    if (is_alu(instr.type)) {
+      executeAlu(instr);
+    } else if (instr.type == InstructionType::LDR ||
+               instr.type == InstructionType::STR) {
+      executeMemory(instr);
+      if (!block->valid) {
+        break; // A lane rewrote the block; re-fetch from the next PC
+      }
+    } else {
+      finishBranch(instr, pc + (executed - 1) * INSTRUCTION_BYTES);
+      branched = true;
+    }
+  }
+
+  for (size_t lane = 0; lane < state.lanes(); lane++) {
+    if (mask[lane] == 0) {
+      continue;
+    }
+    if (!branched) {
+      state.PC[lane] = pc + executed * INSTRUCTION_BYTES;
+    }
+    state.retired[lane] += executed;
+    if (state.retired[lane] >= max_instructions) {
+      state.running[lane] = 0;
+    }
+  }
+  batchStats.laneInstructions += executed * active;
+}
+
+auto BatchExecutor::executeAlu(const DecodedInstruction &instr) -> void {
+  if (!instr.is64Bit) {
+    executeAlu32(instr);
+    return;
+  }
+  bool sub = instr.type == InstructionType::SUB_IMM ||
+             instr.type == InstructionType::SUB_REG;
+  bool reg = instr.type == InstructionType::ADD_REG ||
+             instr.type == InstructionType::SUB_REG;
+  uint8_t rd = instr.rd == arm64::REG_XZR ? BatchState::DISCARD_ROW : instr.rd;
+  AluArgs args{};
+  args.rd = state.row(rd);
+  args.rn = state.row(instr.rn); // Row 31 reads as XZR
+  args.rm = reg ? state.row(instr.rm) : nullptr;
+  args.imm = static_cast<uint64_t>(static_cast<int64_t>(instr.imm));
+  args.mask = mask.data();
+  args.n = state.N.data();
+  args.z = state.Z.data();
+  args.c = state.C.data();
+  args.v = state.V.data();
+  args.count = state.stride();
+  kernels(simd)[sub][instr.setFlags][reg](args);
+}
+
+// W-register forms are rare in practice; they run lane by lane through
+// exec_ops::add_sub, which does the truncation and flag rules
+auto BatchExecutor::executeAlu32(const DecodedInstruction &instr) -> void {
+  bool sub = instr.type == InstructionType::SUB_IMM ||
+             instr.type == InstructionType::SUB_REG;
+  bool reg = instr.type == InstructionType::ADD_REG ||
+             instr.type == InstructionType::SUB_REG;
+  arm64::CPUState cpu{};
+  for (size_t lane = 0; lane < state.lanes(); lane++) {
+    if (mask[lane] == 0) {
+      continue;
+    }
+    cpu.setReg(instr.rn, state.getReg(lane, instr.rn));
+    uint64_t rhs = reg ? state.getReg(lane, instr.rm)
+                       : static_cast<uint64_t>(instr.imm);
+    exec_ops::add_sub(instr, cpu, rhs, sub);
+    state.setReg(lane, instr.rd, cpu.getReg(instr.rd));
+    if (instr.setFlags) {
+      state.setNZCV(lane, cpu.pstate.nzcv());
+    }
+  }
+}
+
+// Loads and stores go to each lane's own Memory, so they run lane by lane
+// with the same addressing rules as exec_ops::ldr/str
+auto BatchExecutor::executeMemory(const DecodedInstruction &instr) -> void {
+  bool load = instr.type == InstructionType::LDR;
+  auto offset = static_cast<uint64_t>(static_cast<int64_t>(instr.imm));
+  for (size_t lane = 0; lane < state.lanes(); lane++) {
+    if (mask[lane] == 0) {
+      continue;
+    }
+    uint64_t &baseReg = (instr.rn == arm64::REG_XZR)
+                            ? state.SP[lane]
+                            : state.X[instr.rn * state.stride() + lane];
+    uint64_t base = baseReg;
+    uint64_t address = base;
+    switch (instr.mode) {
+    case AddrMode::PreIndex:
+      address = base + offset;
+      baseReg = address;
+      break;
+    case AddrMode::PostIndex:
+      baseReg = base + offset;
+      break;
+    default:
+      address = base + offset;
+      break;
+    }
+    Memory &mem = *laneMemory[lane];
+    if (load) {
+      state.setReg(lane, instr.rd,
+                   exec_ops::load_sized(mem, address, instr.size));
+    } else {
+      uint64_t value = (instr.rd == arm64::REG_XZR)
+                           ? state.SP[lane]
+                           : state.getReg(lane, instr.rd);
+      exec_ops::store_sized(mem, address, instr.size, value);
+    }
+  }
+}
+
+auto BatchExecutor::finishBranch(const DecodedInstruction &instr, uint64_t pc)
+    -> void {
+  uint64_t target = pc + static_cast<uint64_t>(static_cast<int64_t>(instr.imm));
+  arm64::CPUState flags{};
+  for (size_t lane = 0; lane < state.lanes(); lane++) {
+    if (mask[lane] == 0) {
+      continue;
+    }
+    bool taken = true;
+    if (instr.type == InstructionType::BRANCH_COND) {
+      flags.pstate.setNZCV(state.nzcv(lane));
+      taken = exec_ops::check_condition(flags, instr.cond);
+    }
+    state.PC[lane] = taken ? target : pc + INSTRUCTION_BYTES;
+  }
+}
@@ -0,0 +1,176 @@
+#include "block_cache.h"
+#include "host_profiler.h"
+#include "registers.h"
+#include <algorithm>
+
+namespace {
+constexpr uint64_t INSTRUCTION_BYTES = 4;
+constexpr uint64_t INSTRUCTION_SHIFT = 2;
+
+auto ends_block(InstructionType type) -> bool {
+  return type == InstructionType::BRANCH ||
+         type == InstructionType::BRANCH_COND;
+}
+
+// Mark the block's pairs (when fuse) and count its dispatches
+void fuse_block(BasicBlock &block, bool fuse) {
+  const auto &instructions = block.instructions;
+  block.fusion.assign(instructions.size(), MacroOp::None);
+  block.dispatches.assign(instructions.size() + 1, 0);
+  size_t i = 0;
+  while (i < instructions.size()) {
+    MacroOp pair = fuse && i + 1 < instructions.size()
+                       ? BlockCache::macroOp(instructions[i].unpack(),
+                                             instructions[i + 1].unpack())
+                       : MacroOp::None;
+    block.fusion[i] = pair;
+    block.dispatches[i + 1] = static_cast<uint8_t>(block.dispatches[i] + 1);
+    if (pair != MacroOp::None) {
+      // Cut after the first half, the pair runs unfused: one dispatch each
+      block.dispatches[i + 2] = block.dispatches[i + 1];
+      i++;
+    }
+    i++;
+  }
+}
+} // namespace
+
+BlockCache::BlockCache(Memory &mem, bool fuse) : mem(mem), fuse(fuse) {
+  mem.setCodeWriteObserver(this);
+}
+
+BlockCache::~BlockCache() {
+  if (mem.codeWriteObserver() == this) {
+    mem.setCodeWriteObserver(nullptr);
+  }
+}
+
+auto BlockCache::lookup(uint64_t pc) -> const BasicBlock * {
+  SIM_PROFILE_PHASE(Fetch);
+  // Other cores' stores to our code land here, between blocks
+  mem.syncCodeWrites();
+  // Nobody can still be executing a retired block once they ask for the next
+  retired.clear();
+
+  BasicBlock *&slot = fast[(pc >> INSTRUCTION_SHIFT) % FAST_ENTRIES];
+  if (slot != nullptr && slot->startPC == pc) {
+    cacheStats.hits++;
+    return slot;
+  }
+  auto found = blocks.find(pc);
+  if (found != blocks.end()) {
+    cacheStats.hits++;
+    slot = found->second.get();
+    return slot;
+  }
+  cacheStats.misses++;
+  slot = build(pc);
+  return slot;
+}
+
+auto BlockCache::build(uint64_t pc) -> BasicBlock * {
+  auto block = std::make_unique<BasicBlock>();
+  block->startPC = pc;
+  uint64_t addr = pc;
+  while (block->instructions.size() < MAX_BLOCK_INSTRUCTIONS) {
+    DecodedInstruction instr = Decoder::decode(mem.read32(addr));
+    if (instr.type == InstructionType::UNKNOWN) {
+      break;
+    }
+    block->instructions.emplace_back(instr);
+    addr += INSTRUCTION_BYTES;
+    if (ends_block(instr.type)) {
+      break;
+    }
+  }
+  block->endPC = addr;
+  fuse_block(*block, fuse);
+
+  // Watch every page the block was decoded from (at least the page of pc, so
+  // an empty block is re-decoded once code is written there)
+  uint64_t lastByte = (addr > pc) ? addr - 1 : pc;
+  for (uint64_t page = pc >> Memory::PAGE_SHIFT;
+       page <= (lastByte >> Memory::PAGE_SHIFT); page++) {
+    mem.watchCode(page << Memory::PAGE_SHIFT);
+    pageBlocks[page].push_back(pc);
+  }
+
+  BasicBlock *raw = block.get();
+  blocks[pc] = std::move(block);
+  return raw;
+}
+
+void BlockCache::drop(std::unique_ptr<BasicBlock> block) {
+  block->valid = false;
+  BasicBlock *&slot =
+      fast[(block->startPC >> INSTRUCTION_SHIFT) % FAST_ENTRIES];
+  if (slot == block.get()) {
+    slot = nullptr;
+  }
+  cacheStats.invalidations++;
+  retired.push_back(std::move(block));
+}
+
+void BlockCache::invalidate(uint64_t address, uint64_t length) {
+  if (length == 0) {
+    return;
+  }
+  uint64_t end = address + length;
+  for (uint64_t page = address >> Memory::PAGE_SHIFT;
+       page <= ((end - 1) >> Memory::PAGE_SHIFT); page++) {
+    auto entry = pageBlocks.find(page);
+    if (entry == pageBlocks.end()) {
+      continue;
+    }
+    std::vector<uint64_t> kept;
+    for (uint64_t start : entry->second) {
+      auto found = blocks.find(start);
+      if (found == blocks.end()) {
+        continue; // Stale: already dropped through another page
+      }
+      const BasicBlock &block = *found->second;
+      // An empty block still covers the word it failed to decode
+      uint64_t blockEnd = std::max(block.endPC, start + INSTRUCTION_BYTES);
+      if (start < end && address < blockEnd) {
+        drop(std::move(found->second));
+        blocks.erase(found);
+      } else {
+        kept.push_back(start);
+      }
+    }
+    if (kept.empty()) {
+      pageBlocks.erase(entry);
+    } else {
+      entry->second = std::move(kept);
+    }
+  }
+}
+
+void BlockCache::flush() {
+  for (auto &entry : blocks) {
+    drop(std::move(entry.second));
+  }
+  blocks.clear();
+  pageBlocks.clear();
+  fast.fill(nullptr);
+}
+
+void BlockCache::onCodeWrite(uint64_t address, uint64_t length) {
+  invalidate(address, length);
+}
+
+auto BlockCache::macroOp(const DecodedInstruction &first,
+                         const DecodedInstruction &second) -> MacroOp {
+  bool compare = (first.type == InstructionType::SUB_IMM ||
+                  first.type == InstructionType::SUB_REG) &&
+                 first.setFlags;
+  if (compare && second.type == InstructionType::BRANCH_COND) {
+    return MacroOp::CompareBranch;
+  }
+  if (first.type == InstructionType::ADD_IMM && !first.setFlags &&
+      first.rd != arm64::REG_XZR && second.type == InstructionType::LDR &&
+      second.rn == first.rd) {
+    return MacroOp::AddLoad;
+  }
+  return MacroOp::None;
+}
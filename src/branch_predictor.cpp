@@ -0,0 +1,383 @@
+#include "branch_predictor.h"
+#include <algorithm>
+#include <ostream>
+
+namespace {
+constexpr uint8_t COUNTER_MAX = 3;  // Two-bit counters
+constexpr uint8_t COUNTER_INIT = 1; // Weakly not taken
+constexpr int8_t TAGE_COUNTER_MIN = -4;
+constexpr int8_t TAGE_COUNTER_MAX = 3;
+constexpr uint8_t USEFUL_MAX = 3;
+constexpr uint32_t MAX_TABLE_BITS = 24;
+constexpr size_t REPORTED_BRANCHES = 5;
+
+auto mask(uint32_t bits) -> uint64_t {
+  return bits >= 64 ? ~uint64_t{0} : (uint64_t{1} << bits) - 1;
+}
+
+void train(uint8_t &counter, bool taken) {
+  if (taken && counter < COUNTER_MAX) {
+    counter++;
+  } else if (!taken && counter > 0) {
+    counter--;
+  }
+}
+
+auto ratio(uint64_t part, uint64_t whole) -> double {
+  if (whole == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(part) / static_cast<double>(whole);
+}
+
+auto branch_setter(BranchConfig &config) -> config_file::Setter {
+  return [&config](const std::string &key,
+                   const std::string &value) -> std::string {
+    if (key == "predictor") {
+      if (value == "bimodal") {
+        config.kind = PredictorKind::Bimodal;
+      } else if (value == "gshare") {
+        config.kind = PredictorKind::Gshare;
+      } else if (value == "tage") {
+        config.kind = PredictorKind::Tage;
+      } else {
+        return "value of predictor must be bimodal, gshare or tage";
+      }
+      return "";
+    }
+    if (key == "table_bits") {
+      std::string why = config_file::set_count(key, value, config.tableBits, 4);
+      if (why.empty() && config.tableBits > MAX_TABLE_BITS) {
+        why = "table_bits must be at most " + std::to_string(MAX_TABLE_BITS);
+      }
+      return why;
+    }
+    if (key == "history_bits") {
+      std::string why =
+          config_file::set_count(key, value, config.historyBits, 1);
+      if (why.empty() && config.historyBits > 64) {
+        why = "history_bits must be at most 64";
+      }
+      return why;
+    }
+    if (key == "btb_entries") {
+      return config_file::set_count(key, value, config.btbEntries, 1);
+    }
+    if (key == "btb_ways") {
+      return config_file::set_count(key, value, config.btbWays, 1);
+    }
+    return "unknown key " + key;
+  };
+}
+
+auto validate_btb(const BranchConfig &config, std::string &error) -> bool {
+  uint32_t sets = config.btbEntries / config.btbWays;
+  if (config.btbEntries % config.btbWays != 0 || (sets & (sets - 1)) != 0) {
+    error = "btb_entries / btb_ways must be a power of two";
+    return false;
+  }
+  return true;
+}
+} // namespace
+
+BimodalPredictor::BimodalPredictor(uint32_t tableBits)
+    : counters(size_t{1} << tableBits, COUNTER_INIT) {}
+
+auto BimodalPredictor::predict(uint64_t pc) -> bool {
+  return counters[(pc >> 2) & (counters.size() - 1)] >= 2;
+}
+
+void BimodalPredictor::update(uint64_t pc, bool taken) {
+  train(counters[(pc >> 2) & (counters.size() - 1)], taken);
+}
+
+void BimodalPredictor::reset() {
+  std::fill(counters.begin(), counters.end(), COUNTER_INIT);
+}
+
+GsharePredictor::GsharePredictor(uint32_t tableBits, uint32_t historyBits)
+    : counters(size_t{1} << tableBits, COUNTER_INIT),
+      historyMask(mask(historyBits)) {}
+
+auto GsharePredictor::index(uint64_t pc) const -> size_t {
+  return ((pc >> 2) ^ history) & (counters.size() - 1);
+}
+
+auto GsharePredictor::predict(uint64_t pc) -> bool {
+  return counters[index(pc)] >= 2;
+}
+
+void GsharePredictor::update(uint64_t pc, bool taken) {
+  train(counters[index(pc)], taken);
+  history = ((history << 1) | (taken ? 1 : 0)) & historyMask;
+}
+
+void GsharePredictor::reset() {
+  std::fill(counters.begin(), counters.end(), COUNTER_INIT);
+  history = 0;
+}
+
+TagePredictor::TagePredictor(uint32_t tableBits)
+    : base(size_t{1} << tableBits, COUNTER_INIT),
+      taggedBits(std::max<uint32_t>(tableBits, 4) - 2) {
+  for (auto &table : tables) {
+    table.assign(size_t{1} << taggedBits, {});
+  }
+}
+
+void TagePredictor::reset() {
+  std::fill(base.begin(), base.end(), COUNTER_INIT);
+  for (auto &table : tables) {
+    std::fill(table.begin(), table.end(), Entry{});
+  }
+  history = 0;
+  branches = 0;
+}
+
+auto TagePredictor::fold(uint32_t length, uint32_t bits) const -> uint64_t {
+  uint64_t recent = history & mask(length);
+  uint64_t folded = 0;
+  while (recent != 0) {
+    folded ^= recent & mask(bits);
+    recent >>= bits;
+  }
+  return folded;
+}
+
+auto TagePredictor::lookup(uint64_t pc) const -> Lookup {
+  Lookup result;
+  uint64_t word = pc >> 2;
+  for (size_t t = 0; t < TAGGED_TABLES; t++) {
+    uint32_t length = HISTORY_LENGTHS[t];
+    result.index[t] = (word ^ (word >> taggedBits) ^ fold(length, taggedBits)) &
+                      mask(taggedBits);
+    result.tag[t] = static_cast<uint16_t>(
+        (word ^ fold(length, TAG_BITS) ^ (fold(length, TAG_BITS - 1) << 1)) &
+        mask(TAG_BITS));
+    const Entry &entry = tables[t][result.index[t]];
+    if (entry.valid && entry.tag == result.tag[t]) {
+      result.alternate = result.provider;
+      result.provider = static_cast<int>(t);
+    }
+  }
+  bool basePrediction = base[word & (base.size() - 1)] >= 2;
+  auto predictionOf = [&](int table) {
+    if (table < 0) {
+      return basePrediction;
+    }
+    return tables[table][result.index[table]].counter >= 0;
+  };
+  result.prediction = predictionOf(result.provider);
+  result.alternatePrediction = predictionOf(result.alternate);
+  return result;
+}
+
+auto TagePredictor::predict(uint64_t pc) -> bool {
+  return lookup(pc).prediction;
+}
+
+void TagePredictor::update(uint64_t pc, bool taken) {
+  Lookup found = lookup(pc);
+  if (found.provider >= 0) {
+    Entry &entry = tables[found.provider][found.index[found.provider]];
+    if (found.prediction != found.alternatePrediction) {
+      if (found.prediction == taken) {
+        entry.useful = std::min<uint8_t>(entry.useful + 1, USEFUL_MAX);
+      } else if (entry.useful > 0) {
+        entry.useful--;
+      }
+    }
+    entry.counter = taken ? std::min<int8_t>(entry.counter + 1,
+                                             TAGE_COUNTER_MAX)
+                          : std::max<int8_t>(entry.counter - 1,
+                                             TAGE_COUNTER_MIN);
+  } else {
+    train(base[(pc >> 2) & (base.size() - 1)], taken);
+  }
+
+  // On a mispredict, claim an entry in a longer-history table
+  if (found.prediction != taken) {
+    bool allocated = false;
+    for (auto t = static_cast<size_t>(found.provider + 1);
+         t < TAGGED_TABLES && !allocated; t++) {
+      Entry &entry = tables[t][found.index[t]];
+      if (entry.useful == 0) {
+        entry = {found.tag[t], static_cast<int8_t>(taken ? 0 : -1), 0, true};
+        allocated = true;
+      }
+    }
+    for (auto t = static_cast<size_t>(found.provider + 1);
+         t < TAGGED_TABLES && !allocated; t++) {
+      tables[t][found.index[t]].useful--;
+    }
+  }
+
+  if (++branches % USEFUL_RESET_PERIOD == 0) {
+    for (auto &table : tables) {
+      for (Entry &entry : table) {
+        entry.useful >>= 1;
+      }
+    }
+  }
+  history = (history << 1) | (taken ? 1 : 0);
+}
+
+BranchTargetBuffer::BranchTargetBuffer(uint32_t entries, uint32_t ways)
+    : entries(entries), ways(ways), sets(entries / ways) {}
+
+void BranchTargetBuffer::reset() {
+  std::fill(entries.begin(), entries.end(), Entry{});
+  clock = 0;
+}
+
+auto BranchTargetBuffer::set(uint64_t pc) -> Entry * {
+  return &entries[((pc >> 2) & (sets - 1)) * ways];
+}
+
+auto BranchTargetBuffer::lookup(uint64_t pc, uint64_t &target) -> bool {
+  Entry *candidates = set(pc);
+  for (uint32_t way = 0; way < ways; way++) {
+    if (candidates[way].valid && candidates[way].pc == pc) {
+      candidates[way].stamp = ++clock;
+      target = candidates[way].target;
+      return true;
+    }
+  }
+  return false;
+}
+
+void BranchTargetBuffer::update(uint64_t pc, uint64_t target) {
+  Entry *candidates = set(pc);
+  Entry *victim = candidates;
+  for (uint32_t way = 0; way < ways; way++) {
+    Entry &entry = candidates[way];
+    if (entry.valid && entry.pc == pc) {
+      victim = &entry;
+      break;
+    }
+    if (!entry.valid || (victim->valid && entry.stamp < victim->stamp)) {
+      victim = &entry;
+    }
+  }
+  *victim = {pc, target, ++clock, true};
+}
+
+auto BranchConfig::load(const std::string &path, std::string &error)
+    -> bool {
+  return config_file::load(path, error, branch_setter(*this)) &&
+         validate_btb(*this, error);
+}
+
+auto BranchConfig::parse(std::istream &in, std::string &error) -> bool {
+  return config_file::parse(in, error, branch_setter(*this)) &&
+         validate_btb(*this, error);
+}
+
+auto make_predictor(const BranchConfig &config)
+    -> std::unique_ptr<DirectionPredictor> {
+  switch (config.kind) {
+  case PredictorKind::Bimodal:
+    return std::make_unique<BimodalPredictor>(config.tableBits);
+  case PredictorKind::Gshare:
+    return std::make_unique<GsharePredictor>(config.tableBits,
+                                             config.historyBits);
+  case PredictorKind::Tage:
+    return std::make_unique<TagePredictor>(config.tableBits);
+  }
+  return nullptr;
+}
+
+auto PcBranchStats::rate() const -> double {
+  return ratio(mispredicts, executed);
+}
+
+auto BranchStats::mpki() const -> double {
+  return 1000.0 * ratio(mispredicts(), instructions);
+}
+
+BranchModel::BranchModel(const BranchConfig &config)
+    : BranchModel(make_predictor(config), config) {}
+
+BranchModel::BranchModel(std::unique_ptr<DirectionPredictor> predictor,
+                         const BranchConfig &config)
+    : direction(std::move(predictor)),
+      btb(config.btbEntries, config.btbWays) {}
+
+void BranchModel::reset() {
+  direction->reset();
+  btb.reset();
+  perPc.clear();
+  branchStats = {};
+}
+
+void BranchModel::onRetire(const RetiredInstruction &retired) {
+  branchStats.instructions++;
+  InstructionType type = retired.instr->type;
+  if (type != InstructionType::BRANCH &&
+      type != InstructionType::BRANCH_COND) {
+    return;
+  }
+  PcBranchStats &stats = perPc[retired.pc];
+  stats.executed++;
+  stats.taken += retired.taken ? 1 : 0;
+
+  bool predictTaken = true;
+  if (type == InstructionType::BRANCH_COND) {
+    branchStats.conditional++;
+    predictTaken = direction->predict(retired.pc);
+    direction->update(retired.pc, retired.taken);
+  } else {
+    branchStats.unconditional++;
+  }
+  bool mispredict = false;
+  if (predictTaken != retired.taken) {
+    branchStats.directionMispredicts++;
+    mispredict = true;
+  } else if (retired.taken) {
+    uint64_t target = 0;
+    if (!btb.lookup(retired.pc, target) || target != retired.address) {
+      branchStats.targetMisses++;
+      mispredict = true;
+    }
+  }
+  if (retired.taken) {
+    btb.update(retired.pc, retired.address);
+  }
+  stats.mispredicts += mispredict ? 1 : 0;
+}
+
+auto BranchModel::hottest(size_t count) const
+    -> std::vector<std::pair<uint64_t, PcBranchStats>> {
+  std::vector<std::pair<uint64_t, PcBranchStats>> all;
+  for (const auto &entry : perPc) {
+    if (entry.second.mispredicts != 0) {
+      all.emplace_back(entry);
+    }
+  }
+  count = std::min(count, all.size());
+  std::partial_sort(all.begin(), all.begin() + count, all.end(),
+                    [](const auto &a, const auto &b) {
+                      return a.second.mispredicts != b.second.mispredicts
+                                 ? a.second.mispredicts > b.second.mispredicts
+                                 : a.first < b.first;
+                    });
+  all.resize(count);
+  return all;
+}
+
+auto BranchModel::report(std::ostream &out) const -> void {
+  out << "predictor:            " << direction->name() << "\n"
+      << "conditional:          " << branchStats.conditional << " ("
+      << branchStats.directionMispredicts << " mispredicted, "
+      << ratio(branchStats.directionMispredicts, branchStats.conditional) *
+             100
+      << "%)\n"
+      << "unconditional:        " << branchStats.unconditional << "\n"
+      << "BTB misses:           " << branchStats.targetMisses << "\n"
+      << "MPKI:                 " << branchStats.mpki() << "\n";
+  for (const auto &entry : hottest(REPORTED_BRANCHES)) {
+    out << "mispredicting pc:     0x" << std::hex << entry.first << std::dec
+        << " " << entry.second.mispredicts << " of " << entry.second.executed
+        << " (" << entry.second.rate() * 100 << "%)\n";
+  }
+}
@@ -0,0 +1,435 @@
+#include "cache_model.h"
+#include <algorithm>
+#include <ostream>
+
+namespace {
+constexpr const char *LEVEL_KEYS[CACHE_LEVEL_COUNT] = {"l1i", "l1d", "l2",
+                                                       "llc"};
+constexpr const char *LEVEL_NAMES[CACHE_LEVEL_COUNT] = {"L1I", "L1D", "L2",
+                                                        "LLC"};
+constexpr size_t REPORTED_PCS = 5;
+constexpr uint8_t RRPV_LONG = 2;    // Insertion prediction
+constexpr uint8_t RRPV_DISTANT = 3; // Eviction candidate
+
+auto is_power_of_two(uint64_t value) -> bool {
+  return value != 0 && (value & (value - 1)) == 0;
+}
+
+auto log2(uint64_t value) -> uint32_t {
+  uint32_t bits = 0;
+  while (value > 1) {
+    value >>= 1;
+    bits++;
+  }
+  return bits;
+}
+
+auto set_flag(const std::string &key, const std::string &value, bool &out)
+    -> std::string {
+  if (value != "0" && value != "1") {
+    return "value of " + key + " must be 0 or 1";
+  }
+  out = value == "1";
+  return "";
+}
+
+auto set_policy(const std::string &key, const std::string &value,
+                ReplacementPolicy &out) -> std::string {
+  if (value == "LRU") {
+    out = ReplacementPolicy::LRU;
+  } else if (value == "PLRU") {
+    out = ReplacementPolicy::PLRU;
+  } else if (value == "RRIP") {
+    out = ReplacementPolicy::RRIP;
+  } else {
+    return "value of " + key + " must be LRU, PLRU or RRIP";
+  }
+  return "";
+}
+
+auto hierarchy_setter(CacheHierarchyConfig &config) -> config_file::Setter {
+  return [&config](const std::string &key,
+                   const std::string &value) -> std::string {
+    size_t dot = key.find('.');
+    size_t level = 0;
+    while (level < CACHE_LEVEL_COUNT &&
+           key.compare(0, dot, LEVEL_KEYS[level]) != 0) {
+      level++;
+    }
+    if (dot == std::string::npos || level == CACHE_LEVEL_COUNT) {
+      return "unknown key " + key;
+    }
+    CacheConfig &cache = config.levels[level];
+    std::string field = key.substr(dot + 1);
+    if (field == "size") {
+      return config_file::set_count(key, value, cache.sizeBytes);
+    }
+    if (field == "ways") {
+      return config_file::set_count(key, value, cache.ways, 1);
+    }
+    if (field == "line") {
+      return config_file::set_count(key, value, cache.lineBytes, 1);
+    }
+    if (field == "policy") {
+      return set_policy(key, value, cache.policy);
+    }
+    if (field == "write_back") {
+      return set_flag(key, value, cache.writeBack);
+    }
+    if (field == "write_allocate") {
+      return set_flag(key, value, cache.writeAllocate);
+    }
+    return "unknown key " + key;
+  };
+}
+
+// Check every configured level once the whole file has been applied
+auto validate_levels(const CacheHierarchyConfig &config, std::string &error)
+    -> bool {
+  for (size_t level = 0; level < CACHE_LEVEL_COUNT; level++) {
+    if (config.levels[level].sizeBytes == 0) {
+      continue;
+    }
+    std::string why = config.levels[level].validate();
+    if (!why.empty()) {
+      error = std::string(LEVEL_KEYS[level]) + ": " + why;
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+auto CacheConfig::validate() const -> std::string {
+  if (!is_power_of_two(lineBytes) || lineBytes < 8) {
+    return "line must be a power of two of at least 8 bytes";
+  }
+  if (ways < 1 || ways > 64) {
+    return "ways must be between 1 and 64";
+  }
+  if (policy == ReplacementPolicy::PLRU && !is_power_of_two(ways)) {
+    return "PLRU needs a power-of-two number of ways";
+  }
+  uint64_t setBytes = uint64_t{ways} * lineBytes;
+  if (sizeBytes % setBytes != 0 || !is_power_of_two(sizeBytes / setBytes)) {
+    return "size must be ways * line * a power of two";
+  }
+  return "";
+}
+
+auto CacheStats::missRate() const -> double {
+  if (accesses() == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(misses()) / static_cast<double>(accesses());
+}
+
+Cache::Cache(const CacheConfig &config)
+    : cacheConfig(config),
+      sets(config.sizeBytes / (uint64_t{config.ways} * config.lineBytes)),
+      lineShift(log2(config.lineBytes)), treeDepth(log2(config.ways)) {
+  reset();
+}
+
+void Cache::reset() {
+  lines.assign(sets * cacheConfig.ways, {});
+  plru.assign(cacheConfig.policy == ReplacementPolicy::PLRU ? sets : 0, 0);
+  clock = 0;
+  cacheStats = {};
+}
+
+auto Cache::find(uint64_t tag) const -> const Line * {
+  const Line *set = &lines[(tag & (sets - 1)) * cacheConfig.ways];
+  for (uint32_t way = 0; way < cacheConfig.ways; way++) {
+    if (set[way].valid && set[way].tag == tag) {
+      return &set[way];
+    }
+  }
+  return nullptr;
+}
+
+auto Cache::contains(uint64_t address) const -> bool {
+  return find(address >> lineShift) != nullptr;
+}
+
+auto Cache::victim(size_t set) -> size_t {
+  Line *ways = &lines[set * cacheConfig.ways];
+  for (uint32_t way = 0; way < cacheConfig.ways; way++) {
+    if (!ways[way].valid) {
+      return way;
+    }
+  }
+  switch (cacheConfig.policy) {
+  case ReplacementPolicy::LRU: {
+    size_t oldest = 0;
+    for (uint32_t way = 1; way < cacheConfig.ways; way++) {
+      if (ways[way].stamp < ways[oldest].stamp) {
+        oldest = way;
+      }
+    }
+    return oldest;
+  }
+  case ReplacementPolicy::PLRU: {
+    // Follow the tree bits, which point away from recent uses
+    size_t node = 1;
+    size_t way = 0;
+    for (uint32_t level = 0; level < treeDepth; level++) {
+      size_t right = (plru[set] >> node) & 1;
+      way = way << 1 | right;
+      node = node * 2 + right;
+    }
+    return way;
+  }
+  case ReplacementPolicy::RRIP:
+    for (;;) {
+      for (uint32_t way = 0; way < cacheConfig.ways; way++) {
+        if (ways[way].rrpv >= RRPV_DISTANT) {
+          return way;
+        }
+      }
+      for (uint32_t way = 0; way < cacheConfig.ways; way++) {
+        ways[way].rrpv++;
+      }
+    }
+  }
+  return 0;
+}
+
+void Cache::touch(size_t set, size_t way, bool fill) {
+  Line &line = lines[set * cacheConfig.ways + way];
+  switch (cacheConfig.policy) {
+  case ReplacementPolicy::LRU:
+    line.stamp = ++clock;
+    break;
+  case ReplacementPolicy::PLRU: {
+    size_t node = 1;
+    for (uint32_t level = treeDepth; level-- > 0;) {
+      size_t right = (way >> level) & 1;
+      if (right) {
+        plru[set] &= ~(uint64_t{1} << node);
+      } else {
+        plru[set] |= uint64_t{1} << node;
+      }
+      node = node * 2 + right;
+    }
+    break;
+  }
+  case ReplacementPolicy::RRIP:
+    line.rrpv = fill ? RRPV_LONG : 0;
+    break;
+  }
+}
+
+auto Cache::access(uint64_t address, bool write) -> Outcome {
+  uint64_t tag = address >> lineShift;
+  size_t set = tag & (sets - 1);
+  (write ? cacheStats.writes : cacheStats.reads)++;
+  Outcome outcome;
+  if (const Line *hit = find(tag)) {
+    auto way = static_cast<size_t>(hit - &lines[set * cacheConfig.ways]);
+    lines[set * cacheConfig.ways + way].dirty |= write && cacheConfig.writeBack;
+    touch(set, way, false);
+    outcome.hit = true;
+    return outcome;
+  }
+  (write ? cacheStats.writeMisses : cacheStats.readMisses)++;
+  if (write && !cacheConfig.writeAllocate) {
+    return outcome;
+  }
+  insert(set, tag, write && cacheConfig.writeBack, outcome);
+  return outcome;
+}
+
+auto Cache::fill(uint64_t address) -> Outcome {
+  uint64_t tag = address >> lineShift;
+  Outcome outcome;
+  if (find(tag) != nullptr) {
+    outcome.hit = true;
+    return outcome;
+  }
+  cacheStats.prefetches++;
+  insert(tag & (sets - 1), tag, false, outcome);
+  return outcome;
+}
+
+void Cache::insert(size_t set, uint64_t tag, bool dirty, Outcome &outcome) {
+  size_t way = victim(set);
+  Line &line = lines[set * cacheConfig.ways + way];
+  if (line.valid) {
+    cacheStats.evictions++;
+    if (line.dirty) {
+      cacheStats.writebacks++;
+      outcome.writeback = true;
+      outcome.victim = line.tag << lineShift;
+    }
+  }
+  line.tag = tag;
+  line.valid = true;
+  line.dirty = dirty;
+  touch(set, way, true);
+}
+
+auto CacheHierarchyConfig::load(const std::string &path, std::string &error)
+    -> bool {
+  return config_file::load(path, error, hierarchy_setter(*this)) &&
+         validate_levels(*this, error);
+}
+
+auto CacheHierarchyConfig::parse(std::istream &in, std::string &error)
+    -> bool {
+  return config_file::parse(in, error, hierarchy_setter(*this)) &&
+         validate_levels(*this, error);
+}
+
+auto PcCacheStats::totalMisses() const -> uint64_t {
+  uint64_t total = 0;
+  for (uint64_t count : misses) {
+    total += count;
+  }
+  return total;
+}
+
+CacheHierarchy::CacheHierarchy(const CacheHierarchyConfig &config) {
+  for (size_t level = 0; level < CACHE_LEVEL_COUNT; level++) {
+    if (config.levels[level].sizeBytes != 0) {
+      caches[level] = std::make_unique<Cache>(config.levels[level]);
+    }
+  }
+  for (CacheLevel level : {CacheLevel::L1I, CacheLevel::L2, CacheLevel::LLC}) {
+    if (caches[static_cast<size_t>(level)]) {
+      fetchPath.push_back(level);
+    }
+  }
+  for (CacheLevel level : {CacheLevel::L1D, CacheLevel::L2, CacheLevel::LLC}) {
+    if (caches[static_cast<size_t>(level)]) {
+      dataPath.push_back(level);
+    }
+  }
+}
+
+auto CacheHierarchy::level(CacheLevel level) const -> const Cache * {
+  return caches[static_cast<size_t>(level)].get();
+}
+
+void CacheHierarchy::reset() {
+  for (auto &cache : caches) {
+    if (cache) {
+      cache->reset();
+    }
+  }
+  perPc.clear();
+}
+
+auto CacheHierarchy::access(const std::vector<CacheLevel> &path, size_t index,
+                            uint64_t address, bool write) -> size_t {
+  if (index == path.size()) {
+    return 0; // Memory
+  }
+  Cache &cache = *caches[static_cast<size_t>(path[index])];
+  Cache::Outcome outcome = cache.access(address, write);
+  if (outcome.writeback) {
+    access(path, index + 1, outcome.victim, true);
+  }
+  bool writeThrough = write && !cache.config().writeBack;
+  if (outcome.hit) {
+    if (writeThrough) {
+      access(path, index + 1, address, true);
+    }
+    return 0;
+  }
+  if (write && !cache.config().writeAllocate) {
+    return 1 + access(path, index + 1, address, true);
+  }
+  // Fill from below, then pass a write-through store on as well
+  size_t missed = 1 + access(path, index + 1, address, false);
+  if (writeThrough) {
+    access(path, index + 1, address, true);
+  }
+  return missed;
+}
+
+void CacheHierarchy::prefetch(uint64_t address) {
+  for (size_t index = 0; index < dataPath.size(); index++) {
+    Cache::Outcome outcome =
+        caches[static_cast<size_t>(dataPath[index])]->fill(address);
+    if (outcome.writeback) {
+      access(dataPath, index + 1, outcome.victim, true);
+    }
+  }
+}
+
+void CacheHierarchy::charge(const std::vector<CacheLevel> &path,
+                            size_t missed, PcCacheStats &stats) {
+  for (size_t index = 0; index < missed; index++) {
+    stats.misses[static_cast<size_t>(path[index])]++;
+  }
+}
+
+void CacheHierarchy::onRetire(const RetiredInstruction &retired) {
+  PcCacheStats &stats = perPc[retired.pc];
+  charge(fetchPath, access(fetchPath, 0, retired.pc, false), stats);
+
+  const DecodedInstruction &instr = *retired.instr;
+  bool write = instr.type == InstructionType::STR;
+  if ((instr.type != InstructionType::LDR && !write) || dataPath.empty()) {
+    return;
+  }
+  (write ? stats.stores : stats.loads)++;
+  // Line size of the first data level decides whether the access splits
+  uint64_t line = caches[static_cast<size_t>(dataPath[0])]->config().lineBytes;
+  uint64_t first = retired.address & ~(line - 1);
+  uint64_t last = (retired.address + (uint64_t{1} << instr.size) - 1) &
+                  ~(line - 1);
+  charge(dataPath, access(dataPath, 0, first, write), stats);
+  if (last != first) {
+    charge(dataPath, access(dataPath, 0, last, write), stats);
+  }
+}
+
+auto CacheHierarchy::hottest(size_t count) const
+    -> std::vector<std::pair<uint64_t, PcCacheStats>> {
+  std::vector<std::pair<uint64_t, PcCacheStats>> all;
+  for (const auto &entry : perPc) {
+    if (entry.second.totalMisses() != 0) {
+      all.emplace_back(entry);
+    }
+  }
+  count = std::min(count, all.size());
+  std::partial_sort(all.begin(), all.begin() + count, all.end(),
+                    [](const auto &a, const auto &b) {
+                      uint64_t missesA = a.second.totalMisses();
+                      uint64_t missesB = b.second.totalMisses();
+                      return missesA != missesB ? missesA > missesB
+                                                : a.first < b.first;
+                    });
+  all.resize(count);
+  return all;
+}
+
+auto CacheHierarchy::report(std::ostream &out) const -> void {
+  for (size_t level = 0; level < CACHE_LEVEL_COUNT; level++) {
+    if (!caches[level]) {
+      continue;
+    }
+    const CacheStats &stats = caches[level]->stats();
+    std::string label = std::string(LEVEL_NAMES[level]) + ":";
+    label.resize(22, ' ');
+    out << label << stats.accesses() << " accesses, "
+        << stats.accesses() - stats.misses() << " hits, " << stats.misses()
+        << " misses (" << stats.missRate() * 100 << "%), " << stats.evictions
+        << " evictions, " << stats.writebacks << " writebacks";
+    if (stats.prefetches != 0) {
+      out << ", " << stats.prefetches << " prefetched";
+    }
+    out << "\n";
+  }
+  for (const auto &entry : hottest(REPORTED_PCS)) {
+    out << "missing pc:           0x" << std::hex << entry.first << std::dec;
+    for (size_t level = 0; level < CACHE_LEVEL_COUNT; level++) {
+      if (entry.second.misses[level] != 0) {
+        out << " " << LEVEL_NAMES[level] << " " << entry.second.misses[level];
+      }
+    }
+    out << "\n";
+  }
+}
@@ -0,0 +1,93 @@
+#include "config_file.h"
+#include <fstream>
+#include <istream>
+
+namespace {
+constexpr char LATENCY_PREFIX[] = "latency.";
+
+// Trim spaces and tabs from both ends
+auto trim(const std::string &text) -> std::string {
+  size_t first = text.find_first_not_of(" \t\r");
+  if (first == std::string::npos) {
+    return "";
+  }
+  size_t last = text.find_last_not_of(" \t\r");
+  return text.substr(first, last - first + 1);
+}
+} // namespace
+
+namespace config_file {
+auto parse(std::istream &in, std::string &error, const Setter &set) -> bool {
+  std::string line;
+  for (int number = 1; std::getline(in, line); number++) {
+    line = trim(line.substr(0, line.find('#')));
+    if (line.empty()) {
+      continue;
+    }
+    size_t equals = line.find('=');
+    std::string why = equals == std::string::npos
+                          ? "expected key = value"
+                          : set(trim(line.substr(0, equals)),
+                                trim(line.substr(equals + 1)));
+    if (!why.empty()) {
+      error = std::to_string(number) + ": " + why;
+      return false;
+    }
+  }
+  return true;
+}
+
+auto load(const std::string &path, std::string &error, const Setter &set)
+    -> bool {
+  std::ifstream in(path);
+  if (!in) {
+    error = path + ": cannot open";
+    return false;
+  }
+  if (!parse(in, error, set)) {
+    error = path + ":" + error;
+    return false;
+  }
+  return true;
+}
+
+auto parse_count(const std::string &text, uint32_t &out) -> bool {
+  if (text.empty() || text.size() > 9 ||
+      text.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  out = static_cast<uint32_t>(std::stoul(text));
+  return true;
+}
+
+auto set_count(const std::string &key, const std::string &value,
+               uint32_t &out, uint32_t minimum) -> std::string {
+  uint32_t count = 0;
+  if (!parse_count(value, count)) {
+    return "value of " + key + " is not a count";
+  }
+  if (count < minimum) {
+    return key + " must be at least " + std::to_string(minimum);
+  }
+  out = count;
+  return "";
+}
+
+auto is_latency_key(const std::string &key) -> bool {
+  return key.rfind(LATENCY_PREFIX, 0) == 0;
+}
+
+auto set_latency(const std::string &key, const std::string &value,
+                 LatencyTable &latency) -> std::string {
+  std::string name = key.substr(sizeof(LATENCY_PREFIX) - 1);
+  size_t type = 1; // UNKNOWN never retires
+  while (type < INSTRUCTION_TYPE_COUNT &&
+         name != Decoder::typeName(static_cast<InstructionType>(type))) {
+    type++;
+  }
+  if (type == INSTRUCTION_TYPE_COUNT) {
+    return "unknown instruction type " + name;
+  }
+  return set_count(key, value, latency[type], 1);
+}
+} // namespace config_file
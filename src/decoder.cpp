@@ -1,122 +1,443 @@
 #include "decoder.h"
+#include "host_profiler.h"
+#include <algorithm>
+#include <array>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SIM_DECODE_AVX2 1
+#define SIM_DECODE_SSE2 1
+#include <immintrin.h>
+#else
+#define SIM_DECODE_AVX2 0
+#define SIM_DECODE_SSE2 0
+#endif
 
 namespace {
 // Naming constants makes the bit-masks readable
-constexpr uint32_t GROUP_DP_IMM = 0b1000;  // 0b1000
-constexpr uint32_t GROUP_DP_IMM2 = 0b1001; // 0b1000
-constexpr uint32_t GROUP_DP_REG = 0b0101;  // pattern : 0xx101 1101
-constexpr uint32_t GROUP_DP_REG_MASK = 0b0111;
-
-constexpr uint32_t GROUP_LS_IMM_MASK = 0b0101; // pattern: x1x0 0b11000
-
-constexpr uint32_t GROUP_BRANCH_IMM = 0b1010;   // pattern 0b101x
-constexpr uint32_t GROUP_BRANCH_IMM_2 = 0b1011; // pattern 0b101x
-
-constexpr uint32_t MASK_REG = 0xF; // 4 bits
+constexpr uint32_t MASK_GROUP = 0xF; // bits [28:25]
 constexpr uint32_t MASK_REGFILE = 0x1F;
-constexpr uint32_t MASK_IMM12 = 0xFFF;    // 12 bits
-constexpr uint32_t MASK_SINGLE_BIT = 0x1; // 1 bit
+constexpr uint32_t MASK_IMM12 = 0xFFF;
+constexpr uint32_t MASK_IMM9 = 0x1FF;
+constexpr uint32_t MASK_IMM19 = 0x7FFFF;
+constexpr uint32_t MASK_IMM26 = 0x3FFFFFF;
+constexpr uint32_t MASK_SINGLE_BIT = 0x1;
 constexpr uint32_t SHIFT_GROUP = 25;
 constexpr uint32_t SHIFT_RN = 5;
+constexpr uint32_t SHIFT_RM = 16;
 constexpr uint32_t SHIFT_IMM = 10;
+constexpr uint32_t SHIFT_IMM9 = 12;
+constexpr uint32_t SHIFT_IMM19 = 5;
+constexpr uint32_t SHIFT_SIZE = 30;
 constexpr uint32_t SHIFT_64BIT = 31;
-constexpr uint32_t SHIFT_OP = 30;
-} // namespace
+constexpr uint32_t SHIFT_OP = 30;  // ADD/SUB, B/B.cond
+constexpr uint32_t SHIFT_OPC = 22; // STR/LDR
+constexpr uint32_t SHIFT_UNSIGNED_OFFSET = 24;
+constexpr uint32_t SHIFT_SETFLAGS = 29;
 
-auto Decoder::decode(uint32_t instr) -> DecodedInstruction {
-  DecodedInstruction decoded;
-  // Data Processing (Immediate) Group: bits [28:25] == 1000
-  uint32_t group = (instr >> SHIFT_GROUP) & MASK_REG;
-
-  if ((group == GROUP_DP_IMM) || (group == GROUP_DP_IMM2)) { // 0b10001
-    // Extract op bit [30] to distinguish ADD (0) from SUB (1)
-    uint32_t operation = (instr >> SHIFT_OP) & MASK_SINGLE_BIT;
-    decoded.type =
-        (operation == 0) ? InstructionType::ADD_IMM : InstructionType::SUB_IMM;
-
-    decoded.rd = instr & MASK_REGFILE;                  // Bits [4:0]
-    decoded.rn = (instr >> SHIFT_RN) & MASK_REGFILE;    // Bits [9:5]
-    uint32_t imm12 = (instr >> SHIFT_IMM) & MASK_IMM12; // Bits [21:10]
-    decoded.imm = static_cast<int32_t>(imm12);
-    decoded.is64Bit =
-        ((instr >> SHIFT_64BIT) & MASK_SINGLE_BIT) != 0; // Bit [31]
-    decoded.setFlags = (decoded.rd == 31) ? 1 : 0; // If rd is XZR, set flags
-  } else if ((group & GROUP_LS_IMM_MASK) == 0x4) { // 0b11000 or 0b11001
-    // Extract op bit [22] to distinguish LDR (1) from STR (0)
-    uint32_t operation = (instr >> 22) & MASK_SINGLE_BIT;
-    decoded.type =
-        (operation == 1) ? InstructionType::LDR : InstructionType::STR;
-    decoded.rd = instr & MASK_REGFILE;               // Bits [4:0]
-    decoded.rn = (instr >> SHIFT_RN) & MASK_REGFILE; // Bits [9:5]
-    bool is_usigned_offset = ((instr >> 24) & MASK_SINGLE_BIT) != 0; // Bit [24]
-    if (is_usigned_offset) {
-      decoded.mode = AddrMode::Offset;
-      uint32_t imm12 = (instr >> SHIFT_IMM) & MASK_IMM12; // Bits [21:10]
-      uint8_t size = (instr >> 30) & 0x3;                 // Bits [31:30]
-      decoded.imm = static_cast<int32_t>(imm12 << size);
-    } else {
-      int32_t imm9 = (instr >> 12) & 0x1FF; // Bits [20:12]
-      // Sign-extend 9-bit immediate
-      if (imm9 & 0x100) {
-        imm9 |= ~0x1FF;
-      }
-      decoded.imm = imm9;
-      uint8_t mode_bits = (instr >> 10) & 0x3; // Bits [11:10]
-      switch (mode_bits) {
-      case 0b01:
-        decoded.mode = AddrMode::PostIndex;
-        break;
-      case 0b11:
-        decoded.mode = AddrMode::PreIndex;
-        break;
-      default:
-        decoded.mode = AddrMode::Offset;
-        break;
-      }
+// Table key: group bits [28:25], then bit 30, then bit 22
+constexpr uint32_t KEY_GROUP_SHIFT = 2;
+constexpr uint32_t KEY_OP_SHIFT = 1;
+constexpr uint32_t TABLE_SIZE = 64;
+
+using DecodeFn = void (*)(uint32_t, DecodedInstruction &);
+
+// --- Per-class field extraction ---
+
+void decode_unknown(uint32_t /*instr*/, DecodedInstruction & /*decoded*/) {}
+
+// Add/subtract (immediate): sf | op | S | 10001 | shift | imm12 | Rn | Rd
+template <InstructionType Type>
+void decode_dp_imm(uint32_t instr, DecodedInstruction &decoded) {
+  decoded.type = Type;
+  decoded.rd = instr & MASK_REGFILE;
+  decoded.rn = (instr >> SHIFT_RN) & MASK_REGFILE;
+  uint32_t imm12 = (instr >> SHIFT_IMM) & MASK_IMM12;
+  decoded.imm = static_cast<int32_t>(imm12);
+  decoded.is64Bit = ((instr >> SHIFT_64BIT) & MASK_SINGLE_BIT) != 0;
+  decoded.setFlags = ((instr >> SHIFT_SETFLAGS) & MASK_SINGLE_BIT) != 0;
+}
+
+// Load/store register (immediate): size | 111 | V | 0 | U | opc | ... | Rn | Rt
+template <InstructionType Type>
+void decode_ls_imm(uint32_t instr, DecodedInstruction &decoded) {
+  decoded.type = Type;
+  decoded.rd = instr & MASK_REGFILE;
+  decoded.rn = (instr >> SHIFT_RN) & MASK_REGFILE;
+  uint32_t size = (instr >> SHIFT_SIZE) & 0x3;
+  if (((instr >> SHIFT_UNSIGNED_OFFSET) & MASK_SINGLE_BIT) != 0) {
+    decoded.mode = AddrMode::Offset;
+    uint32_t imm12 = (instr >> SHIFT_IMM) & MASK_IMM12;
+    decoded.imm = static_cast<int32_t>(imm12 << size); // Scaled by size
+  } else {
+    int32_t imm9 = (instr >> SHIFT_IMM9) & MASK_IMM9;
+    if (imm9 & 0x100) {
+      imm9 |= ~0x1FF; // Sign-extend 9-bit immediate
     }
-    decoded.is64Bit =
-        ((instr >> 30) & 0x3) == 0x3; // Bit [31:30], 64-bit if not 0b11
-  } else if ((group >= GROUP_BRANCH_IMM) &&
-             (group <= GROUP_BRANCH_IMM_2)) { // 0b1011
-    if ((instr >> 30) & 0x1) {
-      decoded.type = InstructionType::BRANCH_COND;
-    } else {
-      decoded.type = InstructionType::BRANCH;
+    decoded.imm = imm9;
+    switch ((instr >> SHIFT_IMM) & 0x3) { // Bits [11:10]
+    case 0b01:
+      decoded.mode = AddrMode::PostIndex;
+      break;
+    case 0b11:
+      decoded.mode = AddrMode::PreIndex;
+      break;
+    default:
+      decoded.mode = AddrMode::Offset;
+      break;
     }
-    if (decoded.type == InstructionType::BRANCH) {
-      uint32_t imm26 = instr & 0x3FFFFFF; // Bits [25:0]
-      // Sign-extend 26-bit immediate
-      if (imm26 & 0x2000000) {
-        imm26 |= ~0x3FFFFFF;
-      }
-      decoded.imm = imm26 * 4; // Left shift by 2 (word-aligned)
-    } else {
-      // For conditional branches, imm19 is in bits [23:5]
-      uint32_t imm19 = (instr >> 5) & 0x7FFFF; // Bits [23:5]
-      // Sign-extend 19-bit immediate
-      if (imm19 & 0x40000) {
-        imm19 |= ~0x7FFFF;
-      }
-      decoded.imm = imm19 * 4;    // Left shift by 2 (word-aligned)
-      decoded.cond = instr & 0xF; // Bits [3:0]
+  }
+  decoded.is64Bit = (size == 0x3);
+  decoded.size = static_cast<uint8_t>(size);
+}
+
+// Unconditional branch (immediate): op | 00101 | imm26
+void decode_branch(uint32_t instr, DecodedInstruction &decoded) {
+  decoded.type = InstructionType::BRANCH;
+  uint32_t imm26 = instr & MASK_IMM26;
+  if (imm26 & 0x2000000) {
+    imm26 |= ~MASK_IMM26; // Sign-extend 26-bit immediate
+  }
+  decoded.imm = imm26 * 4; // Word offset to byte offset
+}
+
+// Conditional branch (immediate): 0101010 | o1 | imm19 | o0 | cond
+void decode_branch_cond(uint32_t instr, DecodedInstruction &decoded) {
+  decoded.type = InstructionType::BRANCH_COND;
+  uint32_t imm19 = (instr >> SHIFT_IMM19) & MASK_IMM19;
+  if (imm19 & 0x40000) {
+    imm19 |= ~MASK_IMM19; // Sign-extend 19-bit immediate
+  }
+  decoded.imm = imm19 * 4; // Word offset to byte offset
+  decoded.cond = instr & 0xF;
+}
+
+// Add/subtract (shifted register): sf | op | S | 01011 | shift | 0 | Rm | ...
+template <InstructionType Type>
+void decode_dp_reg(uint32_t instr, DecodedInstruction &decoded) {
+  decoded.type = Type;
+  decoded.rd = instr & MASK_REGFILE;
+  decoded.rn = (instr >> SHIFT_RN) & MASK_REGFILE;
+  decoded.rm = (instr >> SHIFT_RM) & MASK_REGFILE;
+  decoded.is64Bit = ((instr >> SHIFT_64BIT) & MASK_SINGLE_BIT) != 0;
+  decoded.setFlags = ((instr >> SHIFT_SETFLAGS) & MASK_SINGLE_BIT) != 0;
+}
+
+// --- Table construction (evaluated entirely at compile time) ---
+
+constexpr auto classify(uint32_t key) -> InstructionType {
+  uint32_t group = key >> KEY_GROUP_SHIFT;
+  bool op = ((key >> KEY_OP_SHIFT) & 1) != 0;  // bit 30
+  bool opc = (key & 1) != 0;                   // bit 22
+  if (group == 0b1000 || group == 0b1001) {    // 100x: DP immediate
+    return op ? InstructionType::SUB_IMM : InstructionType::ADD_IMM;
+  }
+  if ((group & 0b0101) == 0b0100) { // x1x0: loads and stores
+    return opc ? InstructionType::LDR : InstructionType::STR;
+  }
+  if (group == 0b1010 || group == 0b1011) { // 101x: branches
+    return op ? InstructionType::BRANCH_COND : InstructionType::BRANCH;
+  }
+  if ((group & 0b0111) == 0b0101) { // x101: DP register
+    return op ? InstructionType::SUB_REG : InstructionType::ADD_REG;
+  }
+  return InstructionType::UNKNOWN;
+}
+
+// Field-extraction routine of each class, by InstructionType
+constexpr std::array<DecodeFn, INSTRUCTION_TYPE_COUNT> CLASS_DECODERS = {
+    decode_unknown,
+    decode_dp_imm<InstructionType::ADD_IMM>,
+    decode_dp_imm<InstructionType::SUB_IMM>,
+    decode_dp_reg<InstructionType::ADD_REG>,
+    decode_dp_reg<InstructionType::SUB_REG>,
+    decode_ls_imm<InstructionType::LDR>,
+    decode_ls_imm<InstructionType::STR>,
+    decode_branch,
+    decode_branch_cond};
+
+constexpr auto make_class_table()
+    -> std::array<InstructionType, TABLE_SIZE> {
+  std::array<InstructionType, TABLE_SIZE> table{};
+  for (uint32_t key = 0; key < TABLE_SIZE; key++) {
+    table[key] = classify(key);
+  }
+  return table;
+}
+
+constexpr auto make_decode_table() -> std::array<DecodeFn, TABLE_SIZE> {
+  std::array<DecodeFn, TABLE_SIZE> table{};
+  for (uint32_t key = 0; key < TABLE_SIZE; key++) {
+    table[key] = CLASS_DECODERS[static_cast<size_t>(classify(key))];
+  }
+  return table;
+}
+
+constexpr std::array<InstructionType, TABLE_SIZE> CLASS_TABLE =
+    make_class_table();
+constexpr std::array<DecodeFn, TABLE_SIZE> DECODE_TABLE = make_decode_table();
+
+constexpr auto table_key(uint32_t instr) -> uint32_t {
+  return (((instr >> SHIFT_GROUP) & MASK_GROUP) << KEY_GROUP_SHIFT) |
+         (((instr >> SHIFT_OP) & MASK_SINGLE_BIT) << KEY_OP_SHIFT) |
+         ((instr >> SHIFT_OPC) & MASK_SINGLE_BIT);
+}
+
+// --- Block decoding ---
+
+// decodeBlock() works through the input in chunks of one word per bit of a
+// uint64_t class mask
+constexpr size_t BLOCK_CHUNK = 64;
+constexpr uint8_t NO_CLASS = 0xFF; // Padding past the end of a short chunk
+
+using ClassMasks = std::array<uint64_t, INSTRUCTION_TYPE_COUNT>;
+
+// The key bits in place after shifting the word right by SHIFT_GROUP -
+// KEY_GROUP_SHIFT, SHIFT_OP - KEY_OP_SHIFT and SHIFT_OPC
+constexpr uint32_t KEY_GROUP_BITS = MASK_GROUP << KEY_GROUP_SHIFT;
+constexpr uint32_t KEY_OP_BIT = MASK_SINGLE_BIT << KEY_OP_SHIFT;
+
+void table_keys_scalar(const uint32_t *words, size_t n, uint8_t *keys) {
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = static_cast<uint8_t>(table_key(words[i]));
+  }
+}
+
+#if !SIM_DECODE_SSE2
+void class_masks_scalar(const uint8_t *classes, ClassMasks &masks) {
+  masks = {};
+  for (size_t i = 0; i < BLOCK_CHUNK && classes[i] != NO_CLASS; i++) {
+    masks[classes[i]] |= uint64_t{1} << i;
+  }
+}
+#endif
+
+#if SIM_DECODE_AVX2
+#define SIM_AVX2 __attribute__((target("avx2")))
+
+// Eight keys per vector; four vectors are narrowed to 32 bytes per store
+SIM_AVX2 auto table_keys_avx2_8(const uint32_t *words) -> __m256i {
+  __m256i word =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words));
+  __m256i group = _mm256_and_si256(
+      _mm256_srli_epi32(word, SHIFT_GROUP - KEY_GROUP_SHIFT),
+      _mm256_set1_epi32(KEY_GROUP_BITS));
+  __m256i op =
+      _mm256_and_si256(_mm256_srli_epi32(word, SHIFT_OP - KEY_OP_SHIFT),
+                       _mm256_set1_epi32(KEY_OP_BIT));
+  __m256i opc = _mm256_and_si256(_mm256_srli_epi32(word, SHIFT_OPC),
+                                 _mm256_set1_epi32(MASK_SINGLE_BIT));
+  return _mm256_or_si256(_mm256_or_si256(group, op), opc);
+}
+
+SIM_AVX2 void table_keys_avx2(const uint32_t *words, size_t n,
+                              uint8_t *keys) {
+  constexpr size_t STEP = 32;
+  // packus works within 128-bit lanes; this puts the dwords back in order
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  size_t i = 0;
+  for (; i + STEP <= n; i += STEP) {
+    __m256i low = _mm256_packus_epi32(table_keys_avx2_8(words + i),
+                                      table_keys_avx2_8(words + i + 8));
+    __m256i high = _mm256_packus_epi32(table_keys_avx2_8(words + i + 16),
+                                       table_keys_avx2_8(words + i + 24));
+    __m256i bytes = _mm256_permutevar8x32_epi32(
+        _mm256_packus_epi16(low, high), order);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(keys + i), bytes);
+  }
+  table_keys_scalar(words + i, n - i, keys + i);
+}
+
+SIM_AVX2 void class_masks_avx2(const uint8_t *classes, ClassMasks &masks) {
+  __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(classes));
+  __m256i high =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(classes + 32));
+  for (size_t type = 0; type < INSTRUCTION_TYPE_COUNT; type++) {
+    __m256i match = _mm256_set1_epi8(static_cast<char>(type));
+    auto lowBits = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(low, match)));
+    auto highBits = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(high, match)));
+    masks[type] = (static_cast<uint64_t>(highBits) << 32) | lowBits;
+  }
+}
+#endif
+
+#if SIM_DECODE_SSE2
+// SSE2 is part of x86-64, so these need no runtime check
+auto table_keys_sse2_4(const uint32_t *words) -> __m128i {
+  __m128i word = _mm_loadu_si128(reinterpret_cast<const __m128i *>(words));
+  __m128i group =
+      _mm_and_si128(_mm_srli_epi32(word, SHIFT_GROUP - KEY_GROUP_SHIFT),
+                    _mm_set1_epi32(KEY_GROUP_BITS));
+  __m128i op = _mm_and_si128(_mm_srli_epi32(word, SHIFT_OP - KEY_OP_SHIFT),
+                             _mm_set1_epi32(KEY_OP_BIT));
+  __m128i opc = _mm_and_si128(_mm_srli_epi32(word, SHIFT_OPC),
+                              _mm_set1_epi32(MASK_SINGLE_BIT));
+  return _mm_or_si128(_mm_or_si128(group, op), opc);
+}
+
+void table_keys_sse2(const uint32_t *words, size_t n, uint8_t *keys) {
+  constexpr size_t STEP = 16;
+  size_t i = 0;
+  for (; i + STEP <= n; i += STEP) {
+    __m128i low = _mm_packs_epi32(table_keys_sse2_4(words + i),
+                                  table_keys_sse2_4(words + i + 4));
+    __m128i high = _mm_packs_epi32(table_keys_sse2_4(words + i + 8),
+                                   table_keys_sse2_4(words + i + 12));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(keys + i),
+                     _mm_packus_epi16(low, high));
+  }
+  table_keys_scalar(words + i, n - i, keys + i);
+}
+
+void class_masks_sse2(const uint8_t *classes, ClassMasks &masks) {
+  constexpr size_t STEP = 16;
+  constexpr size_t PARTS = BLOCK_CHUNK / STEP;
+  __m128i bytes[PARTS];
+  for (size_t part = 0; part < PARTS; part++) {
+    bytes[part] = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(classes + part * STEP));
+  }
+  for (size_t type = 0; type < INSTRUCTION_TYPE_COUNT; type++) {
+    __m128i match = _mm_set1_epi8(static_cast<char>(type));
+    uint64_t mask = 0;
+    for (size_t part = 0; part < PARTS; part++) {
+      auto bits = static_cast<uint32_t>(
+          _mm_movemask_epi8(_mm_cmpeq_epi8(bytes[part], match)));
+      mask |= static_cast<uint64_t>(bits) << (part * STEP);
     }
+    masks[type] = mask;
+  }
+}
+#endif
 
-  } else if ((group & GROUP_DP_REG_MASK) == GROUP_DP_REG) { // 0b0101
-    // Extract op bit [30] to distinguish SUB (1)
-    uint32_t operation = (instr >> SHIFT_OP) & MASK_SINGLE_BIT;
-    decoded.type =
-        (operation == 1) ? InstructionType::SUB_REG : InstructionType::ADD_REG;
-    decoded.rd = instr & MASK_REGFILE;               // Bits [4:0]
-    decoded.rn = (instr >> SHIFT_RN) & MASK_REGFILE; // Bits [9:5]
-    decoded.rm = (instr >> 16) & MASK_REGFILE;       // Bits [20:16]
-    decoded.is64Bit =
-        ((instr >> SHIFT_64BIT) & MASK_SINGLE_BIT) != 0; // Bit [31]
-    decoded.setFlags =
-        (instr >> 29) ? 1 : 0; // 29 bit DP register instructions with S bit set
-                               // (e.g., SUBS) set flags
-  } else {
-    decoded.type = InstructionType::UNKNOWN;
+#if SIM_DECODE_AVX2
+auto host_avx2() -> bool {
+  static const bool avx2 = __builtin_cpu_supports("avx2") != 0;
+  return avx2;
+}
+#endif
+
+// Table keys of n words, with the widest kernel the host supports
+void table_keys(const uint32_t *words, size_t n, uint8_t *keys) {
+#if SIM_DECODE_AVX2
+  if (host_avx2()) {
+    table_keys_avx2(words, n, keys);
+    return;
+  }
+#endif
+#if SIM_DECODE_SSE2
+  table_keys_sse2(words, n, keys);
+#else
+  table_keys_scalar(words, n, keys);
+#endif
+}
+
+// masks[type] bit i is set when classes[i] is type, for BLOCK_CHUNK classes
+void class_masks(const uint8_t *classes, ClassMasks &masks) {
+#if SIM_DECODE_AVX2
+  if (host_avx2()) {
+    class_masks_avx2(classes, masks);
+    return;
   }
+#endif
+#if SIM_DECODE_SSE2
+  class_masks_sse2(classes, masks);
+#else
+  class_masks_scalar(classes, masks);
+#endif
+}
+
+auto lowest_bit(uint64_t mask) -> size_t {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_ctzll(mask));
+#else
+  size_t bit = 0;
+  for (; (mask & 1) == 0; mask >>= 1) {
+    bit++;
+  }
+  return bit;
+#endif
+}
+
+// Decode the words whose bits are set in mask, all of one class. The routine
+// is a template argument, so the loop body is the inlined extraction with no
+// indirect call and no class-dependent branch. Fields are written straight
+// into out: building the struct on the stack and copying it makes the copy's
+// wide loads wait on the byte stores of the fields.
+using GroupFn = void (*)(const uint32_t *, uint64_t, DecodedInstruction *);
 
+template <DecodeFn Fn>
+void decode_group(const uint32_t *words, uint64_t mask,
+                  DecodedInstruction *out) {
+  for (; mask != 0; mask &= mask - 1) {
+    size_t i = lowest_bit(mask);
+    out[i] = DecodedInstruction{};
+    Fn(words[i], out[i]);
+  }
+}
+
+constexpr std::array<GroupFn, INSTRUCTION_TYPE_COUNT> GROUP_DECODERS = {
+    decode_group<CLASS_DECODERS[0]>, decode_group<CLASS_DECODERS[1]>,
+    decode_group<CLASS_DECODERS[2]>, decode_group<CLASS_DECODERS[3]>,
+    decode_group<CLASS_DECODERS[4]>, decode_group<CLASS_DECODERS[5]>,
+    decode_group<CLASS_DECODERS[6]>, decode_group<CLASS_DECODERS[7]>,
+    decode_group<CLASS_DECODERS[8]>};
+
+// One chunk of up to BLOCK_CHUNK words: keys, classes, a mask of the words
+// of each class, then one decode_group() pass per class present
+void decode_chunk(const uint32_t *words, size_t n, DecodedInstruction *out) {
+  std::array<uint8_t, BLOCK_CHUNK> classes;
+  table_keys(words, n, classes.data());
+  for (size_t i = 0; i < n; i++) {
+    classes[i] = static_cast<uint8_t>(CLASS_TABLE[classes[i]]);
+  }
+  std::fill(classes.begin() + static_cast<std::ptrdiff_t>(n), classes.end(),
+            NO_CLASS);
+  ClassMasks masks;
+  class_masks(classes.data(), masks);
+  for (size_t type = 0; type < INSTRUCTION_TYPE_COUNT; type++) {
+    if (masks[type] != 0) {
+      GROUP_DECODERS[type](words, masks[type], out);
+    }
+  }
+}
+} // namespace
+
+auto Decoder::decode(uint32_t instr) -> DecodedInstruction {
+  SIM_PROFILE_PHASE(Decode);
+  DecodedInstruction decoded;
+  DECODE_TABLE[table_key(instr)](instr, decoded);
   return decoded;
 }
+
+void Decoder::decodeBlock(const uint32_t *words, size_t n,
+                          DecodedInstruction *out) {
+  SIM_PROFILE_PHASE(Decode);
+  for (size_t done = 0; done < n; done += BLOCK_CHUNK) {
+    decode_chunk(words + done, std::min(BLOCK_CHUNK, n - done), out + done);
+  }
+}
+
+auto Decoder::typeName(InstructionType type) -> const char * {
+  switch (type) {
+  case InstructionType::ADD_IMM:
+    return "ADD_IMM";
+  case InstructionType::SUB_IMM:
+    return "SUB_IMM";
+  case InstructionType::ADD_REG:
+    return "ADD_REG";
+  case InstructionType::SUB_REG:
+    return "SUB_REG";
+  case InstructionType::LDR:
+    return "LDR";
+  case InstructionType::STR:
+    return "STR";
+  case InstructionType::BRANCH:
+    return "BRANCH";
+  case InstructionType::BRANCH_COND:
+    return "BRANCH_COND";
+  default:
+    return "UNKNOWN";
+  }
+}
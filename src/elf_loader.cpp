@@ -0,0 +1,197 @@
+#include "elf_loader.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <elf.h>
+#include <fcntl.h>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+
+namespace {
+constexpr uint64_t GUEST_PAGE_MASK = Memory::PAGE_SIZE - 1;
+
+// Closes the descriptor on every exit path of load()
+struct FileDescriptor {
+  int fd;
+  ~FileDescriptor() {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+};
+
+// Whether [offset, offset + length) lies inside a file of fileSize bytes
+auto in_file(uint64_t offset, uint64_t length, uint64_t fileSize) -> bool {
+  return offset <= fileSize && length <= fileSize - offset;
+}
+
+void read_symbols(const uint8_t *image, uint64_t fileSize,
+                  const Elf64_Ehdr &header, std::vector<ElfSymbol> &out) {
+  if (header.e_shoff == 0 || header.e_shentsize != sizeof(Elf64_Shdr) ||
+      !in_file(header.e_shoff, header.e_shnum * sizeof(Elf64_Shdr),
+               fileSize)) {
+    return; // Stripped or malformed: no symbols, still loadable
+  }
+  const auto *sections =
+      reinterpret_cast<const Elf64_Shdr *>(image + header.e_shoff);
+  for (uint32_t i = 0; i < header.e_shnum; i++) {
+    const Elf64_Shdr &symtab = sections[i];
+    if (symtab.sh_type != SHT_SYMTAB || symtab.sh_link >= header.e_shnum ||
+        !in_file(symtab.sh_offset, symtab.sh_size, fileSize)) {
+      continue;
+    }
+    const Elf64_Shdr &strtab = sections[symtab.sh_link];
+    if (!in_file(strtab.sh_offset, strtab.sh_size, fileSize)) {
+      continue;
+    }
+    const auto *names =
+        reinterpret_cast<const char *>(image + strtab.sh_offset);
+    const auto *syms =
+        reinterpret_cast<const Elf64_Sym *>(image + symtab.sh_offset);
+    uint64_t count = symtab.sh_size / sizeof(Elf64_Sym);
+    for (uint64_t s = 0; s < count; s++) {
+      const Elf64_Sym &sym = syms[s];
+      uint8_t type = ELF64_ST_TYPE(sym.st_info);
+      if (sym.st_name == 0 || sym.st_name >= strtab.sh_size ||
+          type == STT_SECTION || type == STT_FILE) {
+        continue;
+      }
+      const char *name = names + sym.st_name;
+      size_t length = strnlen(name, strtab.sh_size - sym.st_name);
+      out.push_back({std::string(name, length), sym.st_value, sym.st_size,
+                     type});
+    }
+  }
+}
+} // namespace
+
+auto ElfImage::fail(const std::string &message) -> bool {
+  lastError = message;
+  return false;
+}
+
+auto ElfImage::load(const std::string &path, Memory &mem, arm64::CPUState &cpu)
+    -> bool {
+  lastError.clear();
+  symtab.clear();
+  mapped = 0;
+  copied = 0;
+
+  FileDescriptor file{open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+  if (file.fd < 0) {
+    return fail("cannot open " + path + ": " + std::strerror(errno));
+  }
+  struct stat info {};
+  if (fstat(file.fd, &info) != 0 || info.st_size < 0) {
+    return fail("cannot stat " + path);
+  }
+  auto fileSize = static_cast<uint64_t>(info.st_size);
+  if (fileSize < sizeof(Elf64_Ehdr)) {
+    return fail(path + ": too small for an ELF64 header");
+  }
+
+  // Writable private mapping: guest stores copy-on-write, the file is never
+  // modified
+  void *base = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                    file.fd, 0);
+  if (base == MAP_FAILED) {
+    return fail("cannot mmap " + path + ": " + std::strerror(errno));
+  }
+  std::shared_ptr<void> mapping(
+      base, [fileSize](void *addr) { munmap(addr, fileSize); });
+  auto *image = static_cast<uint8_t *>(base);
+
+  Elf64_Ehdr header{};
+  std::memcpy(&header, image, sizeof(header));
+  if (std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0) {
+    return fail(path + ": not an ELF file");
+  }
+  if (header.e_ident[EI_CLASS] != ELFCLASS64 ||
+      header.e_ident[EI_DATA] != ELFDATA2LSB ||
+      header.e_machine != EM_AARCH64) {
+    return fail(path + ": not a little-endian AArch64 ELF64 image");
+  }
+  if (header.e_phentsize != sizeof(Elf64_Phdr) ||
+      !in_file(header.e_phoff, header.e_phnum * sizeof(Elf64_Phdr),
+               fileSize)) {
+    return fail(path + ": bad program header table");
+  }
+
+  read_symbols(image, fileSize, header, symtab);
+
+  const auto *segments =
+      reinterpret_cast<const Elf64_Phdr *>(image + header.e_phoff);
+  std::unordered_set<uint64_t> aliasedFilePages; // One guest page each
+  for (uint32_t i = 0; i < header.e_phnum; i++) {
+    const Elf64_Phdr &seg = segments[i];
+    if (seg.p_type != PT_LOAD) {
+      continue;
+    }
+    if (seg.p_filesz > seg.p_memsz ||
+        !in_file(seg.p_offset, seg.p_filesz, fileSize)) {
+      return fail(path + ": bad PT_LOAD segment");
+    }
+    if (seg.p_memsz > mem.size() || seg.p_vaddr > mem.size() - seg.p_memsz) {
+      return fail(path + ": segment does not fit in guest memory");
+    }
+    bool congruent = ((seg.p_vaddr - seg.p_offset) & GUEST_PAGE_MASK) == 0;
+    uint64_t fileEnd = seg.p_vaddr + seg.p_filesz;
+    uint64_t memEnd = seg.p_vaddr + seg.p_memsz;
+
+    for (uint64_t page = seg.p_vaddr & ~GUEST_PAGE_MASK; page < fileEnd;
+         page += Memory::PAGE_SIZE) {
+      uint64_t lo = std::max(page, seg.p_vaddr);
+      uint64_t hi = std::min(page + Memory::PAGE_SIZE, fileEnd);
+      uint64_t bssEnd = std::min(page + Memory::PAGE_SIZE, memEnd);
+      uint64_t fileOffset = seg.p_offset + (page - seg.p_vaddr);
+      // A page holding BSS gets a private copy: the rest of its file page
+      // belongs to whatever follows the segment in the file
+      if (congruent && bssEnd == hi &&
+          aliasedFilePages.count(fileOffset) == 0 &&
+          mem.mapHostPage(page, image + fileOffset, mapping)) {
+        aliasedFilePages.insert(fileOffset);
+        mapped += hi - lo;
+        continue;
+      }
+      for (uint64_t addr = lo; addr < hi; addr++) {
+        mem.write<uint8_t>(addr, image[seg.p_offset + (addr - seg.p_vaddr)]);
+      }
+      for (uint64_t addr = hi; addr < bssEnd; addr++) {
+        mem.write<uint8_t>(addr, 0); // Page may already hold other data
+      }
+      copied += hi - lo;
+    }
+  }
+
+  entryPoint = header.e_entry;
+  cpu.PC = entryPoint;
+  return true;
+}
+
+auto ElfImage::findSymbol(const std::string &name) const -> const ElfSymbol * {
+  for (const ElfSymbol &sym : symtab) {
+    if (sym.name == name) {
+      return &sym;
+    }
+  }
+  return nullptr;
+}
+
+auto ElfImage::symbolFor(uint64_t address) const -> const ElfSymbol * {
+  const ElfSymbol *best = nullptr;
+  for (const ElfSymbol &sym : symtab) {
+    if ((sym.type != STT_FUNC && sym.type != STT_OBJECT) ||
+        address < sym.value) {
+      continue;
+    }
+    bool inside = sym.size == 0 ? address == sym.value
+                                : address - sym.value < sym.size;
+    if (inside && (best == nullptr || sym.value > best->value)) {
+      best = &sym;
+    }
+  }
+  return best;
+}
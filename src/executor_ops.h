@@ -0,0 +1,277 @@
+#pragma once
+// Per-instruction semantics shared by the execution engines. Executor's
+// switch (executor.cpp) and the direct-threaded ThreadedExecutor
+// (threaded_executor.cpp) both call these, so the engines differ only in how
+// they dispatch. Every op returns true when it wrote the PC (a taken branch),
+// and counts itself into the PMU when that is compiled in. The pair ops at the
+// end run a fused MacroOp in one dispatch.
+#include "block_cache.h"
+#include "decoder.h"
+#include "host_profiler.h"
+#include "memory.h"
+#include "pmu.h"
+#include "registers.h"
+#include "trace.h"
+
+namespace exec_ops {
+
+constexpr uint64_t PAIR_STRIDE = 4; // PC step from a pair's first half
+
+// Helper: Checks if a conditional branch should be taken based on the condition
+// code and current PSTATE flags (see arm64::CONDITION_TABLE).
+inline auto check_condition(const arm64::CPUState &cpu, uint8_t cond)
+    -> bool {
+  return cpu.pstate.condition(cond);
+}
+
+// Address an LDR/STR will access, or the target of a B/B.cond, computed
+// from the state before the instruction executes; 0 for anything else
+inline auto effective_address(const DecodedInstruction &instr,
+                              const arm64::CPUState &cpu) -> uint64_t {
+  auto offset = static_cast<uint64_t>(static_cast<int64_t>(instr.imm));
+  switch (instr.type) {
+  case InstructionType::LDR:
+  case InstructionType::STR: {
+    uint64_t base = (instr.rn == 31) ? cpu.SP : cpu.getReg(instr.rn);
+    return instr.mode == AddrMode::PostIndex ? base : base + offset;
+  }
+  case InstructionType::BRANCH:
+  case InstructionType::BRANCH_COND:
+    return cpu.PC + offset;
+  default:
+    return 0;
+  }
+}
+
+// Zero-extending load / truncating store of (1 << size) bytes
+inline auto load_sized(const Memory &mem, uint64_t address, uint8_t size)
+    -> uint64_t {
+  SIM_PROFILE_PHASE(Memory);
+  switch (size) {
+  case 0:
+    return mem.read<uint8_t>(address);
+  case 1:
+    return mem.read<uint16_t>(address);
+  case 2:
+    return mem.read<uint32_t>(address);
+  default:
+    return mem.read<uint64_t>(address);
+  }
+}
+
+inline void store_sized(Memory &mem, uint64_t address, uint8_t size,
+                        uint64_t value) {
+  SIM_PROFILE_PHASE(Memory);
+  switch (size) {
+  case 0:
+    mem.write<uint8_t>(address, static_cast<uint8_t>(value));
+    break;
+  case 1:
+    mem.write<uint16_t>(address, static_cast<uint16_t>(value));
+    break;
+  case 2:
+    mem.write<uint32_t>(address, static_cast<uint32_t>(value));
+    break;
+  default:
+    mem.write<uint64_t>(address, value);
+    break;
+  }
+}
+
+// rd = rn + rhs (or rn - rhs) at the instruction's width; W forms use and
+// zero-extend the low 32 bits. Flag-setting forms only record the operation;
+// PState derives N, Z, C and V from it when they are read.
+inline void add_sub(const DecodedInstruction &instr, arm64::CPUState &cpu,
+                    uint64_t rhs, bool sub) {
+  uint64_t mask = instr.is64Bit ? ~uint64_t{0} : 0xFFFFFFFFULL;
+  uint64_t lhs = cpu.getReg(instr.rn) & mask;
+  rhs &= mask;
+  uint64_t result = (sub ? lhs - rhs : lhs + rhs) & mask;
+  if (instr.setFlags) {
+    using Op = arm64::PState::Op;
+    Op op = instr.is64Bit ? (sub ? Op::Sub64 : Op::Add64)
+                          : (sub ? Op::Sub32 : Op::Add32);
+    cpu.pstate.record(op, lhs, rhs, result);
+  }
+  cpu.setReg(instr.rd, result);
+}
+
+inline auto add_imm(const DecodedInstruction &instr, arm64::CPUState &cpu,
+                    Memory & /*mem*/) -> bool {
+  // logic: rd = rn + imm
+  SIM_PMU_COUNT(instr, false);
+  add_sub(instr, cpu, static_cast<uint64_t>(instr.imm), false);
+  return false;
+}
+
+inline auto sub_imm(const DecodedInstruction &instr, arm64::CPUState &cpu,
+                    Memory & /*mem*/) -> bool {
+  // logic: rd = rn - imm
+  SIM_PMU_COUNT(instr, false);
+  add_sub(instr, cpu, static_cast<uint64_t>(instr.imm), true);
+  return false;
+}
+
+inline auto add_reg(const DecodedInstruction &instr, arm64::CPUState &cpu,
+                    Memory & /*mem*/) -> bool {
+  // logic: rd = rn + rm
+  SIM_PMU_COUNT(instr, false);
+  add_sub(instr, cpu, cpu.getReg(instr.rm), false);
+  return false;
+}
+
+inline auto sub_reg(const DecodedInstruction &instr, arm64::CPUState &cpu,
+                    Memory & /*mem*/) -> bool {
+  // logic: rd = rn - rm
+  SIM_PMU_COUNT(instr, false);
+  add_sub(instr, cpu, cpu.getReg(instr.rm), true);
+  return false;
+}
+
+inline auto ldr(const DecodedInstruction &instr, arm64::CPUState &cpu,
+                Memory &mem) -> bool {
+  // logic: rd = [rn + imm], zero-extended from (1 << size) bytes
+  uint64_t base_addr = (instr.rn == 31) ? cpu.SP : cpu.getReg(instr.rn);
+  if (instr.mode == AddrMode::PreIndex) {
+    base_addr += instr.imm;
+    if (instr.rn == 31) {
+      cpu.SP = base_addr;
+    } else {
+      cpu.setReg(instr.rn, base_addr); // Update base register
+    }
+  } else if (instr.mode == AddrMode::PostIndex) {
+    uint64_t temp_addr = base_addr;
+    base_addr += instr.imm;
+    if (instr.rn == 31) {
+      cpu.SP = base_addr;
+    } else {
+      cpu.setReg(instr.rn, base_addr); // Update base register
+    }
+    base_addr = temp_addr;
+  } else {
+    base_addr += instr.imm;
+  }
+  uint64_t target_addr = base_addr;
+  uint64_t result = load_sized(mem, target_addr, instr.size);
+  SIM_TRACE(cpu.PC, instr.type, target_addr, result, instr.rd);
+  SIM_PMU_COUNT(instr, false);
+  cpu.setReg(instr.rd, result);
+  return false;
+}
+
+inline auto str(const DecodedInstruction &instr, arm64::CPUState &cpu,
+                Memory &mem) -> bool {
+  // logic: [rn + imm] = low (1 << size) bytes of rd
+  uint64_t base_addr = (instr.rn == 31) ? cpu.SP : cpu.getReg(instr.rn);
+  uint64_t target_addr = base_addr;
+  // Handle addressing modes
+  if (instr.mode == AddrMode::Offset) {
+    target_addr += instr.imm;
+  } else if (instr.mode == AddrMode::PreIndex) {
+    target_addr += instr.imm;
+    if (instr.rn == 31) {
+      cpu.SP = target_addr;
+    } else {
+      cpu.setReg(instr.rn, target_addr); // Update base register
+    }
+  } else if (instr.mode == AddrMode::PostIndex) {
+    target_addr = base_addr;
+    if (instr.rn == 31) {
+      cpu.SP = target_addr + instr.imm;
+    } else {
+      cpu.setReg(instr.rn, target_addr + instr.imm); // Update base register
+    }
+  }
+  uint64_t val_rd = (instr.rd == 31) ? cpu.SP : cpu.getReg(instr.rd);
+  SIM_TRACE(cpu.PC, instr.type, target_addr, val_rd, instr.rd);
+  SIM_PMU_COUNT(instr, false);
+  store_sized(mem, target_addr, instr.size, val_rd);
+  return false;
+}
+
+inline auto branch(const DecodedInstruction &instr, arm64::CPUState &cpu,
+                   Memory & /*mem*/) -> bool {
+  // PC-relative: the target is computed from the address of the branch
+  // itself, so a zero offset is a legal branch-to-self.
+  SIM_TRACE(cpu.PC, instr.type, cpu.PC + instr.imm, 1, 0);
+  SIM_PMU_COUNT(instr, true);
+  cpu.PC += instr.imm;
+  return true;
+}
+
+inline auto branch_cond(const DecodedInstruction &instr,
+                        arm64::CPUState &cpu, Memory & /*mem*/) -> bool {
+  bool taken = check_condition(cpu, instr.cond);
+  SIM_TRACE(cpu.PC, instr.type, cpu.PC + instr.imm, taken, 0);
+  SIM_PMU_COUNT(instr, taken);
+  if (taken) { // If condition is met, branch
+    cpu.PC += instr.imm;
+    return true;
+  }
+  return false;
+}
+
+inline auto unknown(const DecodedInstruction & /*instr*/,
+                    arm64::CPUState & /*cpu*/, Memory & /*mem*/) -> bool {
+  return false;
+}
+
+// --- Fused pairs (MacroOp) ---
+// Like the single ops they return true when they wrote the PC; otherwise the
+// PC is left on the second instruction for the caller to step past.
+
+// SUBS/CMP then B.cond. The flags are still recorded, since code after the
+// branch may read them, but the branch never derives NZCV from the record.
+inline auto compare_branch(const DecodedInstruction &cmp,
+                           const DecodedInstruction &branch,
+                           arm64::CPUState &cpu, Memory & /*mem*/) -> bool {
+  uint64_t mask = cmp.is64Bit ? ~uint64_t{0} : 0xFFFFFFFFULL;
+  uint64_t lhs = cpu.getReg(cmp.rn) & mask;
+  uint64_t rhs = (cmp.type == InstructionType::SUB_IMM
+                      ? static_cast<uint64_t>(cmp.imm)
+                      : cpu.getReg(cmp.rm)) &
+                 mask;
+  uint64_t result = (lhs - rhs) & mask;
+  using Op = arm64::PState::Op;
+  SIM_PMU_COUNT(cmp, false);
+  cpu.pstate.record(cmp.is64Bit ? Op::Sub64 : Op::Sub32, lhs, rhs, result);
+  cpu.setReg(cmp.rd, result);
+  cpu.PC += PAIR_STRIDE;
+  bool taken = arm64::PState::afterSub(branch.cond, lhs, rhs, cmp.is64Bit);
+  SIM_TRACE(cpu.PC, branch.type, cpu.PC + branch.imm, taken, 0);
+  SIM_PMU_COUNT(branch, taken);
+  if (taken) {
+    cpu.PC += branch.imm;
+  }
+  return taken;
+}
+
+// ADD Xd, Xn, #imm then an LDR based on Xd. The sum is both Xd and the
+// load's base, so the address is computed once and Xd written once (with
+// the base writeback already applied for pre/post-index forms).
+inline auto add_load(const DecodedInstruction &add,
+                     const DecodedInstruction &load, arm64::CPUState &cpu,
+                     Memory &mem) -> bool {
+  uint64_t mask = add.is64Bit ? ~uint64_t{0} : 0xFFFFFFFFULL;
+  uint64_t sum = (cpu.getReg(add.rn) + static_cast<uint64_t>(add.imm)) & mask;
+  uint64_t indexed = sum + static_cast<uint64_t>(load.imm);
+  SIM_PMU_COUNT(add, false);
+  cpu.PC += PAIR_STRIDE;
+  cpu.setReg(add.rd, load.mode == AddrMode::Offset ? sum : indexed);
+  uint64_t address = load.mode == AddrMode::PostIndex ? sum : indexed;
+  uint64_t result = load_sized(mem, address, load.size);
+  SIM_TRACE(cpu.PC, load.type, address, result, load.rd);
+  SIM_PMU_COUNT(load, false);
+  cpu.setReg(load.rd, result);
+  return false;
+}
+
+inline auto run_pair(MacroOp op, const DecodedInstruction &first,
+                     const DecodedInstruction &second, arm64::CPUState &cpu,
+                     Memory &mem) -> bool {
+  return op == MacroOp::CompareBranch
+             ? compare_branch(first, second, cpu, mem)
+             : add_load(first, second, cpu, mem);
+}
+
+} // namespace exec_ops
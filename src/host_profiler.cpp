@@ -0,0 +1,200 @@
+#include "host_profiler.h"
+#include <chrono>
+#include <cstring>
+#include <ostream>
+#include <time.h>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+#if defined(__linux__)
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr double NANOSECONDS = 1e-9;
+constexpr double PERCENT = 100.0;
+
+// Report labels, by HostPhase and by HostEvent
+constexpr std::array<const char *, HOST_PHASE_COUNT> PHASE_LABELS = {
+    "fetch:                ", "decode:               ",
+    "execute:              ", "memory:               "};
+constexpr std::array<const char *, HOST_EVENT_COUNT> EVENT_NAMES = {
+    "cycles", "branch-misses", "cache-misses"};
+
+auto steady_seconds() -> double {
+  std::chrono::duration<double> since =
+      std::chrono::steady_clock::now().time_since_epoch();
+  return since.count();
+}
+} // namespace
+
+thread_local HostProfiler *HostProfiler::threadSink = nullptr;
+
+void HostProfiler::attach(HostProfiler *profiler) { threadSink = profiler; }
+
+HostProfiler::HostProfiler(bool perfEvents)
+    : createdTicks(now()), createdSeconds(steady_seconds()) {
+  stack.reserve(HOST_PHASE_COUNT * 2);
+  if (perfEvents) {
+    openPerf();
+  }
+}
+
+HostProfiler::~HostProfiler() {
+#if defined(__linux__)
+  for (int fd : eventFds) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+#endif
+}
+
+auto HostProfiler::now() -> uint64_t {
+#if defined(__x86_64__)
+  return __rdtsc();
+#else
+  timespec time{};
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return static_cast<uint64_t>(time.tv_sec) * 1000000000ULL +
+         static_cast<uint64_t>(time.tv_nsec);
+#endif
+}
+
+auto HostProfiler::tickSeconds() const -> double {
+#if defined(__x86_64__)
+  double seconds = steady_seconds() - createdSeconds;
+  uint64_t ticks = now() - createdTicks;
+  return ticks > 0 && seconds > 0.0 ? seconds / static_cast<double>(ticks)
+                                    : NANOSECONDS;
+#else
+  return NANOSECONDS;
+#endif
+}
+
+void HostProfiler::openPerf() {
+#if defined(__linux__)
+  constexpr std::array<uint64_t, HOST_EVENT_COUNT> CONFIGS = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_BRANCH_MISSES,
+      PERF_COUNT_HW_CACHE_MISSES};
+  for (size_t i = 0; i < HOST_EVENT_COUNT; i++) {
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = CONFIGS[i];
+    attr.disabled = i == 0 ? 1 : 0; // The leader starts the whole group
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    int leader = i == 0 ? -1 : eventFds[0];
+    auto fd = static_cast<int>(
+        syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+    if (fd < 0) {
+      perfMessage = std::string("perf_event_open(") + EVENT_NAMES[i] +
+                    "): " + std::strerror(errno);
+      for (int &open : eventFds) {
+        if (open >= 0) {
+          close(open);
+          open = -1;
+        }
+      }
+      return;
+    }
+    eventFds[i] = fd;
+  }
+  ioctl(eventFds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(eventFds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  perfFd = eventFds[0];
+#else
+  perfMessage = "perf events need Linux";
+#endif
+}
+
+auto HostProfiler::readEvents() const
+    -> std::array<uint64_t, HOST_EVENT_COUNT> {
+  std::array<uint64_t, HOST_EVENT_COUNT> events{};
+#if defined(__linux__)
+  if (perfFd >= 0) {
+    struct {
+      uint64_t count;
+      uint64_t values[HOST_EVENT_COUNT];
+    } group{};
+    if (read(perfFd, &group, sizeof(group)) ==
+        static_cast<ssize_t>(sizeof(group))) {
+      std::memcpy(events.data(), group.values, sizeof(group.values));
+    }
+  }
+#endif
+  return events;
+}
+
+void HostProfiler::enter(HostPhase phase) {
+  Frame frame{phase, 0, 0, readEvents()};
+  frame.start = now();
+  stack.push_back(frame);
+}
+
+void HostProfiler::leave() {
+  uint64_t end = now();
+  std::array<uint64_t, HOST_EVENT_COUNT> endEvents = readEvents();
+  Frame frame = stack.back();
+  stack.pop_back();
+
+  uint64_t elapsed = end - frame.start;
+  PhaseStats &stats = phases[static_cast<size_t>(frame.phase)];
+  stats.calls++;
+  stats.ticks += elapsed - frame.child;
+  Frame *parent = stack.empty() ? nullptr : &stack.back();
+  if (parent != nullptr) {
+    parent->child += elapsed;
+  }
+  for (size_t i = 0; i < HOST_EVENT_COUNT; i++) {
+    uint64_t delta = endEvents[i] - frame.startEvents[i];
+    stats.events[i] += delta - frame.childEvents[i];
+    if (parent != nullptr) {
+      parent->childEvents[i] += delta;
+    }
+  }
+}
+
+auto HostProfiler::totalTicks() const -> uint64_t {
+  uint64_t total = 0;
+  for (const PhaseStats &stats : phases) {
+    total += stats.ticks;
+  }
+  return total;
+}
+
+void HostProfiler::reset() { phases = {}; }
+
+auto HostProfiler::report(std::ostream &out) const -> void {
+  double seconds = tickSeconds();
+  uint64_t total = totalTicks();
+  out << "profiled seconds:     " << static_cast<double>(total) * seconds
+      << "\n"
+      << "perf events:          "
+      << (perfEnabled()            ? "cycles, branch-misses, cache-misses"
+          : perfMessage.empty() ? "off"
+                                : perfMessage.c_str())
+      << "\n";
+  for (size_t i = 0; i < HOST_PHASE_COUNT; i++) {
+    const PhaseStats &stats = phases[i];
+    double share = total > 0 ? PERCENT * static_cast<double>(stats.ticks) /
+                                   static_cast<double>(total)
+                             : 0.0;
+    out << PHASE_LABELS[i] << stats.calls << " calls, "
+        << static_cast<double>(stats.ticks) * seconds << " s (" << share
+        << "%)";
+    if (perfEnabled()) {
+      for (size_t event = 0; event < HOST_EVENT_COUNT; event++) {
+        out << ", " << stats.events[event] << " " << EVENT_NAMES[event];
+      }
+    }
+    out << "\n";
+  }
+}
@@ -0,0 +1,597 @@
+#include "jit.h"
+#include "executor.h"
+#include "executor_ops.h"
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <sys/mman.h>
+
+#if defined(__x86_64__) && !defined(AARCH64_SIM_TRACE) &&                     \
+    !defined(AARCH64_SIM_PMU) && !defined(AARCH64_SIM_PROFILE)
+#define SIM_JIT_X86_64 1
+#else
+#define SIM_JIT_X86_64 0
+#endif
+
+namespace {
+constexpr uint64_t INSTRUCTION_BYTES = 4;
+// Upper bounds on emitted code, used to make room before compiling
+constexpr size_t MAX_INSTRUCTION_BYTES = 160;
+constexpr size_t MAX_BLOCK_OVERHEAD = 128;
+
+// State shared between Jit::runBlock and translated code; the stubs and
+// blocks reach it through r12
+struct JitContext {
+  arm64::CPUState *cpu;
+  Memory *mem;
+  const BlockCache *blocks;
+  int64_t budget;         // Instructions left; blocks subtract their length
+  uint64_t invalidations; // BlockCacheStats::invalidations on entry
+};
+
+using EnterFn = void (*)(JitContext *, const uint8_t *);
+
+// Memory helpers called from translated code (System V ABI: ctx in rdi,
+// address in rsi, value in rdx)
+template <typename T>
+auto load_helper(JitContext *ctx, uint64_t address) -> uint64_t {
+  return ctx->mem->read<T>(address);
+}
+
+// Returns true when the store invalidated cached code, which makes the
+// translated block exit to the dispatcher
+template <typename T>
+auto store_helper(JitContext *ctx, uint64_t address, uint64_t value) -> bool {
+  ctx->mem->write<T>(address, static_cast<T>(value));
+  return ctx->blocks->stats().invalidations != ctx->invalidations;
+}
+
+using LoadFn = uint64_t (*)(JitContext *, uint64_t);
+using StoreFn = bool (*)(JitContext *, uint64_t, uint64_t);
+const LoadFn LOADS[] = {load_helper<uint8_t>, load_helper<uint16_t>,
+                        load_helper<uint32_t>, load_helper<uint64_t>};
+const StoreFn STORES[] = {store_helper<uint8_t>, store_helper<uint16_t>,
+                          store_helper<uint32_t>, store_helper<uint64_t>};
+
+// B.cond conditions other than EQ/NE on a recorded result (ABI: cpu in rdi,
+// condition code in rsi)
+auto condition_helper(const arm64::CPUState *cpu, uint64_t cond) -> bool {
+  return cpu->pstate.condition(static_cast<uint8_t>(cond));
+}
+
+enum Reg : uint8_t {
+  RAX = 0,
+  RCX = 1,
+  RDX = 2,
+  RBX = 3, // CPUState *
+  RSI = 6,
+  RDI = 7,
+  R12 = 12, // JitContext *
+  R13 = 13, // Remaining budget
+};
+
+// x86 condition codes (the low nibble of Jcc/SETcc)
+enum Cond : uint8_t {
+  CC_E = 0x4,
+  CC_NE = 0x5,
+  CC_L = 0xC,
+};
+
+enum AluOp : uint8_t { ALU_ADD = 0, ALU_SUB = 5 }; // /digit of 0x81
+
+// Minimal x86-64 encoder. Memory operands are always [base + disp32].
+class Emitter {
+public:
+  explicit Emitter(uint8_t *at) : cursor(at) {}
+
+  auto pos() const -> uint8_t * { return cursor; }
+
+  void byte(uint8_t value) { *cursor++ = value; }
+  void u32(uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+      byte(static_cast<uint8_t>(value >> (i * 8)));
+    }
+  }
+  void u64(uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+      byte(static_cast<uint8_t>(value >> (i * 8)));
+    }
+  }
+
+  // mov dst, [base + disp]
+  void load(Reg dst, Reg base, int32_t disp) {
+    rex(true, dst, base);
+    byte(0x8B);
+    mem(dst, base, disp);
+  }
+  // mov [base + disp], src
+  void store(Reg base, int32_t disp, Reg src) {
+    rex(true, src, base);
+    byte(0x89);
+    mem(src, base, disp);
+  }
+  // mov byte [base + disp], imm
+  void storeByte(Reg base, int32_t disp, uint8_t imm) {
+    rex(false, RAX, base);
+    byte(0xC6);
+    mem(RAX, base, disp);
+    byte(imm);
+  }
+  // setcc al
+  void setAl(Cond cc) {
+    byte(0x0F);
+    byte(0x90 | cc);
+    byte(0xC0);
+  }
+  // cmp byte [base + disp], 0
+  void testByte(Reg base, int32_t disp) {
+    rex(false, RAX, base);
+    byte(0x80);
+    mem(static_cast<Reg>(7), base, disp);
+    byte(0);
+  }
+  void movImm(Reg dst, uint64_t imm) {
+    rex(true, RAX, dst);
+    byte(0xB8 | (dst & 7));
+    u64(imm);
+  }
+  void mov(Reg dst, Reg src) { regReg(0x89, dst, src); }
+  void add(Reg dst, Reg src) { regReg(0x01, dst, src); }
+  void sub(Reg dst, Reg src) { regReg(0x29, dst, src); }
+  void test(Reg dst, Reg src) { regReg(0x85, dst, src); }
+  void zeroExtend32(Reg dst) { // mov dst32, dst32
+    rex(false, dst, dst);
+    byte(0x89);
+    byte(0xC0 | (dst & 7) << 3 | (dst & 7));
+  }
+  void alu(AluOp op, Reg dst, int32_t imm) {
+    rex(true, RAX, dst);
+    byte(0x81);
+    byte(0xC0 | op << 3 | (dst & 7));
+    u32(static_cast<uint32_t>(imm));
+  }
+  void zero(Reg dst) { // xor dst32, dst32
+    byte(0x31);
+    byte(0xC0 | (dst & 7) << 3 | (dst & 7));
+  }
+  void call(const void *fn) {
+    movImm(RAX, reinterpret_cast<uint64_t>(fn));
+    byte(0xFF);
+    byte(0xD0); // call rax
+  }
+  // Jumps return the address of their rel32 field, for patching
+  auto jcc(Cond cc) -> uint8_t * {
+    byte(0x0F);
+    byte(0x80 | cc);
+    return rel32();
+  }
+  auto jmp() -> uint8_t * {
+    byte(0xE9);
+    return rel32();
+  }
+
+  static void patch(uint8_t *rel, const uint8_t *target) {
+    auto delta = static_cast<int32_t>(target - (rel + 4));
+    for (int i = 0; i < 4; i++) {
+      rel[i] = static_cast<uint8_t>(static_cast<uint32_t>(delta) >> (i * 8));
+    }
+  }
+
+private:
+  void rex(bool wide, Reg reg, Reg base) {
+    uint8_t prefix = 0x40 | (wide ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0) |
+                     ((base & 8) ? 0x01 : 0);
+    if (prefix != 0x40) {
+      byte(prefix);
+    }
+  }
+  void mem(Reg reg, Reg base, int32_t disp) {
+    byte(0x80 | (reg & 7) << 3 | (base & 7)); // mod 10: [base + disp32]
+    if ((base & 7) == 4) {
+      byte(0x24); // SIB: base only
+    }
+    u32(static_cast<uint32_t>(disp));
+  }
+  void regReg(uint8_t opcode, Reg dst, Reg src) {
+    rex(true, src, dst);
+    byte(opcode);
+    byte(0xC0 | (src & 7) << 3 | (dst & 7));
+  }
+  auto rel32() -> uint8_t * {
+    uint8_t *at = cursor;
+    u32(0);
+    return at;
+  }
+
+  uint8_t *cursor;
+};
+
+// CPUState field offsets, as seen from rbx
+auto x_offset(uint8_t reg) -> int32_t {
+  return static_cast<int32_t>(offsetof(arm64::CPUState, X) + reg * 8);
+}
+constexpr auto PC_OFFSET = static_cast<int32_t>(offsetof(arm64::CPUState, PC));
+constexpr auto SP_OFFSET = static_cast<int32_t>(offsetof(arm64::CPUState, SP));
+constexpr size_t PSTATE_OFFSET = offsetof(arm64::CPUState, pstate);
+constexpr arm64::PState::Layout FLAGS = arm64::PState::layout();
+constexpr auto LHS_OFFSET = static_cast<int32_t>(PSTATE_OFFSET + FLAGS.lhs);
+constexpr auto RHS_OFFSET = static_cast<int32_t>(PSTATE_OFFSET + FLAGS.rhs);
+constexpr auto RESULT_OFFSET =
+    static_cast<int32_t>(PSTATE_OFFSET + FLAGS.result);
+constexpr auto OP_OFFSET = static_cast<int32_t>(PSTATE_OFFSET + FLAGS.op);
+constexpr auto BUDGET_OFFSET =
+    static_cast<int32_t>(offsetof(JitContext, budget));
+constexpr auto CPU_OFFSET = static_cast<int32_t>(offsetof(JitContext, cpu));
+
+// dst = Xn, with register 31 as XZR
+void load_xzr(Emitter &e, Reg dst, uint8_t reg) {
+  if (reg == arm64::REG_XZR) {
+    e.zero(dst);
+  } else {
+    e.load(dst, RBX, x_offset(reg));
+  }
+}
+
+// Xn = src; writes to register 31 (XZR) are dropped
+void store_xzr(Emitter &e, uint8_t reg, Reg src) {
+  if (reg != arm64::REG_XZR) {
+    e.store(RBX, x_offset(reg), src);
+  }
+}
+
+// Load/store base register: 31 is SP
+auto base_offset(uint8_t reg) -> int32_t {
+  return reg == arm64::REG_XZR ? SP_OFFSET : x_offset(reg);
+}
+
+// Same semantics as exec_ops::add_sub: W forms work on zero-extended low
+// halves, and flag-setting forms store the PState record instead of flags
+void emit_alu(Emitter &e, const DecodedInstruction &instr) {
+  bool sub = instr.type == InstructionType::SUB_IMM ||
+             instr.type == InstructionType::SUB_REG;
+  load_xzr(e, RAX, instr.rn);
+  if (instr.type == InstructionType::ADD_IMM ||
+      instr.type == InstructionType::SUB_IMM) {
+    e.movImm(RCX, static_cast<uint64_t>(static_cast<int64_t>(instr.imm)));
+  } else {
+    load_xzr(e, RCX, instr.rm);
+  }
+  if (!instr.is64Bit) {
+    e.zeroExtend32(RAX);
+    e.zeroExtend32(RCX);
+  }
+  Reg result = RAX;
+  if (instr.setFlags) {
+    result = RDX; // Keep the operands for the record
+    e.mov(RDX, RAX);
+  }
+  if (sub) {
+    e.sub(result, RCX);
+  } else {
+    e.add(result, RCX);
+  }
+  if (!instr.is64Bit) {
+    e.zeroExtend32(result);
+  }
+  if (instr.setFlags) {
+    using Op = arm64::PState::Op;
+    Op op = instr.is64Bit ? (sub ? Op::Sub64 : Op::Add64)
+                          : (sub ? Op::Sub32 : Op::Add32);
+    e.store(RBX, LHS_OFFSET, RAX);
+    e.store(RBX, RHS_OFFSET, RCX);
+    e.store(RBX, RESULT_OFFSET, RDX);
+    e.storeByte(RBX, OP_OFFSET, static_cast<uint8_t>(op));
+  }
+  store_xzr(e, instr.rd, result);
+}
+
+// Address of a load/store into rsi, with base writeback, as exec_ops does
+void emit_address(Emitter &e, const DecodedInstruction &instr) {
+  int32_t base = base_offset(instr.rn);
+  e.load(RSI, RBX, base);
+  switch (instr.mode) {
+  case AddrMode::PreIndex:
+    e.alu(ALU_ADD, RSI, instr.imm);
+    e.store(RBX, base, RSI);
+    break;
+  case AddrMode::PostIndex:
+    e.mov(RDX, RSI);
+    e.alu(ALU_ADD, RDX, instr.imm);
+    e.store(RBX, base, RDX);
+    break;
+  default:
+    e.alu(ALU_ADD, RSI, instr.imm);
+    break;
+  }
+}
+
+void emit_ldr(Emitter &e, const DecodedInstruction &instr) {
+  emit_address(e, instr);
+  e.mov(RDI, R12);
+  e.call(reinterpret_cast<const void *>(LOADS[instr.size & 3]));
+  store_xzr(e, instr.rd, RAX);
+}
+
+// Returns the rel32 of the jump taken when the store invalidated code
+auto emit_str(Emitter &e, const DecodedInstruction &instr) -> uint8_t * {
+  emit_address(e, instr);
+  e.load(RDX, RBX, base_offset(instr.rd)); // STR of register 31 stores SP
+  e.mov(RDI, R12);
+  e.call(reinterpret_cast<const void *>(STORES[instr.size & 3]));
+  e.byte(0x84);
+  e.byte(0xC0); // test al, al
+  return e.jcc(CC_NE);
+}
+
+// Jump to the returned rel32 when cond holds. EQ/NE after a recorded ADD/SUB
+// only test the recorded result, as PState::condition does; everything else
+// calls condition_helper.
+auto emit_condition(Emitter &e, uint8_t cond) -> uint8_t * {
+  uint8_t *join = nullptr;
+  if ((cond >> 1) == 0) {
+    e.testByte(RBX, OP_OFFSET); // Op::None: flags already materialized
+    uint8_t *materialized = e.jcc(CC_E);
+    e.load(RAX, RBX, RESULT_OFFSET);
+    e.test(RAX, RAX);
+    e.setAl(cond == 0 ? CC_E : CC_NE);
+    join = e.jmp();
+    Emitter::patch(materialized, e.pos());
+  }
+  e.mov(RDI, RBX);
+  e.movImm(RSI, cond);
+  e.call(reinterpret_cast<const void *>(condition_helper));
+  if (join != nullptr) {
+    Emitter::patch(join, e.pos());
+  }
+  e.byte(0x84);
+  e.byte(0xC0); // test al, al
+  return e.jcc(CC_NE);
+}
+} // namespace
+
+Jit::Jit(BlockCache &blocks, Memory &mem, JitConfig config)
+    : blocks(blocks), mem(mem), config(config),
+      seenInvalidations(blocks.stats().invalidations) {
+  if (!supported() || config.codeBytes < MAX_BLOCK_OVERHEAD * 4) {
+    return;
+  }
+  // W^X: written only while read-write, run only once read-execute
+  void *code = mmap(nullptr, config.codeBytes, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (code == MAP_FAILED) {
+    return;
+  }
+  codeBase = static_cast<uint8_t *>(code);
+  codeEnd = codeBase + config.codeBytes;
+  emitStubs();
+  if (!executable(true)) {
+    release(); // Executable mappings refused: interpret everything
+  }
+}
+
+Jit::~Jit() { release(); }
+
+auto Jit::executable(bool run) -> bool {
+  int prot = run ? PROT_READ | PROT_EXEC : PROT_READ | PROT_WRITE;
+  return mprotect(codeBase, config.codeBytes, prot) == 0;
+}
+
+void Jit::release() {
+  if (codeBase != nullptr) {
+    munmap(codeBase, config.codeBytes);
+  }
+  codeBase = nullptr;
+  translations.clear();
+  pendingLinks.clear();
+}
+
+auto Jit::supported() -> bool { return SIM_JIT_X86_64 != 0; }
+
+auto Jit::translatable(const BasicBlock &block) -> bool {
+  if (block.instructions.empty()) {
+    return false;
+  }
+  for (MicroOp instr : block.instructions) {
+    switch (instr.type()) {
+    case InstructionType::ADD_IMM:
+    case InstructionType::SUB_IMM:
+    case InstructionType::ADD_REG:
+    case InstructionType::SUB_REG:
+    case InstructionType::LDR:
+    case InstructionType::STR:
+    case InstructionType::BRANCH:
+    case InstructionType::BRANCH_COND:
+      break;
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+auto Jit::codeBytesUsed() const -> size_t {
+  return codeBase == nullptr ? 0 : static_cast<size_t>(codeCursor - codeBase);
+}
+
+// enterStub(ctx, code): save the callee-saved registers translated code uses,
+// load them from ctx and jump to code. exitStub undoes it. Three pushes keep
+// rsp 16-byte aligned for the helper calls made from blocks.
+void Jit::emitStubs() {
+  Emitter e(codeBase);
+  enterStub = e.pos();
+  e.byte(0x53); // push rbx
+  e.byte(0x41);
+  e.byte(0x54); // push r12
+  e.byte(0x41);
+  e.byte(0x55); // push r13
+  e.mov(R12, RDI);
+  e.load(RBX, R12, CPU_OFFSET);
+  e.load(R13, R12, BUDGET_OFFSET);
+  e.byte(0xFF);
+  e.byte(0xE6); // jmp rsi
+
+  exitStub = e.pos();
+  e.store(R12, BUDGET_OFFSET, R13);
+  e.byte(0x41);
+  e.byte(0x5D); // pop r13
+  e.byte(0x41);
+  e.byte(0x5C); // pop r12
+  e.byte(0x5B); // pop rbx
+  e.byte(0xC3); // ret
+  firstBlock = e.pos();
+  codeCursor = firstBlock;
+}
+
+void Jit::flush() {
+  translations.clear();
+  pendingLinks.clear();
+  codeCursor = firstBlock;
+  jitStats.flushes++;
+}
+
+void Jit::link(uint8_t *rel32, const uint8_t *target) {
+  Emitter::patch(rel32, target);
+  jitStats.chainLinks++;
+}
+
+auto Jit::compile(const BasicBlock &block) -> const uint8_t * {
+  const auto &instructions = block.instructions;
+  size_t worst =
+      instructions.size() * MAX_INSTRUCTION_BYTES + MAX_BLOCK_OVERHEAD;
+  if (worst > static_cast<size_t>(codeEnd - firstBlock)) {
+    return nullptr;
+  }
+  if (worst > static_cast<size_t>(codeEnd - codeCursor)) {
+    flush(); // Full: start over rather than evict piecemeal
+  }
+  if (!executable(false)) {
+    return nullptr;
+  }
+  auto count = static_cast<int32_t>(instructions.size());
+  Emitter e(codeCursor);
+  uint8_t *entry = e.pos();
+
+  // Charge the whole block up front; too little budget left means the
+  // dispatcher finishes with a partial, interpreted block
+  e.alu(ALU_SUB, R13, count);
+  uint8_t *noBudget = e.jcc(CC_L);
+
+  struct Exit {
+    uint8_t *rel32;
+    uint64_t pc;
+  };
+  std::vector<Exit> chained;              // Guest PC jumps, linkable
+  std::vector<std::pair<uint8_t *, int32_t>> early; // After code writes
+  auto exit_to = [&](uint64_t pc) {
+    e.movImm(RAX, pc);
+    e.store(RBX, PC_OFFSET, RAX);
+    chained.push_back({e.jmp(), pc});
+  };
+
+  uint64_t pc = block.startPC;
+  bool ended = false;
+  for (int32_t i = 0; i < count; i++, pc += INSTRUCTION_BYTES) {
+    DecodedInstruction instr = instructions[i].unpack();
+    switch (instr.type) {
+    case InstructionType::LDR:
+      emit_ldr(e, instr);
+      break;
+    case InstructionType::STR:
+      early.emplace_back(emit_str(e, instr), i + 1);
+      break;
+    case InstructionType::BRANCH:
+      exit_to(pc + instr.imm);
+      ended = true;
+      break;
+    case InstructionType::BRANCH_COND: {
+      uint8_t *taken = emit_condition(e, instr.cond);
+      exit_to(pc + INSTRUCTION_BYTES);
+      Emitter::patch(taken, e.pos());
+      exit_to(pc + instr.imm);
+      ended = true;
+      break;
+    }
+    default:
+      emit_alu(e, instr);
+      break;
+    }
+  }
+  if (!ended) {
+    exit_to(block.endPC); // Block was cut at its size limit or before UNKNOWN
+  }
+
+  // Out-of-line exits back to the dispatcher
+  Emitter::patch(noBudget, e.pos());
+  e.alu(ALU_ADD, R13, count);
+  Emitter::patch(e.jmp(), exitStub);
+  for (const auto &stub : early) {
+    Emitter::patch(stub.first, e.pos());
+    e.movImm(RAX, block.startPC + stub.second * INSTRUCTION_BYTES);
+    e.store(RBX, PC_OFFSET, RAX);
+    e.alu(ALU_ADD, R13, count - stub.second);
+    Emitter::patch(e.jmp(), exitStub);
+  }
+  codeCursor = e.pos();
+
+  translations[block.startPC].code = entry;
+  jitStats.blocksCompiled++;
+  for (const Exit &exit : chained) {
+    auto found = translations.find(exit.pc);
+    if (found != translations.end() && found->second.code != nullptr) {
+      link(exit.rel32, found->second.code);
+    } else {
+      Emitter::patch(exit.rel32, exitStub);
+      pendingLinks[exit.pc].push_back(exit.rel32);
+    }
+  }
+  auto waiting = pendingLinks.find(block.startPC);
+  if (waiting != pendingLinks.end()) {
+    for (uint8_t *rel32 : waiting->second) {
+      link(rel32, entry);
+    }
+    pendingLinks.erase(waiting);
+  }
+  if (!executable(true)) {
+    release(); // Cannot run what was emitted: interpret from now on
+    return nullptr;
+  }
+  return entry;
+}
+
+auto Jit::runBlock(const BasicBlock &block, uint64_t budget,
+                   arm64::CPUState &cpu) -> uint64_t {
+  // Code was written since the last dispatch: translations may be stale
+  uint64_t invalidations = blocks.stats().invalidations;
+  if (invalidations != seenInvalidations) {
+    seenInvalidations = invalidations;
+    if (!translations.empty()) {
+      flush();
+    }
+  }
+
+  uint64_t length = block.instructions.size();
+  const uint8_t *code = nullptr;
+  if (codeBase != nullptr) {
+    Translation &entry = translations[block.startPC];
+    code = entry.code;
+    if (code == nullptr && !entry.rejected &&
+        ++entry.heat >= config.hotThreshold) {
+      code = translatable(block) ? compile(block) : nullptr;
+      if (code == nullptr) {
+        translations[block.startPC].rejected = true; // compile() may rehash
+        jitStats.blocksRejected++;
+      }
+    }
+  }
+  if (code == nullptr || budget < length) {
+    jitStats.interpretedRuns++;
+    return Executor::runBlock(block, std::min(budget, length), cpu, mem);
+  }
+
+  int64_t start = static_cast<int64_t>(
+      std::min<uint64_t>(budget, std::numeric_limits<int64_t>::max()));
+  JitContext ctx{&cpu, &mem, &blocks, start, invalidations};
+  reinterpret_cast<EnterFn>(const_cast<uint8_t *>(enterStub))(&ctx, code);
+  jitStats.nativeRuns++;
+  return static_cast<uint64_t>(start - ctx.budget);
+}
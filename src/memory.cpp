@@ -1,49 +1,377 @@
 #include "memory.h"
+#include <algorithm>
 
 namespace {
 // Naming constants makes the bit-masks readable
-constexpr uint32_t BYTES_IN_64BITS = 8; // 10001
-constexpr uint32_t MASK_BYTE = 0xFF;    // 5 bits
+constexpr uint32_t BITS_IN_BYTE = 8;
+constexpr uint64_t MASK_BYTE = 0xFF;
 } // namespace
 
-Memory::Memory(size_t size) {
-  storage.resize(size, 0); // allocate 'size' bytes, init to 0
+struct Memory::Directory {
+  uint64_t limit = 0;
+  std::array<std::atomic<MidTable *>, LEVEL_ENTRIES> root{};
+  // Serialises table and page creation, mapHostPage() and the view list
+  std::mutex lock;
+  std::vector<std::unique_ptr<MidTable>> mids;
+  std::vector<std::unique_ptr<LeafTable>> leaves;
+  std::vector<std::shared_ptr<void>> hostMappings; // keep-alives
+  std::atomic<uint64_t> pagesAllocated{0};
+  std::atomic<uint64_t> pagesMapped{0};
+  std::vector<Memory *> views;
+  std::atomic<size_t> viewCount{0};
+
+  // Snapshot state: pages written since the baseline, with their contents
+  // at that point (nullptr for pages that did not exist yet and so were
+  // zero). Baseline buffers are recycled through spare.
+  struct SavedPage {
+    uint64_t page;
+    PageEntry *entry;
+    std::unique_ptr<uint8_t[]> baseline;
+  };
+  std::atomic<bool> tracking{false};
+  std::vector<SavedPage> dirty;
+  std::vector<std::unique_ptr<uint8_t[]>> spare;
+};
+
+Memory::Memory(uint64_t size) : Memory(std::make_shared<Directory>()) {
+  dir->limit = std::min(size, MAX_SIZE);
+  limit = dir->limit;
 }
 
-auto Memory::readByte(uint64_t address) const -> uint8_t {
-  if (address >= storage.size()) {
-    return 0;
+Memory::Memory(std::shared_ptr<Directory> shared)
+    : dir(std::move(shared)), limit(dir->limit) {
+  std::lock_guard<std::mutex> guard(dir->lock);
+  dir->views.push_back(this);
+  dir->viewCount.store(dir->views.size(), std::memory_order_relaxed);
+}
+
+Memory::~Memory() {
+  std::lock_guard<std::mutex> guard(dir->lock);
+  auto &views = dir->views;
+  views.erase(std::find(views.begin(), views.end(), this));
+  dir->viewCount.store(views.size(), std::memory_order_relaxed);
+}
+
+auto Memory::makeView() -> std::unique_ptr<Memory> {
+  return std::unique_ptr<Memory>(new Memory(dir));
+}
+
+auto Memory::residentPages() const -> uint64_t {
+  return dir->pagesAllocated.load(std::memory_order_relaxed);
+}
+
+auto Memory::mappedPages() const -> uint64_t {
+  return dir->pagesMapped.load(std::memory_order_relaxed);
+}
+
+auto Memory::findEntry(uint64_t page) const -> const PageEntry * {
+  const MidTable *mid =
+      dir->root[page >> (2 * LEVEL_BITS)].load(std::memory_order_acquire);
+  if (mid == nullptr) {
+    return nullptr;
   }
-  return storage[address];
+  const LeafTable *leaf = mid->leaves[(page >> LEVEL_BITS) &
+                                      (LEVEL_ENTRIES - 1)]
+                              .load(std::memory_order_acquire);
+  if (leaf == nullptr) {
+    return nullptr;
+  }
+  return &leaf->pages[page & (LEVEL_ENTRIES - 1)];
 }
 
-void Memory::writeByte(uint64_t address, uint8_t value) {
-  if (address < storage.size()) {
-    storage[address] = value;
+auto Memory::touchEntry(uint64_t page) -> PageEntry & {
+  auto &midSlot = dir->root[page >> (2 * LEVEL_BITS)];
+  MidTable *mid = midSlot.load(std::memory_order_acquire);
+  if (mid == nullptr) {
+    std::lock_guard<std::mutex> guard(dir->lock);
+    mid = midSlot.load(std::memory_order_relaxed);
+    if (mid == nullptr) { // Nobody beat us to it
+      dir->mids.push_back(std::make_unique<MidTable>());
+      mid = dir->mids.back().get();
+      midSlot.store(mid, std::memory_order_release);
+    }
+  }
+  auto &leafSlot = mid->leaves[(page >> LEVEL_BITS) & (LEVEL_ENTRIES - 1)];
+  LeafTable *leaf = leafSlot.load(std::memory_order_acquire);
+  if (leaf == nullptr) {
+    std::lock_guard<std::mutex> guard(dir->lock);
+    leaf = leafSlot.load(std::memory_order_relaxed);
+    if (leaf == nullptr) {
+      dir->leaves.push_back(std::make_unique<LeafTable>());
+      leaf = dir->leaves.back().get();
+      leafSlot.store(leaf, std::memory_order_release);
+    }
   }
+  return leaf->pages[page & (LEVEL_ENTRIES - 1)];
 }
 
-auto Memory::read64(uint64_t address) const -> uint64_t {
-  // bound check
-  if ((address + BYTES_IN_64BITS) > storage.size()) {
-    return 0;
+auto Memory::pageForWrite(uint64_t page) -> uint8_t * {
+  PageEntry &entry = touchEntry(page);
+  uint8_t *data = entry.data.load(std::memory_order_acquire);
+  bool mustSave = dir->tracking.load(std::memory_order_acquire) &&
+                  !entry.saved.load(std::memory_order_acquire);
+  if (data == nullptr || mustSave) {
+    std::lock_guard<std::mutex> guard(dir->lock);
+    if (dir->tracking.load(std::memory_order_relaxed) &&
+        !entry.saved.load(std::memory_order_relaxed)) {
+      savePage(page, entry); // Before the allocation: absent means zero
+    }
+    data = entry.data.load(std::memory_order_relaxed);
+    if (data == nullptr) {
+      entry.owned = std::make_unique<uint8_t[]>(PAGE_SIZE); // zero-filled
+      data = entry.owned.get();
+      entry.data.store(data, std::memory_order_release);
+      dir->pagesAllocated.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  return data;
+}
+
+void Memory::savePage(uint64_t page, PageEntry &entry) {
+  std::unique_ptr<uint8_t[]> baseline;
+  const uint8_t *data = entry.data.load(std::memory_order_relaxed);
+  if (data != nullptr) {
+    if (dir->spare.empty()) {
+      baseline.reset(new uint8_t[PAGE_SIZE]);
+    } else {
+      baseline = std::move(dir->spare.back());
+      dir->spare.pop_back();
+    }
+    std::memcpy(baseline.get(), data, PAGE_SIZE);
+  }
+  dir->dirty.push_back({page, &entry, std::move(baseline)});
+  entry.saved.store(true, std::memory_order_release);
+}
+
+void Memory::flushAllWriteTlbs() {
+  for (Memory *view : dir->views) {
+    view->writeTlb.fill({});
+  }
+}
+
+void Memory::snapshot() {
+  std::lock_guard<std::mutex> guard(dir->lock);
+  for (auto &saved : dir->dirty) {
+    saved.entry->saved.store(false, std::memory_order_relaxed);
+    if (saved.baseline) {
+      dir->spare.push_back(std::move(saved.baseline));
+    }
+  }
+  dir->dirty.clear();
+  dir->tracking.store(true, std::memory_order_release);
+  flushAllWriteTlbs(); // First stores must reach pageForWrite() again
+}
+
+auto Memory::restore() -> bool {
+  std::vector<uint64_t> codePages;
+  {
+    std::lock_guard<std::mutex> guard(dir->lock);
+    if (!dir->tracking.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    for (auto &saved : dir->dirty) {
+      PageEntry &entry = *saved.entry;
+      uint8_t *data = entry.data.load(std::memory_order_relaxed);
+      if (saved.baseline) {
+        std::memcpy(data, saved.baseline.get(), PAGE_SIZE);
+        dir->spare.push_back(std::move(saved.baseline));
+      } else {
+        std::memset(data, 0, PAGE_SIZE);
+      }
+      entry.saved.store(false, std::memory_order_relaxed);
+      if (entry.code.load(std::memory_order_acquire)) {
+        codePages.push_back(saved.page);
+      }
+    }
+    dir->dirty.clear();
+    // Host pointers are unchanged, so read TLBs stay valid
+    flushAllWriteTlbs();
+  }
+  for (uint64_t page : codePages) {
+    notifyCodeWrite(page << PAGE_SHIFT, PAGE_SIZE);
+  }
+  return true;
+}
+
+auto Memory::dirtyPages() const -> uint64_t {
+  std::lock_guard<std::mutex> guard(dir->lock);
+  return dir->dirty.size();
+}
+
+auto Memory::mapHostPage(uint64_t address, uint8_t *host,
+                         std::shared_ptr<void> keepAlive) -> bool {
+  uint64_t page = address >> PAGE_SHIFT;
+  if (!pageInRange(page)) {
+    return false;
+  }
+  PageEntry &entry = touchEntry(page);
+  std::lock_guard<std::mutex> guard(dir->lock);
+  if (entry.data.load(std::memory_order_relaxed) != nullptr) {
+    return false;
+  }
+  entry.data.store(host, std::memory_order_release);
+  dir->pagesMapped.fetch_add(1, std::memory_order_relaxed);
+  auto &keep = dir->hostMappings;
+  if (keepAlive && (keep.empty() || keep.back() != keepAlive)) {
+    keep.push_back(std::move(keepAlive));
+  }
+  return true;
+}
+
+void Memory::setCodeWriteObserver(CodeWriteObserver *newObserver) {
+  observer = newObserver;
+}
+
+void Memory::watchCode(uint64_t address) {
+  if (address < limit) {
+    uint64_t page = address >> PAGE_SHIFT;
+    touchEntry(page).code.store(true, std::memory_order_release);
+    flushWriteTlb(page); // Stores to it must reach the observer from now on
+    staleOtherWriteTlbs(); // ... from every view
+  }
+}
+
+void Memory::staleOtherWriteTlbs() {
+  if (dir->viewCount.load(std::memory_order_relaxed) <= 1) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(dir->lock);
+  for (Memory *view : dir->views) {
+    if (view != this) {
+      view->writeTlbStale.store(true, std::memory_order_release);
+    }
+  }
+}
+
+// Slow path for stores: a write may straddle two pages, so check the page of
+// the first and of the last byte.
+void Memory::notifyCodeWrite(uint64_t address, uint64_t length) {
+  const PageEntry *first = findEntry(address >> PAGE_SHIFT);
+  const PageEntry *last = findEntry((address + length - 1) >> PAGE_SHIFT);
+  if ((first != nullptr && first->code.load(std::memory_order_acquire)) ||
+      (last != nullptr && last->code.load(std::memory_order_acquire))) {
+    if (observer != nullptr) {
+      observer->onCodeWrite(address, length);
+    }
+    postToOtherViews(address, length);
+  }
+}
+
+void Memory::postToOtherViews(uint64_t address, uint64_t length) {
+  if (dir->viewCount.load(std::memory_order_relaxed) <= 1) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(dir->lock);
+  for (Memory *view : dir->views) {
+    if (view == this) {
+      continue;
+    }
+    std::lock_guard<std::mutex> queued(view->remoteLock);
+    view->remoteWrites.emplace_back(address, length);
+    view->remoteWritesPending.store(true, std::memory_order_release);
+  }
+}
+
+void Memory::drainRemoteWrites() {
+  std::vector<std::pair<uint64_t, uint64_t>> writes;
+  {
+    std::lock_guard<std::mutex> guard(remoteLock);
+    writes.swap(remoteWrites);
+    remoteWritesPending.store(false, std::memory_order_relaxed);
+  }
+  if (observer == nullptr) {
+    return;
   }
-  // make sure give base address is low address : little endian
+  for (const auto &write : writes) {
+    observer->onCodeWrite(write.first, write.second);
+  }
+}
+
+// Little-endian load of `length` bytes. One directory walk when the access
+// stays inside a page, a walk per byte when it straddles two.
+auto Memory::readLE(uint64_t address, uint32_t length) const -> uint64_t {
   uint64_t value = 0;
-  for (int i = 0; i < BYTES_IN_64BITS; i++) {
-    value |= (((uint64_t)storage[address + i]) << (i * BYTES_IN_64BITS));
+  uint64_t offset = address & (PAGE_SIZE - 1);
+  if (offset + length <= PAGE_SIZE) {
+    const PageEntry *entry = findEntry(address >> PAGE_SHIFT);
+    const uint8_t *data = (entry == nullptr)
+                              ? nullptr
+                              : entry->data.load(std::memory_order_acquire);
+    if (data == nullptr) {
+      return 0; // Never written
+    }
+    const uint8_t *bytes = data + offset;
+    for (uint32_t i = 0; i < length; i++) {
+      value |= static_cast<uint64_t>(bytes[i]) << (i * BITS_IN_BYTE);
+    }
+    return value;
+  }
+  for (uint32_t i = 0; i < length; i++) {
+    value |= static_cast<uint64_t>(read<uint8_t>(address + i))
+             << (i * BITS_IN_BYTE);
   }
   return value;
 }
 
-void Memory::write64(uint64_t address, uint64_t value) {
+void Memory::writeLE(uint64_t address, uint32_t length, uint64_t value) {
+  uint64_t offset = address & (PAGE_SIZE - 1);
+  if (offset + length <= PAGE_SIZE) {
+    uint8_t *bytes = pageForWrite(address >> PAGE_SHIFT) + offset;
+    for (uint32_t i = 0; i < length; i++) {
+      bytes[i] = (value >> (i * BITS_IN_BYTE)) & MASK_BYTE;
+    }
+  } else {
+    for (uint32_t i = 0; i < length; i++) {
+      uint64_t byteAddr = address + i;
+      pageForWrite(byteAddr >> PAGE_SHIFT)[byteAddr & (PAGE_SIZE - 1)] =
+          (value >> (i * BITS_IN_BYTE)) & MASK_BYTE;
+    }
+  }
+  notifyCodeWrite(address, length);
+}
+
+auto Memory::readSlow(uint64_t address, uint32_t length) const -> uint64_t {
+  // bound check
+  if (!fits(address, length)) {
+    return 0;
+  }
+  uint64_t page = address >> PAGE_SHIFT;
+  const PageEntry *entry = findEntry(page);
+  if (entry != nullptr && pageInRange(page)) {
+    uint8_t *data = entry->data.load(std::memory_order_acquire);
+    if (data != nullptr) {
+      readTlb[tlbSlot(page)] = {page, data};
+    }
+  }
+  return readLE(address, length);
+}
+
+void Memory::writeSlow(uint64_t address, uint32_t length, uint64_t value) {
   // Bound check
-  if (address + BYTES_IN_64BITS > storage.size()) {
+  if (!fits(address, length)) {
     return;
   }
+  // Another view started watching a page; any entry may now be code
+  if (writeTlbStale.exchange(false, std::memory_order_acq_rel)) {
+    writeTlb.fill({});
+  }
+  writeLE(address, length, value);
+  // The page is resident now; cache it for both directions unless stores to
+  // it have to be reported to the code observer
+  uint64_t page = address >> PAGE_SHIFT;
+  PageEntry &entry = touchEntry(page);
+  if (pageInRange(page)) {
+    uint8_t *data = entry.data.load(std::memory_order_acquire);
+    readTlb[tlbSlot(page)] = {page, data};
+    if (!entry.code.load(std::memory_order_acquire)) {
+      writeTlb[tlbSlot(page)] = {page, data};
+    }
+  }
+}
 
-  // Little Endian : reconstruct the 64-bit word
-  for (int i = 0; i < BYTES_IN_64BITS; ++i) {
-    storage[address + i] = (value >> (i * BYTES_IN_64BITS)) & MASK_BYTE;
+void Memory::flushWriteTlb(uint64_t page) {
+  TlbEntry &entry = writeTlb[tlbSlot(page)];
+  if (entry.page == page) {
+    entry = {};
   }
 }
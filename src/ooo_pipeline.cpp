@@ -0,0 +1,323 @@
+#include "ooo_pipeline.h"
+#include "registers.h"
+#include <algorithm>
+#include <ostream>
+
+namespace {
+constexpr size_t REPORTED_HINTS = 5;
+
+auto is_alu(InstructionType type) -> bool {
+  return type == InstructionType::ADD_IMM ||
+         type == InstructionType::SUB_IMM ||
+         type == InstructionType::ADD_REG || type == InstructionType::SUB_REG;
+}
+
+auto ooo_setter(OutOfOrderConfig &config) -> config_file::Setter {
+  return [&config](const std::string &key, const std::string &value) {
+    if (key == "fetch_width") {
+      return config_file::set_count(key, value, config.fetchWidth, 1);
+    }
+    if (key == "issue_width") {
+      return config_file::set_count(key, value, config.issueWidth, 1);
+    }
+    if (key == "retire_width") {
+      return config_file::set_count(key, value, config.retireWidth, 1);
+    }
+    if (key == "rob_size") {
+      return config_file::set_count(key, value, config.robSize, 1);
+    }
+    if (key == "rs_size") {
+      return config_file::set_count(key, value, config.rsSize, 1);
+    }
+    if (key == "frontend_stages") {
+      return config_file::set_count(key, value, config.frontendStages);
+    }
+    if (key == "mispredict_penalty") {
+      return config_file::set_count(key, value, config.mispredictPenalty);
+    }
+    if (config_file::is_latency_key(key)) {
+      return config_file::set_latency(key, value, config.latency);
+    }
+    return "unknown key " + key;
+  };
+}
+} // namespace
+
+auto OutOfOrderConfig::load(const std::string &path, std::string &error)
+    -> bool {
+  return config_file::load(path, error, ooo_setter(*this));
+}
+
+auto OutOfOrderConfig::parse(std::istream &in, std::string &error) -> bool {
+  return config_file::parse(in, error, ooo_setter(*this));
+}
+
+auto OutOfOrderStats::ipc() const -> double {
+  if (cycles == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(instructions) / static_cast<double>(cycles);
+}
+
+OutOfOrderPipeline::OutOfOrderPipeline(
+    OutOfOrderConfig config, std::unique_ptr<DirectionPredictor> predictor)
+    : coreConfig(config) {
+  reset();
+  this->predictor = std::move(predictor); // Keeps any training it has
+}
+
+void OutOfOrderPipeline::reset() {
+  if (predictor) {
+    predictor->reset();
+  }
+  rename.fill({});
+  fetchCycle = 0;
+  fetched = 0;
+  dispatchCycle = 0;
+  dispatched = 0;
+  retireCycle = 0;
+  retiredInCycle = 0;
+  robRetire.assign(coreConfig.robSize, 0);
+  sequence = 0;
+  rs = {};
+  // Every pending issue lies within a dependence chain through the ROB of
+  // the oldest dispatch cycle that can still be scheduled against
+  uint32_t slowest =
+      *std::max_element(coreConfig.latency.begin(), coreConfig.latency.end());
+  uint64_t span =
+      2 * uint64_t{coreConfig.robSize + coreConfig.rsSize} * (slowest + 1);
+  size_t window = 64;
+  while (window < span) {
+    window *= 2;
+  }
+  issueSlots.assign(window, {});
+  blame.clear();
+  coreStats = {};
+}
+
+auto OutOfOrderPipeline::fetch() -> uint64_t {
+  if (fetched == coreConfig.fetchWidth) {
+    fetchCycle++;
+    fetched = 0;
+  }
+  fetched++;
+  return fetchCycle;
+}
+
+auto OutOfOrderPipeline::dispatch(uint64_t earliest) -> uint64_t {
+  // In order, fetchWidth per cycle
+  uint64_t cycle = std::max(earliest, dispatchCycle);
+  if (cycle == dispatchCycle && dispatched == coreConfig.fetchWidth) {
+    cycle++;
+  }
+  // A ROB entry frees the cycle after its instruction retires
+  if (sequence >= coreConfig.robSize) {
+    uint64_t free = robRetire[sequence % coreConfig.robSize] + 1;
+    if (free > cycle) {
+      coreStats.robFullCycles += free - cycle;
+      cycle = free;
+    }
+  }
+  // A reservation station frees the cycle after its instruction issues
+  while (!rs.empty() && rs.top() < cycle) {
+    rs.pop();
+  }
+  if (rs.size() >= coreConfig.rsSize) {
+    uint64_t free = rs.top() + 1;
+    coreStats.rsFullCycles += free - cycle;
+    cycle = free;
+    while (!rs.empty() && rs.top() < cycle) {
+      rs.pop();
+    }
+  }
+  if (cycle > dispatchCycle) {
+    dispatchCycle = cycle;
+    dispatched = 0;
+  }
+  dispatched++;
+  return cycle;
+}
+
+auto OutOfOrderPipeline::issue(uint64_t ready) -> uint64_t {
+  size_t mask = issueSlots.size() - 1;
+  for (uint64_t cycle = ready;; cycle++) {
+    IssueSlot &slot = issueSlots[cycle & mask];
+    if (slot.cycle != cycle) {
+      slot = {cycle, 0};
+    }
+    if (slot.used < coreConfig.issueWidth) {
+      slot.used++;
+      return cycle;
+    }
+  }
+}
+
+auto OutOfOrderPipeline::retire(uint64_t complete) -> uint64_t {
+  uint64_t cycle = std::max(complete, retireCycle);
+  if (cycle == retireCycle && retiredInCycle == coreConfig.retireWidth) {
+    cycle++;
+  }
+  if (cycle > retireCycle) {
+    retireCycle = cycle;
+    retiredInCycle = 0;
+  }
+  retiredInCycle++;
+  return cycle;
+}
+
+void OutOfOrderPipeline::waitFor(size_t slot, uint64_t &ready,
+                                 const Producer *&late) const {
+  if (rename[slot].ready > ready) {
+    ready = rename[slot].ready;
+    late = &rename[slot];
+  }
+}
+
+void OutOfOrderPipeline::onRetire(const RetiredInstruction &retired) {
+  const DecodedInstruction &instr = *retired.instr;
+  uint64_t fetchedAt = fetch();
+  uint64_t dispatchedAt = dispatch(fetchedAt + coreConfig.frontendStages);
+  // Fetch stalls while dispatch is blocked (no fetch buffer beyond the
+  // front-end stages)
+  if (dispatchedAt - coreConfig.frontendStages > fetchCycle) {
+    fetchCycle = dispatchedAt - coreConfig.frontendStages;
+    fetched = 1;
+  }
+
+  // Source operands, through the rename table
+  uint64_t earliest = dispatchedAt + 1;
+  uint64_t ready = earliest;
+  const Producer *late = nullptr;
+  bool memory = instr.type == InstructionType::LDR ||
+                instr.type == InstructionType::STR;
+  if (is_alu(instr.type)) {
+    if (instr.rn != arm64::REG_XZR) {
+      waitFor(instr.rn, ready, late);
+    }
+    bool reg = instr.type == InstructionType::ADD_REG ||
+               instr.type == InstructionType::SUB_REG;
+    if (reg && instr.rm != arm64::REG_XZR) {
+      waitFor(instr.rm, ready, late);
+    }
+  } else if (memory) {
+    waitFor(instr.rn, ready, late); // Slot 31 is SP
+    if (instr.type == InstructionType::STR) {
+      waitFor(instr.rd, ready, late); // Stored value; 31 stores SP
+    }
+  } else if (instr.type == InstructionType::BRANCH_COND) {
+    waitFor(FLAGS, ready, late);
+  }
+  if (late != nullptr) {
+    uint64_t wait = ready - earliest;
+    if (late == &rename[FLAGS]) {
+      coreStats.flagWaitCycles += wait;
+    } else if (late->load) {
+      coreStats.loadWaitCycles += wait;
+    } else {
+      coreStats.dataWaitCycles += wait;
+    }
+    CriticalPathHint &hint = blame[late->pc];
+    hint.pc = late->pc;
+    hint.type = late->type;
+    hint.cycles += wait;
+    hint.count++;
+  }
+
+  uint64_t issuedAt = issue(ready);
+  coreStats.issueConflictCycles += issuedAt - ready;
+  rs.push(issuedAt);
+  uint64_t complete =
+      issuedAt + coreConfig.latency[static_cast<size_t>(instr.type)];
+
+  // Results get a fresh physical register: only later readers see them
+  if (is_alu(instr.type)) {
+    if (instr.rd != arm64::REG_XZR) {
+      rename[instr.rd] = {complete, retired.pc, instr.type, false};
+    }
+    if (instr.setFlags) {
+      rename[FLAGS] = {complete, retired.pc, instr.type, false};
+    }
+  } else if (memory) {
+    if (instr.mode == AddrMode::PreIndex ||
+        instr.mode == AddrMode::PostIndex) {
+      // The base register writeback is an address add: ADD_IMM's latency
+      uint32_t writeback =
+          coreConfig.latency[static_cast<size_t>(InstructionType::ADD_IMM)];
+      rename[instr.rn] = {issuedAt + writeback, retired.pc, instr.type, false};
+    }
+    if (instr.type == InstructionType::LDR && instr.rd != arm64::REG_XZR) {
+      rename[instr.rd] = {complete, retired.pc, instr.type, true};
+    }
+  }
+
+  uint64_t retiredAt = retire(complete);
+  robRetire[sequence % coreConfig.robSize] = retiredAt;
+  sequence++;
+
+  // Front-end redirects
+  if (instr.type == InstructionType::BRANCH_COND) {
+    coreStats.branches++;
+    bool predictTaken = retired.address <= retired.pc; // Backward
+    if (predictor) {
+      predictTaken = predictor->predict(retired.pc);
+      predictor->update(retired.pc, retired.taken);
+    }
+    if (predictTaken != retired.taken) {
+      coreStats.mispredicts++;
+      uint64_t resume = complete + coreConfig.mispredictPenalty;
+      if (resume > fetchCycle + 1) {
+        coreStats.fetchRedirectCycles += resume - (fetchCycle + 1);
+        fetchCycle = resume;
+      } else {
+        fetchCycle++;
+      }
+      fetched = 0;
+    } else if (retired.taken) {
+      fetchCycle++; // A taken branch ends the fetch group
+      fetched = 0;
+    }
+  } else if (instr.type == InstructionType::BRANCH) {
+    fetchCycle++;
+    fetched = 0;
+  }
+
+  coreStats.instructions++;
+  coreStats.cycles = retiredAt + 1;
+}
+
+auto OutOfOrderPipeline::hints(size_t count) const
+    -> std::vector<CriticalPathHint> {
+  std::vector<CriticalPathHint> all;
+  all.reserve(blame.size());
+  for (const auto &entry : blame) {
+    all.push_back(entry.second);
+  }
+  count = std::min(count, all.size());
+  std::partial_sort(all.begin(), all.begin() + count, all.end(),
+                    [](const CriticalPathHint &a, const CriticalPathHint &b) {
+                      return a.cycles != b.cycles ? a.cycles > b.cycles
+                                                  : a.pc < b.pc;
+                    });
+  all.resize(count);
+  return all;
+}
+
+auto OutOfOrderPipeline::report(std::ostream &out) const -> void {
+  out << "cycles:               " << coreStats.cycles << "\n"
+      << "instructions:         " << coreStats.instructions << "\n"
+      << "IPC:                  " << coreStats.ipc() << "\n"
+      << "mispredicts:          " << coreStats.mispredicts << " of "
+      << coreStats.branches << " B.cond\n"
+      << "fetch redirect:       " << coreStats.fetchRedirectCycles << "\n"
+      << "ROB full:             " << coreStats.robFullCycles << "\n"
+      << "RS full:              " << coreStats.rsFullCycles << "\n"
+      << "data waits:           " << coreStats.dataWaitCycles << "\n"
+      << "load waits:           " << coreStats.loadWaitCycles << "\n"
+      << "flag waits:           " << coreStats.flagWaitCycles << "\n"
+      << "issue conflicts:      " << coreStats.issueConflictCycles << "\n";
+  for (const CriticalPathHint &hint : hints(REPORTED_HINTS)) {
+    out << "critical producer:    0x" << std::hex << hint.pc << std::dec
+        << " " << Decoder::typeName(hint.type) << " delayed " << hint.count
+        << " dependents by " << hint.cycles << " cycles\n";
+  }
+}
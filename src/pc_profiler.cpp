@@ -0,0 +1,121 @@
+#include "pc_profiler.h"
+#include <algorithm>
+#include <map>
+#include <ostream>
+#include <sstream>
+
+namespace {
+constexpr double PERCENT = 100.0;
+
+auto share(uint64_t count, uint64_t total) -> double {
+  return total > 0 ? PERCENT * static_cast<double>(count) /
+                         static_cast<double>(total)
+                   : 0.0;
+}
+
+auto hex(uint64_t value) -> std::string {
+  std::ostringstream text;
+  text << "0x" << std::hex << value;
+  return text.str();
+}
+
+// Sort (key, count) pairs by count, highest first, then by key
+template <typename Key>
+void sort_hottest(std::vector<std::pair<Key, uint64_t>> &entries) {
+  std::sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) {
+    return a.second != b.second ? a.second > b.second : a.first < b.first;
+  });
+}
+} // namespace
+
+PcProfiler::PcProfiler(uint64_t period)
+    : samplePeriod(std::max<uint64_t>(period, 1)), untilSample(samplePeriod) {
+}
+
+auto PcProfiler::run(Simulator &sim, const arm64::CPUState &cpu,
+                     uint64_t max_instructions) -> StopReason {
+  uint64_t left = max_instructions;
+  StopReason reason = StopReason::InstructionLimit;
+  while (left > 0 && reason == StopReason::InstructionLimit) {
+    uint64_t before = sim.stats().instructions;
+    reason = sim.run(std::min(untilSample, left));
+    uint64_t executed = sim.stats().instructions - before;
+    left -= executed;
+    untilSample -= executed;
+    if (untilSample == 0) {
+      sample(cpu.PC);
+      untilSample = samplePeriod;
+    }
+  }
+  return reason;
+}
+
+auto PcProfiler::hottest(size_t count) const
+    -> std::vector<std::pair<uint64_t, uint64_t>> {
+  std::vector<std::pair<uint64_t, uint64_t>> ranked(histogram.begin(),
+                                                    histogram.end());
+  sort_hottest(ranked);
+  ranked.resize(std::min(count, ranked.size()));
+  return ranked;
+}
+
+void PcProfiler::reset() {
+  histogram.clear();
+  sampleCount = 0;
+  untilSample = samplePeriod;
+}
+
+auto PcProfiler::symbolize(uint64_t pc, const ElfImage *symbols)
+    -> std::string {
+  const ElfSymbol *symbol =
+      symbols != nullptr ? symbols->symbolFor(pc) : nullptr;
+  if (symbol == nullptr) {
+    return hex(pc);
+  }
+  uint64_t offset = pc - symbol->value;
+  return offset == 0 ? symbol->name : symbol->name + "+" + hex(offset);
+}
+
+auto PcProfiler::report(std::ostream &out, const ElfImage *symbols,
+                        size_t top) const -> void {
+  out << "samples:              " << sampleCount << " (every "
+      << samplePeriod << " instructions)\n";
+  if (symbols != nullptr && symbols->symbols().empty()) {
+    symbols = nullptr; // Stripped: raw addresses only
+  }
+  if (symbols != nullptr) {
+    std::map<std::string, uint64_t> byFunction;
+    for (const auto &[pc, count] : histogram) {
+      const ElfSymbol *symbol = symbols->symbolFor(pc);
+      byFunction[symbol != nullptr ? symbol->name : "[unknown]"] += count;
+    }
+    std::vector<std::pair<std::string, uint64_t>> functions(
+        byFunction.begin(), byFunction.end());
+    sort_hottest(functions);
+    functions.resize(std::min(top, functions.size()));
+    for (const auto &[name, count] : functions) {
+      out << "hot function:         " << name << " " << count << " ("
+          << share(count, sampleCount) << "%)\n";
+    }
+  }
+  for (const auto &[pc, count] : hottest(top)) {
+    out << "hot pc:               " << hex(pc);
+    if (symbols != nullptr && symbols->symbolFor(pc) != nullptr) {
+      out << " " << symbolize(pc, symbols);
+    }
+    out << " " << count << " (" << share(count, sampleCount) << "%)\n";
+  }
+}
+
+auto PcProfiler::writeFolded(std::ostream &out,
+                             const ElfImage *symbols) const -> void {
+  std::map<uint64_t, uint64_t> ordered(histogram.begin(), histogram.end());
+  for (const auto &[pc, count] : ordered) {
+    const ElfSymbol *symbol =
+        symbols != nullptr ? symbols->symbolFor(pc) : nullptr;
+    if (symbol != nullptr) {
+      out << symbol->name << ";";
+    }
+    out << symbolize(pc, symbols) << " " << count << "\n";
+  }
+}
@@ -0,0 +1,149 @@
+#include "pipeline_model.h"
+#include "registers.h"
+#include <ostream>
+
+namespace {
+auto is_alu(InstructionType type) -> bool {
+  return type == InstructionType::ADD_IMM ||
+         type == InstructionType::SUB_IMM ||
+         type == InstructionType::ADD_REG || type == InstructionType::SUB_REG;
+}
+
+auto pipeline_setter(PipelineConfig &config) -> config_file::Setter {
+  return [&config](const std::string &key, const std::string &value) {
+    if (key == "stages") {
+      return config_file::set_count(key, value, config.stages, 2);
+    }
+    if (key == "flag_latency") {
+      return config_file::set_count(key, value, config.flagLatency);
+    }
+    if (key == "branch_penalty") {
+      return config_file::set_count(key, value, config.branchPenalty);
+    }
+    if (key == "taken_branch_penalty") {
+      return config_file::set_count(key, value, config.takenBranchPenalty);
+    }
+    if (config_file::is_latency_key(key)) {
+      return config_file::set_latency(key, value, config.latency);
+    }
+    return "unknown key " + key;
+  };
+}
+} // namespace
+
+auto PipelineConfig::load(const std::string &path, std::string &error)
+    -> bool {
+  return config_file::load(path, error, pipeline_setter(*this));
+}
+
+auto PipelineConfig::parse(std::istream &in, std::string &error) -> bool {
+  return config_file::parse(in, error, pipeline_setter(*this));
+}
+
+auto PipelineStats::cpi() const -> double {
+  if (instructions == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(cycles) / static_cast<double>(instructions);
+}
+
+InOrderPipeline::InOrderPipeline(PipelineConfig config)
+    : pipelineConfig(config) {}
+
+void InOrderPipeline::reset() {
+  ready.fill(0);
+  loaded.fill(false);
+  flagsReady = 0;
+  nextIssue = 0;
+  pipelineStats = {};
+}
+
+void InOrderPipeline::waitFor(size_t slot, uint64_t &issue,
+                              bool &fromLoad) const {
+  if (ready[slot] > issue) {
+    issue = ready[slot];
+    fromLoad = loaded[slot];
+  }
+}
+
+void InOrderPipeline::onRetire(const RetiredInstruction &retired) {
+  const DecodedInstruction &instr = *retired.instr;
+  auto type = static_cast<size_t>(instr.type);
+  uint64_t earliest = nextIssue;
+  uint64_t issue = earliest;
+  bool fromLoad = false;
+
+  // Source operands
+  bool memory = instr.type == InstructionType::LDR ||
+                instr.type == InstructionType::STR;
+  if (is_alu(instr.type)) {
+    if (instr.rn != arm64::REG_XZR) {
+      waitFor(instr.rn, issue, fromLoad);
+    }
+    bool reg = instr.type == InstructionType::ADD_REG ||
+               instr.type == InstructionType::SUB_REG;
+    if (reg && instr.rm != arm64::REG_XZR) {
+      waitFor(instr.rm, issue, fromLoad);
+    }
+  } else if (memory) {
+    waitFor(instr.rn, issue, fromLoad); // Slot 31 is SP
+    if (instr.type == InstructionType::STR) {
+      waitFor(instr.rd, issue, fromLoad); // Stored value; 31 stores SP
+    }
+  }
+  if (issue > earliest) {
+    (fromLoad ? pipelineStats.loadUseStalls : pipelineStats.dataStalls) +=
+        issue - earliest;
+  }
+  if (instr.type == InstructionType::BRANCH_COND && flagsReady > issue) {
+    pipelineStats.flagStalls += flagsReady - issue;
+    issue = flagsReady;
+  }
+
+  // Results
+  if (is_alu(instr.type)) {
+    if (instr.rd != arm64::REG_XZR) {
+      ready[instr.rd] = issue + pipelineConfig.latency[type];
+      loaded[instr.rd] = false;
+    }
+    if (instr.setFlags) {
+      flagsReady = issue + pipelineConfig.flagLatency;
+    }
+  } else if (memory) {
+    if (instr.mode == AddrMode::PreIndex ||
+        instr.mode == AddrMode::PostIndex) {
+      // The base register writeback is an address add: ADD_IMM's latency
+      ready[instr.rn] =
+          issue +
+          pipelineConfig.latency[static_cast<size_t>(InstructionType::ADD_IMM)];
+      loaded[instr.rn] = false;
+    }
+    if (instr.type == InstructionType::LDR && instr.rd != arm64::REG_XZR) {
+      ready[instr.rd] = issue + pipelineConfig.latency[type];
+      loaded[instr.rd] = true;
+    }
+  }
+
+  nextIssue = issue + 1;
+  uint64_t penalty = 0;
+  if (instr.type == InstructionType::BRANCH) {
+    penalty = pipelineConfig.branchPenalty;
+  } else if (instr.type == InstructionType::BRANCH_COND && retired.taken) {
+    penalty = pipelineConfig.takenBranchPenalty;
+  }
+  nextIssue += penalty;
+  pipelineStats.branchPenaltyCycles += penalty;
+  pipelineStats.instructions++;
+  pipelineStats.cycles = issue + pipelineConfig.stages;
+}
+
+auto InOrderPipeline::report(std::ostream &out) const -> void {
+  out << "cycles:               " << pipelineStats.cycles << "\n"
+      << "instructions:         " << pipelineStats.instructions << "\n"
+      << "CPI:                  " << pipelineStats.cpi() << "\n"
+      << "load-use stalls:      " << pipelineStats.loadUseStalls << "\n"
+      << "data stalls:          " << pipelineStats.dataStalls << "\n"
+      << "flag stalls:          " << pipelineStats.flagStalls << "\n"
+      << "branch penalties:     " << pipelineStats.branchPenaltyCycles
+      << "\n";
+}
@@ -0,0 +1,82 @@
+#include "pmu.h"
+#include <ostream>
+#include <sstream>
+
+namespace {
+// JSON keys of the load/store addressing modes, by AddrMode
+constexpr std::array<const char *, ADDR_MODE_COUNT> MODE_KEYS = {
+    nullptr, "offset", "pre_index", "post_index"};
+
+void write_modes(std::ostream &out,
+                 const std::array<uint64_t, ADDR_MODE_COUNT> &counts) {
+  out << "{";
+  for (size_t mode = 1; mode < ADDR_MODE_COUNT; mode++) {
+    out << (mode > 1 ? "," : "") << "\"" << MODE_KEYS[mode]
+        << "\":" << counts[mode];
+  }
+  out << "}";
+}
+} // namespace
+
+thread_local PmuCounters *PmuCounters::threadSink = nullptr;
+
+void PmuCounters::attach(PmuCounters *counters) { threadSink = counters; }
+
+auto PmuCounters::instructions() const -> uint64_t {
+  uint64_t total = 0;
+  for (uint64_t count : retired) {
+    total += count;
+  }
+  return total;
+}
+
+auto PmuCounters::since(const PmuCounters &earlier) const -> PmuCounters {
+  PmuCounters delta = *this;
+  for (size_t i = 0; i < INSTRUCTION_TYPE_COUNT; i++) {
+    delta.retired[i] -= earlier.retired[i];
+  }
+  for (size_t i = 0; i < ADDR_MODE_COUNT; i++) {
+    delta.loads[i] -= earlier.loads[i];
+    delta.stores[i] -= earlier.stores[i];
+  }
+  delta.branchesTaken -= earlier.branchesTaken;
+  delta.branchesNotTaken -= earlier.branchesNotTaken;
+  delta.flagSetting -= earlier.flagSetting;
+  return delta;
+}
+
+auto PmuCounters::operator+=(const PmuCounters &other) -> PmuCounters & {
+  for (size_t i = 0; i < INSTRUCTION_TYPE_COUNT; i++) {
+    retired[i] += other.retired[i];
+  }
+  for (size_t i = 0; i < ADDR_MODE_COUNT; i++) {
+    loads[i] += other.loads[i];
+    stores[i] += other.stores[i];
+  }
+  branchesTaken += other.branchesTaken;
+  branchesNotTaken += other.branchesNotTaken;
+  flagSetting += other.flagSetting;
+  return *this;
+}
+
+auto PmuCounters::json() const -> std::string {
+  std::ostringstream out;
+  writeJson(out);
+  return out.str();
+}
+
+auto PmuCounters::writeJson(std::ostream &out) const -> void {
+  out << "{\"instructions\":" << instructions() << ",\"retired\":{";
+  for (size_t type = 0; type < INSTRUCTION_TYPE_COUNT; type++) {
+    out << (type > 0 ? "," : "") << "\""
+        << Decoder::typeName(static_cast<InstructionType>(type))
+        << "\":" << retired[type];
+  }
+  out << "},\"loads\":";
+  write_modes(out, loads);
+  out << ",\"stores\":";
+  write_modes(out, stores);
+  out << ",\"branches\":{\"taken\":" << branchesTaken
+      << ",\"not_taken\":" << branchesNotTaken
+      << "},\"flag_setting\":" << flagSetting << "}";
+}
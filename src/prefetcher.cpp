@@ -0,0 +1,303 @@
+#include "prefetcher.h"
+#include <algorithm>
+#include <ostream>
+
+namespace {
+constexpr uint8_t MAX_CONFIDENCE = 3;
+constexpr uint8_t PREFETCH_CONFIDENCE = 2;
+
+auto ratio(uint64_t part, uint64_t whole) -> double {
+  if (whole == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(part) / static_cast<double>(whole);
+}
+
+auto line_shift(uint32_t lineBytes) -> uint32_t {
+  uint32_t shift = 0;
+  while ((uint64_t{1} << shift) < lineBytes) {
+    shift++;
+  }
+  return shift;
+}
+
+auto prefetch_setter(PrefetchConfig &config) -> config_file::Setter {
+  return [&config](const std::string &key,
+                   const std::string &value) -> std::string {
+    if (key == "prefetcher") {
+      if (value == "next_line") {
+        config.kind = PrefetcherKind::NextLine;
+      } else if (value == "stride") {
+        config.kind = PrefetcherKind::Stride;
+      } else if (value == "stream") {
+        config.kind = PrefetcherKind::Stream;
+      } else {
+        return "value of prefetcher must be next_line, stride or stream";
+      }
+      return "";
+    }
+    if (key == "degree") {
+      return config_file::set_count(key, value, config.degree, 1);
+    }
+    if (key == "table_entries") {
+      return config_file::set_count(key, value, config.tableEntries, 1);
+    }
+    if (key == "streams") {
+      return config_file::set_count(key, value, config.streams, 1);
+    }
+    if (key == "depth") {
+      return config_file::set_count(key, value, config.depth, 1);
+    }
+    if (key == "latency") {
+      return config_file::set_count(key, value, config.latency);
+    }
+    return "unknown key " + key;
+  };
+}
+
+// The L1D a PrefetchModel measures against
+auto model_cache(const PrefetchConfig &config, const CacheHierarchy *warm)
+    -> CacheConfig {
+  if (warm != nullptr && warm->level(CacheLevel::L1D) != nullptr) {
+    return warm->level(CacheLevel::L1D)->config();
+  }
+  return config.cache;
+}
+} // namespace
+
+void NextLinePrefetcher::observe(const PrefetchAccess &access,
+                                 std::vector<uint64_t> &lines) {
+  if (access.miss || access.prefetchHit) {
+    for (uint32_t ahead = 1; ahead <= degree; ahead++) {
+      lines.push_back(access.line + ahead);
+    }
+  }
+}
+
+StridePrefetcher::StridePrefetcher(uint32_t entries, uint32_t degree,
+                                   uint32_t lineBytes)
+    : table(entries), degree(degree), lineShift(line_shift(lineBytes)) {}
+
+void StridePrefetcher::reset() { table.assign(table.size(), {}); }
+
+void StridePrefetcher::observe(const PrefetchAccess &access,
+                               std::vector<uint64_t> &lines) {
+  Entry &entry = table[(access.pc >> 2) % table.size()];
+  if (!entry.valid || entry.pc != access.pc) {
+    entry = {access.pc, access.address, 0, 0, true};
+    return;
+  }
+  auto delta = static_cast<int64_t>(access.address - entry.last);
+  entry.last = access.address;
+  if (delta == entry.stride) {
+    entry.confidence =
+        std::min<uint8_t>(entry.confidence + 1, MAX_CONFIDENCE);
+  } else if (entry.confidence > 0) {
+    entry.confidence--;
+  } else {
+    entry.stride = delta;
+  }
+  if (entry.confidence < PREFETCH_CONFIDENCE || entry.stride == 0) {
+    return;
+  }
+  // Strides shorter than a line step a whole line at a time
+  int64_t step = entry.stride;
+  auto lineBytes = static_cast<int64_t>(uint64_t{1} << lineShift);
+  if (step > -lineBytes && step < lineBytes) {
+    step = step > 0 ? lineBytes : -lineBytes;
+  }
+  for (uint32_t ahead = 1; ahead <= degree; ahead++) {
+    uint64_t target = access.address + static_cast<uint64_t>(step * ahead);
+    lines.push_back(target >> lineShift);
+  }
+}
+
+StreamPrefetcher::StreamPrefetcher(uint32_t streams, uint32_t depth)
+    : buffers(streams), depth(depth) {}
+
+void StreamPrefetcher::reset() {
+  buffers.assign(buffers.size(), {});
+  lastMiss = 0;
+  clock = 0;
+}
+
+void StreamPrefetcher::fill(Stream &stream,
+                            std::vector<uint64_t> &lines) const {
+  // Lines from head (inclusive) up to depth ahead of it, in direction
+  auto ahead = [&] {
+    return static_cast<int64_t>(stream.next - stream.head) * stream.direction;
+  };
+  if (ahead() < 0) {
+    stream.next = stream.head;
+  }
+  while (ahead() < static_cast<int64_t>(depth)) {
+    lines.push_back(stream.next);
+    stream.next += static_cast<uint64_t>(stream.direction);
+  }
+}
+
+void StreamPrefetcher::observe(const PrefetchAccess &access,
+                               std::vector<uint64_t> &lines) {
+  clock++;
+  for (Stream &stream : buffers) {
+    auto offset =
+        static_cast<int64_t>(access.line - stream.head) * stream.direction;
+    if (stream.valid && offset >= 0 && offset < static_cast<int64_t>(depth)) {
+      stream.head = access.line + static_cast<uint64_t>(stream.direction);
+      stream.lastUse = clock;
+      fill(stream, lines);
+      return;
+    }
+  }
+  if (!access.miss) {
+    return;
+  }
+  int64_t direction = lastMiss == access.line + 1 ? -1 : 1;
+  lastMiss = access.line;
+  Stream &stream = *std::min_element(
+      buffers.begin(), buffers.end(), [](const Stream &a, const Stream &b) {
+        return a.valid != b.valid ? !a.valid : a.lastUse < b.lastUse;
+      });
+  uint64_t head = access.line + static_cast<uint64_t>(direction);
+  stream = {head, head, direction, clock, true};
+  fill(stream, lines);
+}
+
+auto PrefetchConfig::load(const std::string &path, std::string &error)
+    -> bool {
+  return config_file::load(path, error, prefetch_setter(*this));
+}
+
+auto PrefetchConfig::parse(std::istream &in, std::string &error) -> bool {
+  return config_file::parse(in, error, prefetch_setter(*this));
+}
+
+auto make_prefetcher(const PrefetchConfig &config)
+    -> std::unique_ptr<Prefetcher> {
+  switch (config.kind) {
+  case PrefetcherKind::NextLine:
+    return std::make_unique<NextLinePrefetcher>(config.degree);
+  case PrefetcherKind::Stride:
+    return std::make_unique<StridePrefetcher>(
+        config.tableEntries, config.degree, config.cache.lineBytes);
+  case PrefetcherKind::Stream:
+    return std::make_unique<StreamPrefetcher>(config.streams, config.depth);
+  }
+  return nullptr;
+}
+
+auto PrefetchStats::accuracy() const -> double {
+  return ratio(useful, issued);
+}
+
+auto PrefetchStats::coverage() const -> double {
+  return ratio(useful, useful + misses);
+}
+
+auto PrefetchStats::timeliness() const -> double {
+  return ratio(useful - late, useful);
+}
+
+PrefetchModel::PrefetchModel(const PrefetchConfig &config,
+                             CacheHierarchy *warm)
+    : PrefetchModel(
+          [&] {
+            PrefetchConfig effective = config;
+            effective.cache = model_cache(config, warm);
+            return make_prefetcher(effective);
+          }(),
+          config, warm) {}
+
+PrefetchModel::PrefetchModel(std::unique_ptr<Prefetcher> prefetcher,
+                             const PrefetchConfig &config,
+                             CacheHierarchy *warm)
+    : model(std::move(prefetcher)), latency(config.latency), warm(warm),
+      cache(model_cache(config, warm)),
+      lineShift(line_shift(cache.config().lineBytes)) {}
+
+void PrefetchModel::reset() {
+  model->reset();
+  cache.reset();
+  pending.clear();
+  retiredCount = 0;
+  prefetchStats = {};
+}
+
+void PrefetchModel::forgetEvicted() {
+  for (auto it = pending.begin(); it != pending.end();) {
+    if (cache.contains(it->first << lineShift)) {
+      ++it;
+    } else {
+      it = pending.erase(it);
+    }
+  }
+}
+
+void PrefetchModel::access(uint64_t pc, uint64_t address, bool write) {
+  PrefetchAccess demand;
+  demand.pc = pc;
+  demand.address = address;
+  demand.line = address >> lineShift;
+  demand.miss = !cache.access(address, write).hit;
+  prefetchStats.accesses++;
+  auto it = pending.find(demand.line);
+  if (it != pending.end()) {
+    // Used, or evicted before it could be
+    if (!demand.miss) {
+      demand.prefetchHit = true;
+      prefetchStats.useful++;
+      if (retiredCount - it->second < latency) {
+        prefetchStats.late++;
+      }
+    }
+    pending.erase(it);
+  }
+  if (demand.miss) {
+    prefetchStats.misses++;
+  }
+
+  candidates.clear();
+  model->observe(demand, candidates);
+  for (uint64_t line : candidates) {
+    uint64_t lineAddress = line << lineShift;
+    if (cache.fill(lineAddress).hit) {
+      continue;
+    }
+    pending[line] = retiredCount;
+    prefetchStats.issued++;
+    if (warm != nullptr) {
+      warm->prefetch(lineAddress);
+    }
+  }
+  if (pending.size() > 2 * (cache.config().sizeBytes >> lineShift)) {
+    forgetEvicted();
+  }
+}
+
+void PrefetchModel::onRetire(const RetiredInstruction &retired) {
+  retiredCount++;
+  const DecodedInstruction &instr = *retired.instr;
+  bool write = instr.type == InstructionType::STR;
+  if (instr.type != InstructionType::LDR && !write) {
+    return;
+  }
+  access(retired.pc, retired.address, write);
+  // The second line of an access that crosses a line boundary
+  uint64_t last = retired.address + (uint64_t{1} << instr.size) - 1;
+  if (last >> lineShift != retired.address >> lineShift) {
+    access(retired.pc, last & ~((uint64_t{1} << lineShift) - 1), write);
+  }
+}
+
+auto PrefetchModel::report(std::ostream &out) const -> void {
+  out << "prefetcher:           " << model->name() << "\n"
+      << "demand accesses:      " << prefetchStats.accesses << "\n"
+      << "demand misses:        " << prefetchStats.misses << "\n"
+      << "prefetches issued:    " << prefetchStats.issued << "\n"
+      << "useful prefetches:    " << prefetchStats.useful << " ("
+      << prefetchStats.late << " late)\n"
+      << "accuracy:             " << prefetchStats.accuracy() * 100 << "%\n"
+      << "coverage:             " << prefetchStats.coverage() * 100 << "%\n"
+      << "timeliness:           " << prefetchStats.timeliness() * 100
+      << "%\n";
+}
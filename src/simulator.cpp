@@ -0,0 +1,180 @@
+#include "simulator.h"
+#include "executor.h"
+#include "executor_ops.h"
+#include "threaded_executor.h"
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+
+namespace {
+constexpr uint64_t INSTRUCTION_BYTES = 4;
+constexpr double INSTRUCTIONS_PER_MILLION = 1e6;
+} // namespace
+
+auto RunStats::mips() const -> double {
+  if (hostSeconds <= 0.0) {
+    return 0.0;
+  }
+  return static_cast<double>(instructions) / hostSeconds /
+         INSTRUCTIONS_PER_MILLION;
+}
+
+auto RunStats::dispatchesPerInstruction() const -> double {
+  if (instructions == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(dispatches) / static_cast<double>(instructions);
+}
+
+Simulator::Simulator(arm64::CPUState &cpu, Memory &mem)
+    : cpu(cpu), mem(mem), blocks(mem) {}
+
+auto Simulator::step() -> StopReason {
+  uint32_t word = mem.read32(cpu.PC);
+  DecodedInstruction instr = Decoder::decode(word);
+  if (instr.type == InstructionType::UNKNOWN) {
+    return StopReason::UndefinedInstruction;
+  }
+  // Taken branches write the target themselves; everything else falls
+  // through to the next sequential instruction.
+  if (!observers.empty()) {
+    retire(instr);
+  } else {
+    SIM_PROFILE_PHASE(Execute);
+    if (!Executor::execute(instr, cpu, mem)) {
+      cpu.PC += INSTRUCTION_BYTES;
+    }
+  }
+  runStats.instructions++;
+  runStats.dispatches++;
+  return StopReason::Retired;
+}
+
+auto Simulator::addObserver(RetireObserver *observer) -> void {
+  observers.push_back(observer);
+}
+
+auto Simulator::removeObserver(RetireObserver *observer) -> void {
+  observers.erase(std::remove(observers.begin(), observers.end(), observer),
+                  observers.end());
+}
+
+// Execute instr, advance the PC and report it; true for a taken branch
+auto Simulator::retire(const DecodedInstruction &instr) -> bool {
+  RetiredInstruction retired;
+  retired.pc = cpu.PC;
+  retired.instr = &instr;
+  retired.address = exec_ops::effective_address(instr, cpu);
+  {
+    SIM_PROFILE_PHASE(Execute);
+    retired.taken = Executor::execute(instr, cpu, mem);
+  }
+  if (!retired.taken) {
+    cpu.PC += INSTRUCTION_BYTES;
+  }
+  for (RetireObserver *observer : observers) {
+    observer->onRetire(retired);
+  }
+  return retired.taken;
+}
+
+auto Simulator::runObserved(const BasicBlock &block, uint64_t count)
+    -> uint64_t {
+  uint64_t executed = 0;
+  while (executed < count) {
+    DecodedInstruction instr = block.instructions[executed++].unpack();
+    if (retire(instr)) {
+      break;
+    }
+    if (!block.valid) {
+      break; // The block overwrote its own code; re-fetch from PC
+    }
+  }
+  return executed;
+}
+
+auto Simulator::snapshot() -> void {
+  savedCpu = cpu;
+  mem.snapshot();
+  hasSnapshot = true;
+}
+
+auto Simulator::restore() -> bool {
+  if (!hasSnapshot || !mem.restore()) {
+    return false;
+  }
+  cpu = savedCpu;
+  return true;
+}
+
+auto Simulator::run(uint64_t max_instructions) -> StopReason {
+  return loop(max_instructions, 0, false);
+}
+
+auto Simulator::run_until(uint64_t pc, uint64_t max_instructions)
+    -> StopReason {
+  return loop(max_instructions, pc, true);
+}
+
+auto Simulator::loop(uint64_t max_instructions, uint64_t stop_pc,
+                     bool use_stop_pc) -> StopReason {
+  auto start = std::chrono::steady_clock::now();
+  StopReason reason = StopReason::InstructionLimit;
+  uint64_t retired = 0;
+  while (retired < max_instructions) {
+    if (use_stop_pc && cpu.PC == stop_pc) {
+      reason = StopReason::Breakpoint;
+      break;
+    }
+    const BasicBlock *block = blocks.lookup(cpu.PC);
+    const auto &instructions = block->instructions;
+    if (instructions.empty()) {
+      reason = StopReason::UndefinedInstruction;
+      break;
+    }
+
+    // Run the whole block unless the budget or the breakpoint ends inside it
+    uint64_t count = std::min<uint64_t>(instructions.size(),
+                                        max_instructions - retired);
+    if (use_stop_pc && stop_pc > block->startPC && stop_pc < block->endPC) {
+      count = std::min(count, (stop_pc - block->startPC) / INSTRUCTION_BYTES);
+    }
+    uint64_t executed = 0;
+    if (!observers.empty()) {
+      executed = runObserved(*block, count);
+      runStats.dispatches += executed;
+    } else {
+#if defined(AARCH64_SIM_THREADED_DISPATCH)
+      executed = ThreadedExecutor::runBlock(*block, count, cpu, mem);
+      runStats.dispatches += block->dispatches[executed];
+#elif defined(AARCH64_SIM_JIT_DISPATCH)
+      // Translated blocks chain into each other, so give the Jit the whole
+      // remaining budget rather than one block's worth
+      if (use_stop_pc) {
+        executed = Executor::runBlock(*block, count, cpu, mem);
+        runStats.dispatches += block->dispatches[executed];
+      } else {
+        executed = jit.runBlock(*block, max_instructions - retired, cpu);
+        runStats.dispatches += executed;
+      }
+#else
+      executed = Executor::runBlock(*block, count, cpu, mem);
+      runStats.dispatches += block->dispatches[executed];
+#endif
+    }
+    retired += executed;
+  }
+  runStats.instructions += retired;
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  runStats.hostSeconds += elapsed.count();
+  return reason;
+}
+
+auto Simulator::report(std::ostream &out) const -> void {
+  out << "instructions retired: " << runStats.instructions << "\n"
+      << "dispatches/instr:     " << runStats.dispatchesPerInstruction()
+      << "\n"
+      << "host seconds:         " << runStats.hostSeconds << "\n"
+      << "host MIPS:            " << runStats.mips() << "\n";
+}
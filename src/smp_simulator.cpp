@@ -0,0 +1,139 @@
+#include "smp_simulator.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+namespace {
+constexpr double INSTRUCTIONS_PER_MILLION = 1e6;
+
+// Reusable barrier whose party count shrinks as cores stop
+class QuantumBarrier {
+public:
+  explicit QuantumBarrier(size_t parties) : expected(parties) {}
+
+  void arriveAndWait() {
+    std::unique_lock<std::mutex> guard(lock);
+    uint64_t phase = generation;
+    if (++arrived == expected) {
+      release();
+      return;
+    }
+    wake.wait(guard, [&] { return generation != phase; });
+  }
+
+  void arriveAndDrop() {
+    std::lock_guard<std::mutex> guard(lock);
+    expected--;
+    if (expected > 0 && arrived == expected) {
+      release();
+    }
+  }
+
+private:
+  void release() {
+    arrived = 0;
+    generation++;
+    wake.notify_all();
+  }
+
+  std::mutex lock;
+  std::condition_variable wake;
+  size_t expected;
+  size_t arrived = 0;
+  uint64_t generation = 0;
+};
+} // namespace
+
+SmpSimulator::SmpSimulator(std::vector<arm64::CPUState> &cpus, Memory &mem,
+                           SmpConfig config)
+    : config(config), coreStates(cpus.size()) {
+  this->config.quantum = std::max<uint64_t>(this->config.quantum, 1);
+  for (size_t i = 0; i < cpus.size(); i++) {
+    coreStates[i].view = mem.makeView();
+    coreStates[i].sim =
+        std::make_unique<Simulator>(cpus[i], *coreStates[i].view);
+  }
+}
+
+SmpSimulator::~SmpSimulator() = default;
+
+// Runs one quantum of core, charging it against left. Returns false once the
+// core has stopped or used up its budget.
+auto SmpSimulator::runQuantum(Core &core, uint64_t &left) -> bool {
+  uint64_t before = core.sim->stats().instructions;
+  PmuCounters *previous = PmuCounters::sink();
+  PmuCounters::attach(&core.pmu);
+  core.reason = core.sim->run(std::min(config.quantum, left));
+  PmuCounters::attach(previous);
+  left -= core.sim->stats().instructions - before;
+  return core.reason == StopReason::InstructionLimit && left > 0;
+}
+
+auto SmpSimulator::run(uint64_t max_instructions) -> void {
+  auto start = std::chrono::steady_clock::now();
+  if (config.deterministic || coreStates.size() <= 1) {
+    runDeterministic(max_instructions);
+  } else {
+    runThreaded(max_instructions);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  wallSeconds += elapsed.count();
+}
+
+auto SmpSimulator::runThreaded(uint64_t max_instructions) -> void {
+  QuantumBarrier barrier(coreStates.size());
+  std::vector<std::thread> threads;
+  threads.reserve(coreStates.size());
+  for (Core &core : coreStates) {
+    threads.emplace_back([this, &core, &barrier, max_instructions] {
+      uint64_t left = max_instructions;
+      while (left > 0 && runQuantum(core, left)) {
+        barrier.arriveAndWait();
+      }
+      barrier.arriveAndDrop();
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+auto SmpSimulator::runDeterministic(uint64_t max_instructions) -> void {
+  std::vector<uint64_t> left(coreStates.size(), max_instructions);
+  std::vector<bool> active(coreStates.size(), max_instructions > 0);
+  bool any = max_instructions > 0;
+  while (any) {
+    any = false;
+    for (size_t i = 0; i < coreStates.size(); i++) {
+      if (active[i]) {
+        active[i] = runQuantum(coreStates[i], left[i]);
+        any = any || active[i];
+      }
+    }
+  }
+}
+
+auto SmpSimulator::totalInstructions() const -> uint64_t {
+  uint64_t total = 0;
+  for (const Core &core : coreStates) {
+    total += core.sim->stats().instructions;
+  }
+  return total;
+}
+
+auto SmpSimulator::report(std::ostream &out) const -> void {
+  for (size_t i = 0; i < coreStates.size(); i++) {
+    out << "core " << i << " instructions:   "
+        << coreStates[i].sim->stats().instructions << "\n";
+  }
+  double mips = wallSeconds > 0.0 ? static_cast<double>(totalInstructions()) /
+                                        wallSeconds / INSTRUCTIONS_PER_MILLION
+                                  : 0.0;
+  out << "instructions retired: " << totalInstructions() << "\n"
+      << "host seconds:         " << wallSeconds << "\n"
+      << "aggregate MIPS:       " << mips << "\n";
+}
@@ -0,0 +1,181 @@
+#include "threaded_executor.h"
+#include "executor_ops.h"
+#include <array>
+#include <cstddef>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SIM_COMPUTED_GOTO 1
+#else
+#define SIM_COMPUTED_GOTO 0
+#endif
+
+namespace {
+constexpr uint64_t INSTRUCTION_BYTES = 4;
+constexpr size_t NUM_TYPES =
+    static_cast<size_t>(InstructionType::BRANCH_COND) + 1;
+} // namespace
+
+auto ThreadedExecutor::usesComputedGoto() -> bool {
+  return SIM_COMPUTED_GOTO != 0;
+}
+
+#if SIM_COMPUTED_GOTO
+
+auto ThreadedExecutor::runBlock(const BasicBlock &block, uint64_t count,
+                                arm64::CPUState &cpu, Memory &mem)
+    -> uint64_t {
+  SIM_PROFILE_PHASE(Execute);
+  // Label table by MacroOp, then InstructionType: single instructions in the
+  // None row, the pair handler across the rest of a fused row
+  static const void *const LABELS[MACRO_OP_COUNT][NUM_TYPES] = {
+      {&&op_unknown, &&op_add_imm, &&op_sub_imm, &&op_add_reg, &&op_sub_reg,
+       &&op_ldr, &&op_str, &&op_branch, &&op_branch_cond},
+      {&&op_compare_branch, &&op_compare_branch, &&op_compare_branch,
+       &&op_compare_branch, &&op_compare_branch, &&op_compare_branch,
+       &&op_compare_branch, &&op_compare_branch, &&op_compare_branch},
+      {&&op_add_load, &&op_add_load, &&op_add_load, &&op_add_load,
+       &&op_add_load, &&op_add_load, &&op_add_load, &&op_add_load,
+       &&op_add_load},
+  };
+  const MicroOp *first = block.instructions.data();
+  const MicroOp *ip = first;
+  const MicroOp *end = first + count;
+  const MacroOp *fused = block.fusion.data(); // Walks alongside ip
+
+// Each handler ends in its own copy of this jump
+#define DISPATCH()                                                             \
+  do {                                                                         \
+    if (ip == end) {                                                           \
+      goto done;                                                               \
+    }                                                                          \
+    goto *LABELS[static_cast<size_t>(*fused)]                                  \
+                [static_cast<size_t>(ip->type())];                             \
+  } while (0)
+#define ADVANCE(N_)                                                            \
+  do {                                                                         \
+    ip += (N_);                                                                \
+    fused += (N_);                                                             \
+  } while (0)
+// A pair cut in half by count runs its first instruction on its own
+#define SPLIT_PAIR()                                                           \
+  do {                                                                         \
+    if (ip + 1 == end) {                                                       \
+      goto *LABELS[0][static_cast<size_t>(ip->type())];                        \
+    }                                                                          \
+  } while (0)
+
+  DISPATCH();
+
+op_add_imm:
+  exec_ops::add_imm(ip->unpack(), cpu, mem);
+  ADVANCE(1);
+  cpu.PC += INSTRUCTION_BYTES;
+  DISPATCH();
+op_sub_imm:
+  exec_ops::sub_imm(ip->unpack(), cpu, mem);
+  ADVANCE(1);
+  cpu.PC += INSTRUCTION_BYTES;
+  DISPATCH();
+op_add_reg:
+  exec_ops::add_reg(ip->unpack(), cpu, mem);
+  ADVANCE(1);
+  cpu.PC += INSTRUCTION_BYTES;
+  DISPATCH();
+op_sub_reg:
+  exec_ops::sub_reg(ip->unpack(), cpu, mem);
+  ADVANCE(1);
+  cpu.PC += INSTRUCTION_BYTES;
+  DISPATCH();
+op_ldr:
+  exec_ops::ldr(ip->unpack(), cpu, mem);
+  ADVANCE(1);
+  cpu.PC += INSTRUCTION_BYTES;
+  DISPATCH();
+op_str:
+  exec_ops::str(ip->unpack(), cpu, mem);
+  ADVANCE(1);
+  cpu.PC += INSTRUCTION_BYTES;
+  if (!block.valid) {
+    goto done; // The block overwrote its own code; re-fetch from PC
+  }
+  DISPATCH();
+op_branch:
+  exec_ops::branch(ip->unpack(), cpu, mem);
+  ADVANCE(1);
+  goto done; // Always taken, always last
+op_branch_cond:
+  if (!exec_ops::branch_cond(ip->unpack(), cpu, mem)) {
+    cpu.PC += INSTRUCTION_BYTES;
+  }
+  ADVANCE(1);
+  goto done; // Always last
+op_compare_branch:
+  SPLIT_PAIR();
+  if (!exec_ops::compare_branch(ip[0].unpack(), ip[1].unpack(), cpu, mem)) {
+    cpu.PC += INSTRUCTION_BYTES;
+  }
+  ADVANCE(2);
+  goto done; // The B.cond is always last
+op_add_load:
+  SPLIT_PAIR();
+  exec_ops::add_load(ip[0].unpack(), ip[1].unpack(), cpu, mem);
+  ADVANCE(2);
+  cpu.PC += INSTRUCTION_BYTES;
+  DISPATCH();
+op_unknown:
+  // Blocks never contain undefined words
+  goto done;
+
+#undef SPLIT_PAIR
+#undef ADVANCE
+#undef DISPATCH
+done:
+  return static_cast<uint64_t>(ip - first);
+}
+
+#else
+
+namespace {
+using Handler = bool (*)(const DecodedInstruction &, arm64::CPUState &,
+                         Memory &);
+
+// Handler table for the portable variant, in InstructionType order
+constexpr std::array<Handler, NUM_TYPES> HANDLERS = {
+    exec_ops::unknown, exec_ops::add_imm, exec_ops::sub_imm,
+    exec_ops::add_reg, exec_ops::sub_reg, exec_ops::ldr,
+    exec_ops::str,     exec_ops::branch,  exec_ops::branch_cond,
+};
+} // namespace
+
+auto ThreadedExecutor::runBlock(const BasicBlock &block, uint64_t count,
+                                arm64::CPUState &cpu, Memory &mem)
+    -> uint64_t {
+  SIM_PROFILE_PHASE(Execute);
+  const auto &instructions = block.instructions;
+  uint64_t executed = 0;
+  while (executed < count) {
+    MacroOp pair = block.fusion[executed];
+    if (pair != MacroOp::None && count - executed >= 2) {
+      bool taken =
+          exec_ops::run_pair(pair, instructions[executed].unpack(),
+                             instructions[executed + 1].unpack(), cpu, mem);
+      executed += 2;
+      if (taken) {
+        break;
+      }
+      cpu.PC += INSTRUCTION_BYTES;
+      continue;
+    }
+    DecodedInstruction instr = instructions[executed++].unpack();
+    if (HANDLERS[static_cast<size_t>(instr.type)](instr, cpu, mem)) {
+      break;
+    }
+    cpu.PC += INSTRUCTION_BYTES;
+    if (!block.valid) {
+      break;
+    }
+  }
+  return executed;
+}
+
+#endif
@@ -0,0 +1,125 @@
+#include "trace.h"
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace {
+struct FileCloser {
+  void operator()(FILE *file) const { std::fclose(file); }
+};
+using File = std::unique_ptr<FILE, FileCloser>;
+} // namespace
+
+thread_local TraceBuffer *TraceBuffer::threadSink = nullptr;
+
+TraceBuffer::TraceBuffer(size_t capacity) {
+  size_t size = 1;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  events.resize(size);
+  mask = size - 1;
+}
+
+auto TraceBuffer::dropped() const -> uint64_t {
+  return recorded > events.size() ? recorded - events.size() : 0;
+}
+
+auto TraceBuffer::snapshot() const -> std::vector<TraceEvent> {
+  std::vector<TraceEvent> ordered;
+  uint64_t first = dropped();
+  ordered.reserve(recorded - first);
+  for (uint64_t i = first; i < recorded; i++) {
+    ordered.push_back(events[i & mask]);
+  }
+  return ordered;
+}
+
+auto TraceBuffer::dump(const std::string &path) const -> bool {
+  File file(std::fopen(path.c_str(), "wb"));
+  if (!file) {
+    return false;
+  }
+  std::vector<TraceEvent> ordered = snapshot();
+  FileHeader header{};
+  std::memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+  header.version = FILE_VERSION;
+  header.eventSize = sizeof(TraceEvent);
+  header.count = ordered.size();
+  header.dropped = dropped();
+  return std::fwrite(&header, sizeof(header), 1, file.get()) == 1 &&
+         std::fwrite(ordered.data(), sizeof(TraceEvent), ordered.size(),
+                     file.get()) == ordered.size();
+}
+
+auto TraceBuffer::readFile(const std::string &path,
+                           std::vector<TraceEvent> &out, FileHeader *header)
+    -> bool {
+  File file(std::fopen(path.c_str(), "rb"));
+  if (!file) {
+    return false;
+  }
+  FileHeader read{};
+  if (std::fread(&read, sizeof(read), 1, file.get()) != 1 ||
+      std::memcmp(read.magic, FILE_MAGIC, sizeof(read.magic)) != 0 ||
+      read.version != FILE_VERSION || read.eventSize != sizeof(TraceEvent)) {
+    return false;
+  }
+  // The header's count must match the file before it sizes the allocation
+  long start = std::ftell(file.get());
+  if (start < 0 || std::fseek(file.get(), 0, SEEK_END) != 0) {
+    return false;
+  }
+  long end = std::ftell(file.get());
+  if (end < start || std::fseek(file.get(), start, SEEK_SET) != 0) {
+    return false;
+  }
+  auto remaining = static_cast<uint64_t>(end - start);
+  if (remaining % sizeof(TraceEvent) != 0 ||
+      read.count != remaining / sizeof(TraceEvent)) {
+    return false;
+  }
+  out.resize(read.count);
+  if (std::fread(out.data(), sizeof(TraceEvent), out.size(), file.get()) !=
+      out.size()) {
+    return false;
+  }
+  if (header != nullptr) {
+    *header = read;
+  }
+  return true;
+}
+
+auto TraceBuffer::format(const TraceEvent &event) -> std::string {
+  char line[128];
+  switch (static_cast<InstructionType>(event.type)) {
+  case InstructionType::LDR:
+    std::snprintf(line, sizeof(line),
+                  "%016" PRIx64 "  LDR     x%u <- [%016" PRIx64 "] = %" PRIx64,
+                  event.pc, event.reg, event.address, event.value);
+    break;
+  case InstructionType::STR:
+    std::snprintf(line, sizeof(line),
+                  "%016" PRIx64 "  STR     x%u -> [%016" PRIx64 "] = %" PRIx64,
+                  event.pc, event.reg, event.address, event.value);
+    break;
+  case InstructionType::BRANCH:
+    std::snprintf(line, sizeof(line), "%016" PRIx64 "  B       -> %016" PRIx64,
+                  event.pc, event.address);
+    break;
+  case InstructionType::BRANCH_COND:
+    std::snprintf(line, sizeof(line),
+                  "%016" PRIx64 "  B.cond  -> %016" PRIx64 " %s", event.pc,
+                  event.address, event.value != 0 ? "taken" : "not taken");
+    break;
+  default:
+    std::snprintf(line, sizeof(line),
+                  "%016" PRIx64 "  type %-2u %016" PRIx64 " %016" PRIx64,
+                  event.pc, event.type, event.address, event.value);
+    break;
+  }
+  return line;
+}
+
+void TraceBuffer::attach(TraceBuffer *buffer) { threadSink = buffer; }
@@ -0,0 +1,30 @@
+#pragma once
+#include "simulator.h"
+#include <vector>
+
+// Helpers for tests that run a small guest program from address 0 through a
+// Simulator with models attached
+
+// Copy words into mem from address 0, followed by a zero word, which does not
+// decode, so a run stops there even when mem held a longer program before
+inline void load_words(Memory &mem, const std::vector<uint32_t> &words) {
+  for (size_t i = 0; i < words.size(); i++) {
+    mem.write<uint32_t>(i * 4, words[i]);
+  }
+  mem.write<uint32_t>(words.size() * 4, 0);
+}
+
+// Load words and run them on cpu until the guest stops, reporting every
+// retired instruction to observers; returns the Simulator's counters
+inline auto run_observed(arm64::CPUState &cpu, Memory &mem,
+                         const std::vector<uint32_t> &words,
+                         const std::vector<RetireObserver *> &observers)
+    -> RunStats {
+  load_words(mem, words);
+  Simulator sim(cpu, mem);
+  for (RetireObserver *observer : observers) {
+    sim.addObserver(observer);
+  }
+  sim.run();
+  return sim.stats();
+}
@@ -0,0 +1,190 @@
+#include "batch_executor.h"
+#include "guest_program.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Runs guest code over many lanes and checks every lane against a scalar
+// Simulator started from the same state.
+class BatchExecutorTest : public ::testing::TestWithParam<bool> {
+protected:
+  static constexpr uint64_t DATA = 0x8000;
+  Memory code{64 * 1024};
+
+  static void expect_same_state(const arm64::CPUState &a,
+                                const arm64::CPUState &b, size_t lane) {
+    for (size_t i = 0; i < a.X.size(); i++) {
+      EXPECT_EQ(a.X[i], b.X[i]) << "lane " << lane << " X" << i;
+    }
+    EXPECT_EQ(a.PC, b.PC) << "lane " << lane;
+    EXPECT_EQ(a.SP, b.SP) << "lane " << lane;
+    EXPECT_EQ(a.pstate.nzcv(), b.pstate.nzcv()) << "lane " << lane;
+  }
+
+  // Scalar run of one lane's start state over program and (optional) data
+  static auto reference(const std::vector<uint32_t> &program,
+                        const arm64::CPUState &start, uint64_t dataWord,
+                        uint64_t max = Simulator::NO_LIMIT)
+      -> arm64::CPUState {
+    Memory mem{64 * 1024};
+    load_words(mem, program);
+    mem.write64(DATA, dataWord);
+    arm64::CPUState cpu = start;
+    Simulator sim(cpu, mem);
+    sim.run(max);
+    return cpu;
+  }
+};
+
+// ADD X0, X0, #2; SUB X1, X1, #1; CMP X1, #0; B.NE #-12; ADD X5, X5, #1
+const std::vector<uint32_t> DIVERGENT_LOOP = {
+    0x91000800, 0xD1000421, 0xF100003F, 0x54FFFFA1, 0x910004A5};
+
+TEST_P(BatchExecutorTest, Divergent_Loop_Matches_Scalar_Lanes) {
+  load_words(code, DIVERGENT_LOOP);
+  constexpr size_t LANES = 37; // Not a multiple of the SIMD width
+  BatchState state(LANES);
+  for (size_t lane = 0; lane < LANES; lane++) {
+    state.setReg(lane, 1, lane % 9 + 1);
+  }
+  std::vector<arm64::CPUState> starts;
+  for (size_t lane = 0; lane < LANES; lane++) {
+    starts.push_back(state.lane(lane));
+  }
+  BatchExecutor batch(state, code, std::vector<Memory *>(LANES, &code),
+                      GetParam());
+  batch.run();
+
+  for (size_t lane = 0; lane < LANES; lane++) {
+    EXPECT_EQ(batch.stopReason(lane), StopReason::UndefinedInstruction);
+    expect_same_state(state.lane(lane),
+                      reference(DIVERGENT_LOOP, starts[lane], 0), lane);
+  }
+  EXPECT_LT(batch.stats().utilisation(LANES), 1.0);
+}
+
+TEST_P(BatchExecutorTest, Alu_And_Flags_Match_Scalar_On_Random_Values) {
+  // ADD X0, X2, X3; SUB X4, X2, X3; ADD X6, X2, #9; CMP X2, #5
+  const std::vector<uint32_t> program = {0x8B030040, 0xCB030044, 0x91002446,
+                                         0xF100145F};
+  load_words(code, program);
+  constexpr size_t LANES = 64;
+  BatchState state(LANES);
+  std::mt19937_64 rng(7);
+  for (size_t lane = 0; lane < LANES; lane++) {
+    // Mix small values (to hit the carry and zero edges) with random ones
+    state.setReg(lane, 2, (lane % 4 == 0) ? lane % 7 : rng());
+    state.setReg(lane, 3, (lane % 3 == 0) ? state.getReg(lane, 2) : rng());
+  }
+  std::vector<arm64::CPUState> starts;
+  for (size_t lane = 0; lane < LANES; lane++) {
+    starts.push_back(state.lane(lane));
+  }
+  BatchExecutor batch(state, code, std::vector<Memory *>(LANES, &code),
+                      GetParam());
+  batch.run();
+
+  for (size_t lane = 0; lane < LANES; lane++) {
+    expect_same_state(state.lane(lane), reference(program, starts[lane], 0),
+                      lane);
+  }
+  EXPECT_DOUBLE_EQ(batch.stats().utilisation(LANES), 1.0);
+}
+
+TEST_P(BatchExecutorTest, Overflow_And_W_Forms_Match_Scalar) {
+  // ADDS X0, X2, X3; SUBS X4, X2, X3; ADDS W0, W2, W3; SUBS W4, W2, W3 (one
+  // program each, so the flags compared are that instruction's)
+  const uint32_t words[] = {0xAB030040, 0xEB030044, 0x2B030040, 0x6B030044};
+  const uint64_t edges[] = {0,          1,          0x7FFFFFFF, 0x80000000,
+                            0xFFFFFFFF, INT64_MAX,  1ULL << 63, ~0ULL};
+  constexpr size_t LANES = 64;
+  std::mt19937_64 rng(11);
+  for (uint32_t word : words) {
+    SCOPED_TRACE(word);
+    load_words(code, {word});
+    BatchState state(LANES);
+    std::vector<arm64::CPUState> starts;
+    for (size_t lane = 0; lane < LANES; lane++) {
+      state.setReg(lane, 2, (lane % 2 == 0) ? edges[lane / 8] : rng());
+      state.setReg(lane, 3, (lane % 3 != 0) ? edges[lane % 8] : rng());
+      starts.push_back(state.lane(lane));
+    }
+    BatchExecutor batch(state, code, std::vector<Memory *>(LANES, &code),
+                        GetParam());
+    batch.run();
+    for (size_t lane = 0; lane < LANES; lane++) {
+      expect_same_state(state.lane(lane), reference({word}, starts[lane], 0),
+                        lane);
+    }
+  }
+}
+
+TEST_P(BatchExecutorTest, Lanes_Use_Their_Own_Memory) {
+  // LDR X0, [X10]; ADD X0, X0, #1; STR X0, [X10, #8]
+  const std::vector<uint32_t> program = {0xF9400140, 0x91000400, 0xF9000540};
+  load_words(code, program);
+  constexpr size_t LANES = 5;
+  std::vector<std::unique_ptr<Memory>> data;
+  std::vector<Memory *> laneMemory;
+  BatchState state(LANES);
+  for (size_t lane = 0; lane < LANES; lane++) {
+    data.push_back(std::make_unique<Memory>(64 * 1024));
+    data.back()->write64(DATA, 100 * lane);
+    laneMemory.push_back(data.back().get());
+    state.setReg(lane, 10, DATA);
+  }
+  BatchExecutor batch(state, code, laneMemory, GetParam());
+  batch.run();
+
+  for (size_t lane = 0; lane < LANES; lane++) {
+    EXPECT_EQ(state.getReg(lane, 0), 100 * lane + 1);
+    EXPECT_EQ(data[lane]->read64(DATA + 8), 100 * lane + 1);
+  }
+}
+
+TEST_P(BatchExecutorTest, Budget_Is_Per_Lane) {
+  load_words(code, DIVERGENT_LOOP);
+  constexpr size_t LANES = 8;
+  BatchState state(LANES);
+  for (size_t lane = 0; lane < LANES; lane++) {
+    state.setReg(lane, 1, 1000);
+  }
+  std::vector<arm64::CPUState> starts;
+  for (size_t lane = 0; lane < LANES; lane++) {
+    starts.push_back(state.lane(lane));
+  }
+  BatchExecutor batch(state, code, std::vector<Memory *>(LANES, &code),
+                      GetParam());
+  batch.run(10);
+
+  for (size_t lane = 0; lane < LANES; lane++) {
+    EXPECT_EQ(batch.stopReason(lane), StopReason::InstructionLimit);
+    EXPECT_EQ(state.retired[lane], 10);
+    expect_same_state(state.lane(lane),
+                      reference(DIVERGENT_LOOP, starts[lane], 0, 10), lane);
+  }
+}
+
+TEST_P(BatchExecutorTest, Xzr_Stays_Zero) {
+  // ADD XZR, X2, #1 (discarded); ADD X0, XZR, #3 (reads zero)
+  const std::vector<uint32_t> program = {0x9100045F, 0x91000FE0};
+  load_words(code, program);
+  BatchState state(4);
+  for (size_t lane = 0; lane < 4; lane++) {
+    state.setReg(lane, 2, 41);
+  }
+  BatchExecutor batch(state, code, std::vector<Memory *>(4, &code),
+                      GetParam());
+  batch.run();
+
+  for (size_t lane = 0; lane < 4; lane++) {
+    EXPECT_EQ(state.getReg(lane, 0), 3);
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Kernels, BatchExecutorTest,
+                         ::testing::Values(true, false),
+                         [](const ::testing::TestParamInfo<bool> &info) {
+                           return info.param ? "Simd" : "Scalar";
+                         });
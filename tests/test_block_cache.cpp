@@ -0,0 +1,149 @@
+#include "block_cache.h"
+#include "simulator.h"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <vector>
+
+class BlockCacheTest : public ::testing::Test {
+protected:
+  Memory memory{8192};
+
+  void load(const std::vector<uint32_t> &words, uint64_t base = 0) {
+    for (size_t i = 0; i < words.size(); i++) {
+      for (uint32_t b = 0; b < 4; b++) {
+        memory.writeByte(base + i * 4 + b, (words[i] >> (b * 8)) & 0xFF);
+      }
+    }
+  }
+};
+
+TEST_F(BlockCacheTest, Block_Ends_At_Branch) {
+  // ADD X0, X0, #2; SUB X1, X1, #1; B.NE #-8; ADD X0, X0, #1
+  load({0x91000800, 0xD1000421, 0x54FFFFC1, 0x91000400});
+  BlockCache cache(memory);
+
+  const BasicBlock *block = cache.lookup(0);
+  ASSERT_EQ(block->instructions.size(), 3);
+  EXPECT_EQ(block->startPC, 0);
+  EXPECT_EQ(block->endPC, 12);
+  EXPECT_EQ(block->instructions[2].type(), InstructionType::BRANCH_COND);
+}
+
+TEST_F(BlockCacheTest, Block_Ends_Before_Undefined_Word) {
+  load({0x91000800, 0x91000800}); // Followed by zero words
+  BlockCache cache(memory);
+
+  const BasicBlock *block = cache.lookup(0);
+  EXPECT_EQ(block->instructions.size(), 2);
+  EXPECT_EQ(block->endPC, 8);
+  EXPECT_TRUE(cache.lookup(0x100)->instructions.empty());
+}
+
+TEST_F(BlockCacheTest, Second_Lookup_Hits) {
+  load({0x14000000}); // B . (branch to self)
+  BlockCache cache(memory);
+
+  const BasicBlock *first = cache.lookup(0);
+  const BasicBlock *second = cache.lookup(0);
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(cache.stats().misses, 1);
+  EXPECT_EQ(cache.stats().hits, 1);
+}
+
+TEST_F(BlockCacheTest, Write_To_Code_Invalidates_Block) {
+  load({0x91000800, 0x14000000});
+  BlockCache cache(memory);
+  cache.lookup(0);
+  ASSERT_EQ(cache.size(), 1);
+
+  memory.writeByte(4, 0x00); // Touch the branch
+  EXPECT_EQ(cache.size(), 0);
+  EXPECT_EQ(cache.stats().invalidations, 1);
+}
+
+TEST_F(BlockCacheTest, Write_Outside_Block_Keeps_It) {
+  load({0x91000800, 0x14000000});
+  BlockCache cache(memory);
+  cache.lookup(0);
+
+  memory.write64(0x100, 0xDEADBEEF);  // Same page, other bytes
+  memory.write64(0x1000, 0xDEADBEEF); // Unwatched page
+  EXPECT_EQ(cache.size(), 1);
+}
+
+TEST_F(BlockCacheTest, Write_Into_Empty_Block_Redecodes) {
+  BlockCache cache(memory);
+  EXPECT_TRUE(cache.lookup(0x40)->instructions.empty());
+
+  load({0x91000800}, 0x40);
+  EXPECT_EQ(cache.lookup(0x40)->instructions.size(), 1);
+}
+
+TEST_F(BlockCacheTest, Simulator_Sees_Rewritten_Code_Between_Runs) {
+  arm64::CPUState cpu{};
+  load({0x91000400}); // ADD X0, X0, #1 then undefined
+  Simulator sim(cpu, memory);
+  sim.run();
+  EXPECT_EQ(cpu.getReg(0), 1);
+
+  load({0x91001C00}); // ADD X0, X0, #7
+  cpu.PC = 0;
+  sim.run();
+  EXPECT_EQ(cpu.getReg(0), 8);
+}
+
+TEST_F(BlockCacheTest, Simulator_Handles_Self_Modifying_Block) {
+  // 0x00: STR X3, [X2]      ; overwrite 0x08 and 0x0C
+  // 0x04: ADD X0, X0, #1
+  // 0x08: ADD X0, X0, #100  ; becomes ADD X0, X0, #7
+  // 0x0C: ADD X0, X0, #100  ; becomes an undefined zero word
+  load({0xF9000043, 0x91000400, 0x91019000, 0x91019000});
+  arm64::CPUState cpu{};
+  cpu.setReg(2, 0x08);
+  cpu.setReg(3, 0x91001C00);
+  Simulator sim(cpu, memory);
+
+  EXPECT_EQ(sim.run(), StopReason::UndefinedInstruction);
+  EXPECT_EQ(cpu.getReg(0), 8);
+  EXPECT_EQ(cpu.PC, 0x0C);
+}
+
+TEST_F(BlockCacheTest, Build_Marks_Fusible_Pairs) {
+  // ADD X2, X10, #8; LDR X3, [X2]; ADD X4, X4, #1; LDR X5, [X6];
+  // SUB X1, X1, #1; CMP X1, #0; B.NE #-24
+  load({0x91002142, 0xF9400043, 0x91000484, 0xF94000C5, 0xD1000421,
+        0xF100003F, 0x54FFFF41});
+  BlockCache cache(memory);
+
+  const BasicBlock *block = cache.lookup(0);
+  ASSERT_EQ(block->instructions.size(), 7);
+  const std::vector<MacroOp> fusion = {
+      MacroOp::AddLoad, MacroOp::None,          MacroOp::None, MacroOp::None,
+      MacroOp::None,    MacroOp::CompareBranch, MacroOp::None};
+  EXPECT_EQ(block->fusion, fusion);
+  // Five dispatches for all seven; a cut inside a pair runs its first half
+  const std::vector<uint8_t> dispatches = {0, 1, 1, 2, 3, 4, 5, 5};
+  EXPECT_EQ(block->dispatches, dispatches);
+}
+
+TEST_F(BlockCacheTest, Flag_Setting_Add_Does_Not_Fuse) {
+  // ADDS X2, X10, #8; LDR X3, [X2]; SUB X1, X1, #1 (no S); B.NE #-12
+  load({0xB1002142, 0xF9400043, 0xD1000421, 0x54FFFFA1});
+  BlockCache cache(memory);
+
+  const BasicBlock *block = cache.lookup(0);
+  EXPECT_EQ(std::count(block->fusion.begin(), block->fusion.end(),
+                       MacroOp::None),
+            4);
+  EXPECT_EQ(block->dispatches.back(), 4);
+}
+
+TEST_F(BlockCacheTest, Fusion_Can_Be_Disabled) {
+  load({0xF100003F, 0x54000040}); // CMP X1, #0; B.EQ #8
+  BlockCache cache(memory, false);
+
+  const BasicBlock *block = cache.lookup(0);
+  EXPECT_FALSE(cache.fusing());
+  EXPECT_EQ(block->fusion[0], MacroOp::None);
+  EXPECT_EQ(block->dispatches.back(), 2);
+}
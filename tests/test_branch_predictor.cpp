@@ -0,0 +1,141 @@
+#include "branch_predictor.h"
+#include "guest_program.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <vector>
+
+namespace {
+constexpr uint64_t PC = 0x400;
+
+// Feed pattern to predictor repeats times at one PC and count the
+// mispredicts of the second half, once the predictor had time to learn
+auto late_mispredicts(DirectionPredictor &predictor,
+                      const std::vector<bool> &pattern, size_t repeats)
+    -> size_t {
+  size_t wrong = 0;
+  for (size_t r = 0; r < repeats; r++) {
+    for (bool taken : pattern) {
+      wrong += (r >= repeats / 2 && predictor.predict(PC) != taken) ? 1 : 0;
+      predictor.update(PC, taken);
+    }
+  }
+  return wrong;
+}
+
+// Taken 19 times, then not taken: a loop of 20 iterations
+auto loop_exit(size_t iterations) -> std::vector<bool> {
+  std::vector<bool> pattern(iterations, true);
+  pattern.back() = false;
+  return pattern;
+}
+} // namespace
+
+TEST(DirectionPredictorTest, Bimodal_Learns_Bias_But_Not_Patterns) {
+  BimodalPredictor bimodal;
+  EXPECT_FALSE(bimodal.predict(PC)); // Weakly not taken
+  bimodal.update(PC, true);
+  EXPECT_TRUE(bimodal.predict(PC));
+  bimodal.reset();
+  // Alternating keeps the counter between the two weak states, always wrong
+  EXPECT_EQ(late_mispredicts(bimodal, {true, false}, 100), 100);
+}
+
+TEST(DirectionPredictorTest, History_Predictors_Learn_Patterns) {
+  GsharePredictor gshare;
+  TagePredictor tage;
+  EXPECT_EQ(late_mispredicts(gshare, {true, false}, 100), 0);
+  EXPECT_EQ(late_mispredicts(tage, {true, true, false}, 100), 0);
+
+  // The exit of a 20-iteration loop hides behind 12 bits of gshare history
+  // but not behind TAGE's longest history
+  gshare.reset();
+  tage.reset();
+  EXPECT_EQ(late_mispredicts(gshare, loop_exit(20), 100), 50);
+  EXPECT_EQ(late_mispredicts(tage, loop_exit(20), 100), 0);
+}
+
+TEST(BranchTargetBufferTest, Replaces_Least_Recently_Used) {
+  BranchTargetBuffer btb(2, 2);
+  uint64_t target = 0;
+  EXPECT_FALSE(btb.lookup(0x100, target));
+  btb.update(0x100, 0x40);
+  btb.update(0x104, 0x80);
+  ASSERT_TRUE(btb.lookup(0x100, target));
+  EXPECT_EQ(target, 0x40);
+  btb.update(0x108, 0xC0); // Evicts 0x104
+  EXPECT_FALSE(btb.lookup(0x104, target));
+  EXPECT_TRUE(btb.lookup(0x108, target));
+  btb.update(0x108, 0x10);
+  ASSERT_TRUE(btb.lookup(0x108, target));
+  EXPECT_EQ(target, 0x10);
+}
+
+// Runs a nested loop through a Simulator with a BranchModel attached:
+// 0x00: ADD X2, X3, #3
+// 0x04: SUB X2, X2, #1; CMP X2, #0; B.NE 0x04   (inner: taken, taken, not)
+// 0x10: B 0x14
+// 0x14: SUB X1, X1, #1; CMP X1, #0; B.NE 0x00   (outer: 100 iterations)
+class BranchModelTest : public ::testing::Test {
+protected:
+  arm64::CPUState cpu{};
+  Memory memory{64 * 1024};
+
+  void run(BranchModel &model) {
+    const std::vector<uint32_t> words = {
+        0x91000C62, 0xD1000442, 0xF100005F, 0x54FFFFC1,
+        0x14000001, 0xD1000421, 0xF100003F, 0x54FFFF21};
+    cpu = {};
+    cpu.setReg(1, 100);
+    run_observed(cpu, memory, words, {&model});
+  }
+};
+
+TEST_F(BranchModelTest, Ranks_Mispredicting_Branches) {
+  BranchConfig config;
+  config.kind = PredictorKind::Bimodal;
+  BranchModel bimodal(config);
+  run(bimodal);
+  const BranchStats &stats = bimodal.stats();
+  EXPECT_EQ(stats.instructions, 100 * 14);
+  EXPECT_EQ(stats.conditional, 100 * 3 + 100);
+  EXPECT_EQ(stats.unconditional, 100);
+  EXPECT_GE(stats.directionMispredicts, 100); // Every inner loop exit
+  EXPECT_EQ(bimodal.pcStats().at(0x10).mispredicts, 1); // Cold BTB only
+  auto hottest = bimodal.hottest(1);
+  ASSERT_EQ(hottest.size(), 1);
+  EXPECT_EQ(hottest[0].first, 0x0C);
+  EXPECT_EQ(hottest[0].second.executed, 300);
+  EXPECT_EQ(hottest[0].second.taken, 200);
+
+  BranchModel tage;
+  run(tage);
+  EXPECT_LT(tage.stats().directionMispredicts, 20);
+  EXPECT_LT(tage.stats().mpki(), stats.mpki());
+
+  std::ostringstream text;
+  bimodal.report(text);
+  EXPECT_NE(text.str().find("mispredicting pc:     0xc "), std::string::npos)
+      << text.str();
+}
+
+TEST(BranchConfigTest, Parse) {
+  BranchConfig config;
+  std::string error;
+  std::istringstream good("predictor = gshare\n"
+                          "history_bits = 16\n"
+                          "table_bits = 16   # 64K counters\n"
+                          "btb_entries = 2048\n");
+  ASSERT_TRUE(config.parse(good, error)) << error;
+  EXPECT_EQ(config.kind, PredictorKind::Gshare);
+  EXPECT_EQ(config.historyBits, 16);
+  EXPECT_STREQ(make_predictor(config)->name(), "gshare");
+
+  std::istringstream kind("predictor = perceptron\n");
+  EXPECT_FALSE(config.parse(kind, error));
+  std::istringstream history("history_bits = 65\n");
+  EXPECT_FALSE(config.parse(history, error));
+  EXPECT_EQ(error, "1: history_bits must be at most 64");
+  config = {};
+  std::istringstream btb("btb_entries = 96\n");
+  EXPECT_FALSE(config.parse(btb, error));
+}
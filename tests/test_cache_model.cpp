@@ -0,0 +1,154 @@
+#include "cache_model.h"
+#include "guest_program.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <vector>
+
+namespace {
+constexpr uint64_t LINE = 64;
+
+// One set of ways lines, so every line competes for the same set
+auto one_set(uint32_t ways, ReplacementPolicy policy) -> CacheConfig {
+  return {static_cast<uint32_t>(ways * LINE), ways, LINE, policy, true, true};
+}
+
+// Fill lines A-D, reuse A, then scan four new lines E-H
+auto after_scan(ReplacementPolicy policy, size_t scanned) -> Cache {
+  Cache cache(one_set(4, policy));
+  for (uint64_t line : {0, 1, 2, 3, 0}) {
+    cache.access(line * LINE, false);
+  }
+  for (uint64_t line = 4; line < 4 + scanned; line++) {
+    cache.access(line * LINE, false);
+  }
+  return cache;
+}
+} // namespace
+
+TEST(CacheTest, Replacement_Policies_Choose_Different_Victims) {
+  // LRU evicts B, the least recently used
+  Cache lru = after_scan(ReplacementPolicy::LRU, 1);
+  EXPECT_TRUE(lru.contains(0 * LINE));
+  EXPECT_FALSE(lru.contains(1 * LINE));
+  EXPECT_TRUE(lru.contains(2 * LINE));
+
+  // The PLRU tree only remembers that the right half was used before A, and
+  // within it that D was used after C
+  Cache plru = after_scan(ReplacementPolicy::PLRU, 1);
+  EXPECT_TRUE(plru.contains(0 * LINE));
+  EXPECT_TRUE(plru.contains(1 * LINE));
+  EXPECT_FALSE(plru.contains(2 * LINE));
+  EXPECT_TRUE(plru.contains(3 * LINE));
+
+  // A full scan flushes A from LRU, but RRIP keeps the reused line
+  EXPECT_FALSE(after_scan(ReplacementPolicy::LRU, 4).contains(0));
+  Cache rrip = after_scan(ReplacementPolicy::RRIP, 4);
+  EXPECT_TRUE(rrip.contains(0));
+  EXPECT_EQ(rrip.stats().evictions, 4);
+  EXPECT_EQ(rrip.stats().readMisses, 8);
+}
+
+TEST(CacheTest, Write_Back_And_Write_Allocate) {
+  Cache cache(one_set(1, ReplacementPolicy::LRU));
+  EXPECT_FALSE(cache.access(0x1000, true).hit);
+  EXPECT_TRUE(cache.access(0x1008, false).hit);
+  Cache::Outcome outcome = cache.access(0x2000, false);
+  EXPECT_FALSE(outcome.hit);
+  EXPECT_TRUE(outcome.writeback);
+  EXPECT_EQ(outcome.victim, 0x1000);
+  EXPECT_EQ(cache.stats().writebacks, 1);
+  EXPECT_FALSE(cache.access(0x3000, false).writeback); // 0x2000 was clean
+
+  CacheConfig config = one_set(1, ReplacementPolicy::LRU);
+  config.writeAllocate = false;
+  Cache noAllocate(config);
+  EXPECT_FALSE(noAllocate.access(0x1000, true).hit);
+  EXPECT_FALSE(noAllocate.contains(0x1000));
+  EXPECT_EQ(noAllocate.stats().writeMisses, 1);
+}
+
+// Runs a guest program through a Simulator with a CacheHierarchy attached
+class CacheHierarchyTest : public ::testing::Test {
+protected:
+  arm64::CPUState cpu{};
+  Memory memory{64 * 1024};
+
+  void run(const std::vector<uint32_t> &words, CacheHierarchy &caches) {
+    run_observed(cpu, memory, words, {&caches});
+  }
+};
+
+TEST_F(CacheHierarchyTest, Streaming_Loads_Miss_Once_Per_Line) {
+  // 0x00: LDR X0, [X10], #8; SUB X1, X1, #1; CMP X1, #0; B.NE 0x00
+  cpu.setReg(1, 512);
+  cpu.setReg(10, 0x4000);
+  CacheHierarchy caches;
+  run({0xF8408540, 0xD1000421, 0xF100003F, 0x54FFFFA1}, caches);
+
+  const CacheStats &l1d = caches.level(CacheLevel::L1D)->stats();
+  EXPECT_EQ(l1d.reads, 512);
+  EXPECT_EQ(l1d.readMisses, 512 * 8 / LINE);
+  // L2 and the LLC also see the one miss of the code line
+  EXPECT_EQ(caches.level(CacheLevel::L2)->stats().readMisses, 64 + 1);
+  EXPECT_EQ(caches.level(CacheLevel::LLC)->stats().readMisses, 64 + 1);
+  const CacheStats &l1i = caches.level(CacheLevel::L1I)->stats();
+  EXPECT_EQ(l1i.reads, 4 * 512);
+  EXPECT_EQ(l1i.readMisses, 1);
+
+  const PcCacheStats &load = caches.pcStats().at(0);
+  EXPECT_EQ(load.loads, 512);
+  EXPECT_EQ(load.misses[static_cast<size_t>(CacheLevel::L1D)], 64);
+  EXPECT_EQ(load.misses[static_cast<size_t>(CacheLevel::LLC)], 64 + 1);
+  auto hottest = caches.hottest(1);
+  ASSERT_EQ(hottest.size(), 1);
+  EXPECT_EQ(hottest[0].first, 0);
+
+  std::ostringstream text;
+  caches.report(text);
+  EXPECT_NE(text.str().find("L1D:                  512 accesses, 448 hits"),
+            std::string::npos)
+      << text.str();
+}
+
+TEST_F(CacheHierarchyTest, Stores_Write_Back_Through_The_Levels) {
+  // STR X0, [X10]; LDR X1, [X10, #-4] (crosses into the line below)
+  // with a direct-mapped L1D of one line and no L2
+  cpu.setReg(10, 0x4040);
+  CacheHierarchyConfig config;
+  config[CacheLevel::L1D] = one_set(1, ReplacementPolicy::LRU);
+  config[CacheLevel::L2].sizeBytes = 0;
+  CacheHierarchy caches(config);
+  run({0xF9000140, 0xF85FC141}, caches);
+
+  EXPECT_EQ(caches.level(CacheLevel::L2), nullptr);
+  const CacheStats &l1d = caches.level(CacheLevel::L1D)->stats();
+  EXPECT_EQ(l1d.writes, 1);
+  EXPECT_EQ(l1d.reads, 2); // 0x403C and 0x4040
+  EXPECT_EQ(l1d.writebacks, 1);
+  const CacheStats &llc = caches.level(CacheLevel::LLC)->stats();
+  EXPECT_EQ(llc.writes, 1); // The dirty line at 0x4040
+  EXPECT_EQ(caches.pcStats().at(4).loads, 1);
+}
+
+TEST(CacheHierarchyConfigTest, Parse_And_Validate) {
+  CacheHierarchyConfig config;
+  std::string error;
+  std::istringstream good("l2.size = 1048576\n"
+                          "l2.policy = RRIP   # scan resistant\n"
+                          "l1d.write_back = 0\n"
+                          "llc.size = 0\n");
+  ASSERT_TRUE(config.parse(good, error)) << error;
+  EXPECT_EQ(config[CacheLevel::L2].sizeBytes, 1048576);
+  EXPECT_EQ(config[CacheLevel::L2].policy, ReplacementPolicy::RRIP);
+  EXPECT_FALSE(config[CacheLevel::L1D].writeBack);
+
+  std::istringstream ways("l1d.ways = 3\n");
+  EXPECT_FALSE(config.parse(ways, error));
+  EXPECT_EQ(error, "l1d: PLRU needs a power-of-two number of ways");
+  config = {};
+  std::istringstream policy("l1i.policy = FIFO\n");
+  EXPECT_FALSE(config.parse(policy, error));
+  std::istringstream level("l3.size = 65536\n");
+  EXPECT_FALSE(config.parse(level, error));
+  EXPECT_EQ(error, "1: unknown key l3.size");
+}
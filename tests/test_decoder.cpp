@@ -1,5 +1,6 @@
 #include "decoder.h"
 #include <gtest/gtest.h>
+#include <vector>
 
 class DecoderTest : public ::testing::Test {
 protected:
@@ -94,6 +95,19 @@ TEST_F(DecoderTest, DecodeStore_Word) {
   EXPECT_EQ(result.rn, 2);
   EXPECT_EQ(result.imm, 4);
   EXPECT_FALSE(result.is64Bit); // 32-bit
+  EXPECT_EQ(result.size, 2);    // 4-byte access
+}
+
+TEST_F(DecoderTest, DecodeLoad_Byte) {
+  // LDRB W3, [X4, #5]
+  // Hex: 0x39401483
+  auto result = decode(0x39401483);
+
+  EXPECT_EQ(result.type, InstructionType::LDR);
+  EXPECT_EQ(result.rd, 3);
+  EXPECT_EQ(result.rn, 4);
+  EXPECT_EQ(result.imm, 5); // Byte accesses are not scaled
+  EXPECT_EQ(result.size, 0);
 }
 
 // --- CMP (Compare / SUBS Alias) ---
@@ -150,6 +164,14 @@ TEST_F(DecoderTest, Decode_Branch_Unconditional_Backward) {
   EXPECT_EQ(d.imm, -16);
 }
 
+TEST_F(DecoderTest, Decode_Branch_Offsets_Beyond_16_Bits) {
+  // B #0x100000, B #-128MiB (imm26 minimum), B.EQ #0xFFFFC (imm19 maximum)
+  EXPECT_EQ(decode(0x14040000).imm, 0x100000);
+  EXPECT_EQ(decode(0x16000000).imm, -0x8000000);
+  EXPECT_EQ(decode(0x547FFFE0).imm, 0xFFFFC);
+  EXPECT_EQ(decode(0x54800000).imm, -0x100000);
+}
+
 TEST_F(DecoderTest, Decode_Branch_Conditional_EQ) {
   // B.EQ #20
   // Hex: 0x540000A0
@@ -214,3 +236,149 @@ TEST_F(DecoderTest, Decode_CMP_Register_Alias) {
   EXPECT_EQ(d.rm, 2);
   EXPECT_EQ(d.setFlags, true);
 }
+
+// --- Table-driven decoder vs. reference if/else decoder ---
+
+namespace {
+void expect_same(const DecodedInstruction &fast, const DecodedInstruction &ref,
+                 uint32_t word) {
+  EXPECT_EQ(fast.type, ref.type) << std::hex << word;
+  EXPECT_EQ(fast.rd, ref.rd) << std::hex << word;
+  EXPECT_EQ(fast.rn, ref.rn) << std::hex << word;
+  EXPECT_EQ(fast.rm, ref.rm) << std::hex << word;
+  EXPECT_EQ(fast.imm, ref.imm) << std::hex << word;
+  EXPECT_EQ(fast.mode, ref.mode) << std::hex << word;
+  EXPECT_EQ(fast.is64Bit, ref.is64Bit) << std::hex << word;
+  EXPECT_EQ(fast.setFlags, ref.setFlags) << std::hex << word;
+  EXPECT_EQ(fast.cond, ref.cond) << std::hex << word;
+  EXPECT_EQ(fast.size, ref.size) << std::hex << word;
+}
+
+void expect_same_decode(uint32_t word) {
+  expect_same(Decoder::decode(word), Decoder::decodeReference(word), word);
+}
+
+auto random_words(size_t count) -> std::vector<uint32_t> {
+  std::vector<uint32_t> words;
+  uint32_t state = 0x9E3779B9;
+  for (size_t i = 0; i < count; i++) {
+    state ^= state << 13; // xorshift32
+    state ^= state >> 17;
+    state ^= state << 5;
+    words.push_back(state);
+  }
+  return words;
+}
+} // namespace
+
+TEST_F(DecoderTest, Table_Matches_Reference_For_Every_Key) {
+  // Every combination of bits [28:25], 30 and 22 with assorted field bits
+  for (uint32_t key = 0; key < 64; key++) {
+    uint32_t word = ((key >> 2) << 25) | (((key >> 1) & 1) << 30) |
+                    ((key & 1) << 22);
+    for (uint32_t fill : {0x00000000U, 0x813FFFFFU, 0x01A5A5A5U, 0x80000C1FU}) {
+      expect_same_decode(word | (fill & ~0x5E400000U));
+    }
+  }
+}
+
+TEST_F(DecoderTest, Table_Matches_Reference_On_Random_Words) {
+  uint32_t state = 0x12345678;
+  for (int i = 0; i < 100000; i++) {
+    state ^= state << 13; // xorshift32
+    state ^= state >> 17;
+    state ^= state << 5;
+    expect_same_decode(state);
+  }
+}
+
+TEST_F(DecoderTest, Block_Matches_Decode_On_Every_Key) {
+  std::vector<uint32_t> words;
+  for (uint32_t key = 0; key < 64; key++) {
+    uint32_t word = ((key >> 2) << 25) | (((key >> 1) & 1) << 30) |
+                    ((key & 1) << 22);
+    for (uint32_t fill : {0x00000000U, 0x813FFFFFU, 0x01A5A5A5U, 0x80000C1FU}) {
+      words.push_back(word | (fill & ~0x5E400000U));
+    }
+  }
+  std::vector<DecodedInstruction> out(words.size());
+  Decoder::decodeBlock(words.data(), words.size(), out.data());
+  for (size_t i = 0; i < words.size(); i++) {
+    expect_same(out[i], Decoder::decode(words[i]), words[i]);
+  }
+}
+
+TEST_F(DecoderTest, Block_Matches_Decode_For_Every_Length) {
+  // Lengths around the vector widths and the chunk size exercise every tail
+  std::vector<uint32_t> words = random_words(600);
+  for (size_t n : {0, 1, 3, 4, 7, 8, 15, 16, 31, 33, 255, 256, 257, 600}) {
+    std::vector<DecodedInstruction> out(n + 1);
+    out[n].rd = 0x55; // Canary past the end
+    Decoder::decodeBlock(words.data(), n, out.data());
+    for (size_t i = 0; i < n; i++) {
+      expect_same(out[i], Decoder::decode(words[i]), words[i]);
+    }
+    EXPECT_EQ(out[n].rd, 0x55) << n;
+  }
+}
+
+TEST_F(DecoderTest, Block_Overwrites_Stale_Output) {
+  // Fields the class does not set must come back as their defaults
+  uint32_t words[] = {0x14000001, 0xF9400421, 0x00000000};
+  DecodedInstruction out[3];
+  for (DecodedInstruction &d : out) {
+    d.rd = 7;
+    d.mode = AddrMode::PreIndex;
+    d.cond = 9;
+  }
+  Decoder::decodeBlock(words, 3, out);
+  EXPECT_EQ(out[0].type, InstructionType::BRANCH);
+  EXPECT_EQ(out[0].rd, 0);
+  EXPECT_EQ(out[1].mode, AddrMode::Offset);
+  EXPECT_EQ(out[1].cond, 0);
+  EXPECT_EQ(out[2].type, InstructionType::UNKNOWN);
+  EXPECT_EQ(out[2].mode, AddrMode::None);
+}
+
+// --- MicroOp ---
+
+static_assert(sizeof(MicroOp) == 8, "eight micro-ops per cache line");
+
+TEST_F(DecoderTest, MicroOp_Round_Trips_Every_Key) {
+  for (uint32_t key = 0; key < 64; key++) {
+    uint32_t word = ((key >> 2) << 25) | (((key >> 1) & 1) << 30) |
+                    ((key & 1) << 22);
+    for (uint32_t fill : {0x00000000U, 0x813FFFFFU, 0x01A5A5A5U, 0x80000C1FU}) {
+      uint32_t filled = word | (fill & ~0x5E400000U);
+      expect_same(MicroOp(decode(filled)).unpack(), decode(filled), filled);
+    }
+  }
+}
+
+TEST_F(DecoderTest, MicroOp_Round_Trips_Random_Words) {
+  for (uint32_t word : random_words(100000)) {
+    DecodedInstruction instr = decode(word);
+    MicroOp op(instr);
+    expect_same(op.unpack(), instr, word);
+    EXPECT_EQ(op.type(), instr.type) << std::hex << word;
+    EXPECT_EQ(op.imm(), instr.imm) << std::hex << word;
+  }
+}
+
+TEST_F(DecoderTest, MicroOp_Keeps_Extreme_Fields) {
+  DecodedInstruction instr;
+  instr.type = InstructionType::UNKNOWN;
+  instr.rd = 31;
+  instr.rn = 31;
+  instr.rm = 31;
+  instr.imm = INT32_MIN;
+  instr.mode = AddrMode::PostIndex;
+  instr.is64Bit = true;
+  instr.setFlags = true;
+  instr.cond = 15;
+  instr.size = 3;
+  expect_same(MicroOp(instr).unpack(), instr, 0);
+  instr.imm = INT32_MAX;
+  expect_same(MicroOp(instr).unpack(), instr, 0);
+  expect_same(MicroOp().unpack(), DecodedInstruction{}, 0);
+}
@@ -0,0 +1,243 @@
+#include "elf_loader.h"
+#include "pc_profiler.h"
+#include "simulator.h"
+#include <cstdio>
+#include <cstring>
+#include <elf.h>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Writes a minimal static AArch64 executable to a temporary file:
+//   text segment at 0x10000 (file offset 0x1000): the COUNT_LOOP program
+//   data segment at 0x11010 (file offset 0x2010): 8 bytes + 0x1100 bytes BSS
+//   .symtab with the function "_start" and the object "counter"
+class ElfLoaderTest : public ::testing::Test {
+protected:
+  static constexpr uint64_t TEXT_ADDR = 0x10000;
+  static constexpr uint64_t DATA_ADDR = 0x11010;
+  static constexpr uint64_t DATA_OFFSET = 0x2010;
+  static constexpr uint64_t BSS_SIZE = 0x1100;
+
+  arm64::CPUState cpu{};
+  Memory memory{1 << 20};
+  std::string path;
+
+  void SetUp() override {
+    char name[] = "/tmp/elf_loader_testXXXXXX";
+    int fd = mkstemp(name);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    path = name;
+  }
+
+  void TearDown() override { std::remove(path.c_str()); }
+
+  void write_file(const std::vector<uint8_t> &bytes) const {
+    FILE *file = std::fopen(path.c_str(), "wb");
+    std::fwrite(bytes.data(), 1, bytes.size(), file);
+    std::fclose(file);
+  }
+
+  template <typename T>
+  static void put(std::vector<uint8_t> &bytes, uint64_t offset,
+                  const T &value) {
+    std::memcpy(bytes.data() + offset, &value, sizeof(T));
+  }
+
+  auto build_image(uint64_t dataAddr = DATA_ADDR) const
+      -> std::vector<uint8_t> {
+    std::vector<uint8_t> bytes(0x3200, 0xAA); // Non-zero filler
+    Elf64_Ehdr header{};
+    std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+    header.e_ident[EI_CLASS] = ELFCLASS64;
+    header.e_ident[EI_DATA] = ELFDATA2LSB;
+    header.e_ident[EI_VERSION] = EV_CURRENT;
+    header.e_type = ET_EXEC;
+    header.e_machine = EM_AARCH64;
+    header.e_version = EV_CURRENT;
+    header.e_entry = TEXT_ADDR;
+    header.e_phoff = sizeof(Elf64_Ehdr);
+    header.e_phentsize = sizeof(Elf64_Phdr);
+    header.e_phnum = 2;
+    header.e_shoff = 0x3100;
+    header.e_shentsize = sizeof(Elf64_Shdr);
+    header.e_shnum = 3;
+    put(bytes, 0, header);
+
+    Elf64_Phdr text{};
+    text.p_type = PT_LOAD;
+    text.p_flags = PF_R | PF_X;
+    text.p_offset = 0x1000;
+    text.p_vaddr = TEXT_ADDR;
+    text.p_filesz = 16;
+    text.p_memsz = 16;
+    put(bytes, header.e_phoff, text);
+    const uint32_t program[] = {0x91000800, 0xD1000421, 0xF100003F,
+                                0x54FFFFA1};
+    put(bytes, 0x1000, program);
+    put(bytes, 0x1010, uint32_t{0}); // Undefined word after the loop
+
+    Elf64_Phdr data{};
+    data.p_type = PT_LOAD;
+    data.p_flags = PF_R | PF_W;
+    data.p_offset = DATA_OFFSET;
+    data.p_vaddr = dataAddr;
+    data.p_filesz = 8;
+    data.p_memsz = 8 + BSS_SIZE;
+    put(bytes, header.e_phoff + sizeof(Elf64_Phdr), data);
+    put(bytes, DATA_OFFSET, uint64_t{0x1122334455667788});
+
+    // .strtab at 0x3000, .symtab at 0x3020, section headers at 0x3100
+    const char names[] = "\0_start\0counter";
+    std::memcpy(bytes.data() + 0x3000, names, sizeof(names));
+    Elf64_Sym syms[3]{};
+    syms[1].st_name = 1;
+    syms[1].st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+    syms[1].st_value = TEXT_ADDR;
+    syms[1].st_size = 16;
+    syms[2].st_name = 8;
+    syms[2].st_info = ELF64_ST_INFO(STB_GLOBAL, STT_OBJECT);
+    syms[2].st_value = dataAddr;
+    syms[2].st_size = 8;
+    put(bytes, 0x3020, syms);
+
+    Elf64_Shdr sections[3]{};
+    sections[1].sh_type = SHT_SYMTAB;
+    sections[1].sh_offset = 0x3020;
+    sections[1].sh_size = sizeof(syms);
+    sections[1].sh_link = 2;
+    sections[1].sh_entsize = sizeof(Elf64_Sym);
+    sections[2].sh_type = SHT_STRTAB;
+    sections[2].sh_offset = 0x3000;
+    sections[2].sh_size = sizeof(names);
+    put(bytes, 0x3100, sections);
+    return bytes;
+  }
+};
+
+TEST_F(ElfLoaderTest, Loads_Segments_And_Sets_Entry) {
+  write_file(build_image());
+  ElfImage image;
+  ASSERT_TRUE(image.load(path, memory, cpu)) << image.error();
+
+  EXPECT_EQ(image.entry(), TEXT_ADDR);
+  EXPECT_EQ(cpu.PC, TEXT_ADDR);
+  EXPECT_EQ(memory.read32(TEXT_ADDR), 0x91000800);
+  EXPECT_EQ(memory.read64(DATA_ADDR), 0x1122334455667788);
+}
+
+TEST_F(ElfLoaderTest, Bss_Reads_As_Zero) {
+  write_file(build_image());
+  ElfImage image;
+  ASSERT_TRUE(image.load(path, memory, cpu)) << image.error();
+
+  EXPECT_EQ(memory.read64(DATA_ADDR + 8), 0);        // Same page as data
+  EXPECT_EQ(memory.read64(DATA_ADDR + BSS_SIZE), 0); // Next page
+  EXPECT_EQ(memory.read64(DATA_ADDR - 8), 0);        // Before the segment
+}
+
+TEST_F(ElfLoaderTest, Text_Is_Mapped_Without_Copy) {
+  write_file(build_image());
+  ElfImage image;
+  ASSERT_TRUE(image.load(path, memory, cpu)) << image.error();
+
+  EXPECT_EQ(memory.mappedPages(), 1);   // Text aliases the file mapping
+  EXPECT_EQ(memory.residentPages(), 1); // Data page holds BSS: copied
+  EXPECT_EQ(image.bytesMapped(), 16);
+  EXPECT_EQ(image.bytesCopied(), 8);
+}
+
+TEST_F(ElfLoaderTest, Guest_Store_Does_Not_Touch_File) {
+  write_file(build_image());
+  {
+    ElfImage image;
+    ASSERT_TRUE(image.load(path, memory, cpu)) << image.error();
+    memory.write<uint32_t>(TEXT_ADDR, 0);
+    EXPECT_EQ(memory.read32(TEXT_ADDR), 0);
+  }
+  Memory fresh{1 << 20};
+  ElfImage again;
+  ASSERT_TRUE(again.load(path, fresh, cpu)) << again.error();
+  EXPECT_EQ(fresh.read32(TEXT_ADDR), 0x91000800);
+}
+
+TEST_F(ElfLoaderTest, Misaligned_Segment_Is_Copied) {
+  write_file(build_image(DATA_ADDR + 4)); // Offset and address not congruent
+  ElfImage image;
+  ASSERT_TRUE(image.load(path, memory, cpu)) << image.error();
+
+  EXPECT_EQ(memory.read64(DATA_ADDR + 4), 0x1122334455667788);
+  EXPECT_EQ(memory.read64(DATA_ADDR + 12), 0);
+}
+
+TEST_F(ElfLoaderTest, Exposes_Symbol_Table) {
+  write_file(build_image());
+  ElfImage image;
+  ASSERT_TRUE(image.load(path, memory, cpu)) << image.error();
+
+  ASSERT_EQ(image.symbols().size(), 2);
+  const ElfSymbol *start = image.findSymbol("_start");
+  ASSERT_NE(start, nullptr);
+  EXPECT_EQ(start->value, TEXT_ADDR);
+  EXPECT_EQ(image.symbolFor(TEXT_ADDR + 8), start);
+  EXPECT_EQ(image.symbolFor(DATA_ADDR)->name, "counter");
+  EXPECT_EQ(image.symbolFor(TEXT_ADDR + 16), nullptr);
+  EXPECT_EQ(image.findSymbol("main"), nullptr);
+}
+
+TEST_F(ElfLoaderTest, Simulator_Runs_Loaded_Program) {
+  write_file(build_image());
+  ElfImage image;
+  ASSERT_TRUE(image.load(path, memory, cpu)) << image.error();
+  cpu.setReg(1, 10);
+
+  Simulator sim(cpu, memory);
+  EXPECT_EQ(sim.run(), StopReason::UndefinedInstruction);
+  EXPECT_EQ(cpu.getReg(0), 20);
+  EXPECT_EQ(cpu.PC, TEXT_ADDR + 16);
+}
+
+TEST_F(ElfLoaderTest, Pc_Profiler_Symbolizes_Samples) {
+  write_file(build_image());
+  ElfImage image;
+  ASSERT_TRUE(image.load(path, memory, cpu)) << image.error();
+  cpu.setReg(1, 10);
+
+  Simulator sim(cpu, memory);
+  PcProfiler profiler(1);
+  profiler.run(sim, cpu);
+  std::ostringstream text;
+  profiler.report(text, &image, 2);
+  EXPECT_EQ(text.str(), "samples:              40 (every 1 instructions)\n"
+                        "hot function:         _start 39 (97.5%)\n"
+                        "hot function:         [unknown] 1 (2.5%)\n"
+                        "hot pc:               0x10004 _start+0x4 10 (25%)\n"
+                        "hot pc:               0x10008 _start+0x8 10 (25%)\n");
+  std::ostringstream folded;
+  profiler.writeFolded(folded, &image);
+  EXPECT_EQ(folded.str(), "_start;_start 9\n"
+                          "_start;_start+0x4 10\n"
+                          "_start;_start+0x8 10\n"
+                          "_start;_start+0xc 10\n"
+                          "0x10010 1\n");
+}
+
+TEST_F(ElfLoaderTest, Rejects_Non_Elf_And_Missing_Files) {
+  write_file(std::vector<uint8_t>(128, 0));
+  ElfImage image;
+  EXPECT_FALSE(image.load(path, memory, cpu));
+  EXPECT_NE(image.error().find("not an ELF"), std::string::npos);
+
+  EXPECT_FALSE(image.load(path + ".missing", memory, cpu));
+  EXPECT_FALSE(image.error().empty());
+}
+
+TEST_F(ElfLoaderTest, Rejects_Segment_Outside_Memory) {
+  write_file(build_image());
+  Memory small{0x10000}; // Text starts right past the end
+  ElfImage image;
+  EXPECT_FALSE(image.load(path, small, cpu));
+}
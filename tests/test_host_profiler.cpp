@@ -0,0 +1,88 @@
+#include "guest_program.h"
+#include "host_profiler.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <vector>
+
+namespace {
+// Keep the host busy for a moment so every phase takes measurable time
+void spin() {
+  volatile uint64_t sink = 0;
+  for (int i = 0; i < 20000; i++) {
+    sink = sink + i;
+  }
+}
+} // namespace
+
+TEST(HostProfilerTest, Nested_Phases_Count_Self_Time) {
+  HostProfiler profiler;
+  for (int i = 0; i < 3; i++) {
+    profiler.enter(HostPhase::Execute);
+    spin();
+    profiler.enter(HostPhase::Memory);
+    spin();
+    spin();
+    profiler.leave();
+    profiler.leave();
+  }
+  const PhaseStats &execute = profiler.stats(HostPhase::Execute);
+  const PhaseStats &memory = profiler.stats(HostPhase::Memory);
+  EXPECT_EQ(execute.calls, 3);
+  EXPECT_EQ(memory.calls, 3);
+  EXPECT_EQ(profiler.stats(HostPhase::Fetch).calls, 0);
+  EXPECT_GT(execute.ticks, 0);
+  EXPECT_GT(memory.ticks, 0);
+  EXPECT_EQ(profiler.totalTicks(), execute.ticks + memory.ticks);
+  EXPECT_GT(profiler.tickSeconds(), 0.0);
+
+  std::ostringstream text;
+  profiler.report(text);
+  EXPECT_NE(text.str().find("memory:               3 calls"),
+            std::string::npos)
+      << text.str();
+  EXPECT_NE(text.str().find("perf events:          off"), std::string::npos);
+  profiler.reset();
+  EXPECT_EQ(profiler.totalTicks(), 0);
+}
+
+TEST(HostProfilerTest, Perf_Events_Or_A_Reason) {
+  HostProfiler profiler(true);
+  if (!profiler.perfEnabled()) {
+    EXPECT_FALSE(profiler.perfError().empty());
+    GTEST_SKIP() << profiler.perfError();
+  }
+  profiler.enter(HostPhase::Decode);
+  spin();
+  profiler.leave();
+  EXPECT_GT(profiler.stats(HostPhase::Decode)
+                .events[static_cast<size_t>(HostEvent::Cycles)],
+            0);
+}
+
+TEST(HostProfilerTest, Simulator_Phases_Only_When_Compiled_In) {
+  Memory memory{64 * 1024};
+  // LDR X0, [X10]; ADD X0, X0, #1; STR X0, [X10]; SUB X1, X1, #1;
+  // CMP X1, #0; B.NE #-20
+  const std::vector<uint32_t> program = {0xF9400140, 0x91000400, 0xF9000140,
+                                         0xD1000421, 0xF100003F, 0x54FFFF61};
+  load_words(memory, program);
+  arm64::CPUState cpu{};
+  cpu.setReg(1, 5);
+  cpu.setReg(10, 0x8000);
+  HostProfiler profiler;
+  HostProfiler::attach(&profiler);
+  Simulator sim(cpu, memory);
+  sim.run();
+  HostProfiler::attach(nullptr);
+
+#if defined(AARCH64_SIM_PROFILE)
+  // Two blocks: the loop and the empty one at its exit
+  EXPECT_EQ(profiler.stats(HostPhase::Decode).calls, 7);
+  EXPECT_EQ(profiler.stats(HostPhase::Fetch).calls, 6);
+  EXPECT_EQ(profiler.stats(HostPhase::Execute).calls, 5);
+  EXPECT_EQ(profiler.stats(HostPhase::Memory).calls, 10);
+#else
+  EXPECT_EQ(profiler.totalTicks(), 0);
+#endif
+  EXPECT_EQ(memory.read64(0x8000), 5);
+}
@@ -0,0 +1,270 @@
+#include "guest_program.h"
+#include "jit.h"
+#include <fstream>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+// Runs guest code through the Jit and, in lockstep, through the interpreter
+// (Simulator::step), comparing architectural state every time the Jit hands
+// control back.
+class JitTest : public ::testing::Test {
+protected:
+  static constexpr uint64_t MEMORY_BYTES = 64 * 1024;
+  static constexpr uint64_t DATA_BASE = 0x8000;
+  static constexpr uint64_t DATA_BYTES = 0x400;
+  static constexpr uint64_t CODE_BYTES = 0x100;
+
+  Memory jitMemory{MEMORY_BYTES};
+  Memory refMemory{MEMORY_BYTES};
+  arm64::CPUState jitCpu{};
+  arm64::CPUState refCpu{};
+
+  void load(const std::vector<uint32_t> &words) {
+    for (uint64_t a = 0; a < CODE_BYTES; a += 8) {
+      jitMemory.write64(a, 0);
+      refMemory.write64(a, 0);
+    }
+    load_words(jitMemory, words);
+    load_words(refMemory, words);
+    for (uint64_t a = 0; a < DATA_BYTES; a += 8) {
+      jitMemory.write64(DATA_BASE + a, a * 0x0101010101010101ULL);
+      refMemory.write64(DATA_BASE + a, a * 0x0101010101010101ULL);
+    }
+  }
+
+  void setReg(uint8_t reg, uint64_t value) {
+    jitCpu.setReg(reg, value);
+    refCpu.setReg(reg, value);
+  }
+
+  void expect_same_state() {
+    for (size_t i = 0; i < jitCpu.X.size(); i++) {
+      ASSERT_EQ(jitCpu.X[i], refCpu.X[i]) << "X" << i;
+    }
+    ASSERT_EQ(jitCpu.PC, refCpu.PC);
+    ASSERT_EQ(jitCpu.SP, refCpu.SP);
+    ASSERT_EQ(jitCpu.pstate.nzcv(), refCpu.pstate.nzcv());
+    for (uint64_t a = 0; a < CODE_BYTES; a += 8) {
+      ASSERT_EQ(jitMemory.read64(a), refMemory.read64(a)) << "at " << a;
+    }
+    for (uint64_t a = DATA_BASE - 0x1000; a < DATA_BASE + 0x1000; a += 8) {
+      ASSERT_EQ(jitMemory.read64(a), refMemory.read64(a)) << "at " << a;
+    }
+  }
+
+  // Drive the Jit in chunks of varying size until the guest stops or limit
+  // instructions have retired, checking after every chunk. Returns the
+  // instructions retired.
+  auto lockstep(Jit &jit, BlockCache &cache, uint64_t limit = 200'000)
+      -> uint64_t {
+    Simulator reference(refCpu, refMemory);
+    uint64_t retired = 0;
+    for (uint64_t chunk = 0; retired < limit; chunk++) {
+      const BasicBlock *block = cache.lookup(jitCpu.PC);
+      if (block->instructions.empty()) {
+        EXPECT_EQ(reference.step(), StopReason::UndefinedInstruction);
+        break;
+      }
+      // Mostly short budgets, so chains run out part-way and state is
+      // compared often; now and then everything that is left
+      uint64_t budget =
+          (chunk % 8 == 7) ? limit - retired : 1 + (chunk * 7) % 40;
+      uint64_t ran = jit.runBlock(*block, budget, jitCpu);
+      EXPECT_GE(ran, 1);
+      EXPECT_LE(ran, budget);
+      for (uint64_t i = 0; i < ran; i++) {
+        EXPECT_EQ(reference.step(), StopReason::Retired);
+      }
+      retired += ran;
+      expect_same_state();
+      if (HasFatalFailure()) {
+        break;
+      }
+    }
+    return retired;
+  }
+};
+
+namespace {
+// A loop of random ALU and load/store work counted down by X20, with
+// forward conditional branches that split it into several blocks
+auto random_program(uint32_t seed) -> std::vector<uint32_t> {
+  std::mt19937 rng(seed);
+  auto pick = [&](uint32_t n) { return rng() % n; };
+  auto reg = [&]() -> uint32_t { return pick(8) == 0 ? 31 : pick(10); };
+  // ADD, ADDS, SUB, SUBS; bit 31 is cleared below for the W forms
+  const uint32_t ALU_IMM[] = {0x91000000, 0xB1000000, 0xD1000000, 0xF1000000};
+  const uint32_t ALU_REG[] = {0x8B000000, 0xAB000000, 0xCB000000, 0xEB000000};
+  auto width = [&]() -> uint32_t { return pick(4) == 0 ? 0x7FFFFFFF : ~0U; };
+  std::vector<uint32_t> words;
+  size_t length = 8 + pick(24);
+  for (size_t i = 0; i < length; i++) {
+    switch (pick(8)) {
+    case 0:
+    case 1:
+      words.push_back((ALU_IMM[pick(4)] | pick(4096) << 10 | reg() << 5 |
+                       reg()) &
+                      width());
+      break;
+    case 2:
+    case 3:
+      words.push_back(
+          (ALU_REG[pick(4)] | reg() << 16 | reg() << 5 | reg()) & width());
+      break;
+    case 4: // LDR{B,H,W,X} Rt, [X10, #imm] (unsigned offset)
+      words.push_back(0x39400000 | pick(4) << 30 | pick(16) << 10 |
+                      10 << 5 | pick(10));
+      break;
+    case 5: // STR{B,H,W,X} Rt, [X10, #imm]
+      words.push_back(0x39000000 | pick(4) << 30 | pick(16) << 10 |
+                      10 << 5 | reg());
+      break;
+    case 6: // LDR/STR X, [X11, #+-8]! or [X11], #+-8
+      words.push_back((pick(2) ? 0xF8400000 : 0xF8000000) |
+                      (pick(2) ? 0x008000 : 0x1F8000) |
+                      (pick(2) ? 0xC00 : 0x400) | 11 << 5 | pick(10));
+      break;
+    default: // B.cond over the next instruction
+      words.push_back(0x54000040 | pick(16));
+      break;
+    }
+  }
+  // SUB X20, X20, #1; CMP X20, #0; B.NE back to the start
+  words.push_back(0xD1000694);
+  words.push_back(0xF100029F);
+  auto back = static_cast<uint32_t>(-static_cast<int32_t>(words.size()));
+  words.push_back(0x54000001 | (back & 0x7FFFF) << 5);
+  return words;
+}
+} // namespace
+
+TEST_F(JitTest, Lockstep_Random_Programs) {
+  for (uint32_t seed = 1; seed <= 40; seed++) {
+    SCOPED_TRACE(seed);
+    jitCpu = {};
+    refCpu = {};
+    load(random_program(seed));
+    setReg(10, DATA_BASE);
+    setReg(11, DATA_BASE + DATA_BYTES / 2);
+    setReg(20, 50);
+    jitCpu.SP = refCpu.SP = DATA_BASE;
+    BlockCache cache(jitMemory);
+    Jit jit(cache, jitMemory, {2});
+    lockstep(jit, cache);
+    if (HasFatalFailure()) {
+      return;
+    }
+  }
+}
+
+TEST_F(JitTest, Chains_Blocks_Of_Hot_Loop) {
+  // 0x00: LDR X0, [X10]; ADD X0, X0, #1; STR X0, [X10]; CMP X0, #0;
+  //       B.EQ #8
+  // 0x14: STRH W0, [SP, #2]; LDRB W2, [SP, #2]; SUB X1, X1, #1;
+  //       CMP X1, #0; B.NE #-36
+  load({0xF9400140, 0x91000400, 0xF9000140, 0xF100001F, 0x54000040,
+        0x790007E0, 0x39400BE2, 0xD1000421, 0xF100003F, 0x54FFFEE1});
+  setReg(1, 1000);
+  setReg(10, DATA_BASE);
+  jitCpu.SP = refCpu.SP = DATA_BASE + 0x100;
+  BlockCache cache(jitMemory);
+  Jit jit(cache, jitMemory, {4});
+  uint64_t retired = lockstep(jit, cache);
+  EXPECT_EQ(retired, 1000 * 10);
+
+  if (!Jit::supported()) {
+    GTEST_SKIP() << "no translation on this host";
+  }
+  EXPECT_GE(jit.stats().blocksCompiled, 2);
+  EXPECT_GE(jit.stats().chainLinks, 2);
+  EXPECT_EQ(jit.stats().blocksRejected, 0);
+  EXPECT_GT(jit.codeBytesUsed(), 0);
+}
+
+TEST_F(JitTest, Signed_Conditions_Are_Translated) {
+  // 0x00: SUB W1, W1, #1; CMP W1, #0; B.GT #-8
+  // 0x0C: SUB W2, W2, #1; ADD W1, W1, #2; CMP W2, #0; B.GE #-24
+  // W2 runs 3, 2, 1, 0, -1; only a 32-bit compare sees -1 as negative
+  load({0x51000421, 0x7100003F, 0x54FFFFCC, 0x51000442, 0x11000821,
+        0x7100005F, 0x54FFFF4A});
+  setReg(1, 5);
+  setReg(2, 3);
+  BlockCache cache(jitMemory);
+  Jit jit(cache, jitMemory, {1});
+  lockstep(jit, cache);
+  EXPECT_EQ(jitCpu.getReg(1), 2);
+  EXPECT_EQ(jitCpu.getReg(2), 0xFFFFFFFF);
+  if (Jit::supported()) {
+    EXPECT_GE(jit.stats().blocksCompiled, 2);
+    EXPECT_EQ(jit.stats().blocksRejected, 0);
+    EXPECT_GT(jit.stats().nativeRuns, 0);
+  }
+}
+
+TEST_F(JitTest, Self_Modifying_Store_Leaves_Translated_Code) {
+  // 0x00: ADD X0, X0, #1
+  // 0x04: STR W3, [X12]     (rewrites 0x00 once X1 reaches 5)
+  // 0x08: SUB X1, X1, #1; CMP X1, #0; B.NE #-16
+  load({0x91000400, 0xB9000183, 0xD1000421, 0xF100003F, 0x54FFFF81});
+  setReg(1, 10);
+  setReg(3, 0x91000400); // Same ADD until X3 changes
+  setReg(12, 0);
+  BlockCache cache(jitMemory);
+  Jit jit(cache, jitMemory, {1});
+  Simulator reference(refCpu, refMemory);
+
+  // Run 5 iterations, then patch the stored word to ADD X0, X0, #16
+  for (uint64_t retired = 0; retired < 25;) {
+    const BasicBlock *block = cache.lookup(jitCpu.PC);
+    retired += jit.runBlock(*block, 25 - retired, jitCpu);
+  }
+  for (int i = 0; i < 25; i++) {
+    reference.step();
+  }
+  setReg(3, 0x91004000);
+  lockstep(jit, cache);
+  EXPECT_EQ(jitCpu.getReg(0), 5 + 1 + 16 * 4);
+  if (Jit::supported()) {
+    EXPECT_GE(jit.stats().flushes, 1);
+  }
+}
+
+TEST_F(JitTest, Code_Cache_Is_Never_Writable_And_Executable) {
+  if (!Jit::supported()) {
+    GTEST_SKIP() << "no translation on this host";
+  }
+  // SUB X1, X1, #1; CMP X1, #0; B.NE #-8
+  load({0xD1000421, 0xF100003F, 0x54FFFFC1});
+  setReg(1, 100);
+  BlockCache cache(jitMemory);
+  Jit jit(cache, jitMemory, {1});
+  lockstep(jit, cache);
+  ASSERT_GT(jit.stats().nativeRuns, 0);
+
+  std::ifstream maps("/proc/self/maps");
+  if (!maps) {
+    GTEST_SKIP() << "no /proc/self/maps";
+  }
+  std::string line;
+  while (std::getline(maps, line)) {
+    // "start-end perms offset dev inode path"
+    std::string perms = line.substr(line.find(' ') + 1, 4);
+    EXPECT_NE(perms.substr(0, 3), "rwx") << line;
+  }
+}
+
+TEST_F(JitTest, Stops_At_Budget) {
+  // ADD X0, X0, #1; B #-4
+  load({0x91000400, 0x17FFFFFF});
+  BlockCache cache(jitMemory);
+  Jit jit(cache, jitMemory, {1});
+  uint64_t retired = 0;
+  while (retired < 1001) {
+    retired += jit.runBlock(*cache.lookup(jitCpu.PC), 1001 - retired, jitCpu);
+  }
+  EXPECT_EQ(retired, 1001);
+  EXPECT_EQ(jitCpu.getReg(0), 501);
+  EXPECT_EQ(jitCpu.PC, 4);
+}
@@ -113,3 +113,59 @@ TEST_F(LDRTest, Load_From_Unmapped_Memory_Returns_Zero) {
 
   EXPECT_EQ(state.X[4], 0); // Assuming Memory returns 0 on OOB
 }
+
+TEST_F(LDRTest, Load_Word_Zero_Extends) {
+  // LDR W5, [X1] reads only 4 bytes and clears the upper half of X5
+  state.X[1] = 0x400;
+  state.X[5] = 0xFFFFFFFFFFFFFFFF;
+  ram.write64(0x400, 0x1122334455667788);
+
+  DecodedInstruction instr;
+  instr.type = InstructionType::LDR;
+  instr.rd = 5;
+  instr.rn = 1;
+  instr.imm = 0;
+  instr.size = 2;
+
+  Executor::execute(instr, state, ram);
+
+  EXPECT_EQ(state.X[5], 0x55667788);
+}
+
+TEST_F(LDRTest, Load_Byte_And_Halfword) {
+  state.X[1] = 0x500;
+  ram.write64(0x500, 0x00000000CAFEBEEF);
+
+  DecodedInstruction instr;
+  instr.type = InstructionType::LDR;
+  instr.rd = 6;
+  instr.rn = 1;
+  instr.imm = 1;
+  instr.size = 0; // LDRB W6, [X1, #1]
+  Executor::execute(instr, state, ram);
+  EXPECT_EQ(state.X[6], 0xBE);
+
+  instr.imm = 2;
+  instr.size = 1; // LDRH W6, [X1, #2]
+  Executor::execute(instr, state, ram);
+  EXPECT_EQ(state.X[6], 0xCAFE);
+}
+
+TEST_F(LDRTest, Store_Word_Writes_Four_Bytes) {
+  // STR W2, [X1] must leave the neighbouring bytes alone
+  state.X[1] = 0x600;
+  state.X[2] = 0xAAAABBBBCCCCDDDD;
+  ram.write64(0x600, 0x1111111111111111);
+
+  DecodedInstruction instr;
+  instr.type = InstructionType::STR;
+  instr.rd = 2;
+  instr.rn = 1;
+  instr.imm = 0;
+  instr.mode = AddrMode::Offset;
+  instr.size = 2;
+
+  Executor::execute(instr, state, ram);
+
+  EXPECT_EQ(ram.read64(0x600), 0x11111111CCCCDDDD);
+}
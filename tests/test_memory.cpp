@@ -15,3 +15,185 @@ TEST(MemoryTest, OutofBoundSafe) {
 
   EXPECT_EQ(ram.readByte(9999), 0);
 }
+
+TEST(MemoryTest, Read64Write64RoundTrip) {
+  Memory ram(1024);
+  ram.write64(0x10, 0x1122334455667788);
+  EXPECT_EQ(ram.read64(0x10), 0x1122334455667788);
+  EXPECT_EQ(ram.readByte(0x10), 0x88); // Little endian
+  EXPECT_EQ(ram.read32(0x14), 0x11223344);
+}
+
+TEST(MemoryTest, Access_Straddling_Page_Boundary) {
+  Memory ram(3 * Memory::PAGE_SIZE);
+  uint64_t addr = Memory::PAGE_SIZE - 3;
+  ram.write64(addr, 0xA1B2C3D4E5F60718);
+  EXPECT_EQ(ram.read64(addr), 0xA1B2C3D4E5F60718);
+  EXPECT_EQ(ram.residentPages(), 2);
+}
+
+TEST(MemoryTest, Access_Past_End_Is_Ignored) {
+  Memory ram(1024);
+  ram.write64(1020, 0xFFFFFFFFFFFFFFFF); // Would spill past the last byte
+  EXPECT_EQ(ram.readByte(1020), 0);
+  EXPECT_EQ(ram.read64(1020), 0);
+}
+
+TEST(MemoryTest, Untouched_Pages_Read_Zero_Without_Allocating) {
+  Memory ram(Memory::MAX_SIZE);
+  EXPECT_EQ(ram.read64(0x7FFF00001000), 0);
+  EXPECT_EQ(ram.readByte(0x123456789), 0);
+  EXPECT_EQ(ram.residentPages(), 0);
+}
+
+TEST(MemoryTest, Sparse_48Bit_Address_Space) {
+  // Stack near the top of the 48-bit space plus low code: two pages resident
+  Memory ram(Memory::MAX_SIZE);
+  uint64_t stackTop = Memory::MAX_SIZE - 16;
+  ram.write64(stackTop, 0xCAFEBABE);
+  ram.write64(0x400000, 0xD503201F);
+
+  EXPECT_EQ(ram.read64(stackTop), 0xCAFEBABE);
+  EXPECT_EQ(ram.read64(0x400000), 0xD503201F);
+  EXPECT_EQ(ram.residentPages(), 2);
+  EXPECT_EQ(ram.size(), Memory::MAX_SIZE);
+}
+
+TEST(MemoryTest, Size_Is_Clamped_To_48_Bits) {
+  Memory ram(~uint64_t{0});
+  EXPECT_EQ(ram.size(), Memory::MAX_SIZE);
+  ram.writeByte(Memory::MAX_SIZE, 0xFF); // First address past the space
+  EXPECT_EQ(ram.readByte(Memory::MAX_SIZE), 0);
+  EXPECT_EQ(ram.residentPages(), 0);
+}
+
+// --- Width-templated accessors and software TLB ---
+
+TEST(MemoryTest, Templated_Widths_Little_Endian) {
+  Memory ram(4096);
+  ram.write<uint64_t>(0x20, 0x8877665544332211);
+  EXPECT_EQ(ram.read<uint8_t>(0x20), 0x11);
+  EXPECT_EQ(ram.read<uint16_t>(0x20), 0x2211);
+  EXPECT_EQ(ram.read<uint32_t>(0x21), 0x55443322); // Unaligned
+  EXPECT_EQ(ram.read<uint64_t>(0x20), 0x8877665544332211);
+
+  ram.write<uint16_t>(0x23, 0xBEEF);
+  EXPECT_EQ(ram.read<uint64_t>(0x20), 0x887766BEEF332211);
+}
+
+TEST(MemoryTest, Templated_Access_Straddling_Page) {
+  Memory ram(2 * Memory::PAGE_SIZE);
+  ram.write<uint32_t>(Memory::PAGE_SIZE - 1, 0xAABBCCDD);
+  EXPECT_EQ(ram.read<uint8_t>(Memory::PAGE_SIZE - 1), 0xDD);
+  EXPECT_EQ(ram.read<uint32_t>(Memory::PAGE_SIZE - 1), 0xAABBCCDD);
+}
+
+TEST(MemoryTest, Repeated_Access_Sees_Latest_Data) {
+  // The second and later accesses to a page go through the TLB
+  Memory ram(16 * Memory::PAGE_SIZE);
+  for (uint64_t i = 0; i < 512; i++) {
+    ram.write<uint64_t>(i * 8, i);
+  }
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < 512; i++) {
+    sum += ram.read<uint64_t>(i * 8);
+  }
+  EXPECT_EQ(sum, 511 * 512 / 2);
+}
+
+TEST(MemoryTest, TLB_Conflicts_Do_Not_Alias) {
+  // Pages 64 apart share a TLB slot
+  Memory ram(Memory::MAX_SIZE);
+  uint64_t a = 3 * Memory::PAGE_SIZE;
+  uint64_t b = a + 64 * Memory::PAGE_SIZE;
+  ram.write<uint32_t>(a, 1);
+  ram.write<uint32_t>(b, 2);
+  EXPECT_EQ(ram.read<uint32_t>(a), 1);
+  EXPECT_EQ(ram.read<uint32_t>(b), 2);
+  ram.write<uint32_t>(a, 3);
+  EXPECT_EQ(ram.read<uint32_t>(b), 2);
+  EXPECT_EQ(ram.read<uint32_t>(a), 3);
+}
+
+TEST(MemoryTest, Partial_Last_Page_Stays_Bounded) {
+  // The last page is only partly inside the memory, so it is never cached
+  Memory ram(1000);
+  ram.write<uint32_t>(990, 0x01020304);
+  EXPECT_EQ(ram.read<uint32_t>(990), 0x01020304);
+  ram.write<uint32_t>(998, 0xFFFFFFFF); // Spills past byte 999
+  EXPECT_EQ(ram.read<uint16_t>(998), 0);
+}
+
+namespace {
+struct RecordingObserver : CodeWriteObserver {
+  int writes = 0;
+  void onCodeWrite(uint64_t /*address*/, uint64_t /*length*/) override {
+    writes++;
+  }
+};
+} // namespace
+
+TEST(MemoryTest, Watched_Page_Bypasses_Write_TLB) {
+  Memory ram(4096);
+  RecordingObserver observer;
+  ram.setCodeWriteObserver(&observer);
+  ram.write<uint64_t>(0x100, 1); // Page now cached for writes
+  ram.write<uint64_t>(0x100, 2);
+  EXPECT_EQ(observer.writes, 0);
+
+  ram.watchCode(0x100);
+  ram.write<uint32_t>(0x200, 3);
+  ram.write<uint8_t>(0x201, 4);
+  EXPECT_EQ(observer.writes, 2);
+  ram.setCodeWriteObserver(nullptr);
+}
+
+TEST(MemoryTest, Restore_Rolls_Back_Written_Pages_Only) {
+  Memory ram(uint64_t{1} << 30);
+  ram.write64(0x1000, 0x1111);
+  ram.write64(0x5000, 0x5555);
+  EXPECT_FALSE(ram.restore()); // No snapshot yet
+
+  ram.snapshot();
+  EXPECT_EQ(ram.dirtyPages(), 0);
+  ram.write64(0x1000, 0xAAAA);   // Existing page
+  ram.write64(0x1008, 0xBBBB);   // Same page again, through the write TLB
+  ram.write64(0x3FFF0000, 0xCC); // Page created after the snapshot
+  EXPECT_EQ(ram.dirtyPages(), 2);
+
+  ASSERT_TRUE(ram.restore());
+  EXPECT_EQ(ram.read64(0x1000), 0x1111);
+  EXPECT_EQ(ram.read64(0x1008), 0);
+  EXPECT_EQ(ram.read64(0x3FFF0000), 0);
+  EXPECT_EQ(ram.read64(0x5000), 0x5555);
+  EXPECT_EQ(ram.dirtyPages(), 0);
+
+  // The baseline survives a restore
+  ram.write64(0x1000, 0xDDDD);
+  ASSERT_TRUE(ram.restore());
+  EXPECT_EQ(ram.read64(0x1000), 0x1111);
+}
+
+TEST(MemoryTest, Restore_Tracks_Writes_From_Every_View) {
+  Memory ram(1 << 20);
+  ram.write64(0x2000, 7);
+  std::unique_ptr<Memory> view = ram.makeView();
+  view->write64(0x2000, 7); // Fill the view's write TLB before the snapshot
+  ram.snapshot();
+  view->write64(0x2000, 8);
+  ASSERT_TRUE(ram.restore());
+  EXPECT_EQ(view->read64(0x2000), 7);
+}
+
+TEST(MemoryTest, Restore_Reports_Code_Pages) {
+  Memory ram(4096);
+  RecordingObserver observer;
+  ram.setCodeWriteObserver(&observer);
+  ram.watchCode(0);
+  ram.snapshot();
+  ram.write<uint32_t>(0, 0xD503201F);
+  ASSERT_TRUE(ram.restore());
+  EXPECT_EQ(observer.writes, 2); // The store and the restore
+  EXPECT_EQ(ram.read<uint32_t>(0), 0);
+  ram.setCodeWriteObserver(nullptr);
+}
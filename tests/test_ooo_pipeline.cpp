@@ -0,0 +1,173 @@
+#include "guest_program.h"
+#include "ooo_pipeline.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <vector>
+
+// Runs a guest program through a Simulator with an OutOfOrderPipeline
+// attached
+class OutOfOrderPipelineTest : public ::testing::Test {
+protected:
+  arm64::CPUState cpu{};
+  Memory memory{64 * 1024};
+
+  auto run(const std::vector<uint32_t> &words, OutOfOrderConfig config = {},
+           std::unique_ptr<DirectionPredictor> predictor = nullptr)
+      -> OutOfOrderPipeline {
+    OutOfOrderPipeline core(config, std::move(predictor));
+    RunStats ran = run_observed(cpu, memory, words, {&core});
+    EXPECT_EQ(core.stats().instructions, ran.instructions);
+    return core;
+  }
+
+  // ADD Xd, Xn, #imm
+  static auto add(uint32_t d, uint32_t n, uint32_t imm = 1) -> uint32_t {
+    return 0x91000000 | imm << 10 | n << 5 | d;
+  }
+  // LDR Xt, [Xn]
+  static auto ldr(uint32_t t, uint32_t n) -> uint32_t {
+    return 0xF9400000 | n << 5 | t;
+  }
+};
+
+TEST_F(OutOfOrderPipelineTest, Independent_Instructions_Use_The_Full_Width) {
+  std::vector<uint32_t> words;
+  for (uint32_t i = 0; i < 400; i++) {
+    words.push_back(add(i % 8, 20)); // ADD Xi, X20, #1
+  }
+  OutOfOrderStats stats = run(words).stats();
+  EXPECT_EQ(stats.instructions, 400);
+  EXPECT_GT(stats.ipc(), 3.7);
+  EXPECT_EQ(stats.dataWaitCycles + stats.loadWaitCycles, 0);
+}
+
+TEST_F(OutOfOrderPipelineTest, Dependence_Chain_Runs_One_Per_Cycle) {
+  std::vector<uint32_t> words(400, add(0, 0)); // ADD X0, X0, #1
+  OutOfOrderStats stats = run(words).stats();
+  EXPECT_LT(stats.ipc(), 1.05);
+  EXPECT_GT(stats.ipc(), 0.9);
+  EXPECT_GT(stats.dataWaitCycles, 0);
+  EXPECT_EQ(cpu.getReg(0), 400);
+}
+
+TEST_F(OutOfOrderPipelineTest, Renaming_Removes_False_Dependences) {
+  // LDR X0, [X10]; ADD X0, X1, #1; ADD X2, X0, #1
+  // The second ADD reads the renamed X0 of the first ADD, not the load
+  cpu.setReg(10, 0x8000);
+  OutOfOrderStats stats =
+      run({ldr(0, 10), add(0, 1), add(2, 0)}).stats();
+  EXPECT_EQ(stats.loadWaitCycles, 0);
+  EXPECT_EQ(stats.dataWaitCycles, 1);
+}
+
+TEST_F(OutOfOrderPipelineTest, Hints_Blame_The_Slow_Producer) {
+  // LDR X0, [X10]; ADD X1, X0, #1; ADD X2, X0, #2
+  cpu.setReg(10, 0x8000);
+  OutOfOrderPipeline core = run({ldr(0, 10), add(1, 0), add(2, 0, 2)});
+  EXPECT_EQ(core.stats().loadWaitCycles, 2 * 4); // latency.LDR each
+  std::vector<CriticalPathHint> hints = core.hints(4);
+  ASSERT_EQ(hints.size(), 1);
+  EXPECT_EQ(hints[0].pc, 0);
+  EXPECT_EQ(hints[0].type, InstructionType::LDR);
+  EXPECT_EQ(hints[0].count, 2);
+  EXPECT_EQ(hints[0].cycles, 8);
+
+  std::ostringstream text;
+  core.report(text);
+  EXPECT_NE(text.str().find("critical producer:    0x0 LDR"),
+            std::string::npos)
+      << text.str();
+}
+
+TEST_F(OutOfOrderPipelineTest, Small_Windows_Stall_Dispatch) {
+  std::vector<uint32_t> words;
+  for (uint32_t i = 0; i < 64; i++) {
+    words.push_back(ldr(i % 8, 10));
+  }
+  OutOfOrderConfig config;
+  config.latency[static_cast<size_t>(InstructionType::LDR)] = 20;
+  cpu.setReg(10, 0x8000);
+  OutOfOrderStats wide = run(words, config).stats();
+  EXPECT_EQ(wide.robFullCycles, 0);
+  EXPECT_LT(wide.cycles, 64 / 4 + 30);
+
+  // Eight loads in flight at a time
+  config.robSize = 8;
+  cpu = {};
+  cpu.setReg(10, 0x8000);
+  OutOfOrderStats narrow = run(words, config).stats();
+  EXPECT_GT(narrow.robFullCycles, 0);
+  EXPECT_GT(narrow.cycles, 64 / 8 * 20);
+
+  // A load followed by a chain waiting on it fills two reservation stations
+  words.assign(16, add(0, 0));
+  words.insert(words.begin(), ldr(0, 10));
+  config = {};
+  config.rsSize = 2;
+  cpu = {};
+  cpu.setReg(10, 0x8000);
+  EXPECT_GT(run(words, config).stats().rsFullCycles, 0);
+}
+
+TEST_F(OutOfOrderPipelineTest, Static_Prediction_And_Redirects) {
+  // 0x00: SUB X1, X1, #1; CMP X1, #0; B.NE 0x00  (10 iterations)
+  // The backward branch is predicted taken, so only the exit mispredicts
+  cpu.setReg(1, 10);
+  OutOfOrderStats loop = run({0xD1000421, 0xF100003F, 0x54FFFFC1}).stats();
+  EXPECT_EQ(loop.branches, 10);
+  EXPECT_EQ(loop.mispredicts, 1);
+  EXPECT_GT(loop.flagWaitCycles, 0);
+
+  // CMP X1, #0; B.EQ +8; ADD X0, X0, #1; ADD X2, X2, #1
+  // A taken forward branch is predicted not taken
+  cpu = {};
+  memory.write<uint32_t>(12, 0);
+  OutOfOrderStats skip =
+      run({0xF100003F, 0x54000040, add(0, 0), add(2, 2)}).stats();
+  EXPECT_EQ(skip.instructions, 3);
+  EXPECT_EQ(skip.mispredicts, 1);
+  EXPECT_GT(skip.fetchRedirectCycles, 0);
+}
+
+TEST_F(OutOfOrderPipelineTest, Dynamic_Predictor_Learns_Inner_Loop_Exits) {
+  // 0x00: ADD X2, X3, #3
+  // 0x04: SUB X2, X2, #1; CMP X2, #0; B.NE 0x04  (3 iterations)
+  // 0x10: SUB X1, X1, #1; CMP X1, #0; B.NE 0x00  (100 iterations)
+  const std::vector<uint32_t> words = {0x91000C62, 0xD1000442, 0xF100005F,
+                                       0x54FFFFC1, 0xD1000421, 0xF100003F,
+                                       0x54FFFF41};
+  cpu.setReg(1, 100);
+  OutOfOrderStats fixed = run(words).stats();
+  EXPECT_EQ(fixed.branches, 400);
+  EXPECT_EQ(fixed.mispredicts, 101); // Every exit
+
+  cpu = {};
+  cpu.setReg(1, 100);
+  OutOfOrderStats tage =
+      run(words, {}, std::make_unique<TagePredictor>()).stats();
+  EXPECT_EQ(tage.branches, 400);
+  EXPECT_LT(tage.mispredicts, 20);
+  EXPECT_LT(tage.fetchRedirectCycles, fixed.fetchRedirectCycles);
+  EXPECT_GT(tage.ipc(), fixed.ipc());
+}
+
+TEST_F(OutOfOrderPipelineTest, Config_Parse) {
+  OutOfOrderConfig config;
+  std::string error;
+  std::istringstream good("fetch_width = 8\n"
+                          "issue_width = 6   # six ports\n"
+                          "rob_size = 320\n"
+                          "latency.LDR = 5\n");
+  ASSERT_TRUE(config.parse(good, error)) << error;
+  EXPECT_EQ(config.fetchWidth, 8);
+  EXPECT_EQ(config.issueWidth, 6);
+  EXPECT_EQ(config.robSize, 320);
+  EXPECT_EQ(config.latency[static_cast<size_t>(InstructionType::LDR)], 5);
+
+  std::istringstream zero("rob_size = 0\n");
+  EXPECT_FALSE(config.parse(zero, error));
+  EXPECT_NE(error.find("1: rob_size must be at least 1"), std::string::npos)
+      << error;
+  std::istringstream unknown("stages = 5\n");
+  EXPECT_FALSE(config.parse(unknown, error));
+}
@@ -0,0 +1,76 @@
+#include "guest_program.h"
+#include "pc_profiler.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <vector>
+
+// Runs a nested loop through a Simulator under a PcProfiler:
+// 0x00: ADD X2, X3, #8
+// 0x04: SUB X2, X2, #1; CMP X2, #0; B.NE 0x04   (inner: 8 iterations)
+// 0x10: SUB X1, X1, #1; CMP X1, #0; B.NE 0x00   (outer: X1 iterations)
+class PcProfilerTest : public ::testing::Test {
+protected:
+  arm64::CPUState cpu{};
+  Memory memory{64 * 1024};
+
+  void SetUp() override {
+    const std::vector<uint32_t> words = {0x91002062, 0xD1000442, 0xF100005F,
+                                         0x54FFFFC1, 0xD1000421, 0xF100003F,
+                                         0x54FFFF41};
+    load_words(memory, words);
+    cpu.setReg(1, 100);
+  }
+};
+
+TEST_F(PcProfilerTest, Every_Instruction_Gives_The_Exact_Histogram) {
+  PcProfiler profiler(1);
+  Simulator sim(cpu, memory);
+  EXPECT_EQ(profiler.run(sim, cpu), StopReason::UndefinedInstruction);
+  // 1 + 8 * 3 + 3 instructions per outer iteration
+  EXPECT_EQ(sim.stats().instructions, 2800);
+  EXPECT_EQ(profiler.samples(), 2800);
+  EXPECT_EQ(profiler.pcSamples().at(0x04), 800); // Inner loop head
+  EXPECT_EQ(profiler.pcSamples().at(0x00), 99);  // Outer loop head
+  EXPECT_EQ(profiler.pcSamples().at(0x1C), 1);   // Where the guest stops
+
+  auto hottest = profiler.hottest(4);
+  ASSERT_EQ(hottest.size(), 4);
+  EXPECT_EQ(hottest[0].first, 0x04); // Ties in address order
+  EXPECT_EQ(hottest[1].first, 0x08);
+  EXPECT_EQ(hottest[2].first, 0x0C);
+  EXPECT_EQ(hottest[3].first, 0x10);
+}
+
+TEST_F(PcProfilerTest, Period_Carries_Over_Between_Runs) {
+  PcProfiler profiler(7);
+  Simulator sim(cpu, memory);
+  EXPECT_EQ(profiler.run(sim, cpu, 10), StopReason::InstructionLimit);
+  EXPECT_EQ(profiler.samples(), 1);
+  EXPECT_EQ(profiler.run(sim, cpu, 4), StopReason::InstructionLimit);
+  EXPECT_EQ(profiler.samples(), 2); // After instruction 14
+  profiler.run(sim, cpu);
+  EXPECT_EQ(profiler.samples(), 2800 / 7);
+  uint64_t inner = 0;
+  for (uint64_t pc : {0x04, 0x08, 0x0C}) {
+    inner += profiler.pcSamples().count(pc) ? profiler.pcSamples().at(pc) : 0;
+  }
+  EXPECT_GE(inner, profiler.samples() * 3 / 4);
+  profiler.reset();
+  EXPECT_EQ(profiler.samples(), 0);
+  EXPECT_TRUE(profiler.pcSamples().empty());
+}
+
+TEST_F(PcProfilerTest, Raw_Addresses_Without_Symbols) {
+  PcProfiler profiler(1);
+  Simulator sim(cpu, memory);
+  profiler.run(sim, cpu);
+
+  std::ostringstream text;
+  profiler.report(text, nullptr, 1);
+  EXPECT_EQ(text.str(), "samples:              2800 (every 1 instructions)\n"
+                        "hot pc:               0x4 800 (28.5714%)\n");
+  std::ostringstream folded;
+  profiler.writeFolded(folded);
+  EXPECT_EQ(folded.str().substr(0, 15), "0x0 99\n0x4 800\n");
+  EXPECT_EQ(PcProfiler::symbolize(0x1234, nullptr), "0x1234");
+}
@@ -0,0 +1,91 @@
+#include "guest_program.h"
+#include "pipeline_model.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <vector>
+
+// Runs a guest program through a Simulator with an InOrderPipeline attached
+class PipelineModelTest : public ::testing::Test {
+protected:
+  arm64::CPUState cpu{};
+  Memory memory{64 * 1024};
+
+  auto run(const std::vector<uint32_t> &words, PipelineConfig config = {})
+      -> PipelineStats {
+    InOrderPipeline pipeline(config);
+    RunStats ran = run_observed(cpu, memory, words, {&pipeline});
+    EXPECT_EQ(pipeline.stats().instructions, ran.instructions);
+    return pipeline.stats();
+  }
+};
+
+TEST_F(PipelineModelTest, Independent_Instructions_Fill_The_Pipeline) {
+  // ADD X0, X0, #1; ADD X1, X1, #1; ADD X2, X2, #1; ADD X3, X3, #1
+  PipelineStats stats =
+      run({0x91000400, 0x91000421, 0x91000442, 0x91000463});
+  EXPECT_EQ(stats.instructions, 4);
+  EXPECT_EQ(stats.cycles, 4 + 4); // N + stages - 1
+  EXPECT_EQ(stats.loadUseStalls + stats.dataStalls + stats.flagStalls, 0);
+}
+
+TEST_F(PipelineModelTest, Load_Use_Costs_One_Bubble) {
+  // LDR X0, [X10]; ADD X1, X0, #1; ADD X2, X2, #1
+  cpu.setReg(10, 0x8000);
+  PipelineStats stats = run({0xF9400140, 0x91000401, 0x91000442});
+  EXPECT_EQ(stats.loadUseStalls, 1);
+  EXPECT_EQ(stats.dataStalls, 0);
+  EXPECT_EQ(stats.cycles, 3 + 4 + 1);
+
+  // A slower load: latency.LDR = 4 leaves three bubbles
+  PipelineConfig config;
+  std::string error;
+  std::istringstream text("latency.LDR = 4\n");
+  ASSERT_TRUE(config.parse(text, error)) << error;
+  cpu = {};
+  cpu.setReg(10, 0x8000);
+  stats = run({0xF9400140, 0x91000401, 0x91000442}, config);
+  EXPECT_EQ(stats.loadUseStalls, 3);
+}
+
+TEST_F(PipelineModelTest, Taken_Branches_And_Flags) {
+  // 0x00: SUB X1, X1, #1; CMP X1, #0; B.NE 0x00  (3 iterations)
+  cpu.setReg(1, 3);
+  PipelineStats stats = run({0xD1000421, 0xF100003F, 0x54FFFFC1});
+  EXPECT_EQ(stats.instructions, 9);
+  EXPECT_EQ(stats.branchPenaltyCycles, 2 * 2); // Last B.NE falls through
+  EXPECT_EQ(stats.flagStalls, 0);              // Forwarded
+  EXPECT_EQ(stats.cycles, 9 + 4 + 4);
+  EXPECT_DOUBLE_EQ(stats.cpi(), 17.0 / 9.0);
+
+  // Flags readable two cycles after CMP enters EX: one bubble per B.NE
+  PipelineConfig config;
+  config.flagLatency = 2;
+  cpu = {};
+  cpu.setReg(1, 3);
+  stats = run({0xD1000421, 0xF100003F, 0x54FFFFC1}, config);
+  EXPECT_EQ(stats.flagStalls, 3);
+  EXPECT_EQ(stats.cycles, 9 + 4 + 4 + 3);
+}
+
+TEST_F(PipelineModelTest, Config_Parse_Reports_Bad_Lines) {
+  PipelineConfig config;
+  std::string error;
+  std::istringstream good("# in-order core\n"
+                          "stages = 7\n"
+                          "latency.ADD_REG = 2   # slow adder\n"
+                          "taken_branch_penalty = 3\n");
+  ASSERT_TRUE(config.parse(good, error)) << error;
+  EXPECT_EQ(config.stages, 7);
+  EXPECT_EQ(config.latency[static_cast<size_t>(InstructionType::ADD_REG)], 2);
+  EXPECT_EQ(config.takenBranchPenalty, 3);
+
+  std::istringstream unknown("stages = 5\nwidth = 2\n");
+  EXPECT_FALSE(config.parse(unknown, error));
+  EXPECT_NE(error.find("2: unknown key width"), std::string::npos) << error;
+
+  std::istringstream badType("latency.MUL = 3\n");
+  EXPECT_FALSE(config.parse(badType, error));
+  std::istringstream badValue("flag_latency = -1\n");
+  EXPECT_FALSE(config.parse(badValue, error));
+  EXPECT_FALSE(config.load("/nonexistent/pipeline.cfg", error));
+}
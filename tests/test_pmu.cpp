@@ -0,0 +1,107 @@
+#include "guest_program.h"
+#include "pmu.h"
+#include "smp_simulator.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <vector>
+
+static_assert(alignof(PmuCounters) == 64, "one block per cache line group");
+
+TEST(PmuTest, Count_Classifies_Instructions) {
+  PmuCounters pmu;
+  pmu.count(Decoder::decode(0xF9400020), false); // LDR X0, [X1]
+  pmu.count(Decoder::decode(0xF8408C20), false); // LDR X0, [X1, #8]!
+  pmu.count(Decoder::decode(0xF8008420), false); // STR X0, [X1], #8
+  pmu.count(Decoder::decode(0xF100003F), false); // CMP X1, #0
+  pmu.count(Decoder::decode(0x91000400), false); // ADD X0, X0, #1
+  pmu.count(Decoder::decode(0x54FFFFA1), true);  // B.NE
+  pmu.count(Decoder::decode(0x54FFFFA1), false);
+  pmu.count(Decoder::decode(0x14000001), true); // B
+
+  EXPECT_EQ(pmu.instructions(), 8);
+  EXPECT_EQ(pmu.retired[static_cast<size_t>(InstructionType::LDR)], 2);
+  EXPECT_EQ(pmu.retired[static_cast<size_t>(InstructionType::SUB_IMM)], 1);
+  EXPECT_EQ(pmu.loads[static_cast<size_t>(AddrMode::Offset)], 1);
+  EXPECT_EQ(pmu.loads[static_cast<size_t>(AddrMode::PreIndex)], 1);
+  EXPECT_EQ(pmu.stores[static_cast<size_t>(AddrMode::PostIndex)], 1);
+  EXPECT_EQ(pmu.branchesTaken, 2);
+  EXPECT_EQ(pmu.branchesNotTaken, 1);
+  EXPECT_EQ(pmu.flagSetting, 1);
+}
+
+TEST(PmuTest, Intervals_And_Json) {
+  PmuCounters pmu;
+  pmu.count(Decoder::decode(0xF100003F), false); // CMP X1, #0
+  PmuCounters first = pmu;
+  pmu.count(Decoder::decode(0xF9400020), false); // LDR X0, [X1]
+  pmu.count(Decoder::decode(0x54FFFFA1), true);  // B.NE
+
+  PmuCounters interval = pmu.since(first);
+  EXPECT_EQ(interval.instructions(), 2);
+  EXPECT_EQ(interval.flagSetting, 0);
+  interval += first;
+  EXPECT_EQ(interval.json(), pmu.json());
+
+  EXPECT_EQ(first.json(),
+            "{\"instructions\":1,\"retired\":{\"UNKNOWN\":0,\"ADD_IMM\":0,"
+            "\"SUB_IMM\":1,\"ADD_REG\":0,\"SUB_REG\":0,\"LDR\":0,\"STR\":0,"
+            "\"BRANCH\":0,\"BRANCH_COND\":0},"
+            "\"loads\":{\"offset\":0,\"pre_index\":0,\"post_index\":0},"
+            "\"stores\":{\"offset\":0,\"pre_index\":0,\"post_index\":0},"
+            "\"branches\":{\"taken\":0,\"not_taken\":0},\"flag_setting\":1}");
+  pmu.clear();
+  EXPECT_EQ(pmu.instructions(), 0);
+}
+
+// LDR X0, [X10]; ADD X0, X0, #1; STR X0, [X10]; SUB X1, X1, #1;
+// CMP X1, #0; B.NE #-20
+const std::vector<uint32_t> INCREMENT_LOOP = {
+    0xF9400140, 0x91000400, 0xF9000140,
+    0xD1000421, 0xF100003F, 0x54FFFF61};
+
+TEST(PmuTest, Engines_Count_Only_When_Compiled_In) {
+  Memory memory{64 * 1024};
+  load_words(memory, INCREMENT_LOOP);
+  arm64::CPUState cpu{};
+  cpu.setReg(1, 3);
+  cpu.setReg(10, 0x8000);
+  PmuCounters pmu;
+  PmuCounters::attach(&pmu);
+  Simulator sim(cpu, memory);
+  sim.run();
+  PmuCounters::attach(nullptr);
+
+#if defined(AARCH64_SIM_PMU)
+  EXPECT_EQ(pmu.instructions(), sim.stats().instructions);
+  EXPECT_EQ(pmu.instructions(), 18);
+  EXPECT_EQ(pmu.loads[static_cast<size_t>(AddrMode::Offset)], 3);
+  EXPECT_EQ(pmu.stores[static_cast<size_t>(AddrMode::Offset)], 3);
+  EXPECT_EQ(pmu.branchesTaken, 2);
+  EXPECT_EQ(pmu.branchesNotTaken, 1);
+  EXPECT_EQ(pmu.flagSetting, 3);
+#else
+  EXPECT_EQ(pmu.instructions(), 0);
+#endif
+}
+
+TEST(PmuTest, Smp_Cores_Count_Separately) {
+  Memory memory{1 << 20};
+  load_words(memory, INCREMENT_LOOP);
+  std::vector<arm64::CPUState> cpus(2, arm64::CPUState{});
+  for (size_t i = 0; i < cpus.size(); i++) {
+    cpus[i].setReg(1, 10 * (i + 1));
+    cpus[i].setReg(10, 0x8000 + 8 * i);
+  }
+  SmpSimulator smp(cpus, memory, {7, false});
+  smp.run();
+
+  for (size_t i = 0; i < cpus.size(); i++) {
+#if defined(AARCH64_SIM_PMU)
+    EXPECT_EQ(smp.pmu(i).instructions(), 60 * (i + 1));
+    EXPECT_EQ(smp.pmu(i).branchesNotTaken, 1);
+#else
+    EXPECT_EQ(smp.pmu(i).instructions(), 0);
+#endif
+  }
+  EXPECT_EQ(PmuCounters::sink(), nullptr);
+}
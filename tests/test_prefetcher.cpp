@@ -0,0 +1,131 @@
+#include "guest_program.h"
+#include "prefetcher.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <vector>
+
+// Runs a guest loop through a Simulator with a PrefetchModel attached
+class PrefetcherTest : public ::testing::Test {
+protected:
+  static constexpr uint64_t DATA = 0x4000;
+  arm64::CPUState cpu{};
+  Memory memory{64 * 1024};
+
+  // 512 iterations of LDR X0, [X10], #8
+  const std::vector<uint32_t> SEQUENTIAL = {0xF8408540, 0xD1000421,
+                                            0xF100003F, 0x54FFFFA1};
+  // 64 iterations of LDR X0, [X10]; ADD X10, X10, #256
+  const std::vector<uint32_t> STRIDED = {0xF9400140, 0x9104014A, 0xD1000421,
+                                         0xF100003F, 0x54FFFF81};
+
+  void run(const std::vector<uint32_t> &words, uint64_t iterations,
+           const std::vector<RetireObserver *> &observers) {
+    cpu = {};
+    cpu.setReg(1, iterations);
+    cpu.setReg(10, DATA);
+    run_observed(cpu, memory, words, observers);
+  }
+
+  auto run(const std::vector<uint32_t> &words, uint64_t iterations,
+           const PrefetchConfig &config) -> PrefetchStats {
+    PrefetchModel model(config);
+    run(words, iterations, {&model});
+    return model.stats();
+  }
+};
+
+TEST_F(PrefetcherTest, Next_Line_Covers_A_Sequential_Walk) {
+  PrefetchConfig config;
+  config.kind = PrefetcherKind::NextLine;
+  config.degree = 1;
+  PrefetchStats stats = run(SEQUENTIAL, 512, config);
+  EXPECT_EQ(stats.accesses, 512);
+  EXPECT_EQ(stats.misses, 1); // Only the first line
+  EXPECT_EQ(stats.useful, 63);
+  EXPECT_EQ(stats.issued, 64); // One line past the end
+  EXPECT_NEAR(stats.coverage(), 63.0 / 64.0, 1e-9);
+  EXPECT_NEAR(stats.accuracy(), 63.0 / 64.0, 1e-9);
+
+  // One line ahead is 32 instructions of warning; a slower memory makes
+  // every prefetch late, while a deeper stream buffer stays in time
+  config.latency = 64;
+  EXPECT_EQ(run(SEQUENTIAL, 512, config).timeliness(), 0.0);
+  config.kind = PrefetcherKind::Stream;
+  PrefetchStats stream = run(SEQUENTIAL, 512, config);
+  EXPECT_EQ(stream.misses, 1);
+  EXPECT_GT(stream.timeliness(), 0.95);
+}
+
+TEST_F(PrefetcherTest, Stride_Table_Learns_Large_Strides) {
+  PrefetchConfig config;
+  config.kind = PrefetcherKind::NextLine;
+  PrefetchStats nextLine = run(STRIDED, 64, config);
+  EXPECT_EQ(nextLine.misses, 64); // Every access skips four lines
+  EXPECT_EQ(nextLine.useful, 0);
+
+  config.kind = PrefetcherKind::Stride;
+  PrefetchStats stride = run(STRIDED, 64, config);
+  // Allocate, learn the stride, confirm it twice, then run ahead
+  EXPECT_EQ(stride.misses, 4);
+  EXPECT_GT(stride.accuracy(), 0.9);
+  EXPECT_GT(stride.coverage(), 0.9);
+}
+
+TEST_F(PrefetcherTest, Prefetches_Warm_A_Cache_Hierarchy) {
+  CacheHierarchy cold;
+  run(STRIDED, 64, {&cold});
+  EXPECT_EQ(cold.level(CacheLevel::L1D)->stats().readMisses, 64);
+
+  CacheHierarchy warm;
+  PrefetchModel model(PrefetchConfig{}, &warm);
+  run(STRIDED, 64, {&model, &warm});
+  const CacheStats &l1d = warm.level(CacheLevel::L1D)->stats();
+  EXPECT_EQ(l1d.readMisses, model.stats().misses);
+  EXPECT_EQ(l1d.readMisses, 4);
+  EXPECT_EQ(l1d.prefetches, model.stats().issued);
+  EXPECT_EQ(warm.level(CacheLevel::LLC)->stats().prefetches,
+            model.stats().issued);
+}
+
+TEST(StreamPrefetcherTest, Follows_Descending_Streams) {
+  StreamPrefetcher streams(2, 3);
+  std::vector<uint64_t> lines;
+  PrefetchAccess access;
+  access.miss = true;
+  access.line = 100;
+  streams.observe(access, lines);
+  EXPECT_EQ(lines, (std::vector<uint64_t>{101, 102, 103}));
+
+  // A miss just below the last one starts a descending stream
+  lines.clear();
+  access.line = 99;
+  streams.observe(access, lines);
+  EXPECT_EQ(lines, (std::vector<uint64_t>{98, 97, 96}));
+  // Using 97 moves that stream's window down to 96..94
+  lines.clear();
+  access.miss = false;
+  access.line = 97;
+  streams.observe(access, lines);
+  EXPECT_EQ(lines, (std::vector<uint64_t>{95, 94}));
+}
+
+TEST(PrefetchConfigTest, Parse) {
+  PrefetchConfig config;
+  std::string error;
+  std::istringstream good("prefetcher = stream\n"
+                          "streams = 8\n"
+                          "depth = 6   # lines ahead\n"
+                          "latency = 100\n");
+  ASSERT_TRUE(config.parse(good, error)) << error;
+  EXPECT_EQ(config.kind, PrefetcherKind::Stream);
+  EXPECT_EQ(config.streams, 8);
+  EXPECT_EQ(config.depth, 6);
+  EXPECT_EQ(config.latency, 100);
+  EXPECT_STREQ(make_prefetcher(config)->name(), "stream");
+
+  std::istringstream kind("prefetcher = markov\n");
+  EXPECT_FALSE(config.parse(kind, error));
+  std::istringstream degree("degree = 0\n");
+  EXPECT_FALSE(config.parse(degree, error));
+  EXPECT_EQ(error, "1: degree must be at least 1");
+}
@@ -28,3 +28,69 @@ TEST(RegisterTest, RegisterStateIndependence) {
   EXPECT_EQ(cpu.getReg(0), 100);
   EXPECT_EQ(cpu.getReg(1), 200);
 }
+
+TEST(RegisterTest, ConditionTableMatchesDefinitions) {
+  PState pstate;
+  for (uint8_t nzcv = 0; nzcv < 16; nzcv++) {
+    pstate.setNZCV(nzcv);
+    bool n = pstate.N();
+    bool z = pstate.Z();
+    bool c = pstate.C();
+    bool v = pstate.V();
+    const bool expected[16] = {
+        z,            !z,          c,      !c,     // EQ NE CS CC
+        n,            !n,          v,      !v,     // MI PL VS VC
+        c && !z,      !c || z,     n == v, n != v, // HI LS GE LT
+        !z && n == v, z || n != v, true,   true,   // GT LE AL NV
+    };
+    for (uint8_t cond = 0; cond < 16; cond++) {
+      EXPECT_EQ(pstate.condition(cond), expected[cond])
+          << "cond " << int(cond) << " nzcv " << int(nzcv);
+    }
+  }
+}
+
+TEST(RegisterTest, RecordedFlagsMaterializeOnWrite) {
+  PState pstate;
+  // SUBS of equal values: Z and C (no borrow)
+  pstate.record(PState::Op::Sub64, 5, 5, 0);
+  EXPECT_EQ(pstate.nzcv(), FLAG_Z | FLAG_C);
+  EXPECT_TRUE(pstate.condition(0x0)); // EQ
+  EXPECT_TRUE(pstate.condition(0x2)); // CS
+
+  // Writing one flag keeps the other three
+  pstate.setN(true);
+  EXPECT_EQ(pstate.nzcv(), FLAG_N | FLAG_Z | FLAG_C);
+  EXPECT_TRUE(pstate.condition(0x0));  // EQ, now from the stored flags
+  EXPECT_FALSE(pstate.condition(0xA)); // GE: N != V
+}
+
+TEST(RegisterTest, AfterSubMatchesRecordedFlags) {
+  // Boundary operands of both widths, every condition code
+  const uint64_t values[] = {0,
+                             1,
+                             2,
+                             0x7FFFFFFF,
+                             0x80000000,
+                             0xFFFFFFFF,
+                             0x7FFFFFFFFFFFFFFF,
+                             0x8000000000000000,
+                             0xFFFFFFFFFFFFFFFF,
+                             0x123456789};
+  for (bool is64 : {false, true}) {
+    uint64_t mask = is64 ? ~uint64_t{0} : 0xFFFFFFFFULL;
+    for (uint64_t a : values) {
+      for (uint64_t b : values) {
+        PState pstate;
+        pstate.record(is64 ? PState::Op::Sub64 : PState::Op::Sub32, a & mask,
+                      b & mask, (a - b) & mask);
+        for (uint8_t cond = 0; cond < 16; cond++) {
+          EXPECT_EQ(PState::afterSub(cond, a & mask, b & mask, is64),
+                    pstate.condition(cond))
+              << std::hex << a << " - " << b << " cond " << int(cond)
+              << (is64 ? " X" : " W");
+        }
+      }
+    }
+  }
+}
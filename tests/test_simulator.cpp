@@ -0,0 +1,256 @@
+#include "simulator.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <vector>
+
+// Fixture: loads a small guest program at address 0 and resets the CPU
+class SimulatorTest : public ::testing::Test {
+protected:
+  arm64::CPUState cpu;
+  Memory memory{4096};
+
+  void SetUp() override {
+    cpu.SP = 0;
+    cpu.PC = 0;
+    for (auto &reg : cpu.X) {
+      reg = 0;
+    }
+    cpu.pstate = {};
+  }
+
+  void load(const std::vector<uint32_t> &words, uint64_t base = 0) {
+    for (size_t i = 0; i < words.size(); i++) {
+      for (uint32_t b = 0; b < 4; b++) {
+        memory.writeByte(base + i * 4 + b, (words[i] >> (b * 8)) & 0xFF);
+      }
+    }
+  }
+};
+
+// Counts X1 down to zero while adding 2 to X0 on every iteration:
+//   0x00: ADD  X0, X0, #2
+//   0x04: SUB  X1, X1, #1
+//   0x08: CMP  X1, #0
+//   0x0C: B.NE 0x00
+//   0x10: (zero word, undefined)
+const std::vector<uint32_t> COUNT_LOOP = {0x91000800, 0xD1000421, 0xF100003F,
+                                          0x54FFFFA1};
+
+TEST_F(SimulatorTest, Step_Advances_PC_By_Four) {
+  load({0x91000800}); // ADD X0, X0, #2
+  Simulator sim(cpu, memory);
+
+  EXPECT_EQ(sim.step(), StopReason::Retired);
+  EXPECT_EQ(cpu.PC, 4);
+  EXPECT_EQ(cpu.getReg(0), 2);
+  EXPECT_EQ(sim.stats().instructions, 1);
+}
+
+TEST_F(SimulatorTest, Step_Taken_Branch_Uses_Target_Only) {
+  load({0x14000004}); // B #16
+  Simulator sim(cpu, memory);
+
+  sim.step();
+  EXPECT_EQ(cpu.PC, 16); // Not 20: no extra +4 after a taken branch
+}
+
+TEST_F(SimulatorTest, Run_Takes_Branch_Beyond_16_Bit_Offsets) {
+  // 0x000000: B #0x100000; 0x100000: ADD X0, X0, #2; then undefined
+  Memory far(2 * 1024 * 1024);
+  far.write<uint32_t>(0, 0x14040000);
+  far.write<uint32_t>(0x100000, 0x91000800);
+  Simulator sim(cpu, far);
+
+  // A truncated offset would spin on the branch until the limit
+  EXPECT_EQ(sim.run(100), StopReason::UndefinedInstruction);
+  EXPECT_EQ(cpu.PC, 0x100004);
+  EXPECT_EQ(cpu.getReg(0), 2);
+}
+
+TEST_F(SimulatorTest, Step_Undefined_Leaves_PC) {
+  cpu.PC = 0x100; // Zero-filled memory does not decode
+  Simulator sim(cpu, memory);
+
+  EXPECT_EQ(sim.step(), StopReason::UndefinedInstruction);
+  EXPECT_EQ(cpu.PC, 0x100);
+  EXPECT_EQ(sim.stats().instructions, 0);
+}
+
+TEST_F(SimulatorTest, Run_Loop_Until_Undefined) {
+  load(COUNT_LOOP);
+  cpu.setReg(1, 5);
+  Simulator sim(cpu, memory);
+
+  EXPECT_EQ(sim.run(), StopReason::UndefinedInstruction);
+  EXPECT_EQ(cpu.getReg(0), 10);
+  EXPECT_EQ(cpu.getReg(1), 0);
+  EXPECT_EQ(cpu.PC, 0x10);
+  EXPECT_EQ(sim.stats().instructions, 20);
+}
+
+TEST_F(SimulatorTest, Run_Stops_At_Instruction_Limit) {
+  load(COUNT_LOOP);
+  cpu.setReg(1, 5);
+  Simulator sim(cpu, memory);
+
+  EXPECT_EQ(sim.run(6), StopReason::InstructionLimit);
+  EXPECT_EQ(sim.stats().instructions, 6);
+  EXPECT_EQ(cpu.PC, 0x08); // Second iteration, about to CMP
+}
+
+TEST_F(SimulatorTest, RunUntil_Stops_At_Breakpoint) {
+  load(COUNT_LOOP);
+  cpu.setReg(1, 5);
+  Simulator sim(cpu, memory);
+
+  EXPECT_EQ(sim.run_until(0x0C), StopReason::Breakpoint);
+  EXPECT_EQ(cpu.PC, 0x0C);
+  EXPECT_EQ(sim.stats().instructions, 3);
+}
+
+TEST_F(SimulatorTest, Fused_Compare_Branch_Saves_Dispatches) {
+  // CMP X1, #0 and B.NE run as one dispatch: 3 per 4-instruction iteration
+  load(COUNT_LOOP);
+  cpu.setReg(1, 3);
+  Simulator sim(cpu, memory);
+
+  EXPECT_EQ(sim.run_until(0x10), StopReason::Breakpoint);
+  EXPECT_EQ(sim.stats().instructions, 12);
+  EXPECT_EQ(sim.stats().dispatches, 9);
+  EXPECT_DOUBLE_EQ(sim.stats().dispatchesPerInstruction(), 0.75);
+}
+
+TEST_F(SimulatorTest, Budget_Inside_Fused_Pair_Matches_Step) {
+  // Every budget, including ones that end between CMP and B.NE, leaves the
+  // same state as stepping one instruction at a time
+  load(COUNT_LOOP);
+  for (uint64_t budget = 1; budget <= 12; budget++) {
+    arm64::CPUState ran{};
+    ran.setReg(1, 3);
+    arm64::CPUState stepped = ran;
+    Simulator running(ran, memory);
+    Simulator stepping(stepped, memory);
+    running.run(budget);
+    for (uint64_t i = 0; i < budget; i++) {
+      stepping.step();
+    }
+    EXPECT_EQ(ran.PC, stepped.PC) << budget;
+    EXPECT_EQ(ran.X, stepped.X) << budget;
+    EXPECT_EQ(ran.pstate.nzcv(), stepped.pstate.nzcv()) << budget;
+  }
+}
+
+TEST_F(SimulatorTest, Flags_After_Fused_Compare_Branch_Stay_Readable) {
+  // The loop exit leaves NZCV = 0110 from SUBS; the B.cond after it reads C,
+  // Z and N in later blocks, which the fused pair never derived
+  //   0x00: SUBS X1, X1, #1
+  //   0x04: B.NE 0x00
+  //   0x08: B.HS 0x10          (taken: C)
+  //   0x0C: ADD  X0, X0, #1
+  //   0x10: B.EQ 0x18          (taken: Z)
+  //   0x14: ADD  X0, X0, #2
+  //   0x18: B.MI 0x20          (not taken: N clear)
+  //   0x1C: ADD  X2, X2, #1
+  load({0xF1000421, 0x54FFFFE1, 0x54000042, 0x91000400, 0x54000040,
+        0x91000800, 0x54000044, 0x91000442});
+  cpu.setReg(1, 3);
+  arm64::CPUState stepped = cpu;
+  Simulator running(cpu, memory);
+  ASSERT_EQ(running.run_until(0x08), StopReason::Breakpoint);
+  EXPECT_LT(running.stats().dispatches, running.stats().instructions);
+  EXPECT_EQ(cpu.pstate.nzcv(), arm64::FLAG_Z | arm64::FLAG_C);
+
+  EXPECT_EQ(running.run(), StopReason::UndefinedInstruction);
+  EXPECT_EQ(cpu.PC, 0x20);
+  EXPECT_EQ(cpu.getReg(0), 0);
+  EXPECT_EQ(cpu.getReg(2), 1);
+
+  Simulator stepping(stepped, memory);
+  while (stepping.step() == StopReason::Retired) {
+  }
+  EXPECT_EQ(stepped.X, cpu.X);
+  EXPECT_EQ(stepped.pstate.nzcv(), cpu.pstate.nzcv());
+}
+
+TEST_F(SimulatorTest, Report_Contains_Throughput) {
+  load(COUNT_LOOP);
+  cpu.setReg(1, 3);
+  Simulator sim(cpu, memory);
+  sim.run();
+
+  std::ostringstream out;
+  sim.report(out);
+  EXPECT_NE(out.str().find("instructions retired: 12"), std::string::npos);
+  EXPECT_NE(out.str().find("dispatches/instr:"), std::string::npos);
+  EXPECT_NE(out.str().find("MIPS"), std::string::npos);
+  EXPECT_GE(sim.stats().mips(), 0.0);
+}
+
+TEST_F(SimulatorTest, Restore_Returns_To_Snapshot) {
+  load(COUNT_LOOP);
+  cpu.setReg(1, 3);
+  memory.write64(0x800, 42);
+  Simulator sim(cpu, memory);
+  EXPECT_FALSE(sim.restore());
+  sim.snapshot();
+
+  sim.run();
+  memory.write64(0x800, 0);
+  memory.write<uint32_t>(0, 0x91000C00); // ADD X0, X0, #3 replaces #2
+  ASSERT_TRUE(sim.restore());
+  EXPECT_EQ(cpu.PC, 0);
+  EXPECT_EQ(cpu.getReg(0), 0);
+  EXPECT_EQ(cpu.getReg(1), 3);
+  EXPECT_EQ(memory.read64(0x800), 42);
+
+  sim.run(); // Blocks decoded from the patched word must be gone
+  EXPECT_EQ(cpu.getReg(0), 6);
+}
+
+namespace {
+struct Recorder : RetireObserver {
+  std::vector<RetiredInstruction> seen;
+  std::vector<InstructionType> types;
+  void onRetire(const RetiredInstruction &retired) override {
+    seen.push_back(retired);
+    types.push_back(retired.instr->type);
+  }
+};
+} // namespace
+
+TEST_F(SimulatorTest, Observers_See_Every_Retired_Instruction) {
+  // 0x00: STR X0, [X10], #8; SUB X1, X1, #1; CMP X1, #0; B.NE 0x00
+  load({0xF8008540, 0xD1000421, 0xF100003F, 0x54FFFFA1});
+  cpu.setReg(1, 3);
+  cpu.setReg(10, 0x800);
+  arm64::CPUState plainCpu = cpu;
+  Memory plainMemory{4096};
+  for (uint64_t a = 0; a < 16; a += 4) {
+    plainMemory.write<uint32_t>(a, memory.read<uint32_t>(a));
+  }
+
+  Recorder recorder;
+  Simulator sim(cpu, memory);
+  sim.addObserver(&recorder);
+  EXPECT_EQ(sim.run(), StopReason::UndefinedInstruction);
+  Simulator plain(plainCpu, plainMemory);
+  plain.run();
+
+  ASSERT_EQ(recorder.seen.size(), 12);
+  EXPECT_EQ(sim.stats().instructions, 12);
+  EXPECT_EQ(cpu.X, plainCpu.X); // Observed runs compute the same state
+  EXPECT_EQ(cpu.PC, plainCpu.PC);
+  for (size_t i = 0; i < 12; i += 4) {
+    EXPECT_EQ(recorder.seen[i].pc, 0);
+    EXPECT_EQ(recorder.seen[i].address, 0x800 + i * 2); // Post-index base
+    EXPECT_EQ(recorder.types[i + 3], InstructionType::BRANCH_COND);
+    EXPECT_EQ(recorder.seen[i + 3].address, 0);
+    EXPECT_EQ(recorder.seen[i + 3].taken, i < 8);
+  }
+
+  sim.removeObserver(&recorder);
+  cpu.PC = 0;
+  cpu.setReg(1, 1);
+  sim.run();
+  EXPECT_EQ(recorder.seen.size(), 12);
+}
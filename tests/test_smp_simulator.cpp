@@ -0,0 +1,152 @@
+#include "smp_simulator.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+class SmpSimulatorTest : public ::testing::Test {
+protected:
+  Memory memory{1 << 20};
+
+  void load(const std::vector<uint32_t> &words, uint64_t base = 0) {
+    for (size_t i = 0; i < words.size(); i++) {
+      memory.write<uint32_t>(base + i * 4, words[i]);
+    }
+  }
+};
+
+// ADD X0, X0, #2; SUB X1, X1, #1; CMP X1, #0; B.NE #-12; STR X0, [X4]
+const std::vector<uint32_t> COUNT_AND_PUBLISH = {
+    0x91000800, 0xD1000421, 0xF100003F, 0x54FFFFA1, 0xF9000080};
+
+// Non-atomic increment of the counter at [X3], X1 times:
+// LDR X2, [X3]; ADD X2, X2, #1; STR X2, [X3]; SUB X1, X1, #1; CMP X1, #0;
+// B.NE #-20
+const std::vector<uint32_t> SHARED_INCREMENT = {
+    0xF9400062, 0x91000442, 0xF9000062,
+    0xD1000421, 0xF100003F, 0x54FFFF61};
+
+TEST_F(SmpSimulatorTest, Cores_Run_Independently_On_Threads) {
+  load(COUNT_AND_PUBLISH);
+  std::vector<arm64::CPUState> cpus(4, arm64::CPUState{});
+  for (size_t i = 0; i < cpus.size(); i++) {
+    cpus[i].setReg(1, 1000 * (i + 1));
+    cpus[i].setReg(4, 0x8000 + 8 * i);
+  }
+  SmpSimulator smp(cpus, memory, {100, false});
+  smp.run();
+
+  for (size_t i = 0; i < cpus.size(); i++) {
+    EXPECT_EQ(smp.stopReason(i), StopReason::UndefinedInstruction);
+    EXPECT_EQ(cpus[i].getReg(0), 2000 * (i + 1));
+    EXPECT_EQ(memory.read64(0x8000 + 8 * i), 2000 * (i + 1)); // Shared pages
+  }
+  EXPECT_EQ(smp.totalInstructions(), 4 * (4 * 2500) + 4);
+}
+
+TEST_F(SmpSimulatorTest, Budget_Is_Per_Core) {
+  load({0x91000400, 0x17FFFFFF}); // ADD X0, X0, #1; B #-4
+  std::vector<arm64::CPUState> cpus(3, arm64::CPUState{});
+  SmpSimulator smp(cpus, memory, {7, false});
+  smp.run(100);
+
+  for (size_t i = 0; i < cpus.size(); i++) {
+    EXPECT_EQ(smp.stopReason(i), StopReason::InstructionLimit);
+    EXPECT_EQ(smp.core(i).stats().instructions, 100);
+    EXPECT_EQ(cpus[i].getReg(0), 50);
+  }
+}
+
+TEST_F(SmpSimulatorTest, Deterministic_Mode_Is_Reproducible) {
+  auto run_once = [this](uint64_t quantum) {
+    memory.write64(0x8000, 0);
+    std::vector<arm64::CPUState> cpus(3, arm64::CPUState{});
+    for (auto &cpu : cpus) {
+      cpu.setReg(1, 500);
+      cpu.setReg(3, 0x8000);
+    }
+    SmpSimulator smp(cpus, memory, {quantum, true});
+    smp.run();
+    return memory.read64(0x8000);
+  };
+  load(SHARED_INCREMENT);
+
+  uint64_t first = run_once(13);
+  EXPECT_EQ(run_once(13), first);
+  // Quantum boundaries inside LDR..STR lose updates; none with whole runs
+  EXPECT_LT(first, 1500);
+  EXPECT_EQ(run_once(1'000'000), 1500);
+}
+
+TEST_F(SmpSimulatorTest, Report_Lists_Every_Core) {
+  load(COUNT_AND_PUBLISH);
+  std::vector<arm64::CPUState> cpus(2, arm64::CPUState{});
+  for (auto &cpu : cpus) {
+    cpu.setReg(1, 10);
+    cpu.setReg(4, 0x8000);
+  }
+  SmpSimulator smp(cpus, memory);
+  smp.run();
+
+  std::ostringstream out;
+  smp.report(out);
+  EXPECT_NE(out.str().find("core 1 instructions"), std::string::npos);
+  EXPECT_NE(out.str().find("aggregate MIPS"), std::string::npos);
+}
+
+TEST_F(SmpSimulatorTest, Views_Share_Pages_And_Grow_Concurrently) {
+  constexpr uint64_t PAGES_PER_THREAD = 64;
+  std::vector<std::unique_ptr<Memory>> views;
+  for (int i = 0; i < 4; i++) {
+    views.push_back(memory.makeView());
+  }
+  std::vector<std::thread> threads;
+  for (uint64_t t = 0; t < views.size(); t++) {
+    threads.emplace_back([&, t] {
+      for (uint64_t p = 0; p < PAGES_PER_THREAD; p++) {
+        uint64_t addr = ((p * views.size() + t) << Memory::PAGE_SHIFT) + 8;
+        views[t]->write64(addr, addr);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(memory.residentPages(), PAGES_PER_THREAD * views.size());
+  for (uint64_t page = 0; page < PAGES_PER_THREAD * views.size(); page++) {
+    uint64_t addr = (page << Memory::PAGE_SHIFT) + 8;
+    EXPECT_EQ(memory.read64(addr), addr);
+  }
+}
+
+TEST_F(SmpSimulatorTest, Code_Write_Through_Other_View_Invalidates_Block) {
+  load({0x91000800, 0x14000000});
+  std::unique_ptr<Memory> other = memory.makeView();
+  BlockCache cache(memory);
+  cache.lookup(0);
+  ASSERT_EQ(cache.size(), 1);
+
+  other->write<uint32_t>(4, 0x91000400); // Seen at the next lookup
+  EXPECT_EQ(cache.size(), 1);
+  EXPECT_EQ(cache.lookup(0x100)->instructions.size(), 0);
+  EXPECT_EQ(cache.size(), 1); // Only the new (empty) block is left
+  EXPECT_EQ(cache.stats().invalidations, 1);
+}
+
+TEST_F(SmpSimulatorTest, Code_Page_Cached_As_Data_By_Other_View) {
+  load({0x91000800, 0x14000000}, 0x1000);
+  std::unique_ptr<Memory> other = memory.makeView();
+  other->write<uint64_t>(0x1100, 1); // Page now in the other view's write TLB
+  other->write<uint64_t>(0x1108, 2); // ... and hitting it
+  BlockCache cache(memory);
+  cache.lookup(0x1000);
+  ASSERT_EQ(cache.size(), 1);
+
+  // The other core never reaches a block boundary, yet its next store to
+  // the page must still be reported
+  other->write<uint32_t>(0x1004, 0x91000400);
+  cache.lookup(0x2000);
+  EXPECT_EQ(cache.stats().invalidations, 1);
+  EXPECT_EQ(cache.lookup(0x1000)->instructions.size(), 2);
+  EXPECT_EQ(memory.read<uint64_t>(0x1108), 2);
+}
@@ -0,0 +1,140 @@
+#include "executor.h"
+#include "simulator.h"
+#include "threaded_executor.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+// Runs the same guest code through the switch engine and the threaded engine
+// and checks that they leave identical architectural state behind.
+class ThreadedExecutorTest : public ::testing::Test {
+protected:
+  Memory memory{4096};
+
+  void load(const std::vector<uint32_t> &words, uint64_t base = 0) {
+    for (size_t i = 0; i < words.size(); i++) {
+      for (uint32_t b = 0; b < 4; b++) {
+        memory.writeByte(base + i * 4 + b, (words[i] >> (b * 8)) & 0xFF);
+      }
+    }
+  }
+
+  static void expect_same_state(const arm64::CPUState &a,
+                                const arm64::CPUState &b) {
+    for (size_t i = 0; i < a.X.size(); i++) {
+      EXPECT_EQ(a.X[i], b.X[i]) << "X" << i;
+    }
+    EXPECT_EQ(a.PC, b.PC);
+    EXPECT_EQ(a.SP, b.SP);
+    EXPECT_EQ(a.pstate.nzcv(), b.pstate.nzcv());
+  }
+};
+
+TEST_F(ThreadedExecutorTest, Matches_Switch_Engine_On_Block) {
+  // ADD X0, X0, #2; ADD X2, X0, X1; SUB X1, X1, #1; CMP X1, #0; B.NE #-16
+  load({0x91000800, 0x8B010002, 0xD1000421, 0xF100003F, 0x54FFFF81});
+  BlockCache cache(memory);
+  const BasicBlock *block = cache.lookup(0);
+  ASSERT_EQ(block->instructions.size(), 5);
+
+  arm64::CPUState viaSwitch{};
+  viaSwitch.setReg(1, 3);
+  arm64::CPUState viaThreaded = viaSwitch;
+
+  EXPECT_EQ(Executor::runBlock(*block, 5, viaSwitch, memory), 5);
+  EXPECT_EQ(ThreadedExecutor::runBlock(*block, 5, viaThreaded, memory), 5);
+  expect_same_state(viaSwitch, viaThreaded);
+  EXPECT_EQ(viaThreaded.PC, 0); // Branch taken back to the start
+}
+
+TEST_F(ThreadedExecutorTest, Stops_At_Count) {
+  load({0x91000800, 0x91000800, 0x91000800, 0x14000000});
+  BlockCache cache(memory);
+  const BasicBlock *block = cache.lookup(0);
+
+  arm64::CPUState cpu{};
+  EXPECT_EQ(ThreadedExecutor::runBlock(*block, 2, cpu, memory), 2);
+  EXPECT_EQ(cpu.getReg(0), 4);
+  EXPECT_EQ(cpu.PC, 8);
+}
+
+TEST_F(ThreadedExecutorTest, Not_Taken_Branch_Falls_Through) {
+  load({0xF100003F, 0x54000040}); // CMP X1, #0; B.EQ #8
+  BlockCache cache(memory);
+  const BasicBlock *block = cache.lookup(0);
+
+  arm64::CPUState cpu{};
+  cpu.setReg(1, 1);
+  EXPECT_EQ(ThreadedExecutor::runBlock(*block, 2, cpu, memory), 2);
+  EXPECT_EQ(cpu.PC, 8);
+}
+
+TEST_F(ThreadedExecutorTest, Stops_After_Self_Modifying_Store) {
+  // STR X3, [X2] over the next instruction, then ADD X0, X0, #1
+  load({0xF9000043, 0x91000400, 0x91000400});
+  BlockCache cache(memory);
+  const BasicBlock *block = cache.lookup(0);
+
+  arm64::CPUState cpu{};
+  cpu.setReg(2, 4);
+  EXPECT_EQ(ThreadedExecutor::runBlock(*block, 3, cpu, memory), 1);
+  EXPECT_FALSE(block->valid);
+  EXPECT_EQ(cpu.PC, 4);
+}
+
+TEST_F(ThreadedExecutorTest, Simulator_Runs_With_Configured_Engine) {
+  load({0x91000800, 0xD1000421, 0xF100003F, 0x54FFFFA1});
+  arm64::CPUState cpu{};
+  cpu.setReg(1, 100);
+  Simulator sim(cpu, memory);
+
+  EXPECT_EQ(sim.run(), StopReason::UndefinedInstruction);
+  EXPECT_EQ(cpu.getReg(0), 200);
+  EXPECT_EQ(sim.stats().instructions, 400);
+}
+
+TEST_F(ThreadedExecutorTest, Fused_Add_Load_Matches_Separate_Ops) {
+  // ADD X2, X10, #8 then LDR X3, [X2, #16]!, LDR X3, [X2], #16 and
+  // LDR X2, [X2], run fused by both engines and unfused by the switch
+  memory.write64(0x108, 55);
+  memory.write64(0x118, 66);
+  for (uint32_t second : {0xF8410C43U, 0xF8410443U, 0xF9400042U}) {
+    load({0x91002142, second});
+    BlockCache fusedCache(memory);
+    BlockCache plainCache(memory, false);
+    const BasicBlock *fused = fusedCache.lookup(0);
+    const BasicBlock *plain = plainCache.lookup(0);
+    ASSERT_EQ(fused->fusion[0], MacroOp::AddLoad) << std::hex << second;
+
+    arm64::CPUState separate{};
+    separate.setReg(10, 0x100);
+    arm64::CPUState viaSwitch = separate;
+    arm64::CPUState viaThreaded = separate;
+    EXPECT_EQ(Executor::runBlock(*plain, 2, separate, memory), 2);
+    EXPECT_EQ(Executor::runBlock(*fused, 2, viaSwitch, memory), 2);
+    EXPECT_EQ(ThreadedExecutor::runBlock(*fused, 2, viaThreaded, memory), 2);
+    expect_same_state(separate, viaSwitch);
+    expect_same_state(separate, viaThreaded);
+  }
+}
+
+TEST_F(ThreadedExecutorTest, Matches_Switch_Engine_On_Fused_Pairs) {
+  // ADD X2, X10, #8; LDR X3, [X2]; SUBS W1, W1, #1; B.GT #-12, cut at every
+  // count so the pairs also run split
+  load({0x91002142, 0xF9400043, 0x71000421, 0x54FFFFAC});
+  memory.write64(0x108, 77);
+  BlockCache cache(memory);
+  const BasicBlock *block = cache.lookup(0);
+  ASSERT_EQ(block->fusion[0], MacroOp::AddLoad);
+  ASSERT_EQ(block->fusion[2], MacroOp::CompareBranch);
+
+  for (uint64_t count = 1; count <= 4; count++) {
+    arm64::CPUState viaSwitch{};
+    viaSwitch.setReg(1, 2);
+    viaSwitch.setReg(10, 0x100);
+    arm64::CPUState viaThreaded = viaSwitch;
+    EXPECT_EQ(Executor::runBlock(*block, count, viaSwitch, memory), count);
+    EXPECT_EQ(ThreadedExecutor::runBlock(*block, count, viaThreaded, memory),
+              count);
+    expect_same_state(viaSwitch, viaThreaded);
+  }
+}
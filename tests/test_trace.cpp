@@ -0,0 +1,138 @@
+#include "guest_program.h"
+#include "trace.h"
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>
+
+namespace {
+auto event(uint64_t pc) -> TraceEvent {
+  TraceEvent e;
+  e.pc = pc;
+  e.type = static_cast<uint8_t>(InstructionType::BRANCH);
+  return e;
+}
+} // namespace
+
+TEST(TraceTest, Ring_Keeps_Newest_Events) {
+  TraceBuffer trace(4);
+  for (uint64_t pc = 0; pc < 6; pc++) {
+    trace.record(event(pc * 4));
+  }
+  EXPECT_EQ(trace.total(), 6);
+  EXPECT_EQ(trace.dropped(), 2);
+  auto held = trace.snapshot();
+  ASSERT_EQ(held.size(), 4);
+  EXPECT_EQ(held.front().pc, 8);
+  EXPECT_EQ(held.back().pc, 20);
+}
+
+TEST(TraceTest, Capacity_Rounds_Up_To_Power_Of_Two) {
+  TraceBuffer trace(5);
+  EXPECT_EQ(trace.capacity(), 8);
+}
+
+TEST(TraceTest, Dump_Round_Trips) {
+  char name[] = "/tmp/trace_testXXXXXX";
+  int fd = mkstemp(name);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  TraceBuffer trace(2);
+  for (uint64_t pc = 0; pc < 3; pc++) {
+    trace.record(event(pc));
+  }
+  ASSERT_TRUE(trace.dump(name));
+  std::vector<TraceEvent> events;
+  TraceBuffer::FileHeader header{};
+  ASSERT_TRUE(TraceBuffer::readFile(name, events, &header));
+  EXPECT_EQ(header.count, 2);
+  EXPECT_EQ(header.dropped, 1);
+  ASSERT_EQ(events.size(), 2);
+  EXPECT_EQ(events[0].pc, 1);
+  EXPECT_EQ(events[1].pc, 2);
+  std::remove(name);
+
+  EXPECT_FALSE(TraceBuffer::readFile(std::string(name) + ".missing", events));
+}
+
+TEST(TraceTest, Read_Rejects_Truncated_And_Corrupt_Dumps) {
+  char name[] = "/tmp/trace_testXXXXXX";
+  int fd = mkstemp(name);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  TraceBuffer trace(4);
+  for (uint64_t pc = 0; pc < 3; pc++) {
+    trace.record(event(pc));
+  }
+  ASSERT_TRUE(trace.dump(name));
+  std::vector<TraceEvent> events;
+  const off_t full = sizeof(TraceBuffer::FileHeader) + 3 * sizeof(TraceEvent);
+  // Cut inside the last event, then exactly after the second one
+  ASSERT_EQ(truncate(name, full - 1), 0);
+  EXPECT_FALSE(TraceBuffer::readFile(name, events));
+  ASSERT_EQ(truncate(name, full - sizeof(TraceEvent)), 0);
+  EXPECT_FALSE(TraceBuffer::readFile(name, events));
+  // A header claiming an enormous count must not size the allocation
+  ASSERT_TRUE(trace.dump(name));
+  TraceBuffer::FileHeader header{};
+  FILE *file = std::fopen(name, "r+b");
+  ASSERT_NE(file, nullptr);
+  ASSERT_EQ(std::fread(&header, sizeof(header), 1, file), 1);
+  header.count = uint64_t{1} << 40;
+  std::rewind(file);
+  ASSERT_EQ(std::fwrite(&header, sizeof(header), 1, file), 1);
+  std::fclose(file);
+  EXPECT_FALSE(TraceBuffer::readFile(name, events));
+  std::remove(name);
+}
+
+TEST(TraceTest, Formats_Loads_And_Branches) {
+  TraceEvent load;
+  load.pc = 0x10;
+  load.type = static_cast<uint8_t>(InstructionType::LDR);
+  load.reg = 3;
+  load.address = 0x8000;
+  load.value = 0x2a;
+  EXPECT_EQ(TraceBuffer::format(load),
+            "0000000000000010  LDR     x3 <- [0000000000008000] = 2a");
+
+  TraceEvent branch;
+  branch.pc = 0xC;
+  branch.type = static_cast<uint8_t>(InstructionType::BRANCH_COND);
+  branch.address = 0;
+  EXPECT_EQ(TraceBuffer::format(branch),
+            "000000000000000c  B.cond  -> 0000000000000000 not taken");
+}
+
+TEST(TraceTest, Executor_Records_Only_When_Compiled_In) {
+  Memory memory{64 * 1024};
+  // LDR X0, [X10]; ADD X0, X0, #1; STR X0, [X10]; SUB X1, X1, #1;
+  // CMP X1, #0; B.NE #-20
+  load_words(memory, {0xF9400140, 0x91000400, 0xF9000140, 0xD1000421,
+                      0xF100003F, 0x54FFFF61});
+  arm64::CPUState cpu{};
+  cpu.setReg(1, 2);
+  cpu.setReg(10, 0x8000);
+  TraceBuffer trace;
+  TraceBuffer::attach(&trace);
+  Simulator sim(cpu, memory);
+  sim.run();
+  TraceBuffer::attach(nullptr);
+
+#if defined(AARCH64_SIM_TRACE)
+  auto events = trace.snapshot();
+  ASSERT_EQ(events.size(), 6); // LDR, STR, B.cond per iteration
+  EXPECT_EQ(events[0].type, static_cast<uint8_t>(InstructionType::LDR));
+  EXPECT_EQ(events[0].address, 0x8000);
+  EXPECT_EQ(events[1].type, static_cast<uint8_t>(InstructionType::STR));
+  EXPECT_EQ(events[1].value, 1);
+  EXPECT_EQ(events[2].pc, 0x14);
+  EXPECT_EQ(events[2].value, 1); // Taken
+  EXPECT_EQ(events[5].value, 0); // Falls out of the loop
+#else
+  EXPECT_EQ(trace.total(), 0);
+#endif
+  EXPECT_EQ(memory.read64(0x8000), 2);
+}
@@ -0,0 +1,299 @@
+// sim_run: load a static AArch64 ELF executable and run it, optionally with
+// timing models attached.
+//
+//   sim_run ELF [--max N] [--pipeline CONFIG] [--ooo CONFIG]
+//               [--caches CONFIG] [--prefetch CONFIG] [--branch CONFIG]
+//               [--pmu FILE [--pmu-interval N]] [--profile time|perf]
+//               [--sample N [--folded FILE]]
+//
+//   --max N              stop after N instructions
+//   --pipeline CONFIG    attach an InOrderPipeline configured from CONFIG
+//                        (see configs/in_order.cfg) and report cycles and CPI
+//   --ooo CONFIG         attach an OutOfOrderPipeline configured from CONFIG
+//                        (see configs/ooo_wide.cfg) and report IPC, stalls
+//                        and critical-path hints
+//   --caches CONFIG      attach a CacheHierarchy configured from CONFIG
+//                        (see configs/caches.cfg) and report hits, misses
+//                        and evictions per level and the PCs missing most
+//   --prefetch CONFIG    attach a PrefetchModel configured from CONFIG (see
+//                        configs/prefetch.cfg) and report its accuracy,
+//                        coverage and timeliness; with --caches its
+//                        prefetches also fill the cache hierarchy
+//   --branch CONFIG      attach a BranchModel configured from CONFIG (see
+//                        configs/branch.cfg) and report MPKI and the worst
+//                        branches; with --ooo the core predicts with the
+//                        same kind of predictor instead of statically
+//   --pmu FILE           write the guest performance counters to FILE as a
+//                        JSON object (needs a -DAARCH64_SIM_PMU=ON build)
+//   --pmu-interval N     with --pmu, write one JSON object per line for
+//                        every N instructions instead, each holding the
+//                        counts of that interval
+//   --profile time|perf  report the host time spent fetching, decoding,
+//                        executing and accessing guest memory; perf adds
+//                        cycles, branch misses and cache misses from
+//                        perf_event_open (needs a -DAARCH64_SIM_PROFILE=ON
+//                        build)
+//   --sample N           sample the guest PC every N instructions and report
+//                        the hottest functions and PCs, symbolised with the
+//                        ELF's symbol table
+//   --folded FILE        with --sample, also write the samples to FILE as
+//                        folded stacks for flamegraph tools
+//
+// The stack pointer starts at the top of the guest address space.
+#include "branch_predictor.h"
+#include "cache_model.h"
+#include "elf_loader.h"
+#include "host_profiler.h"
+#include "ooo_pipeline.h"
+#include "pc_profiler.h"
+#include "pipeline_model.h"
+#include "pmu.h"
+#include "prefetcher.h"
+#include "simulator.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace {
+constexpr uint64_t STACK_TOP = Memory::MAX_SIZE - 16;
+
+auto usage(const char *program) -> int {
+  std::cerr << "usage: " << program
+            << " ELF [--max N] [--pipeline CONFIG] [--ooo CONFIG]"
+               " [--caches CONFIG] [--prefetch CONFIG] [--branch CONFIG]"
+               " [--pmu FILE [--pmu-interval N]] [--profile time|perf]"
+               " [--sample N [--folded FILE]]\n";
+  return 2;
+}
+
+// Read a model configuration, reporting why it cannot be used
+template <typename Config>
+auto load_config(const char *path, std::optional<Config> &config) -> bool {
+  config.emplace();
+  std::string error;
+  if (!config->load(path, error)) {
+    std::cerr << error << "\n";
+    return false;
+  }
+  return true;
+}
+
+// Run sim in slices of interval instructions, writing the counts of each
+// slice to out as one line of JSON
+auto run_sampled(Simulator &sim, uint64_t maxInstructions, uint64_t interval,
+                 const PmuCounters &pmu, std::ostream &out) -> StopReason {
+  uint64_t left = maxInstructions;
+  PmuCounters last = pmu;
+  StopReason reason = StopReason::InstructionLimit;
+  while (left > 0 && reason == StopReason::InstructionLimit) {
+    uint64_t before = sim.stats().instructions;
+    reason = sim.run(std::min(interval, left));
+    left -= sim.stats().instructions - before;
+    pmu.since(last).writeJson(out);
+    out << "\n";
+    last = pmu;
+  }
+  return reason;
+}
+} // namespace
+
+auto main(int argc, char **argv) -> int {
+  if (argc < 2) {
+    return usage(argv[0]);
+  }
+  uint64_t maxInstructions = Simulator::NO_LIMIT;
+  std::optional<PipelineConfig> pipelineConfig;
+  std::optional<OutOfOrderConfig> coreConfig;
+  std::optional<CacheHierarchyConfig> cacheConfig;
+  std::optional<PrefetchConfig> prefetchConfig;
+  std::optional<BranchConfig> branchConfig;
+  const char *pmuPath = nullptr;
+  uint64_t pmuInterval = 0;
+  std::unique_ptr<HostProfiler> profiler;
+  uint64_t samplePeriod = 0;
+  const char *foldedPath = nullptr;
+  for (int i = 2; i < argc; i++) {
+    std::string option = argv[i];
+    if (i + 1 >= argc) {
+      return usage(argv[0]);
+    }
+    const char *value = argv[++i];
+    bool loaded = true;
+    if (option == "--max") {
+      maxInstructions = std::strtoull(value, nullptr, 10);
+    } else if (option == "--pipeline") {
+      loaded = load_config(value, pipelineConfig);
+    } else if (option == "--ooo") {
+      loaded = load_config(value, coreConfig);
+    } else if (option == "--caches") {
+      loaded = load_config(value, cacheConfig);
+    } else if (option == "--prefetch") {
+      loaded = load_config(value, prefetchConfig);
+    } else if (option == "--branch") {
+      loaded = load_config(value, branchConfig);
+    } else if (option == "--pmu") {
+      pmuPath = value;
+    } else if (option == "--pmu-interval") {
+      pmuInterval = std::strtoull(value, nullptr, 10);
+    } else if (option == "--profile") {
+      bool perf = std::strcmp(value, "perf") == 0;
+      if (!perf && std::strcmp(value, "time") != 0) {
+        return usage(argv[0]);
+      }
+      profiler = std::make_unique<HostProfiler>(perf);
+    } else if (option == "--sample") {
+      samplePeriod = std::strtoull(value, nullptr, 10);
+    } else if (option == "--folded") {
+      foldedPath = value;
+    } else {
+      return usage(argv[0]);
+    }
+    if (!loaded) {
+      return 1;
+    }
+  }
+  if (foldedPath != nullptr && samplePeriod == 0) {
+    return usage(argv[0]);
+  }
+  if (pmuInterval > 0 && pmuPath == nullptr) {
+    return usage(argv[0]);
+  }
+  if (samplePeriod > 0 && pmuInterval > 0) {
+    std::cerr << "--sample and --pmu-interval cannot be combined\n";
+    return 2;
+  }
+  std::unique_ptr<InOrderPipeline> pipeline;
+  std::unique_ptr<OutOfOrderPipeline> core;
+  std::unique_ptr<CacheHierarchy> caches;
+  std::unique_ptr<PrefetchModel> prefetch;
+  std::unique_ptr<BranchModel> branches;
+  if (pipelineConfig) {
+    pipeline = std::make_unique<InOrderPipeline>(*pipelineConfig);
+  }
+  if (coreConfig) {
+    core = std::make_unique<OutOfOrderPipeline>(
+        *coreConfig, branchConfig ? make_predictor(*branchConfig) : nullptr);
+  }
+  if (cacheConfig) {
+    caches = std::make_unique<CacheHierarchy>(*cacheConfig);
+  }
+  if (prefetchConfig) {
+    prefetch = std::make_unique<PrefetchModel>(*prefetchConfig, caches.get());
+  }
+  if (branchConfig) {
+    branches = std::make_unique<BranchModel>(*branchConfig);
+  }
+
+  Memory mem(Memory::MAX_SIZE);
+  arm64::CPUState cpu{};
+  ElfImage image;
+  if (!image.load(argv[1], mem, cpu)) {
+    std::cerr << argv[1] << ": " << image.error() << "\n";
+    return 1;
+  }
+  cpu.SP = STACK_TOP;
+
+  Simulator sim(cpu, mem);
+  if (pipeline) {
+    sim.addObserver(pipeline.get());
+  }
+  if (core) {
+    sim.addObserver(core.get());
+  }
+  if (caches) {
+    sim.addObserver(caches.get());
+  }
+  if (prefetch) {
+    sim.addObserver(prefetch.get());
+  }
+  if (branches) {
+    sim.addObserver(branches.get());
+  }
+  PmuCounters pmu;
+  std::ofstream pmuOut;
+  if (pmuPath != nullptr) {
+    pmuOut.open(pmuPath);
+    if (!pmuOut) {
+      std::cerr << pmuPath << ": cannot write\n";
+      return 1;
+    }
+#if !defined(AARCH64_SIM_PMU)
+    std::cerr << "warning: PMU counters are compiled out; configure with "
+                 "-DAARCH64_SIM_PMU=ON\n";
+#endif
+    PmuCounters::attach(&pmu);
+  }
+  if (profiler) {
+#if !defined(AARCH64_SIM_PROFILE)
+    std::cerr << "warning: the host profiler is compiled out; configure with "
+                 "-DAARCH64_SIM_PROFILE=ON\n";
+#endif
+    HostProfiler::attach(profiler.get());
+  }
+  std::optional<PcProfiler> sampler;
+  if (samplePeriod > 0) {
+    sampler.emplace(samplePeriod);
+  }
+  StopReason reason = StopReason::InstructionLimit;
+  if (pmuPath != nullptr && pmuInterval > 0) {
+    reason = run_sampled(sim, maxInstructions, pmuInterval, pmu, pmuOut);
+  } else if (sampler) {
+    reason = sampler->run(sim, cpu, maxInstructions);
+  } else {
+    reason = sim.run(maxInstructions);
+  }
+  if (pmuPath != nullptr && pmuInterval == 0) {
+    pmu.writeJson(pmuOut);
+    pmuOut << "\n";
+  }
+  PmuCounters::attach(nullptr);
+  HostProfiler::attach(nullptr);
+  std::cout << "stopped:              "
+            << (reason == StopReason::UndefinedInstruction
+                    ? "undefined instruction"
+                    : "instruction limit")
+            << " at pc 0x" << std::hex << cpu.PC << std::dec << "\n";
+  sim.report(std::cout);
+  if (pipeline) {
+    std::cout << "-- in-order pipeline\n";
+    pipeline->report(std::cout);
+  }
+  if (core) {
+    std::cout << "-- out-of-order core\n";
+    core->report(std::cout);
+  }
+  if (caches) {
+    std::cout << "-- caches\n";
+    caches->report(std::cout);
+  }
+  if (prefetch) {
+    std::cout << "-- prefetcher\n";
+    prefetch->report(std::cout);
+  }
+  if (branches) {
+    std::cout << "-- branch predictor\n";
+    branches->report(std::cout);
+  }
+  if (profiler) {
+    std::cout << "-- host profile\n";
+    profiler->report(std::cout);
+  }
+  if (sampler) {
+    std::cout << "-- guest profile\n";
+    sampler->report(std::cout, &image);
+    if (foldedPath != nullptr) {
+      std::ofstream folded(foldedPath);
+      sampler->writeFolded(folded, &image);
+      if (!folded) {
+        std::cerr << foldedPath << ": cannot write\n";
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,34 @@
+// trace_dump: print a TraceBuffer::dump() file as text, one event per line.
+//
+//   trace_dump FILE            every event, oldest first
+//   trace_dump FILE --tail N   only the newest N events
+#include "trace.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+auto main(int argc, char **argv) -> int {
+  if (argc != 2 && !(argc == 4 && std::strcmp(argv[2], "--tail") == 0)) {
+    std::fprintf(stderr, "usage: %s FILE [--tail N]\n", argv[0]);
+    return 2;
+  }
+  std::vector<TraceEvent> events;
+  TraceBuffer::FileHeader header{};
+  if (!TraceBuffer::readFile(argv[1], events, &header)) {
+    std::fprintf(stderr, "%s: not a readable trace file\n", argv[1]);
+    return 1;
+  }
+  size_t first = 0;
+  if (argc == 4) {
+    size_t tail = std::strtoull(argv[3], nullptr, 10);
+    first = events.size() > tail ? events.size() - tail : 0;
+  }
+  std::printf("# %llu events, %llu older events dropped\n",
+              static_cast<unsigned long long>(header.count),
+              static_cast<unsigned long long>(header.dropped));
+  for (size_t i = first; i < events.size(); i++) {
+    std::printf("%s\n", TraceBuffer::format(events[i]).c_str());
+  }
+  return 0;
+}